@@ -0,0 +1,846 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <streamer/streamer.h>
+#include "corpus.h"
+
+#include <fastlz/fastlz.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(STREAMER_WIN32)
+#include <windows.h>
+#elif defined(STREAMER_UNIX)
+#include <sched.h>
+#include <time.h>
+#endif
+
+typedef enum
+{
+	BenchPhase_Idle,
+	BenchPhase_Open,
+	BenchPhase_Read,
+	BenchPhase_Close
+} BenchPhase;
+
+typedef struct BenchSamples
+{
+	unsigned int* data;	// Latencies in microseconds
+	unsigned int count;
+	unsigned int capacity;
+} BenchSamples;
+
+typedef struct BenchSlot
+{
+	int fd;
+	BenchPhase phase;
+	unsigned int remaining;		// Bytes left to read in current file
+	unsigned long long submitted;	// Time when current request was submitted
+	unsigned char* buffer;
+} BenchSlot;
+
+typedef struct BenchTarget
+{
+	const char* name;
+	StreamerContainer container;
+	const char* root;
+	const char* file;
+} BenchTarget;
+
+typedef struct BenchResult
+{
+	unsigned long long bytes;
+	unsigned int files;
+	double seconds;
+
+	BenchSamples open;
+	BenchSamples read;
+	BenchSamples close;
+
+	StreamerStats stats;
+} BenchResult;
+
+#define BENCH_LOOKUP_BATCH (256)
+#define BENCH_LOOKUP_ROUNDS (4)
+
+#define BENCH_DECODE_BLOCK (16 * 1024)	// Same block size as the corpus archives
+#define BENCH_DECODE_SAMPLE (8 << 20)	// Uncompressed bytes sampled per file kind
+
+typedef struct BenchDecodeSample
+{
+	unsigned char* original;	// Compressible blocks, back to back
+	unsigned char* packed;		// The same blocks compressed, back to back
+	unsigned int* sizes;		// Compressed size of each block
+	unsigned int blocks;
+	unsigned int compressed;
+} BenchDecodeSample;
+
+static const char* s_kindNames[CorpusKind_Count] = { "text", "mesh", "audio", "texture" };
+static const char* s_decoderNames[] = { "scalar", "sse2", "avx2" };
+
+static const unsigned int s_readSizes[] = { 4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20 };
+static const unsigned int s_quickReadSizes[] = { 4 << 10, 64 << 10, 1 << 20, 16 << 20 };
+static const unsigned int s_handles[] = { 1, 2, 4, 8 };
+static const unsigned int s_quickHandles[] = { 1, 8 };
+
+static unsigned long long benchTime()
+{
+#if defined(STREAMER_WIN32)
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	if (!frequency.QuadPart)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (unsigned long long)((counter.QuadPart / frequency.QuadPart) * 1000000 + ((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((unsigned long long)now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+static void benchYield()
+{
+#if defined(STREAMER_WIN32)
+	SleepEx(0, TRUE);
+#elif defined(STREAMER_UNIX)
+	sched_yield();
+#endif
+}
+
+static int benchAddSample(BenchSamples* samples, unsigned long long value)
+{
+	if (samples->count == samples->capacity)
+	{
+		unsigned int capacity = samples->capacity ? samples->capacity * 2 : 1024;
+		unsigned int* data = realloc(samples->data, capacity * sizeof(unsigned int));
+
+		if (!data)
+		{
+			return -1;
+		}
+		samples->data = data;
+		samples->capacity = capacity;
+	}
+
+	samples->data[samples->count++] = value > 0xffffffff ? 0xffffffff : (unsigned int)value;
+	return 0;
+}
+
+static int benchCompare(const void* a, const void* b)
+{
+	unsigned int x = *(const unsigned int*)a;
+	unsigned int y = *(const unsigned int*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static unsigned int benchPercentile(const BenchSamples* samples, unsigned int permille)
+{
+	unsigned int index;
+
+	if (!samples->count)
+	{
+		return 0;
+	}
+
+	index = (unsigned int)(((unsigned long long)samples->count * permille + 999) / 1000);
+	return samples->data[index ? index - 1 : 0];
+}
+
+static void benchPrintSamples(FILE* out, const char* name, BenchSamples* samples)
+{
+	unsigned long long total = 0;
+	unsigned int i;
+
+	qsort(samples->data, samples->count, sizeof(unsigned int), benchCompare);
+	for (i = 0; i < samples->count; ++i)
+	{
+		total += samples->data[i];
+	}
+
+	fprintf(out, ",\"%s\":{\"count\":%u,\"mean_us\":%llu,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"p999_us\":%u,\"max_us\":%u}", name, samples->count, samples->count ? total / samples->count : 0, benchPercentile(samples, 500), benchPercentile(samples, 900), benchPercentile(samples, 990), benchPercentile(samples, 999), samples->count ? samples->data[samples->count - 1] : 0);
+}
+
+static int benchSubmitRead(StreamerContext* context, BenchSlot* slot, unsigned int readSize)
+{
+	unsigned int length = slot->remaining < readSize ? slot->remaining : readSize;
+
+	slot->phase = BenchPhase_Read;
+	slot->submitted = benchTime();
+	return streamerContextRead(context, slot->fd, slot->buffer, length);
+}
+
+static int benchRun(const BenchTarget* target, const Corpus* corpus, const unsigned int* order, unsigned int readSize, unsigned int handles, unsigned long long budget, BenchResult* result)
+{
+	BenchSlot slots[STREAMER_MAX_FILEHANDLES];
+	StreamerContext* context;
+	unsigned long long assigned = 0, start;
+	unsigned int cursor = 0, active = 0, bufferSize, i;
+	int failed = 0;
+
+	memset(result, 0, sizeof(BenchResult));
+	memset(slots, 0, sizeof(slots));
+
+	context = streamerCreateContext(StreamerTransport_FileIo, target->container, target->root, target->file);
+	if (!context)
+	{
+		fprintf(stderr, "Failed to create streamer context for %s\n", target->name);
+		return -1;
+	}
+
+	bufferSize = readSize < corpus->largest ? readSize : corpus->largest;
+	for (i = 0; i < handles; ++i)
+	{
+		slots[i].fd = -1;
+		slots[i].buffer = malloc(bufferSize);
+		if (!slots[i].buffer)
+		{
+			failed = 1;
+		}
+	}
+
+	start = benchTime();
+
+	while (!failed)
+	{
+		int progress = 0;
+
+		for (i = 0; (i < handles) && !failed; ++i)
+		{
+			BenchSlot* slot = &(slots[i]);
+			unsigned long long now;
+			int ret;
+
+			if (slot->phase == BenchPhase_Idle)
+			{
+				const CorpusFile* file;
+
+				if ((assigned >= budget) || (cursor == corpus->count))
+				{
+					continue;
+				}
+
+				file = &(corpus->files[order[cursor++]]);
+				assigned += file->size;
+
+				slot->remaining = file->size;
+				slot->phase = BenchPhase_Open;
+				slot->submitted = benchTime();
+				slot->fd = streamerContextOpen(context, file->path, StreamerOpenMode_Read);
+				if (slot->fd < 0)
+				{
+					fprintf(stderr, "Failed to submit open of \"%s\"\n", file->path);
+					failed = 1;
+					break;
+				}
+
+				++active;
+				progress = 1;
+				continue;
+			}
+
+			ret = streamerContextPoll(context, slot->fd);
+			if (ret == StreamerResult_Pending)
+			{
+				continue;
+			}
+
+			now = benchTime();
+			progress = 1;
+
+			if (ret < 0)
+			{
+				fprintf(stderr, "Request failed on %s (phase %d)\n", target->name, slot->phase);
+				failed = 1;
+				break;
+			}
+
+			switch (slot->phase)
+			{
+				case BenchPhase_Open:
+				{
+					benchAddSample(&(result->open), now - slot->submitted);
+					ret = benchSubmitRead(context, slot, readSize);
+				}
+				break;
+
+				case BenchPhase_Read:
+				{
+					benchAddSample(&(result->read), now - slot->submitted);
+					result->bytes += ret;
+					slot->remaining -= ret;
+
+					if (ret && slot->remaining)
+					{
+						ret = benchSubmitRead(context, slot, readSize);
+						break;
+					}
+
+					slot->phase = BenchPhase_Close;
+					slot->submitted = benchTime();
+					ret = streamerContextClose(context, slot->fd);
+				}
+				break;
+
+				default:
+				{
+					benchAddSample(&(result->close), now - slot->submitted);
+					slot->phase = BenchPhase_Idle;
+					slot->fd = -1;
+					++result->files;
+					--active;
+					ret = 0;
+				}
+				break;
+			}
+
+			if (ret < 0)
+			{
+				fprintf(stderr, "Failed to submit request on %s\n", target->name);
+				failed = 1;
+			}
+		}
+
+		if (!active && ((assigned >= budget) || (cursor == corpus->count)))
+		{
+			break;
+		}
+
+		if (!progress)
+		{
+			benchYield();
+		}
+	}
+
+	result->seconds = (double)(benchTime() - start) / 1000000.0;
+	streamerContextGetStats(context, &(result->stats));
+
+	for (i = 0; i < handles; ++i)
+	{
+		free(slots[i].buffer);
+	}
+
+	if (streamerDestroyContext(context) < 0)
+	{
+		failed = 1;
+	}
+
+	return failed ? -1 : 0;
+}
+
+static void benchReport(FILE* out, const BenchTarget* target, unsigned int readSize, unsigned int handles, const char* cache, BenchResult* result)
+{
+	double throughput = result->seconds > 0.0 ? ((double)result->bytes / (1024.0 * 1024.0)) / result->seconds : 0.0;
+
+	fprintf(out, "{\"target\":\"%s\",\"read_size\":%u,\"handles\":%u,\"cache\":\"%s\",\"files\":%u,\"bytes\":%llu,\"seconds\":%.6f,\"mb_per_s\":%.2f", target->name, readSize, handles, cache, result->files, result->bytes, result->seconds, throughput);
+
+	benchPrintSamples(out, "open", &(result->open));
+	benchPrintSamples(out, "read", &(result->read));
+	benchPrintSamples(out, "close", &(result->close));
+
+	fprintf(out, ",\"stats\":{\"chunks\":%llu,\"driver_us\":%llu,\"decompress_us\":%llu,\"bytes_decompressed\":%llu,\"cache_hits\":%llu,\"cache_misses\":%llu,\"block_hits\":%llu,\"block_misses\":%llu}}\n",
+		(unsigned long long)result->stats.chunks, (unsigned long long)result->stats.driverTime, (unsigned long long)result->stats.decompressTime,
+		(unsigned long long)result->stats.bytesDecompressed, (unsigned long long)result->stats.cacheHits, (unsigned long long)result->stats.cacheMisses,
+		(unsigned long long)result->stats.blockHits, (unsigned long long)result->stats.blockMisses);
+	fflush(out);
+
+	fprintf(stderr, "%-7s %9u bytes x %u handles, %-4s: %8.2f MB/s, read p50 %u us p99 %u us\n", target->name, readSize, handles, cache, throughput, benchPercentile(&(result->read), 500), benchPercentile(&(result->read), 990));
+}
+
+static int benchLookupBatch(StreamerContext* context, StreamerStat* stats, unsigned int count, unsigned long long* elapsed)
+{
+	unsigned long long start = benchTime();
+	int fd, ret;
+
+	fd = streamerContextStat(context, stats, count);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	while ((ret = streamerContextPoll(context, fd)) == StreamerResult_Pending)
+	{
+		benchYield();
+	}
+
+	*elapsed += benchTime() - start;
+	return ret;
+}
+
+static int benchLookup(FILE* out, const Corpus* corpus, const unsigned int* order)
+{
+	StreamerStat stats[BENCH_LOOKUP_BATCH];
+	char missing[BENCH_LOOKUP_BATCH][64];
+	unsigned long long hitTime = 0, missTime = 0;
+	unsigned int hits = 0, misses = 0, found = 0, round, i, j;
+	StreamerContext* context;
+	int failed = 0;
+
+	context = streamerCreateContext(StreamerTransport_FileIo, StreamerContainer_FileArchive, "", corpus->stored);
+	if (!context)
+	{
+		fprintf(stderr, "Failed to create streamer context for lookups\n");
+		return -1;
+	}
+
+	// Batches amortize the request round trip, so the time is dominated by the lookups themselves
+
+	for (round = 0; (round < BENCH_LOOKUP_ROUNDS) && !failed; ++round)
+	{
+		for (i = 0; (i < corpus->count) && !failed; i += BENCH_LOOKUP_BATCH)
+		{
+			unsigned int count = (corpus->count - i) < BENCH_LOOKUP_BATCH ? (corpus->count - i) : BENCH_LOOKUP_BATCH;
+			int ret;
+
+			memset(stats, 0, sizeof(stats));
+			for (j = 0; j < count; ++j)
+			{
+				stats[j].filename = corpus->files[order[i + j]].path;
+			}
+
+			ret = benchLookupBatch(context, stats, count, &hitTime);
+			if (ret < 0)
+			{
+				failed = 1;
+				break;
+			}
+			found += ret;
+			hits += count;
+
+			// Misses share the directory of an existing file, so they cost a full probe sequence
+
+			memset(stats, 0, sizeof(stats));
+			for (j = 0; j < count; ++j)
+			{
+				sprintf(missing[j], "%.*s/missing%u", (int)(strchr(corpus->files[order[i + j]].path, '/') - corpus->files[order[i + j]].path), corpus->files[order[i + j]].path, i + j);
+				stats[j].filename = missing[j];
+			}
+
+			ret = benchLookupBatch(context, stats, count, &missTime);
+			if (ret != 0)
+			{
+				failed = 1;
+				break;
+			}
+			misses += count;
+		}
+	}
+
+	if (streamerDestroyContext(context) < 0)
+	{
+		failed = 1;
+	}
+
+	if (failed || (found != hits))
+	{
+		fprintf(stderr, "Lookup benchmark failed (found %u of %u)\n", found, hits);
+		return -1;
+	}
+
+	fprintf(out, "{\"target\":\"lookup\",\"entries\":%u,\"batch\":%u,\"hits\":%u,\"misses\":%u,\"hit_ns\":%.1f,\"miss_ns\":%.1f}\n", corpus->count, BENCH_LOOKUP_BATCH, hits, misses, (double)hitTime * 1000.0 / hits, (double)missTime * 1000.0 / misses);
+	fflush(out);
+
+	fprintf(stderr, "lookup  %9u entries: hit %.1f ns, miss %.1f ns per lookup\n", corpus->count, (double)hitTime * 1000.0 / hits, (double)missTime * 1000.0 / misses);
+	return 0;
+}
+
+static int benchDecodeSample(const Corpus* corpus, CorpusKind kind, BenchDecodeSample* sample)
+{
+	unsigned char* scratch;
+	unsigned int length = 0, i;
+	char path[512];
+
+	memset(sample, 0, sizeof(BenchDecodeSample));
+
+	sample->original = malloc(BENCH_DECODE_SAMPLE);
+	sample->packed = malloc(BENCH_DECODE_SAMPLE);
+	sample->sizes = malloc((BENCH_DECODE_SAMPLE / BENCH_DECODE_BLOCK) * sizeof(unsigned int));
+	scratch = malloc(BENCH_DECODE_BLOCK * 2 + 66);
+	if (!sample->original || !sample->packed || !sample->sizes || !scratch)
+	{
+		free(scratch);
+		return -1;
+	}
+
+	for (i = 0; (i < corpus->count) && (length < BENCH_DECODE_SAMPLE); ++i)
+	{
+		FILE* in;
+
+		if (corpus->files[i].kind != kind)
+		{
+			continue;
+		}
+
+		sprintf(path, "%s%s", corpus->root, corpus->files[i].path);
+		in = fopen(path, "rb");
+		if (!in)
+		{
+			fprintf(stderr, "Failed to open \"%s\"\n", path);
+			free(scratch);
+			return -1;
+		}
+		length += (unsigned int)fread(sample->original + length, 1, BENCH_DECODE_SAMPLE - length, in);
+		fclose(in);
+	}
+
+	// Blocks that do not compress are stored in the archive and never decoded, so leave them out
+
+	for (i = 0; (i + BENCH_DECODE_BLOCK) <= length; i += BENCH_DECODE_BLOCK)
+	{
+		int packed = fastlz_compress(sample->original + i, BENCH_DECODE_BLOCK, scratch);
+
+		if (packed >= BENCH_DECODE_BLOCK)
+		{
+			continue;
+		}
+
+		memmove(sample->original + sample->blocks * BENCH_DECODE_BLOCK, sample->original + i, BENCH_DECODE_BLOCK);
+		memcpy(sample->packed + sample->compressed, scratch, packed);
+		sample->sizes[sample->blocks++] = (unsigned int)packed;
+		sample->compressed += (unsigned int)packed;
+	}
+
+	free(scratch);
+	return 0;
+}
+
+static int benchDecodeRound(int decoder, const BenchDecodeSample* sample, unsigned char* output)
+{
+	const unsigned char* packed = sample->packed;
+	unsigned int i;
+
+	for (i = 0; i < sample->blocks; ++i)
+	{
+		if (fastlz_decompress_using(decoder, packed, (int)sample->sizes[i], output + i * BENCH_DECODE_BLOCK, BENCH_DECODE_BLOCK) != BENCH_DECODE_BLOCK)
+		{
+			return -1;
+		}
+		packed += sample->sizes[i];
+	}
+
+	return 0;
+}
+
+static int benchDecode(FILE* out, const Corpus* corpus, unsigned long long budget)
+{
+	BenchDecodeSample sample;
+	unsigned int kind;
+	int failed = 0, decoder;
+
+	for (kind = 0; (kind < CorpusKind_Count) && !failed; ++kind)
+	{
+		unsigned char* output = 0;
+		double scalar = 0.0;
+
+		if (benchDecodeSample(corpus, (CorpusKind)kind, &sample) < 0)
+		{
+			failed = 1;
+		}
+		else if (!sample.blocks)
+		{
+			fprintf(stderr, "decode  %-7s: no compressible blocks, skipped\n", s_kindNames[kind]);
+		}
+		else if (!(output = malloc(sample.blocks * BENCH_DECODE_BLOCK)))
+		{
+			failed = 1;
+		}
+
+		for (decoder = FASTLZ_DECODER_SCALAR; (decoder <= FASTLZ_DECODER_AVX2) && output && !failed; ++decoder)
+		{
+			unsigned long long decoded = 0, start;
+			double seconds, throughput;
+
+			if (!fastlz_decoder_supported(decoder))
+			{
+				continue;
+			}
+
+			// Every decoder has to reproduce the input exactly before it is timed
+
+			memset(output, 0, sample.blocks * BENCH_DECODE_BLOCK);
+			if ((benchDecodeRound(decoder, &sample, output) < 0) || memcmp(output, sample.original, sample.blocks * BENCH_DECODE_BLOCK))
+			{
+				fprintf(stderr, "Decoder %s does not reproduce the %s sample\n", s_decoderNames[decoder - 1], s_kindNames[kind]);
+				failed = 1;
+				break;
+			}
+
+			start = benchTime();
+			while (decoded < budget)
+			{
+				benchDecodeRound(decoder, &sample, output);
+				decoded += sample.blocks * BENCH_DECODE_BLOCK;
+			}
+			seconds = (double)(benchTime() - start) / 1000000.0;
+
+			throughput = seconds > 0.0 ? ((double)decoded / (1024.0 * 1024.0)) / seconds : 0.0;
+			if (decoder == FASTLZ_DECODER_SCALAR)
+			{
+				scalar = throughput;
+			}
+
+			fprintf(out, "{\"target\":\"decode\",\"kind\":\"%s\",\"decoder\":\"%s\",\"block\":%u,\"blocks\":%u,\"ratio\":%.3f,\"bytes\":%llu,\"seconds\":%.6f,\"mb_per_s\":%.2f,\"speedup\":%.3f,\"selected\":%s}\n", s_kindNames[kind], s_decoderNames[decoder - 1], BENCH_DECODE_BLOCK, sample.blocks, (double)sample.compressed / ((double)sample.blocks * BENCH_DECODE_BLOCK), decoded, seconds, throughput, scalar > 0.0 ? throughput / scalar : 0.0, decoder == fastlz_decoder() ? "true" : "false");
+			fflush(out);
+
+			fprintf(stderr, "decode  %-7s %-6s: %8.2f MB/s (%.2fx scalar)%s\n", s_kindNames[kind], s_decoderNames[decoder - 1], throughput, scalar > 0.0 ? throughput / scalar : 0.0, decoder == fastlz_decoder() ? ", selected" : "");
+		}
+
+		free(output);
+		free(sample.original);
+		free(sample.packed);
+		free(sample.sizes);
+	}
+
+	if (failed)
+	{
+		fprintf(stderr, "Decode benchmark failed\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void benchUsage()
+{
+	fprintf(stderr, "\nStreamer benchmark - measure throughput and latency on a generated corpus\n\n");
+	fprintf(stderr, "Usage: bench [options]\n\n");
+	fprintf(stderr, "  --work <dir>     Working directory for the corpus (default: bench.work)\n");
+	fprintf(stderr, "  --size <MB>      Approximate corpus size (default: 256)\n");
+	fprintf(stderr, "  --budget <MB>    Data read per measurement (default: 64)\n");
+	fprintf(stderr, "  --seed <n>       Seed for corpus generation (default: 1)\n");
+	fprintf(stderr, "  --output <file>  Write results to file instead of stdout\n");
+	fprintf(stderr, "  --target <name>  Only measure direct, stored or fastlz\n");
+	fprintf(stderr, "  --quick          Measure a reduced set of read sizes and handle counts\n");
+	fprintf(stderr, "  --lookup <n>     Only measure path lookups in an archive of n empty files\n");
+	fprintf(stderr, "  --decode         Only measure fastlz decoding of corpus blocks, for each decoder the CPU supports\n");
+	fprintf(stderr, "  --keep           Keep the generated corpus\n\n");
+	fprintf(stderr, "Results are written as one JSON object per line. Cold cache runs require Linux.\n\n");
+}
+
+int main(int argc, char* argv[])
+{
+	const char* work = "bench.work";
+	const char* output = 0;
+	const char* only = 0;
+	unsigned int size = 256, budget = 64, seed = 1, lookup = 0;
+	int quick = 0, keep = 0, decode = 0, cold, result = 0;
+	const unsigned int* readSizes;
+	const unsigned int* handleCounts;
+	unsigned int readSizeCount, handleCount, i, j, k;
+	unsigned int* order;
+	BenchTarget targets[3];
+	BenchResult run;
+	Corpus corpus;
+	FILE* out = stdout;
+
+	for (i = 1; i < (unsigned int)argc; ++i)
+	{
+		const char* value = (i + 1) < (unsigned int)argc ? argv[i + 1] : 0;
+
+		if (!strcmp(argv[i], "--quick"))
+		{
+			quick = 1;
+		}
+		else if (!strcmp(argv[i], "--keep"))
+		{
+			keep = 1;
+		}
+		else if (!strcmp(argv[i], "--decode"))
+		{
+			decode = 1;
+		}
+		else if (value && !strcmp(argv[i], "--work"))
+		{
+			work = value;
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--size"))
+		{
+			size = (unsigned int)atoi(value);
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--budget"))
+		{
+			budget = (unsigned int)atoi(value);
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--seed"))
+		{
+			seed = (unsigned int)atoi(value);
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--output"))
+		{
+			output = value;
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--target"))
+		{
+			only = value;
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--lookup"))
+		{
+			lookup = (unsigned int)atoi(value);
+			++i;
+		}
+		else
+		{
+			benchUsage();
+			return 1;
+		}
+	}
+
+	// Archive offsets are 32-bit, keep the corpus well below that
+
+	if (!size || (size > 2048) || !budget)
+	{
+		fprintf(stderr, "Corpus size must be between 1 and 2048 MB, budget must be non-zero\n");
+		return 1;
+	}
+
+	if (lookup > 4000000)
+	{
+		fprintf(stderr, "Lookup archive must have at most 4000000 files\n");
+		return 1;
+	}
+
+	if (output)
+	{
+		out = fopen(output, "w");
+		if (!out)
+		{
+			fprintf(stderr, "Failed to open \"%s\" for writing\n", output);
+			return 1;
+		}
+	}
+
+	if (lookup)
+	{
+		fprintf(stderr, "Generating archive with %u files in \"%s\"...\n", lookup, work);
+	}
+	else
+	{
+		fprintf(stderr, "Generating %u MB corpus in \"%s\"...\n", size, work);
+	}
+
+	if ((lookup ? corpusGenerateNames(&corpus, work, lookup) : corpusGenerate(&corpus, work, size, seed)) < 0)
+	{
+		fprintf(stderr, "Failed to generate corpus\n");
+		corpusDestroy(&corpus, !keep);
+		return 1;
+	}
+	fprintf(stderr, "Generated %u files, %llu bytes (%llu bytes compressed)\n", corpus.count, corpus.total, corpus.packed);
+
+	// Visit files in a fixed shuffled order, so cold and warm runs touch the same data
+
+	order = malloc(corpus.count * sizeof(unsigned int));
+	if (!order)
+	{
+		corpusDestroy(&corpus, !keep);
+		return 1;
+	}
+	for (i = 0; i < corpus.count; ++i)
+	{
+		order[i] = i;
+	}
+	for (i = corpus.count; i > 1; --i)
+	{
+		unsigned int other = (unsigned int)((seed * 2654435761u + i * 40503u) % i);
+		unsigned int temp = order[i - 1];
+		order[i - 1] = order[other];
+		order[other] = temp;
+	}
+
+	if (lookup || decode)
+	{
+		result = (lookup ? benchLookup(out, &corpus, order) : benchDecode(out, &corpus, ((unsigned long long)budget) << 20)) < 0 ? 1 : 0;
+
+		free(order);
+		corpusDestroy(&corpus, !keep);
+
+		if (out != stdout)
+		{
+			fclose(out);
+		}
+
+		return result;
+	}
+
+	targets[0].name = "direct";
+	targets[0].container = StreamerContainer_Direct;
+	targets[0].root = corpus.root;
+	targets[0].file = "";
+
+	targets[1].name = "stored";
+	targets[1].container = StreamerContainer_FileArchive;
+	targets[1].root = "";
+	targets[1].file = corpus.stored;
+
+	targets[2].name = "fastlz";
+	targets[2].container = StreamerContainer_FileArchive;
+	targets[2].root = "";
+	targets[2].file = corpus.compressed;
+
+	readSizes = quick ? s_quickReadSizes : s_readSizes;
+	readSizeCount = quick ? sizeof(s_quickReadSizes) / sizeof(s_quickReadSizes[0]) : sizeof(s_readSizes) / sizeof(s_readSizes[0]);
+	handleCounts = quick ? s_quickHandles : s_handles;
+	handleCount = quick ? sizeof(s_quickHandles) / sizeof(s_quickHandles[0]) : sizeof(s_handles) / sizeof(s_handles[0]);
+
+	memset(&run, 0, sizeof(run));
+
+	for (i = 0; (i < 3) && !result; ++i)
+	{
+		if (only && strcmp(only, targets[i].name))
+		{
+			continue;
+		}
+
+		for (j = 0; (j < readSizeCount) && !result; ++j)
+		{
+			for (k = 0; (k < handleCount) && !result; ++k)
+			{
+				for (cold = 1; cold >= 0; --cold)
+				{
+					if (cold && (corpusDropCache(&corpus) < 0))
+					{
+						continue;
+					}
+
+					if (benchRun(&(targets[i]), &corpus, order, readSizes[j], handleCounts[k], ((unsigned long long)budget) << 20, &run) < 0)
+					{
+						result = 1;
+					}
+					else
+					{
+						benchReport(out, &(targets[i]), readSizes[j], handleCounts[k], cold ? "cold" : "warm", &run);
+					}
+
+					free(run.open.data);
+					free(run.read.data);
+					free(run.close.data);
+
+					if (result)
+					{
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	free(order);
+	corpusDestroy(&corpus, !keep);
+
+	if (out != stdout)
+	{
+		fclose(out);
+	}
+
+	return result;
+}
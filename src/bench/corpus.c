@@ -0,0 +1,658 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "corpus.h"
+
+#include <streamer/backend/filearchive.h>
+#include <fastlz/fastlz.h>
+#include <sha1/sha1.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(STREAMER_WIN32)
+#include <direct.h>
+#include <errno.h>
+#include <io.h>
+#elif defined(STREAMER_UNIX)
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define CORPUS_FILES_PER_DIRECTORY (16)
+#define CORPUS_CHUNK_SIZE (64 * 1024)
+#define CORPUS_BLOCK_SIZE (16 * 1024)
+
+typedef struct CorpusGenerator
+{
+	CorpusKind kind;
+	unsigned int random;
+	unsigned int index;		// Records generated so far
+	unsigned int column;		// Text column, used for line breaks
+	unsigned char record[64];
+	unsigned int size;		// Size of current record
+	unsigned int offset;		// Bytes of current record already emitted
+} CorpusGenerator;
+
+static const char* s_words[] =
+{
+	"entity", "transform", "position", "rotation", "scale", "mesh", "material", "texture",
+	"shader", "sound", "volume", "trigger", "spawn", "player", "enemy", "weapon",
+	"health", "damage", "speed", "radius", "target", "script", "event", "state",
+	"if", "then", "else", "end", "local", "function", "return", "true",
+	"false", "nil", "=", "{", "}", "(", ")", ",",
+	"0", "1", "0.5", "100", "255", "-1", "level", "layer"
+};
+
+static const char* s_extensions[CorpusKind_Count] = { "txt", "msh", "snd", "tex" };
+
+static unsigned int corpusRandom(unsigned int* state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static unsigned int corpusTriangle(unsigned int phase)
+{
+	phase &= 0xffff;
+	return phase < 0x8000 ? phase : 0xffff - phase;
+}
+
+static void corpusRecord(CorpusGenerator* generator)
+{
+	unsigned int i = generator->index++;
+
+	switch (generator->kind)
+	{
+		case CorpusKind_Text:
+		{
+			const char* word = s_words[corpusRandom(&generator->random) % (sizeof(s_words) / sizeof(s_words[0]))];
+			unsigned int length = (unsigned int)strlen(word);
+
+			memcpy(generator->record, word, length);
+			generator->column += length + 1;
+			if (generator->column > 72)
+			{
+				generator->record[length++] = '\n';
+				generator->column = 0;
+			}
+			else
+			{
+				generator->record[length++] = ' ';
+			}
+			generator->size = length;
+		}
+		break;
+
+		case CorpusKind_Mesh:
+		{
+			float vertex[8];
+			unsigned int noise = corpusRandom(&generator->random);
+
+			vertex[0] = (float)(i & 255) * 0.125f;
+			vertex[1] = (float)corpusTriangle(i * 97) * (1.0f / 4096.0f) + (float)(noise & 15) * (1.0f / 1024.0f);
+			vertex[2] = (float)((i >> 8) & 255) * 0.125f;
+			vertex[3] = 0.0f;
+			vertex[4] = 1.0f;
+			vertex[5] = (float)((noise >> 4) & 7) * (1.0f / 64.0f);
+			vertex[6] = vertex[0] * (1.0f / 32.0f);
+			vertex[7] = vertex[2] * (1.0f / 32.0f);
+
+			memcpy(generator->record, vertex, sizeof(vertex));
+			generator->size = sizeof(vertex);
+		}
+		break;
+
+		case CorpusKind_Audio:
+		{
+			int sample = (int)corpusTriangle(i * 300) - 0x4000 + (int)corpusTriangle(i * 1170) / 4 + (int)(corpusRandom(&generator->random) & 1023) - 512;
+
+			generator->record[0] = (unsigned char)(sample & 255);
+			generator->record[1] = (unsigned char)((sample >> 8) & 255);
+			generator->size = 2;
+		}
+		break;
+
+		default:
+		{
+			unsigned int colors = corpusRandom(&generator->random);
+			unsigned int indices = corpusRandom(&generator->random);
+
+			// Endpoint colors drift slowly across the texture, indices are noise
+
+			colors = (colors & 0x18e318e3) | ((i >> 6) * 0x00210021);
+			memcpy(generator->record, &colors, 4);
+			memcpy(generator->record + 4, &indices, 4);
+			generator->size = 8;
+		}
+		break;
+	}
+
+	generator->offset = 0;
+}
+
+static void corpusFill(CorpusGenerator* generator, unsigned char* buffer, unsigned int length)
+{
+	while (length > 0)
+	{
+		unsigned int count;
+
+		if (generator->offset == generator->size)
+		{
+			corpusRecord(generator);
+		}
+
+		count = generator->size - generator->offset;
+		count = count < length ? count : length;
+
+		memcpy(buffer, generator->record + generator->offset, count);
+		generator->offset += count;
+		buffer += count;
+		length -= count;
+	}
+}
+
+static int corpusMakeDirectory(const char* path)
+{
+#if defined(STREAMER_WIN32)
+	return (_mkdir(path) == 0) || (errno == EEXIST) ? 0 : -1;
+#else
+	struct stat info;
+
+	if (!stat(path, &info))
+	{
+		return S_ISDIR(info.st_mode) ? 0 : -1;
+	}
+	return mkdir(path, 0755);
+#endif
+}
+
+static int corpusWriteFile(const Corpus* corpus, const CorpusFile* file, unsigned int seed, unsigned char* chunk)
+{
+	CorpusGenerator generator;
+	char path[512];
+	unsigned int remaining = file->size;
+	FILE* fp;
+
+	memset(&generator, 0, sizeof(generator));
+	generator.kind = file->kind;
+	generator.random = seed ? seed : 1;
+
+	sprintf(path, "%s%s", corpus->root, file->path);
+	fp = fopen(path, "wb");
+	if (!fp)
+	{
+		fprintf(stderr, "Failed to create \"%s\"\n", path);
+		return -1;
+	}
+
+	while (remaining > 0)
+	{
+		unsigned int count = remaining < CORPUS_CHUNK_SIZE ? remaining : CORPUS_CHUNK_SIZE;
+
+		corpusFill(&generator, chunk, count);
+		if (fwrite(chunk, 1, count, fp) != count)
+		{
+			fprintf(stderr, "Failed writing \"%s\"\n", path);
+			fclose(fp);
+			return -1;
+		}
+		remaining -= count;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+static void corpusDigest(SHA1Context* state, fa_hash_t* hash)
+{
+	int i;
+
+	SHA1Result(state);
+	for (i = 0; i < 20; ++i)
+	{
+		hash->data[i] = (uint8_t)((state->Message_Digest[i / 4] >> ((3 - (i & 3)) * 8)) & 0xff);
+	}
+}
+
+static int corpusWriteArchive(Corpus* corpus, const char* target, int compress)
+{
+	unsigned int directories = (corpus->count + CORPUS_FILES_PER_DIRECTORY - 1) / CORPUS_FILES_PER_DIRECTORY;
+	unsigned int containers = directories + 1;
+	unsigned int namesOffset, namesSize, tocSize, i;
+	fa_header_t* header;
+	fa_container_t* container;
+	fa_entry_t* entry;
+	fa_hash_t* hashes;
+	fa_footer_t footer;
+	uint32_t position = 0;
+	unsigned char* input = 0;
+	unsigned char* output = 0;
+	unsigned char* toc = 0;
+	char* names;
+	int result = -1;
+	FILE* out = 0;
+	FILE* in = 0;
+	SHA1Context state;
+
+	// Layout: data, TOC (header, containers, entries, hashes, names), footer
+
+	namesSize = directories * 8;
+	for (i = 0; i < corpus->count; ++i)
+	{
+		namesSize += (unsigned int)strlen(strrchr(corpus->files[i].path, '/') + 1) + 1;
+	}
+
+	namesOffset = sizeof(fa_header_t) + containers * sizeof(fa_container_t) + corpus->count * (sizeof(fa_entry_t) + sizeof(fa_hash_t));
+	tocSize = (namesOffset + namesSize + 3) & ~3;
+
+	do
+	{
+		input = malloc(CORPUS_BLOCK_SIZE);
+		output = malloc(CORPUS_BLOCK_SIZE * 2 + 66);
+		toc = calloc(1, tocSize);
+		if (!input || !output || !toc)
+		{
+			fprintf(stderr, "Failed to allocate archive buffers\n");
+			break;
+		}
+
+		header = (fa_header_t*)toc;
+		container = (fa_container_t*)(toc + sizeof(fa_header_t));
+		entry = (fa_entry_t*)(container + containers);
+		hashes = (fa_hash_t*)(entry + corpus->count);
+		names = (char*)(toc + namesOffset);
+
+		header->cookie = FA_MAGIC_COOKIE_HEADER;
+		header->version = FA_VERSION_1;
+		header->size = tocSize;
+		header->flags = 0;
+		header->containers.offset = sizeof(fa_header_t);
+		header->containers.count = containers;
+		header->entries.offset = (uint32_t)((unsigned char*)entry - toc);
+		header->entries.count = corpus->count;
+		header->hashes = (uint32_t)((unsigned char*)hashes - toc);
+
+		container[0].parent = FA_INVALID_OFFSET;
+		container[0].children = directories ? header->containers.offset + sizeof(fa_container_t) : FA_INVALID_OFFSET;
+		container[0].next = FA_INVALID_OFFSET;
+		container[0].name = FA_INVALID_OFFSET;
+		container[0].entries.offset = header->entries.offset;
+		container[0].entries.count = 0;
+
+		for (i = 0; i < directories; ++i)
+		{
+			fa_container_t* directory = &(container[i + 1]);
+			unsigned int first = i * CORPUS_FILES_PER_DIRECTORY;
+
+			directory->parent = header->containers.offset;
+			directory->children = FA_INVALID_OFFSET;
+			directory->next = (i + 1) < directories ? header->containers.offset + (i + 2) * sizeof(fa_container_t) : FA_INVALID_OFFSET;
+			directory->name = (uint32_t)(names - (char*)toc);
+			directory->entries.offset = header->entries.offset + first * sizeof(fa_entry_t);
+			directory->entries.count = (corpus->count - first) < CORPUS_FILES_PER_DIRECTORY ? (corpus->count - first) : CORPUS_FILES_PER_DIRECTORY;
+
+			memcpy(names, corpus->files[first].path, strchr(corpus->files[first].path, '/') - corpus->files[first].path);
+			names += strlen(names) + 1;
+		}
+
+		out = fopen(target, "wb");
+		if (!out)
+		{
+			fprintf(stderr, "Failed to create \"%s\"\n", target);
+			break;
+		}
+
+		for (i = 0; i < corpus->count; ++i)
+		{
+			const CorpusFile* file = &(corpus->files[i]);
+			const char* name = strrchr(file->path, '/') + 1;
+			char path[512];
+			size_t count;
+
+			// Empty files have no loose copy, so name only corpora can be archived without touching the disk
+
+			sprintf(path, "%s%s", corpus->root, file->path);
+			in = file->size ? fopen(path, "rb") : 0;
+			if (file->size && !in)
+			{
+				fprintf(stderr, "Failed to open \"%s\"\n", path);
+				break;
+			}
+
+			entry[i].data = position;
+			entry[i].name = (uint32_t)(names - (char*)toc);
+			entry[i].compression = compress ? FA_COMPRESSION_FASTLZ : FA_COMPRESSION_NONE;
+			entry[i].blockSize = CORPUS_BLOCK_SIZE;
+			entry[i].size.original = file->size;
+
+			strcpy(names, name);
+			names += strlen(name) + 1;
+
+			SHA1Reset(&state);
+
+			while (in && ((count = fread(input, 1, CORPUS_BLOCK_SIZE, in)) > 0))
+			{
+				SHA1Input(&state, input, (unsigned)count);
+
+				if (compress)
+				{
+					fa_block_t block;
+					int packed = count >= 16 ? fastlz_compress(input, (int)count, output) : (int)count;
+
+					block.original = (uint16_t)count;
+					if (packed < (int)count)
+					{
+						block.compressed = (uint16_t)packed;
+						fwrite(&block, sizeof(block), 1, out);
+						fwrite(output, 1, packed, out);
+					}
+					else
+					{
+						block.compressed = (uint16_t)(count | FA_COMPRESSION_SIZE_IGNORE);
+						fwrite(&block, sizeof(block), 1, out);
+						fwrite(input, 1, count, out);
+						packed = (int)count;
+					}
+					position += sizeof(block) + packed;
+				}
+				else
+				{
+					fwrite(input, 1, count, out);
+					position += (uint32_t)count;
+				}
+			}
+
+			if (in)
+			{
+				fclose(in);
+				in = 0;
+			}
+
+			entry[i].size.compressed = position - entry[i].data;
+			corpusDigest(&state, &(hashes[i]));
+		}
+
+		if (i != corpus->count)
+		{
+			break;
+		}
+
+		memset(&footer, 0, sizeof(footer));
+		footer.cookie = FA_MAGIC_COOKIE_FOOTER;
+		footer.toc.compression = FA_COMPRESSION_NONE;
+		footer.toc.original = tocSize;
+		footer.toc.compressed = tocSize;
+		footer.data.original = (uint32_t)corpus->total;
+		footer.data.compressed = position;
+
+		SHA1Reset(&state);
+		SHA1Input(&state, toc, tocSize);
+		corpusDigest(&state, &(footer.toc.hash));
+
+		if ((fwrite(toc, 1, tocSize, out) != tocSize) || (fwrite(&footer, sizeof(footer), 1, out) != 1))
+		{
+			fprintf(stderr, "Failed writing \"%s\"\n", target);
+			break;
+		}
+
+		if (compress)
+		{
+			corpus->packed = position;
+		}
+
+		result = 0;
+	}
+	while (0);
+
+	if (in)
+	{
+		fclose(in);
+	}
+	if (out && fclose(out))
+	{
+		result = -1;
+	}
+
+	free(toc);
+	free(output);
+	free(input);
+	return result;
+}
+
+int corpusGenerate(Corpus* corpus, const char* work, unsigned int megabytes, unsigned int seed)
+{
+	unsigned long long budget = ((unsigned long long)megabytes) << 20;
+	unsigned int random = seed ? seed : 1;
+	unsigned int capacity = 256;
+	unsigned char* chunk;
+	char path[512];
+	unsigned int i;
+
+	memset(corpus, 0, sizeof(Corpus));
+
+	if (strlen(work) > 200)
+	{
+		fprintf(stderr, "Working directory path too long\n");
+		return -1;
+	}
+
+	sprintf(corpus->work, "%s/", work);
+	sprintf(corpus->root, "%scorpus/", corpus->work);
+	sprintf(corpus->stored, "%sstored.far", corpus->work);
+	sprintf(corpus->compressed, "%sfastlz.far", corpus->work);
+
+	if ((corpusMakeDirectory(work) < 0) || (corpusMakeDirectory(corpus->root) < 0))
+	{
+		fprintf(stderr, "Failed to create working directory \"%s\"\n", work);
+		return -1;
+	}
+
+	corpus->files = malloc(capacity * sizeof(CorpusFile));
+	chunk = malloc(CORPUS_CHUNK_SIZE);
+	if (!corpus->files || !chunk)
+	{
+		free(chunk);
+		return -1;
+	}
+
+	// Mostly small assets with a long tail of large ones; the first file is always large enough for the biggest reads
+
+	while (corpus->total < budget)
+	{
+		CorpusFile* file;
+		unsigned int size, bucket = corpusRandom(&random) % 100;
+
+		if (corpus->count == capacity)
+		{
+			CorpusFile* files = realloc(corpus->files, capacity * 2 * sizeof(CorpusFile));
+			if (!files)
+			{
+				free(chunk);
+				return -1;
+			}
+			corpus->files = files;
+			capacity *= 2;
+		}
+
+		if (!corpus->count)
+		{
+			size = (20 << 20);
+		}
+		else if (bucket < 50)
+		{
+			size = (4 << 10) + corpusRandom(&random) % (60 << 10);
+		}
+		else if (bucket < 80)
+		{
+			size = (64 << 10) + corpusRandom(&random) % (960 << 10);
+		}
+		else if (bucket < 95)
+		{
+			size = (1 << 20) + corpusRandom(&random) % (3 << 20);
+		}
+		else
+		{
+			size = (4 << 20) + corpusRandom(&random) % (12 << 20);
+		}
+
+		file = &(corpus->files[corpus->count]);
+		file->size = size;
+		file->kind = corpus->count ? (CorpusKind)(corpusRandom(&random) % CorpusKind_Count) : CorpusKind_Texture;
+		sprintf(file->path, "d%02u/f%04u.%s", corpus->count / CORPUS_FILES_PER_DIRECTORY, corpus->count, s_extensions[file->kind]);
+
+		if (!(corpus->count % CORPUS_FILES_PER_DIRECTORY))
+		{
+			sprintf(path, "%sd%02u", corpus->root, corpus->count / CORPUS_FILES_PER_DIRECTORY);
+			if (corpusMakeDirectory(path) < 0)
+			{
+				fprintf(stderr, "Failed to create \"%s\"\n", path);
+				free(chunk);
+				return -1;
+			}
+		}
+
+		if (corpusWriteFile(corpus, file, random ^ (corpus->count * 0x9e3779b9), chunk) < 0)
+		{
+			free(chunk);
+			return -1;
+		}
+
+		corpus->largest = size > corpus->largest ? size : corpus->largest;
+		corpus->total += size;
+		++corpus->count;
+	}
+
+	free(chunk);
+
+	for (i = 0; i < 2; ++i)
+	{
+		if (corpusWriteArchive(corpus, i ? corpus->compressed : corpus->stored, i) < 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int corpusGenerateNames(Corpus* corpus, const char* work, unsigned int count)
+{
+	unsigned int i;
+
+	memset(corpus, 0, sizeof(Corpus));
+
+	if (strlen(work) > 200)
+	{
+		fprintf(stderr, "Working directory path too long\n");
+		return -1;
+	}
+
+	sprintf(corpus->work, "%s/", work);
+	sprintf(corpus->root, "%scorpus/", corpus->work);
+	sprintf(corpus->stored, "%snames.far", corpus->work);
+
+	if (corpusMakeDirectory(work) < 0)
+	{
+		fprintf(stderr, "Failed to create working directory \"%s\"\n", work);
+		return -1;
+	}
+
+	corpus->files = malloc(count * sizeof(CorpusFile));
+	if (!corpus->files)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < count; ++i)
+	{
+		CorpusFile* file = &(corpus->files[i]);
+
+		file->size = 0;
+		file->kind = CorpusKind_Text;
+		sprintf(file->path, "d%04u/f%07u.%s", i / CORPUS_FILES_PER_DIRECTORY, i, s_extensions[file->kind]);
+	}
+	corpus->count = count;
+
+	return corpusWriteArchive(corpus, corpus->stored, 0);
+}
+
+void corpusDestroy(Corpus* corpus, int remove)
+{
+	char path[512];
+	unsigned int i;
+
+	if (remove && corpus->files)
+	{
+		for (i = 0; i < corpus->count; ++i)
+		{
+			sprintf(path, "%s%s", corpus->root, corpus->files[i].path);
+			unlink(path);
+		}
+
+		for (i = 0; i < corpus->count; i += CORPUS_FILES_PER_DIRECTORY)
+		{
+			sprintf(path, "%sd%02u", corpus->root, i / CORPUS_FILES_PER_DIRECTORY);
+			rmdir(path);
+		}
+
+		rmdir(corpus->root);
+		unlink(corpus->stored);
+		unlink(corpus->compressed);
+	}
+
+	free(corpus->files);
+	corpus->files = 0;
+	corpus->count = 0;
+}
+
+#if defined(__linux__)
+static int corpusDropFile(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	int result;
+
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	fdatasync(fd);
+	result = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+
+	return result ? -1 : 0;
+}
+#endif
+
+int corpusDropCache(const Corpus* corpus)
+{
+#if defined(__linux__)
+	char path[512];
+	unsigned int i;
+
+	for (i = 0; i < corpus->count; ++i)
+	{
+		sprintf(path, "%s%s", corpus->root, corpus->files[i].path);
+		if (corpusDropFile(path) < 0)
+		{
+			return -1;
+		}
+	}
+
+	if ((corpusDropFile(corpus->stored) < 0) || (corpusDropFile(corpus->compressed) < 0))
+	{
+		return -1;
+	}
+
+	return 0;
+#else
+	return -1;
+#endif
+}
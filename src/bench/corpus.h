@@ -0,0 +1,78 @@
+#ifndef streamer_bench_corpus_h
+#define streamer_bench_corpus_h
+
+typedef enum
+{
+	CorpusKind_Text,	// Script and config like text, compresses well
+	CorpusKind_Mesh,	// Vertex streams with smoothly varying values, compresses moderately
+	CorpusKind_Audio,	// 16-bit PCM tones with noise, compresses poorly
+	CorpusKind_Texture,	// Block compressed texture like noise, barely compresses
+
+	CorpusKind_Count
+} CorpusKind;
+
+typedef struct CorpusFile
+{
+	char path[64];		// Path relative to corpus root
+	unsigned int size;
+	CorpusKind kind;
+} CorpusFile;
+
+typedef struct Corpus
+{
+	char work[224];		// Working directory, with trailing separator
+	char root[256];		// Directory holding loose files, with trailing separator
+	char stored[256];	// Archive with all files stored
+	char compressed[256];	// Archive with all files compressed with fastlz
+
+	CorpusFile* files;
+	unsigned int count;
+	unsigned int largest;
+	unsigned long long total;
+	unsigned long long packed;	// Size of compressed archive data
+} Corpus;
+
+/**
+ *
+ * Generate a corpus of loose files and matching stored and fastlz archives
+ *
+ * \param corpus - Corpus to fill in
+ * \param work - Working directory, created if missing
+ * \param megabytes - Approximate size of corpus
+ * \param seed - Seed for content generation, the same seed always gives the same corpus
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int corpusGenerate(Corpus* corpus, const char* work, unsigned int megabytes, unsigned int seed);
+
+/**
+ *
+ * Generate a stored archive of empty files, for measuring path lookups in large archives
+ *
+ * \note No loose files are written, only the stored archive is valid in the resulting corpus
+ *
+ * \param corpus - Corpus to fill in
+ * \param work - Working directory, created if missing
+ * \param count - Number of files in archive
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int corpusGenerateNames(Corpus* corpus, const char* work, unsigned int count);
+
+/**
+ *
+ * Release corpus, optionally deleting the generated files
+ *
+**/
+void corpusDestroy(Corpus* corpus, int remove);
+
+/**
+ *
+ * Evict corpus files and archives from the OS file cache
+ *
+ * \return 0 if successful, <0 if the platform cannot drop cached file data
+ *
+**/
+int corpusDropCache(const Corpus* corpus);
+
+#endif
@@ -54,6 +54,35 @@
 #define FASTLZ_INLINE
 #endif
 
+/*
+ * Code generation target for a decoder, only set for the wide decoders.
+ */
+#define FASTLZ_TARGET
+
+/*
+ * Wide decoders use SSE2/AVX2 copies and are picked at runtime from the CPU features.
+ * Define FASTLZ_NO_WIDE to leave them out.
+ */
+#if !defined(FASTLZ_NO_WIDE) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#if defined(__clang__) || (defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9))))
+#define FASTLZ_WIDE_DECODERS
+#define FASTLZ_TARGET_SSE2 __attribute__((target("sse2")))
+#define FASTLZ_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (_MSC_VER >= 1700)
+#define FASTLZ_WIDE_DECODERS
+#define FASTLZ_TARGET_SSE2
+#define FASTLZ_TARGET_AVX2
+#endif
+#endif
+
+#if defined(FASTLZ_WIDE_DECODERS)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
 /*
  * Prevent accessing more than 8-bit at once, except on x86 architectures.
  */
@@ -85,6 +114,13 @@ typedef unsigned int   flzuint32;
 int fastlz_compress(const void* input, int length, void* output);
 int fastlz_compress_level(int level, const void* input, int length, void* output);
 int fastlz_decompress(const void* input, int length, void* output, int maxout);
+int fastlz_decompress_using(int decoder, const void* input, int length, void* output, int maxout);
+int fastlz_decoder(void);
+int fastlz_decoder_supported(int decoder);
+
+#define FASTLZ_DECODER_SCALAR 1
+#define FASTLZ_DECODER_SSE2   2
+#define FASTLZ_DECODER_AVX2   3
 
 #define MAX_COPY       32
 #define MAX_LEN       264  /* 256 + 8 */
@@ -127,6 +163,156 @@ static FASTLZ_INLINE int FASTLZ_COMPRESSOR(const void* input, int length, void*
 static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
 #include "fastlz.c"
 
+#if defined(FASTLZ_WIDE_DECODERS)
+
+/* SSE2, 16 bytes per copy */
+#undef FASTLZ_TARGET
+#define FASTLZ_TARGET FASTLZ_TARGET_SSE2
+#define FASTLZ_WIDE 16
+#define FASTLZ_WIDE_TYPE __m128i
+#define FASTLZ_WIDE_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define FASTLZ_WIDE_STORE(p,v) _mm_storeu_si128((__m128i*)(p), (v))
+#define FASTLZ_WIDE_SPLAT(b) _mm_set1_epi8((char)(b))
+
+#undef FASTLZ_LEVEL
+#define FASTLZ_LEVEL 1
+#undef MAX_DISTANCE
+#define MAX_DISTANCE 8192
+#undef FASTLZ_DECOMPRESSOR
+#define FASTLZ_DECOMPRESSOR fastlz1_decompress_sse2
+static FASTLZ_INLINE FASTLZ_TARGET int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
+#include "fastlz.c"
+
+#undef FASTLZ_LEVEL
+#define FASTLZ_LEVEL 2
+#undef MAX_DISTANCE
+#define MAX_DISTANCE 8191
+#undef FASTLZ_DECOMPRESSOR
+#define FASTLZ_DECOMPRESSOR fastlz2_decompress_sse2
+static FASTLZ_INLINE FASTLZ_TARGET int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
+#include "fastlz.c"
+
+/* AVX2, 32 bytes per copy */
+#undef FASTLZ_TARGET
+#define FASTLZ_TARGET FASTLZ_TARGET_AVX2
+#undef FASTLZ_WIDE
+#undef FASTLZ_WIDE_TYPE
+#undef FASTLZ_WIDE_LOAD
+#undef FASTLZ_WIDE_STORE
+#undef FASTLZ_WIDE_SPLAT
+#define FASTLZ_WIDE 32
+#define FASTLZ_WIDE_TYPE __m256i
+#define FASTLZ_WIDE_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define FASTLZ_WIDE_STORE(p,v) _mm256_storeu_si256((__m256i*)(p), (v))
+#define FASTLZ_WIDE_SPLAT(b) _mm256_set1_epi8((char)(b))
+
+#undef FASTLZ_LEVEL
+#define FASTLZ_LEVEL 1
+#undef MAX_DISTANCE
+#define MAX_DISTANCE 8192
+#undef FASTLZ_DECOMPRESSOR
+#define FASTLZ_DECOMPRESSOR fastlz1_decompress_avx2
+static FASTLZ_INLINE FASTLZ_TARGET int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
+#include "fastlz.c"
+
+#undef FASTLZ_LEVEL
+#define FASTLZ_LEVEL 2
+#undef MAX_DISTANCE
+#define MAX_DISTANCE 8191
+#undef FASTLZ_DECOMPRESSOR
+#define FASTLZ_DECOMPRESSOR fastlz2_decompress_avx2
+static FASTLZ_INLINE FASTLZ_TARGET int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout);
+#include "fastlz.c"
+
+#undef FASTLZ_TARGET
+#define FASTLZ_TARGET
+
+#endif
+
+typedef int (*fastlz_decompressor)(const void* input, int length, void* output, int maxout);
+
+/* decoders per level, indexed by FASTLZ_DECODER_xxx - 1 */
+static const fastlz_decompressor fastlz_decompressors[3][2] =
+{
+  { fastlz1_decompress, fastlz2_decompress },
+#if defined(FASTLZ_WIDE_DECODERS)
+  { fastlz1_decompress_sse2, fastlz2_decompress_sse2 },
+  { fastlz1_decompress_avx2, fastlz2_decompress_avx2 }
+#else
+  { 0, 0 },
+  { 0, 0 }
+#endif
+};
+
+/* bit per supported decoder, bit 0 is set once the CPU has been checked */
+static int fastlz_supported = 0;
+static int fastlz_selected = 0;
+
+static int fastlz_detect(void)
+{
+  int supported = 1 | (1 << FASTLZ_DECODER_SCALAR);
+#if defined(FASTLZ_WIDE_DECODERS)
+#if defined(_MSC_VER)
+  int info[4];
+  int count;
+
+  __cpuid(info, 0);
+  count = info[0];
+  __cpuid(info, 1);
+  if(info[3] & (1 << 26))
+    supported |= 1 << FASTLZ_DECODER_SSE2;
+
+  /* AVX state must be enabled by the OS (OSXSAVE, XCR0 bits 1 and 2) */
+  if((info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6) && (count >= 7))
+  {
+    __cpuidex(info, 7, 0);
+    if(info[1] & (1 << 5))
+      supported |= 1 << FASTLZ_DECODER_AVX2;
+  }
+#else
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("sse2"))
+    supported |= 1 << FASTLZ_DECODER_SSE2;
+  if(__builtin_cpu_supports("avx2"))
+    supported |= 1 << FASTLZ_DECODER_AVX2;
+#endif
+#endif
+  return supported;
+}
+
+int fastlz_decoder_supported(int decoder)
+{
+  /* detection always gives the same answer, so racing callers are harmless */
+  if(!fastlz_supported)
+    fastlz_supported = fastlz_detect();
+  if(decoder < FASTLZ_DECODER_SCALAR || decoder > FASTLZ_DECODER_AVX2)
+    return 0;
+  return (fastlz_supported >> decoder) & 1;
+}
+
+int fastlz_decoder(void)
+{
+  if(!fastlz_selected)
+  {
+    int decoder = FASTLZ_DECODER_SCALAR;
+
+    /*
+     * fastlz literal runs are at most 32 bytes and most matches are short, where
+     * 256-bit copies measure slower than 128-bit ones, so AVX2 is opt-in
+     */
+#if defined(FASTLZ_PREFER_AVX2)
+    if(fastlz_decoder_supported(FASTLZ_DECODER_AVX2))
+      decoder = FASTLZ_DECODER_AVX2;
+    else
+#endif
+    if(fastlz_decoder_supported(FASTLZ_DECODER_SSE2))
+      decoder = FASTLZ_DECODER_SSE2;
+
+    fastlz_selected = decoder;
+  }
+  return fastlz_selected;
+}
+
 int fastlz_compress(const void* input, int length, void* output)
 {
   /* for short block, choose fastlz1 */
@@ -138,14 +324,20 @@ int fastlz_compress(const void* input, int length, void* output)
 }
 
 int fastlz_decompress(const void* input, int length, void* output, int maxout)
+{
+  return fastlz_decompress_using(fastlz_decoder(), input, length, output, maxout);
+}
+
+int fastlz_decompress_using(int decoder, const void* input, int length, void* output, int maxout)
 {
   /* magic identifier for compression level */
   int level = ((*(const flzuint8*)input) >> 5) + 1;
 
-  if(level == 1)
-    return fastlz1_decompress(input, length, output, maxout);
-  if(level == 2)
-    return fastlz2_decompress(input, length, output, maxout);
+  if(!fastlz_decoder_supported(decoder))
+    return 0;
+
+  if(level == 1 || level == 2)
+    return fastlz_decompressors[decoder - 1][level - 1](input, length, output, maxout);
 
   /* unknown level, trigger error */
   return 0;
@@ -163,6 +355,8 @@ int fastlz_compress_level(int level, const void* input, int length, void* output
 
 #else /* !defined(FASTLZ_COMPRESSOR) && !defined(FASTLZ_DECOMPRESSOR) */
 
+#if !defined(FASTLZ_WIDE)
+
 static FASTLZ_INLINE int FASTLZ_COMPRESSOR(const void* input, int length, void* output)
 {
   const flzuint8* ip = (const flzuint8*) input;
@@ -417,7 +611,9 @@ static FASTLZ_INLINE int FASTLZ_COMPRESSOR(const void* input, int length, void*
   return op - (flzuint8*)output;
 }
 
-static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout)
+#endif /* !defined(FASTLZ_WIDE) */
+
+static FASTLZ_INLINE FASTLZ_TARGET int FASTLZ_DECOMPRESSOR(const void* input, int length, void* output, int maxout)
 {
   const flzuint8* ip = (const flzuint8*) input;
   const flzuint8* ip_limit  = ip + length;
@@ -475,6 +671,46 @@ static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void
       else
         loop = 0;
 
+#if defined(FASTLZ_WIDE)
+      /*
+       * copy in chunks no larger than the match distance, so every chunk only
+       * reads finished output; the last chunk may spill past the match but
+       * never past the output
+       */
+      if(FASTLZ_EXPECT_CONDITIONAL(op + len + 3 + FASTLZ_WIDE <= op_limit) && (ref == op || ref + 8 - 1 <= op))
+      {
+        flzuint8* end = op + len + 3;
+        if(ref == op)
+        {
+          FASTLZ_WIDE_TYPE b = FASTLZ_WIDE_SPLAT(ref[-1]);
+          for(; op < end; op += FASTLZ_WIDE)
+            FASTLZ_WIDE_STORE(op, b);
+        }
+        else
+        {
+          ref--;
+          if(ref + FASTLZ_WIDE <= op)
+          {
+            for(; op < end; op += FASTLZ_WIDE, ref += FASTLZ_WIDE)
+              FASTLZ_WIDE_STORE(op, FASTLZ_WIDE_LOAD(ref));
+          }
+#if FASTLZ_WIDE > 16
+          else if(ref + 16 <= op)
+          {
+            for(; op < end; op += 16, ref += 16)
+              _mm_storeu_si128((__m128i*)op, _mm_loadu_si128((const __m128i*)ref));
+          }
+#endif
+          else
+          {
+            for(; op < end; op += 8, ref += 8)
+              _mm_storel_epi64((__m128i*)op, _mm_loadl_epi64((const __m128i*)ref));
+          }
+        }
+        op = end;
+      }
+      else
+#endif
       if(ref == op)
       {
         /* optimize copy for a run */
@@ -534,9 +770,24 @@ static FASTLZ_INLINE int FASTLZ_DECOMPRESSOR(const void* input, int length, void
         return 0;
 #endif
 
-      *op++ = *ip++; 
-      for(--ctrl; ctrl; ctrl--)
-        *op++ = *ip++;
+#if defined(FASTLZ_WIDE)
+      /* literal runs are at most MAX_COPY bytes, copy them whole when both buffers have room */
+      if(FASTLZ_EXPECT_CONDITIONAL(op + MAX_COPY <= op_limit) && FASTLZ_EXPECT_CONDITIONAL(ip + MAX_COPY <= ip_limit))
+      {
+        FASTLZ_WIDE_STORE(op, FASTLZ_WIDE_LOAD(ip));
+#if FASTLZ_WIDE < MAX_COPY
+        FASTLZ_WIDE_STORE(op + FASTLZ_WIDE, FASTLZ_WIDE_LOAD(ip + FASTLZ_WIDE));
+#endif
+        op += ctrl;
+        ip += ctrl;
+      }
+      else
+#endif
+      {
+        *op++ = *ip++; 
+        for(--ctrl; ctrl; ctrl--)
+          *op++ = *ip++;
+      }
 
       loop = FASTLZ_EXPECT_CONDITIONAL(ip < ip_limit);
       if(loop)
@@ -64,11 +64,43 @@ int fastlz_compress(const void* input, int length, void* output);
   The input buffer and the output buffer can not overlap.
 
   Decompression is memory safe and guaranteed not to write the output buffer
-  more than what is specified in maxout.
+  more than what is specified in maxout. Bytes between the end of the
+  decompressed data and maxout may be overwritten.
  */
 
 int fastlz_decompress(const void* input, int length, void* output, int maxout); 
 
+/**
+  Decoders available to fastlz_decompress_using. All of them produce identical
+  output. The SSE2 and AVX2 decoders are only built for x86 targets.
+*/
+
+#define FASTLZ_DECODER_SCALAR 1
+#define FASTLZ_DECODER_SSE2   2
+#define FASTLZ_DECODER_AVX2   3
+
+/**
+  Returns the decoder used by fastlz_decompress, picked from the CPU features
+  on first use. SSE2 is preferred over AVX2 unless FASTLZ_PREFER_AVX2 is
+  defined when building, as fastlz literal runs and most matches are too
+  short to benefit from 256-bit copies.
+*/
+
+int fastlz_decoder(void);
+
+/**
+  Returns non-zero if the decoder is built and supported by the CPU.
+*/
+
+int fastlz_decoder_supported(int decoder);
+
+/**
+  Same as fastlz_decompress, but with an explicit decoder. Returns 0 if the
+  decoder is not supported by the CPU or was not built.
+*/
+
+int fastlz_decompress_using(int decoder, const void* input, int length, void* output, int maxout);
+
 /**
   Compress a block of data in the input buffer and returns the size of 
   compressed block. The size of input buffer is specified by length. The 
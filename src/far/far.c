@@ -0,0 +1,1270 @@
+#define _CRT_SECURE_NO_WARNINGS
+#if defined(STREAMER_UNIX) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64	// Source files may be larger than 2GB
+#endif
+
+#include <streamer/backend/filearchive.h>
+#include <streamer/backend/drivers/crc32c.h>
+#include <fastlz/fastlz.h>
+#include <sha1/sha1.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(STREAMER_WIN32)
+#include <windows.h>
+#elif defined(STREAMER_UNIX)
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#define FAR_BLOCK_SIZE (64 * 1024)		// Default block size for file data
+#define FAR_TOC_BLOCK_SIZE (16 * 1024)		// Compressed TOCs keep 16-bit block headers
+#define FAR_CHUNK_SIZE (1024 * 1024)		// Input is read in whole blocks up to this size
+#define FAR_OUTPUT_SIZE(length, blockSize) ((length) + (length) / 16 + ((length) / (blockSize) + 1) * sizeof(fa_block_crc_t) + 66)
+#define FAR_JOBS_PER_THREAD (4)
+#define FAR_MAX_THREADS (64)
+#define FAR_MAX_PATH (1024)
+#define FAR_NONE (0xffffffff)
+
+typedef enum
+{
+	FarJobState_Free,
+	FarJobState_Loaded,		// Input read, waiting for a worker
+	FarJobState_Compressing,
+	FarJobState_Compressed,		// Waiting for earlier chunks of the same file to be hashed
+	FarJobState_Hashing,
+	FarJobState_Done		// Ready to be written
+} FarJobState;
+
+typedef struct FarDirectory
+{
+	unsigned int parent;
+	unsigned int children;		// First child directory, FAR_NONE if none
+	unsigned int next;		// Next sibling directory, FAR_NONE if none
+	unsigned int name;		// Offset of name in name pool, FAR_NONE for the root
+
+	unsigned int first;		// First file in directory
+	unsigned int count;		// Number of files in directory
+} FarDirectory;
+
+typedef struct FarFile
+{
+	unsigned int name;		// Offset of name in name pool
+	unsigned int source;		// Offset of path on disk in source pool
+	unsigned int hashed;		// Chunks added to the content hash so far
+
+	unsigned long long size;	// Size when scanned
+	unsigned long long data;	// Offset of file in archive data
+	unsigned long long compressed;	// Size of file in archive data
+} FarFile;
+
+typedef struct FarJob
+{
+	FarJobState state;
+	unsigned long long sequence;	// Position of job in submission order
+	unsigned int file;
+	unsigned int chunk;		// Index of chunk within file
+	int last;			// Set on the last chunk of a file
+	unsigned int length;		// Bytes of input
+	unsigned int packed;		// Bytes of output
+	unsigned char* input;
+	unsigned char* output;
+} FarJob;
+
+typedef struct FarPool
+{
+	char* data;
+	unsigned int size;
+	unsigned int capacity;
+} FarPool;
+
+typedef struct Far
+{
+	// Options
+
+	int store;			// Store files without compression
+	int level;			// FastLZ compression level
+	int packToc;			// Compress the TOC
+	int checksums;			// Add a CRC32C to each block of file data
+	unsigned int threads;
+	unsigned int blockSize;		// Largest block of file data
+	unsigned int chunkSize;		// Bytes of input per job, a whole number of blocks
+	unsigned int header;		// Size of block headers, fa_block32_t or fa_block_crc_t for file data and fa_block_t for the TOC
+	unsigned int version;		// Archive version, archives without checksums stay readable by version 3 readers
+
+	// Input tree
+
+	FarDirectory* directories;
+	unsigned int directoryCount;
+	unsigned int directoryCapacity;
+
+	FarFile* files;
+	unsigned int fileCount;
+	unsigned int fileCapacity;
+
+	FarPool names;
+	FarPool sources;
+
+	fa_hash_t* hashes;		// Content hash of each file
+	SHA1Context* streams;		// Hash state of files in flight, indexed by file modulo job count
+
+	// Pipeline, jobs are loaded at head and written at tail
+
+	FarJob* jobs;
+	unsigned int jobCount;
+	unsigned long long head;
+	unsigned long long tail;
+	int quit;
+
+#if defined(STREAMER_WIN32)
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE signal;
+	HANDLE workers[FAR_MAX_THREADS];
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t signal;
+	pthread_t workers[FAR_MAX_THREADS];
+#endif
+
+	// Output
+
+	FILE* out;
+	unsigned long long position;	// Bytes of data written
+	unsigned long long total;	// Bytes of data read
+} Far;
+
+static unsigned long long farTime()
+{
+#if defined(STREAMER_WIN32)
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	if (!frequency.QuadPart)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (unsigned long long)((counter.QuadPart / frequency.QuadPart) * 1000000 + ((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((unsigned long long)now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+static unsigned int farCores()
+{
+#if defined(STREAMER_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (unsigned int)count : 1;
+#endif
+}
+
+static void farLock(Far* far)
+{
+#if defined(STREAMER_WIN32)
+	EnterCriticalSection(&(far->lock));
+#else
+	pthread_mutex_lock(&(far->lock));
+#endif
+}
+
+static void farUnlock(Far* far)
+{
+#if defined(STREAMER_WIN32)
+	LeaveCriticalSection(&(far->lock));
+#else
+	pthread_mutex_unlock(&(far->lock));
+#endif
+}
+
+static void farWait(Far* far)
+{
+#if defined(STREAMER_WIN32)
+	SleepConditionVariableCS(&(far->signal), &(far->lock), INFINITE);
+#else
+	pthread_cond_wait(&(far->signal), &(far->lock));
+#endif
+}
+
+static void farWake(Far* far)
+{
+#if defined(STREAMER_WIN32)
+	WakeAllConditionVariable(&(far->signal));
+#else
+	pthread_cond_broadcast(&(far->signal));
+#endif
+}
+
+static int farReserve(void** data, unsigned int* capacity, unsigned int count, unsigned int size)
+{
+	unsigned int target = *capacity ? *capacity : 256;
+	void* memory;
+
+	if (count < *capacity)
+	{
+		return 0;
+	}
+
+	while (target <= count)
+	{
+		target *= 2;
+	}
+
+	memory = realloc(*data, (size_t)target * size);
+	if (!memory)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+
+	*data = memory;
+	*capacity = target;
+	return 0;
+}
+
+static unsigned int farIntern(FarPool* pool, const char* string)
+{
+	unsigned int length = (unsigned int)strlen(string) + 1;
+	unsigned int offset = pool->size;
+
+	if (((pool->size + length) > pool->capacity) && (farReserve((void**)&(pool->data), &(pool->capacity), pool->size + length, 1) < 0))
+	{
+		return FAR_NONE;
+	}
+
+	memcpy(pool->data + offset, string, length);
+	pool->size += length;
+	return offset;
+}
+
+static int farJoin(char* buffer, const char* path, const char* name)
+{
+	size_t length = strlen(path);
+
+	if ((length + strlen(name) + 2) > FAR_MAX_PATH)
+	{
+		fprintf(stderr, "Path too long below \"%s\"\n", path);
+		return -1;
+	}
+
+	memcpy(buffer, path, length);
+	buffer[length] = '/';
+	strcpy(buffer + length + 1, name);
+	return 0;
+}
+
+typedef struct FarListed
+{
+	unsigned int name;		// Offset of name in listing
+	int directory;
+	unsigned long long size;
+} FarListed;
+
+typedef struct FarListing
+{
+	FarPool names;
+	FarListed* entries;
+	unsigned int count;
+	unsigned int capacity;
+} FarListing;
+
+static const FarListing* s_sortListing;
+
+static int farCompareListing(const void* a, const void* b)
+{
+	return strcmp(s_sortListing->names.data + ((const FarListed*)a)->name, s_sortListing->names.data + ((const FarListed*)b)->name);
+}
+
+static int farListAdd(FarListing* listing, const char* name, int directory, unsigned long long size)
+{
+	FarListed* entry;
+
+	if (farReserve((void**)&(listing->entries), &(listing->capacity), listing->count, sizeof(FarListed)) < 0)
+	{
+		return -1;
+	}
+
+	entry = &(listing->entries[listing->count]);
+	entry->name = farIntern(&(listing->names), name);
+	entry->directory = directory;
+	entry->size = size;
+
+	if (entry->name == FAR_NONE)
+	{
+		return -1;
+	}
+
+	++listing->count;
+	return 0;
+}
+
+static int farList(const char* path, FarListing* listing)
+{
+#if defined(STREAMER_WIN32)
+	WIN32_FIND_DATAA data;
+	char pattern[FAR_MAX_PATH];
+	HANDLE find;
+
+	if (farJoin(pattern, path, "*") < 0)
+	{
+		return -1;
+	}
+
+	find = FindFirstFileA(pattern, &data);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		return GetLastError() == ERROR_FILE_NOT_FOUND ? 0 : -1;
+	}
+
+	do
+	{
+		int directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? 1 : 0;
+
+		if (!strcmp(data.cFileName, ".") || !strcmp(data.cFileName, ".."))
+		{
+			continue;
+		}
+
+		if (farListAdd(listing, data.cFileName, directory, (((unsigned long long)data.nFileSizeHigh) << 32) | data.nFileSizeLow) < 0)
+		{
+			FindClose(find);
+			return -1;
+		}
+	}
+	while (FindNextFileA(find, &data));
+
+	FindClose(find);
+	return 0;
+#else
+	DIR* dir = opendir(path);
+	struct dirent* entry;
+
+	if (!dir)
+	{
+		return -1;
+	}
+
+	while ((entry = readdir(dir)) != 0)
+	{
+		char target[FAR_MAX_PATH];
+		struct stat info;
+
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+		{
+			continue;
+		}
+
+		if (farJoin(target, path, entry->d_name) < 0)
+		{
+			closedir(dir);
+			return -1;
+		}
+
+		if (stat(target, &info) < 0)
+		{
+			fprintf(stderr, "Could not stat \"%s\"\n", target);
+			closedir(dir);
+			return -1;
+		}
+
+		// Only regular files and directories are packed, symbolic links are followed
+
+		if (!S_ISDIR(info.st_mode) && !S_ISREG(info.st_mode))
+		{
+			continue;
+		}
+
+		if (farListAdd(listing, entry->d_name, S_ISDIR(info.st_mode), (unsigned long long)info.st_size) < 0)
+		{
+			closedir(dir);
+			return -1;
+		}
+	}
+
+	closedir(dir);
+	return 0;
+#endif
+}
+
+static int farScan(Far* far, unsigned int directory, const char* path)
+{
+	FarListing listing;
+	unsigned int i, last = FAR_NONE;
+	int result = -1;
+
+	memset(&listing, 0, sizeof(listing));
+
+	do
+	{
+		if (farList(path, &listing) < 0)
+		{
+			fprintf(stderr, "Could not list \"%s\"\n", path);
+			break;
+		}
+
+		// Sorted names keep archives reproducible, independent of directory order on disk
+
+		s_sortListing = &listing;
+		qsort(listing.entries, listing.count, sizeof(FarListed), farCompareListing);
+
+		// Files of a directory are stored as a contiguous range of entries
+
+		far->directories[directory].first = far->fileCount;
+		for (i = 0; i < listing.count; ++i)
+		{
+			const char* name = listing.names.data + listing.entries[i].name;
+			char source[FAR_MAX_PATH];
+			FarFile* file;
+
+			if (listing.entries[i].directory)
+			{
+				continue;
+			}
+
+			if (farJoin(source, path, name) < 0)
+			{
+				break;
+			}
+
+			if (farReserve((void**)&(far->files), &(far->fileCapacity), far->fileCount, sizeof(FarFile)) < 0)
+			{
+				break;
+			}
+
+			file = &(far->files[far->fileCount]);
+			memset(file, 0, sizeof(FarFile));
+
+			file->name = farIntern(&(far->names), name);
+			file->source = farIntern(&(far->sources), source);
+			file->size = listing.entries[i].size;
+
+			if ((file->name == FAR_NONE) || (file->source == FAR_NONE))
+			{
+				break;
+			}
+
+			++far->fileCount;
+			++far->directories[directory].count;
+		}
+
+		if (i != listing.count)
+		{
+			break;
+		}
+
+		for (i = 0; i < listing.count; ++i)
+		{
+			const char* name = listing.names.data + listing.entries[i].name;
+			char source[FAR_MAX_PATH];
+			unsigned int child = far->directoryCount;
+			FarDirectory* entry;
+
+			if (!listing.entries[i].directory)
+			{
+				continue;
+			}
+
+			if (farJoin(source, path, name) < 0)
+			{
+				break;
+			}
+
+			if (farReserve((void**)&(far->directories), &(far->directoryCapacity), far->directoryCount, sizeof(FarDirectory)) < 0)
+			{
+				break;
+			}
+
+			entry = &(far->directories[child]);
+			entry->parent = directory;
+			entry->children = FAR_NONE;
+			entry->next = FAR_NONE;
+			entry->name = farIntern(&(far->names), name);
+			entry->first = 0;
+			entry->count = 0;
+			++far->directoryCount;
+
+			if (entry->name == FAR_NONE)
+			{
+				break;
+			}
+
+			if (last == FAR_NONE)
+			{
+				far->directories[directory].children = child;
+			}
+			else
+			{
+				far->directories[last].next = child;
+			}
+			last = child;
+
+			if (farScan(far, child, source) < 0)
+			{
+				break;
+			}
+		}
+
+		if (i != listing.count)
+		{
+			break;
+		}
+
+		result = 0;
+	}
+	while (0);
+
+	free(listing.names.data);
+	free(listing.entries);
+	return result;
+}
+
+static void farCompress(Far* far, FarJob* job)
+{
+	const unsigned char* input = job->input;
+	unsigned char* output = job->output;
+	unsigned int remaining = job->length;
+
+	if (far->store)
+	{
+		job->packed = job->length;
+		return;
+	}
+
+	// Blocks that do not shrink are stored, so incompressible data costs only the block headers
+
+	while (remaining > 0)
+	{
+		unsigned int count = remaining < far->blockSize ? remaining : far->blockSize;
+		int packed = count >= 16 ? fastlz_compress_level(far->level, input, (int)count, output + far->header) : (int)count;
+		int stored = (packed <= 0) || (packed >= (int)count);
+
+		if (stored)
+		{
+			memcpy(output + far->header, input, count);
+			packed = (int)count;
+		}
+
+		if (far->header == sizeof(fa_block_crc_t))
+		{
+			fa_block_crc_t block;
+
+			block.original = count;
+			block.compressed = stored ? (count | FA_COMPRESSION_SIZE_IGNORE_32) : (uint32_t)packed;
+			block.checksum = Crc32c_Update(Crc32c_Update(0, &block, sizeof(block.original) + sizeof(block.compressed)), output + far->header, (uint32_t)packed);
+			memcpy(output, &block, sizeof(block));
+		}
+		else if (far->header == sizeof(fa_block32_t))
+		{
+			fa_block32_t block;
+
+			block.original = count;
+			block.compressed = stored ? (count | FA_COMPRESSION_SIZE_IGNORE_32) : (uint32_t)packed;
+			memcpy(output, &block, sizeof(block));
+		}
+		else
+		{
+			fa_block_t block;
+
+			block.original = (uint16_t)count;
+			block.compressed = (uint16_t)(stored ? (count | FA_COMPRESSION_SIZE_IGNORE) : (unsigned int)packed);
+			memcpy(output, &block, sizeof(block));
+		}
+
+		output += far->header + packed;
+		input += count;
+		remaining -= count;
+	}
+
+	job->packed = (unsigned int)(output - job->output);
+}
+
+static void farDigest(SHA1Context* state, fa_hash_t* hash)
+{
+	int i;
+
+	SHA1Result(state);
+	for (i = 0; i < 20; ++i)
+	{
+		hash->data[i] = (uint8_t)((state->Message_Digest[i / 4] >> ((3 - (i & 3)) * 8)) & 0xff);
+	}
+}
+
+#if defined(STREAMER_WIN32)
+static DWORD WINAPI farWorker(LPVOID data)
+#else
+static void* farWorker(void* data)
+#endif
+{
+	Far* far = (Far*)data;
+
+	farLock(far);
+	for (;;)
+	{
+		FarJob* job = 0;
+		unsigned long long i;
+
+		for (i = far->tail; i < far->head; ++i)
+		{
+			if (far->jobs[i % far->jobCount].state == FarJobState_Loaded)
+			{
+				job = &(far->jobs[i % far->jobCount]);
+				break;
+			}
+		}
+
+		if (!job)
+		{
+			if (far->quit)
+			{
+				break;
+			}
+
+			farWait(far);
+			continue;
+		}
+
+		job->state = FarJobState_Compressing;
+		farUnlock(far);
+
+		farCompress(far, job);
+
+		farLock(far);
+		job->state = FarJobState_Compressed;
+
+		// Content hashes are sequential per file, so whoever completes the next chunk in order
+		// hashes it and then continues with any later chunks that were compressed meanwhile
+
+		while (job && (job->state == FarJobState_Compressed) && (far->files[job->file].hashed == job->chunk))
+		{
+			SHA1Context* stream = &(far->streams[job->file % far->jobCount]);
+			FarJob* next;
+
+			job->state = FarJobState_Hashing;
+			farUnlock(far);
+
+			if (!job->chunk)
+			{
+				SHA1Reset(stream);
+			}
+			SHA1Input(stream, job->input, job->length);
+			if (job->last)
+			{
+				farDigest(stream, &(far->hashes[job->file]));
+			}
+
+			farLock(far);
+			job->state = FarJobState_Done;
+			++far->files[job->file].hashed;
+
+			next = &(far->jobs[(job->sequence + 1) % far->jobCount]);
+			job = ((job->sequence + 1) < far->head) && (next->file == job->file) ? next : 0;
+		}
+
+		farWake(far);
+	}
+	farUnlock(far);
+
+	return 0;
+}
+
+static int farStartWorkers(Far* far)
+{
+	unsigned int i;
+
+	for (i = 0; i < far->threads; ++i)
+	{
+#if defined(STREAMER_WIN32)
+		far->workers[i] = CreateThread(0, 0, farWorker, far, 0, 0);
+		if (!far->workers[i])
+#else
+		if (pthread_create(&(far->workers[i]), 0, farWorker, far))
+#endif
+		{
+			fprintf(stderr, "Failed to start worker thread\n");
+			far->threads = i;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void farStopWorkers(Far* far)
+{
+	unsigned int i;
+
+	farLock(far);
+	far->quit = 1;
+	farWake(far);
+	farUnlock(far);
+
+	for (i = 0; i < far->threads; ++i)
+	{
+#if defined(STREAMER_WIN32)
+		WaitForSingleObject(far->workers[i], INFINITE);
+		CloseHandle(far->workers[i]);
+#else
+		pthread_join(far->workers[i], 0);
+#endif
+	}
+}
+
+static int farPack(Far* far)
+{
+	unsigned int file = 0, chunk = 0;
+	unsigned long long remaining = 0;
+	FILE* in = 0;
+	int failed = 0;
+
+	farLock(far);
+	while (!failed)
+	{
+		FarJob* job;
+
+		// Write completed jobs in submission order first, to free slots for loading
+
+		if ((far->tail < far->head) && (far->jobs[far->tail % far->jobCount].state == FarJobState_Done))
+		{
+			job = &(far->jobs[far->tail % far->jobCount]);
+			farUnlock(far);
+
+			if (!job->chunk)
+			{
+				far->files[job->file].data = far->position;
+			}
+
+			if (job->packed && (fwrite(far->store ? job->input : job->output, 1, job->packed, far->out) != job->packed))
+			{
+				fprintf(stderr, "Failed writing archive data\n");
+				failed = 1;
+			}
+
+			far->files[job->file].compressed += job->packed;
+			far->position += job->packed;
+
+			farLock(far);
+			job->state = FarJobState_Free;
+			++far->tail;
+			continue;
+		}
+
+		if (((far->head - far->tail) < far->jobCount) && (file < far->fileCount))
+		{
+			FarFile* source = &(far->files[file]);
+
+			job = &(far->jobs[far->head % far->jobCount]);
+			farUnlock(far);
+
+			if (!in)
+			{
+				in = fopen(far->sources.data + source->source, "rb");
+				if (!in)
+				{
+					fprintf(stderr, "Could not open \"%s\"\n", far->sources.data + source->source);
+					farLock(far);
+					failed = 1;
+					break;
+				}
+
+				remaining = source->size;
+				chunk = 0;
+			}
+
+			job->sequence = far->head;
+			job->file = file;
+			job->chunk = chunk++;
+			job->length = remaining < far->chunkSize ? (unsigned int)remaining : far->chunkSize;
+
+			if (job->length && (fread(job->input, 1, job->length, in) != job->length))
+			{
+				fprintf(stderr, "Short read from \"%s\", was it modified while packing?\n", far->sources.data + source->source);
+				farLock(far);
+				failed = 1;
+				break;
+			}
+
+			remaining -= job->length;
+			job->last = remaining ? 0 : 1;
+			far->total += job->length;
+
+			if (job->last)
+			{
+				fclose(in);
+				in = 0;
+				++file;
+			}
+
+			farLock(far);
+			job->state = FarJobState_Loaded;
+			++far->head;
+			farWake(far);
+			continue;
+		}
+
+		if ((far->tail == far->head) && (file == far->fileCount))
+		{
+			break;
+		}
+
+		farWait(far);
+	}
+	farUnlock(far);
+
+	if (in)
+	{
+		fclose(in);
+	}
+
+	return failed ? -1 : 0;
+}
+
+static int farWriteToc(Far* far)
+{
+	unsigned int containersOffset = sizeof(fa_header_t);
+	unsigned int entriesOffset = containersOffset + far->directoryCount * sizeof(fa_container_t);
+	unsigned int hashesOffset = entriesOffset + far->fileCount * sizeof(fa_entry_t);
+	unsigned int extentsOffset = hashesOffset + far->fileCount * sizeof(fa_hash_t);
+	unsigned int namesOffset = extentsOffset + far->fileCount * sizeof(fa_extent_t);
+	unsigned long long tocSize = ((unsigned long long)namesOffset + far->names.size + 3) & ~3ull;
+	unsigned char* toc = 0;
+	unsigned char* packed = 0;
+	unsigned char* table = 0;
+	static const unsigned char zero[8] = { 0 };
+	unsigned int packedSize = 0, tableSize = 0, padding, i;
+	fa_header_t* header;
+	fa_container_t* containers;
+	fa_entry_t* entries;
+	fa_extent_t* extents;
+	fa_footer64_t footer;
+	fa_trailer_t trailer;
+	SHA1Context state;
+	int result = -1;
+
+	do
+	{
+		if (tocSize > 0x7fffffff)
+		{
+			fprintf(stderr, "Archive TOC too large\n");
+			break;
+		}
+
+		toc = calloc(1, (size_t)tocSize);
+		if (!toc)
+		{
+			fprintf(stderr, "Failed to allocate TOC\n");
+			break;
+		}
+
+		header = (fa_header_t*)toc;
+		containers = (fa_container_t*)(toc + containersOffset);
+		entries = (fa_entry_t*)(toc + entriesOffset);
+		extents = (fa_extent_t*)(toc + extentsOffset);
+
+		header->cookie = FA_MAGIC_COOKIE_HEADER;
+		header->version = far->version;
+		header->size = (uint32_t)tocSize;
+		header->flags = 0;
+		header->containers.offset = containersOffset;
+		header->containers.count = far->directoryCount;
+		header->entries.offset = entriesOffset;
+		header->entries.count = far->fileCount;
+		header->hashes = hashesOffset;
+		header->extents = extentsOffset;
+		header->blockSize = far->store ? 0 : far->blockSize;
+
+		for (i = 0; i < far->directoryCount; ++i)
+		{
+			const FarDirectory* directory = &(far->directories[i]);
+
+			containers[i].parent = i ? containersOffset + directory->parent * sizeof(fa_container_t) : FA_INVALID_OFFSET;
+			containers[i].children = directory->children != FAR_NONE ? containersOffset + directory->children * sizeof(fa_container_t) : FA_INVALID_OFFSET;
+			containers[i].next = directory->next != FAR_NONE ? containersOffset + directory->next * sizeof(fa_container_t) : FA_INVALID_OFFSET;
+			containers[i].name = directory->name != FAR_NONE ? namesOffset + directory->name : FA_INVALID_OFFSET;
+			containers[i].entries.offset = entriesOffset + directory->first * sizeof(fa_entry_t);
+			containers[i].entries.count = directory->count;
+		}
+
+		for (i = 0; i < far->fileCount; ++i)
+		{
+			const FarFile* file = &(far->files[i]);
+
+			entries[i].data = (uint32_t)file->data;
+			entries[i].name = namesOffset + file->name;
+			entries[i].compression = far->store ? FA_COMPRESSION_NONE : FA_COMPRESSION_FASTLZ;
+			entries[i].blockSize = far->store ? 0 : far->blockSize;
+			entries[i].size.original = (uint32_t)file->size;
+			entries[i].size.compressed = (uint32_t)file->compressed;
+
+			extents[i].data = (uint32_t)(file->data >> 32);
+			extents[i].original = (uint32_t)(file->size >> 32);
+			extents[i].compressed = (uint32_t)(file->compressed >> 32);
+		}
+
+		memcpy(toc + hashesOffset, far->hashes, far->fileCount * sizeof(fa_hash_t));
+		memcpy(toc + namesOffset, far->names.data, far->names.size);
+
+		memset(&footer, 0, sizeof(footer));
+		footer.toc.compression = FA_COMPRESSION_NONE;
+		footer.toc.original = (uint32_t)tocSize;
+		footer.toc.compressed = (uint32_t)tocSize;
+		footer.data.original = far->total;
+
+		// Readers use uncompressed TOCs in place, so the TOC starts on an 8 byte boundary with the data padded up to it
+
+		padding = (unsigned int)((8 - (far->position & 7)) & 7);
+		footer.data.compressed = far->position + padding;
+
+		SHA1Reset(&state);
+		SHA1Input(&state, toc, (unsigned)tocSize);
+		farDigest(&state, &(footer.toc.hash));
+
+		// Compressed TOCs are paged, each page a block the reader can decompress on its own when first touched
+
+		if (far->packToc)
+		{
+			Far local;
+			FarJob job;
+			fa_pages_t* pages;
+			uint32_t* offsets;
+			unsigned int count = (unsigned int)((tocSize + FAR_TOC_BLOCK_SIZE - 1) / FAR_TOC_BLOCK_SIZE), position = 0;
+
+			tableSize = sizeof(fa_pages_t) + (count + 1) * sizeof(uint32_t);
+			packed = malloc((size_t)FAR_OUTPUT_SIZE(tocSize, FAR_TOC_BLOCK_SIZE));
+			table = malloc(tableSize);
+			if (!packed || !table)
+			{
+				fprintf(stderr, "Failed to allocate TOC\n");
+				break;
+			}
+
+			memset(&local, 0, sizeof(local));
+			local.level = far->level;
+			local.blockSize = FAR_TOC_BLOCK_SIZE;
+			local.header = sizeof(fa_block_t);
+
+			job.input = toc;
+			job.output = packed;
+			job.length = (unsigned int)tocSize;
+			farCompress(&local, &job);
+
+			packedSize = job.packed;
+
+			pages = (fa_pages_t*)table;
+			pages->size = FAR_TOC_BLOCK_SIZE;
+			pages->count = count;
+
+			offsets = (uint32_t*)(table + sizeof(fa_pages_t));
+			for (i = 0; i < count; ++i)
+			{
+				fa_block_t block;
+
+				memcpy(&block, packed + position, sizeof(block));
+				offsets[i] = tableSize + position;
+				position += sizeof(fa_block_t) + (block.compressed & ~FA_COMPRESSION_SIZE_IGNORE);
+			}
+			offsets[count] = tableSize + position;
+
+			footer.toc.compression = FA_COMPRESSION_FASTLZ_PAGED;
+			footer.toc.compressed = tableSize + packedSize;
+		}
+
+		if (fwrite(zero, 1, padding, far->out) != padding)
+		{
+			fprintf(stderr, "Failed writing TOC\n");
+			break;
+		}
+
+		if (far->packToc ? ((fwrite(table, 1, tableSize, far->out) != tableSize) || (fwrite(packed, 1, packedSize, far->out) != packedSize)) : (fwrite(toc, 1, (size_t)tocSize, far->out) != tocSize))
+		{
+			fprintf(stderr, "Failed writing TOC\n");
+			break;
+		}
+
+		// Archives with less than 4GB of data keep the narrow footer, which older readers understand
+
+		if ((footer.data.original > 0xffffffff) || (footer.data.compressed > 0xffffffff))
+		{
+			footer.cookie = FA_MAGIC_COOKIE_FOOTER_64;
+			if (fwrite(&footer, sizeof(footer), 1, far->out) != 1)
+			{
+				fprintf(stderr, "Failed writing footer\n");
+				break;
+			}
+
+			trailer.footer = sizeof(footer);
+		}
+		else
+		{
+			fa_footer_t narrow;
+
+			narrow.cookie = FA_MAGIC_COOKIE_FOOTER;
+			narrow.toc.compression = footer.toc.compression;
+			narrow.toc.original = footer.toc.original;
+			narrow.toc.compressed = footer.toc.compressed;
+			narrow.toc.hash = footer.toc.hash;
+			narrow.data.original = (uint32_t)footer.data.original;
+			narrow.data.compressed = (uint32_t)footer.data.compressed;
+
+			if (fwrite(&narrow, sizeof(narrow), 1, far->out) != 1)
+			{
+				fprintf(stderr, "Failed writing footer\n");
+				break;
+			}
+
+			trailer.footer = sizeof(narrow);
+		}
+
+		// The trailer lets readers find the footer with one small read at the end of the archive
+
+		trailer.version = far->version;
+		trailer.cookie = FA_MAGIC_COOKIE_TRAILER;
+		if (fwrite(&trailer, sizeof(trailer), 1, far->out) != 1)
+		{
+			fprintf(stderr, "Failed writing trailer\n");
+			break;
+		}
+
+		result = 0;
+	}
+	while (0);
+
+	free(table);
+	free(packed);
+	free(toc);
+	return result;
+}
+
+static void farUsage()
+{
+	fprintf(stderr, "\nFile archive builder - pack a directory tree into a streamer file archive\n\n");
+	fprintf(stderr, "Usage: far [options] <directory> <archive>\n\n");
+	fprintf(stderr, "  --threads <n>    Compression threads (default: one per core)\n");
+	fprintf(stderr, "  --level <n>      FastLZ compression level, 1 (faster) or 2 (smaller) (default: 1)\n");
+	fprintf(stderr, "  --block-size <n> Block size in KB, 16 to %d (default: %d)\n", FA_BLOCK_SIZE_MAX / 1024, FAR_BLOCK_SIZE / 1024);
+	fprintf(stderr, "  --store          Store files without compression\n");
+	fprintf(stderr, "  --pack-toc       Compress the table of contents\n");
+	fprintf(stderr, "  --checksums      Add a CRC32C to each block, for verifying reads\n\n");
+}
+
+int main(int argc, char* argv[])
+{
+	const char* input = 0;
+	const char* output = 0;
+	unsigned long long start, elapsed;
+	unsigned int i;
+	int result = 1;
+	Far far;
+
+	memset(&far, 0, sizeof(far));
+	far.level = 1;
+	far.threads = farCores();
+	far.blockSize = FAR_BLOCK_SIZE;
+
+	for (i = 1; i < (unsigned int)argc; ++i)
+	{
+		const char* value = (i + 1) < (unsigned int)argc ? argv[i + 1] : 0;
+
+		if (!strcmp(argv[i], "--store"))
+		{
+			far.store = 1;
+		}
+		else if (!strcmp(argv[i], "--pack-toc"))
+		{
+			far.packToc = 1;
+		}
+		else if (!strcmp(argv[i], "--checksums"))
+		{
+			far.checksums = 1;
+		}
+		else if (value && !strcmp(argv[i], "--threads"))
+		{
+			far.threads = (unsigned int)atoi(value);
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--level"))
+		{
+			far.level = atoi(value);
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--block-size"))
+		{
+			far.blockSize = (unsigned int)atoi(value) * 1024;
+			++i;
+		}
+		else if ((argv[i][0] != '-') && !input)
+		{
+			input = argv[i];
+		}
+		else if ((argv[i][0] != '-') && !output)
+		{
+			output = argv[i];
+		}
+		else
+		{
+			farUsage();
+			return 1;
+		}
+	}
+
+	if (!input || !output)
+	{
+		farUsage();
+		return 1;
+	}
+
+	if (!far.threads || (far.threads > FAR_MAX_THREADS) || (far.level < 1) || (far.level > 2))
+	{
+		fprintf(stderr, "Threads must be between 1 and %d, level must be 1 or 2\n", FAR_MAX_THREADS);
+		return 1;
+	}
+
+	if ((far.blockSize < 16 * 1024) || (far.blockSize > FA_BLOCK_SIZE_MAX))
+	{
+		fprintf(stderr, "Block size must be between 16 and %d KB\n", FA_BLOCK_SIZE_MAX / 1024);
+		return 1;
+	}
+
+	far.chunkSize = (FAR_CHUNK_SIZE / far.blockSize) * far.blockSize;
+	far.header = far.checksums ? sizeof(fa_block_crc_t) : sizeof(fa_block32_t);
+	far.version = far.checksums ? FA_VERSION_4 : FA_VERSION_3;
+
+	start = farTime();
+
+#if defined(STREAMER_WIN32)
+	InitializeCriticalSection(&(far.lock));
+	InitializeConditionVariable(&(far.signal));
+#else
+	pthread_mutex_init(&(far.lock), 0);
+	pthread_cond_init(&(far.signal), 0);
+#endif
+
+	do
+	{
+		if (farReserve((void**)&(far.directories), &(far.directoryCapacity), 0, sizeof(FarDirectory)) < 0)
+		{
+			break;
+		}
+
+		far.directories[0].parent = FAR_NONE;
+		far.directories[0].children = FAR_NONE;
+		far.directories[0].next = FAR_NONE;
+		far.directories[0].name = FAR_NONE;
+		far.directories[0].first = 0;
+		far.directories[0].count = 0;
+		far.directoryCount = 1;
+
+		if (farScan(&far, 0, input) < 0)
+		{
+			break;
+		}
+
+		fprintf(stderr, "Packing %u files in %u directories using %u threads...\n", far.fileCount, far.directoryCount, far.threads);
+
+		far.jobCount = far.threads * FAR_JOBS_PER_THREAD;
+		far.jobs = calloc(far.jobCount, sizeof(FarJob));
+		far.streams = malloc(far.jobCount * sizeof(SHA1Context));
+		far.hashes = malloc((far.fileCount ? far.fileCount : 1) * sizeof(fa_hash_t));
+		if (!far.jobs || !far.streams || !far.hashes)
+		{
+			fprintf(stderr, "Out of memory\n");
+			break;
+		}
+
+		for (i = 0; i < far.jobCount; ++i)
+		{
+			far.jobs[i].input = malloc(far.chunkSize);
+			far.jobs[i].output = malloc(FAR_OUTPUT_SIZE(far.chunkSize, far.blockSize));
+			if (!far.jobs[i].input || !far.jobs[i].output)
+			{
+				break;
+			}
+		}
+
+		if (i != far.jobCount)
+		{
+			fprintf(stderr, "Out of memory\n");
+			break;
+		}
+
+		far.out = fopen(output, "wb");
+		if (!far.out)
+		{
+			fprintf(stderr, "Could not create \"%s\"\n", output);
+			break;
+		}
+
+		if (farStartWorkers(&far) < 0)
+		{
+			farStopWorkers(&far);
+			break;
+		}
+
+		result = farPack(&far);
+		farStopWorkers(&far);
+
+		if (result || (farWriteToc(&far) < 0))
+		{
+			result = 1;
+			break;
+		}
+
+		if (fclose(far.out))
+		{
+			fprintf(stderr, "Failed writing \"%s\"\n", output);
+			far.out = 0;
+			result = 1;
+			break;
+		}
+		far.out = 0;
+
+		elapsed = farTime() - start;
+		fprintf(stderr, "Packed %llu bytes into %llu bytes (%.1f%%) in %.2f s, %.1f MB/s\n", far.total, far.position, far.total ? (100.0 * far.position) / far.total : 100.0,
+			elapsed / 1000000.0, elapsed ? (far.total / (1024.0 * 1024.0)) / (elapsed / 1000000.0) : 0.0);
+	}
+	while (0);
+
+	if (far.out)
+	{
+		fclose(far.out);
+		remove(output);
+	}
+
+	if (far.jobs)
+	{
+		for (i = 0; i < far.jobCount; ++i)
+		{
+			free(far.jobs[i].input);
+			free(far.jobs[i].output);
+		}
+	}
+
+#if defined(STREAMER_WIN32)
+	DeleteCriticalSection(&(far.lock));
+#else
+	pthread_mutex_destroy(&(far.lock));
+	pthread_cond_destroy(&(far.signal));
+#endif
+
+	free(far.jobs);
+	free(far.streams);
+	free(far.hashes);
+	free(far.files);
+	free(far.directories);
+	free(far.names.data);
+	free(far.sources.data);
+
+	return result;
+}
@@ -0,0 +1,586 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <streamer/streamer.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(STREAMER_WIN32)
+#include <windows.h>
+#elif defined(STREAMER_UNIX)
+#include <sched.h>
+#include <time.h>
+#endif
+
+typedef enum
+{
+	ReplayOp_Open,
+	ReplayOp_Read,
+	ReplayOp_LSeek,
+	ReplayOp_Close,
+
+	ReplayOp_Count
+} ReplayOp;
+
+typedef struct ReplaySamples
+{
+	unsigned int* data;	// Latencies in microseconds
+	unsigned int count;
+	unsigned int capacity;
+} ReplaySamples;
+
+typedef struct ReplayHandle
+{
+	int fd;				// Handle in replay, <0 if not open
+	int pending;			// Set while a request is outstanding
+	ReplayOp op;			// Operation of outstanding request
+	unsigned long long submitted;	// Time when outstanding request was submitted
+	int expected;			// Result of the request in the recording
+	int recorded;			// Set when the recording holds the result of the outstanding request
+} ReplayHandle;
+
+typedef struct Replay
+{
+	StreamerContext* context;
+	ReplayHandle handles[STREAMER_MAX_FILEHANDLES];
+	ReplaySamples samples[ReplayOp_Count];
+	unsigned char* buffer;
+	unsigned int version;		// Version of recording
+
+	unsigned long long bytes;
+	unsigned int calls;
+	unsigned int skipped;		// Calls that failed in the recording and were not replayed
+	unsigned int failures;		// Calls that succeeded in the recording but failed in the replay
+	unsigned int mismatches;	// Requests completing with a different result than in the recording
+} Replay;
+
+// Entries of version 1 and 2 recordings, with time wrapping after 71 minutes. Version 1 entries end before offset
+
+typedef struct ReplayLegacyEntry
+{
+	unsigned int time;
+	unsigned char call;
+	unsigned char reserved;
+	unsigned short path;
+	int fd;
+	int argument;
+	int whence;
+	int result;
+	StreamerOffset offset;
+} ReplayLegacyEntry;
+
+static const char* s_opNames[ReplayOp_Count] = { "open", "read", "lseek", "close" };
+
+static unsigned long long replayTime()
+{
+#if defined(STREAMER_WIN32)
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	if (!frequency.QuadPart)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (unsigned long long)((counter.QuadPart / frequency.QuadPart) * 1000000 + ((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((unsigned long long)now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+static void replayYield()
+{
+#if defined(STREAMER_WIN32)
+	SleepEx(0, TRUE);
+#elif defined(STREAMER_UNIX)
+	sched_yield();
+#endif
+}
+
+static void replayAddSample(ReplaySamples* samples, unsigned long long value)
+{
+	if (samples->count == samples->capacity)
+	{
+		unsigned int capacity = samples->capacity ? samples->capacity * 2 : 1024;
+		unsigned int* data = realloc(samples->data, capacity * sizeof(unsigned int));
+
+		if (!data)
+		{
+			return;
+		}
+		samples->data = data;
+		samples->capacity = capacity;
+	}
+
+	samples->data[samples->count++] = value > 0xffffffff ? 0xffffffff : (unsigned int)value;
+}
+
+static int replayCompare(const void* a, const void* b)
+{
+	unsigned int x = *(const unsigned int*)a;
+	unsigned int y = *(const unsigned int*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static unsigned int replayPercentile(const ReplaySamples* samples, unsigned int permille)
+{
+	unsigned int index;
+
+	if (!samples->count)
+	{
+		return 0;
+	}
+
+	index = (unsigned int)(((unsigned long long)samples->count * permille + 999) / 1000);
+	return samples->data[index ? index - 1 : 0];
+}
+
+static unsigned int replayEntrySize(unsigned int version)
+{
+	if (version < 3)
+	{
+		return version < 2 ? (unsigned int)offsetof(ReplayLegacyEntry, offset) : (unsigned int)sizeof(ReplayLegacyEntry);
+	}
+
+	return (unsigned int)sizeof(StreamerRecordEntry);
+}
+
+static void replayDecode(StreamerRecordEntry* entry, const unsigned char* curr, unsigned int version)
+{
+	ReplayLegacyEntry legacy;
+
+	memset(entry, 0, sizeof(*entry));
+
+	if (version >= 3)
+	{
+		memcpy(entry, curr, sizeof(*entry));
+		return;
+	}
+
+	memset(&legacy, 0, sizeof(legacy));
+	memcpy(&legacy, curr, replayEntrySize(version));
+
+	entry->time = legacy.time;
+	entry->call = legacy.call;
+	entry->path = legacy.path;
+	entry->fd = legacy.fd;
+	entry->argument = legacy.argument;
+	entry->whence = legacy.whence;
+	entry->result = legacy.result;
+	entry->offset = version < 2 ? legacy.argument : legacy.offset;
+}
+
+static void replayComplete(Replay* replay, ReplayHandle* handle)
+{
+	int result;
+
+	// Block until the outstanding request on handle completes
+
+	while ((result = streamerContextPoll(replay->context, handle->fd)) == StreamerResult_Pending)
+	{
+		replayYield();
+	}
+
+	replayAddSample(&(replay->samples[handle->op]), replayTime() - handle->submitted);
+	handle->pending = 0;
+
+	if ((handle->op == ReplayOp_Read) && (result > 0))
+	{
+		replay->bytes += result;
+	}
+
+	if (handle->recorded && (result != handle->expected))
+	{
+		++replay->mismatches;
+	}
+
+	if (handle->op == ReplayOp_Close)
+	{
+		handle->fd = -1;
+	}
+}
+
+static void replaySubmitted(Replay* replay, ReplayHandle* handle, ReplayOp op, int result)
+{
+	if (result < 0)
+	{
+		++replay->failures;
+		return;
+	}
+
+	handle->pending = 1;
+	handle->op = op;
+	handle->recorded = 0;
+}
+
+static int replayRun(Replay* replay, const unsigned char* data, unsigned int size, int original)
+{
+	const unsigned char* curr = data + sizeof(StreamerRecordHeader);
+	const unsigned char* end = data + size;
+	unsigned long long start = replayTime();
+	unsigned int i;
+
+	while ((end - curr) >= (int)replayEntrySize(replay->version))
+	{
+		StreamerRecordEntry entry;
+		ReplayHandle* handle;
+		char path[256];
+		int result;
+
+		replayDecode(&entry, curr, replay->version);
+		curr += replayEntrySize(replay->version);
+
+		if ((entry.path >= sizeof(path)) || ((unsigned int)(end - curr) < entry.path))
+		{
+			fprintf(stderr, "Corrupt recording\n");
+			return -1;
+		}
+
+		memcpy(path, curr, entry.path);
+		path[entry.path] = 0;
+		curr += entry.path;
+
+		++replay->calls;
+
+		if ((entry.fd < 0) || (entry.fd >= STREAMER_MAX_FILEHANDLES) || ((entry.call != StreamerRecordCall_Poll) && (entry.result < 0)))
+		{
+			++replay->skipped;
+			continue;
+		}
+
+		if (original)
+		{
+			while ((replayTime() - start) < entry.time)
+			{
+				replayYield();
+			}
+		}
+
+		handle = &(replay->handles[entry.fd]);
+
+		// The recording never has two requests in flight on one handle, but the replay may run at a different pace
+
+		if (handle->pending && (entry.call != StreamerRecordCall_Poll))
+		{
+			replayComplete(replay, handle);
+		}
+
+		switch (entry.call)
+		{
+			case StreamerRecordCall_Open:
+			{
+				handle->submitted = replayTime();
+				result = streamerContextOpen(replay->context, path, (StreamerOpenMode)entry.argument);
+				handle->fd = result;
+				replaySubmitted(replay, handle, ReplayOp_Open, result);
+			}
+			break;
+
+			case StreamerRecordCall_Read:
+			case StreamerRecordCall_LSeek:
+			case StreamerRecordCall_LSeek64:
+			case StreamerRecordCall_Close:
+			{
+				if (handle->fd < 0)
+				{
+					++replay->failures;
+					break;
+				}
+
+				handle->submitted = replayTime();
+				switch (entry.call)
+				{
+					case StreamerRecordCall_Read: result = streamerContextRead(replay->context, handle->fd, replay->buffer, (unsigned int)entry.argument); break;
+					case StreamerRecordCall_LSeek: result = streamerContextLSeek(replay->context, handle->fd, entry.argument, (StreamerSeekMode)entry.whence); break;
+					case StreamerRecordCall_LSeek64: result = streamerContextLSeek64(replay->context, handle->fd, entry.offset, (StreamerSeekMode)entry.whence); break;
+					default: result = streamerContextClose(replay->context, handle->fd); break;
+				}
+				replaySubmitted(replay, handle, entry.call == StreamerRecordCall_Read ? ReplayOp_Read : (entry.call == StreamerRecordCall_Close ? ReplayOp_Close : ReplayOp_LSeek), result);
+			}
+			break;
+
+			case StreamerRecordCall_Poll:
+			{
+				if (handle->pending)
+				{
+					handle->expected = entry.result;
+					handle->recorded = 1;
+					replayComplete(replay, handle);
+				}
+			}
+			break;
+
+			default:
+			{
+				fprintf(stderr, "Unknown call %d in recording\n", entry.call);
+				return -1;
+			}
+			break;
+		}
+	}
+
+	// Requests the recording never polled still have to finish before the replay is done
+
+	for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+	{
+		if (replay->handles[i].pending)
+		{
+			replayComplete(replay, &(replay->handles[i]));
+		}
+	}
+
+	return 0;
+}
+
+static unsigned char* replayLoad(const char* filename, unsigned int* size, unsigned int* version, StreamerCounter* span, unsigned int* largest)
+{
+	const unsigned char* curr;
+	StreamerRecordHeader header;
+	unsigned char* data;
+	long length;
+	FILE* fp;
+
+	fp = fopen(filename, "rb");
+	if (!fp)
+	{
+		fprintf(stderr, "Failed to open \"%s\"\n", filename);
+		return 0;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	data = length > 0 ? malloc(length) : 0;
+	if (!data || (fread(data, 1, length, fp) != (size_t)length))
+	{
+		fprintf(stderr, "Failed to read \"%s\"\n", filename);
+		free(data);
+		fclose(fp);
+		return 0;
+	}
+	fclose(fp);
+
+	memcpy(&header, data, length < (long)sizeof(header) ? 0 : sizeof(header));
+	if ((length < (long)sizeof(header)) || (header.magic != STREAMER_RECORD_MAGIC) || (header.version < 1) || (header.version > STREAMER_RECORD_VERSION))
+	{
+		fprintf(stderr, "\"%s\" is not a streamer access recording\n", filename);
+		free(data);
+		return 0;
+	}
+
+	// Find the duration of the recording and the largest read, so one buffer can serve every read
+
+	*size = (unsigned int)length;
+	*version = header.version;
+	*span = 0;
+	*largest = 1;
+
+	for (curr = data + sizeof(header); (data + length - curr) >= (long)replayEntrySize(header.version);)
+	{
+		StreamerRecordEntry entry;
+
+		replayDecode(&entry, curr, header.version);
+		curr += replayEntrySize(header.version) + entry.path;
+
+		*span = entry.time;
+		if ((entry.call == StreamerRecordCall_Read) && (entry.argument > 0) && ((unsigned int)entry.argument > *largest))
+		{
+			*largest = (unsigned int)entry.argument;
+		}
+	}
+
+	return data;
+}
+
+static void replayUsage()
+{
+	fprintf(stderr, "\nStreamer replay - re-issue a recorded access pattern and report timing\n\n");
+	fprintf(stderr, "Usage: replay [options] <recording>\n\n");
+	fprintf(stderr, "  --direct <root>     Replay against loose files below root (default: current directory)\n");
+	fprintf(stderr, "  --archive <file>    Replay against a file archive\n");
+	fprintf(stderr, "  --transport <name>  Transport to use, fileio, cdvd or simulated (default: fileio)\n");
+	fprintf(stderr, "  --model <overhead>,<seek>,<seekrate>,<bandwidth>\n");
+	fprintf(stderr, "                      Device model for the simulated transport (us, us, us/MB, KB/s)\n");
+	fprintf(stderr, "  --virtual           Account simulated device time without waiting for it\n");
+	fprintf(stderr, "  --original          Issue calls at their recorded times instead of as fast as possible\n\n");
+	fprintf(stderr, "Recordings are made with streamerRecordStart(). A summary is printed to stderr and one JSON object to stdout.\n\n");
+}
+
+int main(int argc, char* argv[])
+{
+	StreamerTransport transport = StreamerTransport_FileIo;
+	StreamerContainer container = StreamerContainer_Direct;
+	const char* root = "";
+	const char* file = "";
+	const char* recording = 0;
+	unsigned int size, version, largest, i;
+	StreamerCounter span;
+	unsigned long long start, elapsed;
+	int original = 0, custom = 0, result;
+	StreamerDeviceModel model;
+	StreamerStats stats;
+	unsigned char* data;
+	Replay replay;
+
+	// Defaults roughly match a DVD drive, the same as the library default
+
+	model.overhead = 500;
+	model.seekTime = 30000;
+	model.seekRate = 20;
+	model.bandwidth = 5000;
+	model.capacity = 4480;
+	model.virtualClock = 0;
+
+	for (i = 1; i < (unsigned int)argc; ++i)
+	{
+		const char* value = (i + 1) < (unsigned int)argc ? argv[i + 1] : 0;
+
+		if (!strcmp(argv[i], "--original"))
+		{
+			original = 1;
+		}
+		else if (!strcmp(argv[i], "--virtual"))
+		{
+			model.virtualClock = 1;
+			custom = 1;
+		}
+		else if (value && !strcmp(argv[i], "--model"))
+		{
+			if (sscanf(value, "%u,%u,%u,%u", &(model.overhead), &(model.seekTime), &(model.seekRate), &(model.bandwidth)) != 4)
+			{
+				replayUsage();
+				return 1;
+			}
+			custom = 1;
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--direct"))
+		{
+			container = StreamerContainer_Direct;
+			root = value;
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--archive"))
+		{
+			container = StreamerContainer_FileArchive;
+			file = value;
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--transport"))
+		{
+			if (!strcmp(value, "fileio"))
+			{
+				transport = StreamerTransport_FileIo;
+			}
+			else if (!strcmp(value, "cdvd"))
+			{
+				transport = StreamerTransport_Cdvd;
+			}
+			else if (!strcmp(value, "simulated"))
+			{
+				transport = StreamerTransport_Simulated;
+			}
+			else
+			{
+				replayUsage();
+				return 1;
+			}
+			++i;
+		}
+		else if ((argv[i][0] != '-') && !recording)
+		{
+			recording = argv[i];
+		}
+		else
+		{
+			replayUsage();
+			return 1;
+		}
+	}
+
+	if (!recording)
+	{
+		replayUsage();
+		return 1;
+	}
+
+	data = replayLoad(recording, &size, &version, &span, &largest);
+	if (!data)
+	{
+		return 1;
+	}
+
+	memset(&replay, 0, sizeof(replay));
+	replay.version = version;
+	for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+	{
+		replay.handles[i].fd = -1;
+	}
+
+	replay.buffer = malloc(largest);
+	if (!replay.buffer)
+	{
+		fprintf(stderr, "Failed to allocate %u byte read buffer\n", largest);
+		free(data);
+		return 1;
+	}
+
+	replay.context = streamerCreateContext(transport, container, root, file);
+	if (!replay.context)
+	{
+		fprintf(stderr, "Failed to initialize streamer\n");
+		free(replay.buffer);
+		free(data);
+		return 1;
+	}
+
+	if (custom && (streamerContextSetDeviceModel(replay.context, &model) < 0))
+	{
+		fprintf(stderr, "Device model requires the simulated transport\n");
+		streamerDestroyContext(replay.context);
+		free(replay.buffer);
+		free(data);
+		return 1;
+	}
+
+	start = replayTime();
+	result = replayRun(&replay, data, size, original);
+	elapsed = replayTime() - start;
+
+	streamerContextGetStats(replay.context, &stats);
+	streamerDestroyContext(replay.context);
+
+	fprintf(stderr, "Replayed %u calls (%u skipped, %u failed, %u mismatched results) in %.3f s, recorded span %.3f s\n", replay.calls, replay.skipped, replay.failures, replay.mismatches, (double)elapsed / 1000000.0, (double)span / 1000000.0);
+	fprintf(stderr, "Read %llu bytes, %.2f MB/s\n", replay.bytes, elapsed ? ((double)replay.bytes / (1024.0 * 1024.0)) / ((double)elapsed / 1000000.0) : 0.0);
+
+	if (transport == StreamerTransport_Simulated)
+	{
+		fprintf(stderr, "Simulated device time %.3f s, %llu seeks\n", (double)stats.deviceTime / 1000000.0, (unsigned long long)stats.deviceSeeks);
+	}
+
+	fprintf(stdout, "{\"recording\":\"%s\",\"calls\":%u,\"skipped\":%u,\"failed\":%u,\"mismatched\":%u,\"seconds\":%.6f,\"recorded_seconds\":%.6f,\"bytes\":%llu,\"device_seconds\":%.6f,\"device_seeks\":%llu", recording, replay.calls, replay.skipped, replay.failures, replay.mismatches, (double)elapsed / 1000000.0, (double)span / 1000000.0, replay.bytes, (double)stats.deviceTime / 1000000.0, (unsigned long long)stats.deviceSeeks);
+
+	for (i = 0; i < ReplayOp_Count; ++i)
+	{
+		ReplaySamples* samples = &(replay.samples[i]);
+
+		qsort(samples->data, samples->count, sizeof(unsigned int), replayCompare);
+
+		fprintf(stderr, "%-6s %8u requests, p50 %8u us, p90 %8u us, p99 %8u us, max %8u us\n", s_opNames[i], samples->count, replayPercentile(samples, 500), replayPercentile(samples, 900), replayPercentile(samples, 990), samples->count ? samples->data[samples->count - 1] : 0);
+		fprintf(stdout, ",\"%s\":{\"count\":%u,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u}", s_opNames[i], samples->count, replayPercentile(samples, 500), replayPercentile(samples, 900), replayPercentile(samples, 990), samples->count ? samples->data[samples->count - 1] : 0);
+
+		free(samples->data);
+	}
+	fprintf(stdout, "}\n");
+
+	free(replay.buffer);
+	free(data);
+
+	return result < 0 ? 1 : 0;
+}
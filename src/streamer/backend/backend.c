@@ -24,17 +24,18 @@ SOFTWARE.
 #define _CRT_SECURE_NO_WARNINGS
 #include "backend.h"
 #include "drivers/driver.h"
-#include "drivers/filearchive.h"
-#include "drivers/fileio.h"
-#include "drivers/cdvd.h"
+#include "drivers/mount.h"
+#include "drivers/decompressor.h"
 
 #if defined(STREAMER_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <stdlib.h>
 #elif defined(STREAMER_PS2)
 #include "iop/irx_imports.h"
 #elif defined(STREAMER_UNIX)
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #endif
@@ -83,35 +84,72 @@ typedef struct QueueEntry
 		StreamerSeekMode m_whence;
 	};
 
+	StreamerOffset m_seek;	// Seek offset (LSeek only)
+	int m_wide;		// Seek was issued through streamerLSeek64(), completing with 0 instead of the new position
+
 	int m_dma;
 	int m_result;
 
+	StreamerCounter m_submitTime;	// Time when request was queued
+	StreamerCounter m_serviceTime;	// Time when request was first serviced, 0 while waiting
+	StreamerOffset m_position;	// Current file position (for tracing and streamerTell64())
+
 	char m_filename[256];	
 } QueueEntry;
 
-static IODriver* s_driver = 0;
-static QueueEntry s_files[STREAMER_MAX_FILEHANDLES];
+#define STREAMER_BUFFER_SIZE (128 * 1024)
+#define STREAMER_BUFFER_SIZE_ALIGN (STREAMER_BUFFER_SIZE + 64)
+
+#define STREAMER_STAT_BATCH (64)
+
+#define STREAMER_RECORD_BUFFER (4096)
+
+typedef struct MountArguments
+{
+	StreamerContainer container;
+	int priority;
+	char root[256];
+	char file[256];
+} MountArguments;
+
+struct StreamerContext
+{
+	IODriver* m_driver;	// Mount table, forwarding to mounted sources
+	QueueEntry m_files[STREAMER_MAX_FILEHANDLES];
 
-static EntryHeader s_active;
-static EntryHeader s_pending;
+	EntryHeader m_active;
+	EntryHeader m_pending;
 
 #if defined(STREAMER_PS2)
-static void* s_streamBuffer = 0;
-static void* s_transferBuffer = 0;
-static int s_activeDmaTransfer = -1;
+	void* m_streamBuffer;
+	void* m_transferBuffer;
+	int m_activeDmaTransfer;
 #endif
 
-#define STREAMER_BUFFER_SIZE (128 * 1024)
-#define STREAMER_BUFFER_SIZE_ALIGN (STREAMER_BUFFER_SIZE + 64)
-
 #if defined(STREAMER_WIN32)
-static CRITICAL_SECTION s_queueCs;
+	CRITICAL_SECTION m_queueCs;
 #elif defined(STREAMER_PS2)
-static int s_queueSemaphore = -1;
+	int m_queueSemaphore;
 #elif defined(STREAMER_UNIX)
-static pthread_mutex_t s_queueMutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_mutex_t m_queueMutex;
 #endif
 
+	void* m_platform;	// Data owned by the platform layer
+
+	StreamerStats m_stats;
+	StreamerLatencyStats m_latency;
+	StreamerTrace m_trace;
+
+	struct
+	{
+		StreamerTraceWriter writer;	// Receives recorded calls, NULL when not recording
+		void* user;
+		StreamerCounter start;
+		unsigned int fill;
+		unsigned char buffer[STREAMER_RECORD_BUFFER];
+	} m_record;
+};
+
 static void entryInitialize(EntryHeader* header)
 {
 	header->m_prev = header->m_next = header;
@@ -134,118 +172,363 @@ static void entryDetach(EntryHeader* header)
 	header->m_prev = header->m_next = header;
 }
 
-void lockStreamerQueue()
+void lockStreamerQueue(StreamerContext* context)
 {
 #if defined(STREAMER_WIN32)
-	EnterCriticalSection(&s_queueCs);
+	EnterCriticalSection(&(context->m_queueCs));
 #elif defined(STREAMER_PS2)
-	WaitSema(s_queueSemaphore);
+	WaitSema(context->m_queueSemaphore);
 #elif defined(STREAMER_UNIX)
-	pthread_mutex_lock(&s_queueMutex);
+	pthread_mutex_lock(&(context->m_queueMutex));
 #else
 #error Implement locking for your platform
 #endif
 }
 
-void unlockStreamerQueue()
+void unlockStreamerQueue(StreamerContext* context)
 {
 #if defined(STREAMER_WIN32)
-	LeaveCriticalSection(&s_queueCs);
+	LeaveCriticalSection(&(context->m_queueCs));
 #elif defined(STREAMER_PS2)
-	SignalSema(s_queueSemaphore);
+	SignalSema(context->m_queueSemaphore);
 #elif defined(STREAMER_UNIX)
-	pthread_mutex_unlock(&s_queueMutex);
+	pthread_mutex_unlock(&(context->m_queueMutex));
 #else
 #error Implement unlocking for your platform
 #endif
 }
 
-static int rescheduleStreamerQueue(QueueEntry* entry)
+static int rescheduleStreamerQueue(StreamerContext* context, QueueEntry* entry)
 {
-	lockStreamerQueue();
+	lockStreamerQueue(context);
 	{
 		if (!(entry->m_mode & EntryMode_Busy))
 		{
-			unlockStreamerQueue();
+			unlockStreamerQueue(context);
 			return 0;
 		}
 
 		entryDetach(&(entry->m_header));
-		entryAttach(&s_active, &(entry->m_header));
+		entryAttach(&context->m_active, &(entry->m_header));
+	}
+	unlockStreamerQueue(context);
+
+	return (context->m_active.m_next == &(entry->m_header)) && (context->m_pending.m_next == &context->m_pending);
+}
+
+static const char* tracePath(QueueEntry* entry)
+{
+	// Only requests on file and directory handles carry a path
+
+	switch (entry->m_operation)
+	{
+		case StreamerOperation_Open:
+		case StreamerOperation_Close:
+		case StreamerOperation_Read:
+		case StreamerOperation_LSeek:
+		case StreamerOperation_DOpen:
+		case StreamerOperation_DClose:
+		case StreamerOperation_DRead:
+			return entry->m_filename;
+
+		default:
+			return "";
+	}
+}
+
+static void queueStreamerEntry(StreamerContext* context, QueueEntry* entry)
+{
+	StreamerStats* stats = &(context->m_stats);
+	StreamerHandleStats* handle = &(stats->handles[entry - context->m_files]);
+	StreamerCounter depth = 0;
+	int i;
+
+	// Called with the queue locked
+
+	switch (entry->m_operation)
+	{
+		case StreamerOperation_Open:
+		{
+			memset(handle, 0, sizeof(StreamerHandleStats));
+			STREAMER_ATOMIC_ADD(stats->opens, 1);
+		}
+		break;
+
+		case StreamerOperation_Close: STREAMER_ATOMIC_ADD(stats->closes, 1); break;
+		case StreamerOperation_LSeek: STREAMER_ATOMIC_ADD(stats->seeks, 1); break;
+		case StreamerOperation_LoadList: STREAMER_ATOMIC_ADD(stats->lists, 1); break;
+		case StreamerOperation_Stat: STREAMER_ATOMIC_ADD(stats->stats, 1); break;
+
+		case StreamerOperation_Read:
+		{
+			STREAMER_ATOMIC_ADD(stats->reads, 1);
+			STREAMER_ATOMIC_ADD(stats->bytesRequested, entry->m_length);
+			STREAMER_ATOMIC_ADD(handle->bytesRequested, entry->m_length);
+		}
+		break;
+
+		case StreamerOperation_DOpen:
+		case StreamerOperation_DClose:
+		case StreamerOperation_DRead:
+		{
+			STREAMER_ATOMIC_ADD(stats->directories, 1);
+		}
+		break;
+
+		case StreamerOperation_Mount:
+		case StreamerOperation_Unmount:
+		{
+			STREAMER_ATOMIC_ADD(stats->mounts, 1);
+		}
+		break;
+	}
+	STREAMER_ATOMIC_ADD(handle->operations, 1);
+
+	for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+	{
+		if (context->m_files[i].m_mode & EntryMode_Busy)
+		{
+			++depth;
+		}
+	}
+
+	if (depth > stats->queueDepthMax)
+	{
+		stats->queueDepthMax = depth;
+	}
+
+	entry->m_submitTime = IODriver_GetTime();
+	entry->m_serviceTime = 0;
+
+	if (entry->m_operation == StreamerOperation_Open)
+	{
+		entry->m_position = 0;
+	}
+
+	Trace_Record(&(context->m_trace), TraceEvent_Submit, entry->m_operation, entry->m_submitTime, 0, entry - context->m_files, entry->m_position, entry->m_operation == StreamerOperation_Read ? entry->m_length : 0, 0, tracePath(entry));
+
+	entryAttach(&context->m_pending, &(entry->m_header));
+}
+
+static StreamerCounter statsDriverCall(StreamerContext* context, QueueEntry* entry, StreamerCounter start)
+{
+	StreamerCounter elapsed = IODriver_GetTime() - start;
+
+	STREAMER_ATOMIC_ADD(context->m_stats.driverTime, elapsed);
+	STREAMER_ATOMIC_ADD(context->m_stats.handles[entry - context->m_files].driverTime, elapsed);
+
+	return elapsed;
+}
+
+static void statsRead(StreamerContext* context, QueueEntry* entry, int result, StreamerCounter start)
+{
+	StreamerHandleStats* handle = &(context->m_stats.handles[entry - context->m_files]);
+	StreamerCounter elapsed = statsDriverCall(context, entry, start);
+
+	Trace_Record(&(context->m_trace), TraceEvent_Read, StreamerOperation_Read, start, elapsed, entry - context->m_files, entry->m_position, result > 0 ? result : 0, result, entry->m_filename);
+
+	STREAMER_ATOMIC_ADD(context->m_stats.chunks, 1);
+	STREAMER_ATOMIC_ADD(handle->chunks, 1);
+
+	if (result > 0)
+	{
+		STREAMER_ATOMIC_ADD(context->m_stats.bytesRead, result);
+		STREAMER_ATOMIC_ADD(handle->bytesRead, result);
+		entry->m_position += result;
+	}
+}
+
+static int latencyOperation(int operation)
+{
+	switch (operation)
+	{
+		case StreamerOperation_Open: return StreamerLatency_Open;
+		case StreamerOperation_Read: return StreamerLatency_Read;
+		case StreamerOperation_LSeek: return StreamerLatency_LSeek;
+		case StreamerOperation_Close: return StreamerLatency_Close;
+		default: return -1;
+	}
+}
+
+static void latencyRecord(StreamerHistogram* histogram, StreamerCounter elapsed)
+{
+	StreamerCounter limit = 1;
+	unsigned int bucket = 0;
+
+	// Bucket 0 holds samples below 1us, bucket n holds [2^(n-1), 2^n) and the last bucket everything above
+
+	while ((elapsed >= limit) && (bucket < (STREAMER_LATENCY_BUCKETS - 1)))
+	{
+		limit <<= 1;
+		++bucket;
+	}
+
+	STREAMER_ATOMIC_ADD(histogram->buckets[bucket], 1);
+	STREAMER_ATOMIC_ADD(histogram->total, elapsed);
+	STREAMER_ATOMIC_ADD(histogram->count, 1);
+
+	if (elapsed > histogram->max)
+	{
+		histogram->max = elapsed;
+	}
+}
+
+static void serviceStreamerEntry(StreamerContext* context, QueueEntry* entry)
+{
+	int index = latencyOperation(entry->m_operation);
+
+	if (entry->m_serviceTime)
+	{
+		return;
+	}
+
+	entry->m_serviceTime = IODriver_GetTime();
+
+	if (index >= 0)
+	{
+		latencyRecord(&(context->m_latency.wait[index]), entry->m_serviceTime - entry->m_submitTime);
+	}
+
+	Trace_Record(&(context->m_trace), TraceEvent_Dequeue, entry->m_operation, entry->m_serviceTime, 0, entry - context->m_files, entry->m_position, 0, 0, tracePath(entry));
+}
+
+static void issueStreamerCompletion(StreamerContext* context, QueueEntry* entry, int operation)
+{
+	int index = latencyOperation(operation);
+	StreamerCounter now = IODriver_GetTime();
+
+	if ((index >= 0) && entry->m_serviceTime)
+	{
+		latencyRecord(&(context->m_latency.service[index]), now - entry->m_serviceTime);
+	}
+
+	Trace_Record(&(context->m_trace), TraceEvent_Complete, operation, now, 0, entry - context->m_files, entry->m_position, ((operation == StreamerOperation_Read) && (entry->m_result > 0)) ? entry->m_result : 0, entry->m_result, tracePath(entry));
+
+	internalStreamerIssueCompletion(context, entry - context->m_files, operation, entry->m_result, entry->m_method);
+}
+
+static void recordStreamerFlush(StreamerContext* context)
+{
+	// Called with the queue locked
+
+	if (context->m_record.fill && (context->m_record.writer((const char*)context->m_record.buffer, context->m_record.fill, context->m_record.user) < 0))
+	{
+		STREAMER_PRINTF(("Streamer: Failed writing access recording, recording stopped\n"));
+		context->m_record.writer = 0;
+	}
+	context->m_record.fill = 0;
+}
+
+static void recordStreamerCall(StreamerContext* context, StreamerRecordCall call, int fd, StreamerOffset argument, int whence, int result, const char* path)
+{
+	StreamerRecordEntry record;
+	unsigned int length = path ? (unsigned int)strlen(path) : 0;
+
+	// Called with the queue locked
+
+	if (!context->m_record.writer)
+	{
+		return;
+	}
+
+	record.time = IODriver_GetTime() - context->m_record.start;
+	record.call = (unsigned char)call;
+	record.reserved = 0;
+	record.path = (unsigned short)length;
+	record.fd = fd;
+	record.argument = (int)argument;
+	record.offset = argument;
+	record.whence = whence;
+	record.result = result;
+	record.align = 0;
+
+	if ((context->m_record.fill + sizeof(record) + length) > STREAMER_RECORD_BUFFER)
+	{
+		recordStreamerFlush(context);
+		if (!context->m_record.writer)
+		{
+			return;
+		}
 	}
-	unlockStreamerQueue();
 
-	return (s_active.m_next == &(entry->m_header)) && (s_pending.m_next == &s_pending);
+	memcpy(context->m_record.buffer + context->m_record.fill, &record, sizeof(record));
+	memcpy(context->m_record.buffer + context->m_record.fill + sizeof(record), path ? path : "", length);
+	context->m_record.fill += sizeof(record) + length;
 }
 
 #if defined(STREAMER_PS2)
-int ps2ReadSifDma(QueueEntry* request)
+int ps2ReadSifDma(StreamerContext* context, QueueEntry* request)
 {
 	char* curr = request->m_buffer + request->m_offset;
 	char* lead = (char*)(((ptrdiff_t)curr) & ~63);
 
+	StreamerCounter start;
+	int result;
+
 	unsigned int packet = request->m_length - request->m_offset;
 	packet = packet > (STREAMER_BUFFER_SIZE - (curr-lead)) ? (STREAMER_BUFFER_SIZE - (curr-lead)) : packet;
 
 	if (!packet)
 	{
-		if (s_activeDmaTransfer == (request-s_files))
+		if (context->m_activeDmaTransfer == (request-context->m_files))
 		{
 			while (sceSifDmaStat(request->m_dma) >= 0);
-			s_activeDmaTransfer = -1;
+			context->m_activeDmaTransfer = -1;
 		}
 
-		lockStreamerQueue();
+		lockStreamerQueue(context);
 		{
 			request->m_mode &= ~EntryMode_Busy;
 			entryDetach(&(request->m_header));
 		}
-		unlockStreamerQueue();
+		unlockStreamerQueue(context);
 
-		internalStreamerIssueCompletion(request - s_files, StreamerOperation_Read, request->m_result, request->m_method);
+		issueStreamerCompletion(context, request, StreamerOperation_Read);
 		return -1;
 	}
 
-	int result = s_driver->read(s_driver, request->m_target, s_streamBuffer + (curr-lead),packet);
+	start = IODriver_GetTime();
+	result = context->m_driver->read(context->m_driver, request->m_target, context->m_streamBuffer + (curr-lead),packet);
+	statsRead(context, request, result, start);
 
 	if (result < 0)
 	{
-		if (s_activeDmaTransfer == (request-s_files))
+		if (context->m_activeDmaTransfer == (request-context->m_files))
 		{
 			while (sceSifDmaStat(request->m_dma) >= 0);
-			s_activeDmaTransfer = -1;
+			context->m_activeDmaTransfer = -1;
 		}
 
 		request->m_length = 0;
 		request->m_offset = 0;
 		request->m_result = result;
 
-		lockStreamerQueue();
+		lockStreamerQueue(context);
 		{
 			request->m_mode &= ~EntryMode_Busy;
 			entryDetach(&(request->m_header));
 		}
-		unlockStreamerQueue();
+		unlockStreamerQueue(context);
 		return -1;
 	}
 	else if (result == 0)
 	{
 		request->m_result = request->m_offset;
 
-		if (s_activeDmaTransfer == (request-s_files))
+		if (context->m_activeDmaTransfer == (request-context->m_files))
 		{
 			while (sceSifDmaStat(request->m_dma) >= 0);
-			s_activeDmaTransfer = -1;
+			context->m_activeDmaTransfer = -1;
 		}
 
-		lockStreamerQueue();
+		lockStreamerQueue(context);
 		{
 			request->m_mode &= ~EntryMode_Busy;
 			entryDetach(&(request->m_header));
 		}
-		unlockStreamerQueue();
+		unlockStreamerQueue(context);
 
-		internalStreamerIssueCompletion(request - s_files, StreamerOperation_Read, request->m_result, request->m_method);
+		issueStreamerCompletion(context, request, StreamerOperation_Read);
 		return -1;
 	}
 	else if (result > 0)
@@ -253,7 +536,7 @@ int ps2ReadSifDma(QueueEntry* request)
 		unsigned int uploaded = 0;
 		unsigned int transfers = 0;
 		SifDmaTransfer_t tx[3];
-		char* src = s_streamBuffer;
+		char* src = context->m_streamBuffer;
 
 		// head, transfer unaligned part to private buffer
 
@@ -305,10 +588,10 @@ int ps2ReadSifDma(QueueEntry* request)
 			int queue;
 			int interrupts;
 
-			if (s_activeDmaTransfer >= 0)
+			if (context->m_activeDmaTransfer >= 0)
 			{
-				while (sceSifDmaStat(s_files[s_activeDmaTransfer].m_dma) >= 0);
-				s_activeDmaTransfer = -1;
+				while (sceSifDmaStat(context->m_files[context->m_activeDmaTransfer].m_dma) >= 0);
+				context->m_activeDmaTransfer = -1;
 			}
 
 //			WaitVblankStart();
@@ -317,12 +600,12 @@ int ps2ReadSifDma(QueueEntry* request)
 			while (!(queue = sceSifSetDma(tx,transfers)));
 			CpuResumeIntr(interrupts);
 
-			s_activeDmaTransfer = request-s_files;
+			context->m_activeDmaTransfer = request-context->m_files;
 			request->m_dma = queue;
 
-			char* temp = s_transferBuffer;
-			s_transferBuffer = s_streamBuffer;
-			s_streamBuffer = temp;
+			char* temp = context->m_transferBuffer;
+			context->m_transferBuffer = context->m_streamBuffer;
+			context->m_streamBuffer = temp;
 		}
 	}
 
@@ -332,16 +615,16 @@ int ps2ReadSifDma(QueueEntry* request)
 	{
 		request->m_result = request->m_offset;
 
-		if (s_activeDmaTransfer != (request-s_files))
+		if (context->m_activeDmaTransfer != (request-context->m_files))
 		{
-			lockStreamerQueue();
+			lockStreamerQueue(context);
 			{
 				request->m_mode &= ~EntryMode_Busy;
 				entryDetach(&(request->m_header));
 			}
-			unlockStreamerQueue();
+			unlockStreamerQueue(context);
 
-			internalStreamerIssueCompletion(request - s_files, StreamerOperation_Read, request->m_result, request->m_method);
+			issueStreamerCompletion(context, request, StreamerOperation_Read);
 		}
 		return -1;
 	}
@@ -350,29 +633,32 @@ int ps2ReadSifDma(QueueEntry* request)
 }
 #endif
 
-int internalStreamerIdle()
+int internalStreamerIdle(StreamerContext* context)
 {
+	StreamerCounter start;
 	QueueEntry* entry;
 
-	if (s_pending.m_prev != &s_pending)
+	if (context->m_pending.m_prev != &context->m_pending)
 	{
-		lockStreamerQueue();
-		while (s_pending.m_prev != &s_pending)
+		lockStreamerQueue(context);
+		while (context->m_pending.m_prev != &context->m_pending)
 		{
-			QueueEntry* entry = (QueueEntry*)s_pending.m_next;
+			QueueEntry* entry = (QueueEntry*)context->m_pending.m_next;
 
 			entryDetach(&(entry->m_header));
-			entryAttach(&s_active, &(entry->m_header));
+			entryAttach(&context->m_active, &(entry->m_header));
 		}
-		unlockStreamerQueue();
+		unlockStreamerQueue(context);
 	}
 
-	if (s_active.m_prev == &s_active)
+	if (context->m_active.m_prev == &context->m_active)
 	{
 		return StreamerResult_Ok;
 	}
 
-	entry = (QueueEntry*)s_active.m_next;
+	entry = (QueueEntry*)context->m_active.m_next;
+	serviceStreamerEntry(context, entry);
+
 	switch (entry->m_operation)
 	{
 		case StreamerOperation_Open:
@@ -381,9 +667,11 @@ int internalStreamerIdle()
 
 			STREAMER_PRINTF(("Streamer: Opening file \"%s\"\n", entry->m_filename));
 
-			fd = s_driver->open(s_driver, entry->m_filename, entry->m_openMode);
+			start = IODriver_GetTime();
+			fd = context->m_driver->open(context->m_driver, entry->m_filename, entry->m_openMode);
+			statsDriverCall(context, entry, start);
 
-			lockStreamerQueue();
+			lockStreamerQueue(context);
 			{
 				if (fd < 0)
 				{
@@ -402,9 +690,9 @@ int internalStreamerIdle()
 				}
 				entryDetach(&(entry->m_header));
 			}
-			unlockStreamerQueue();
+			unlockStreamerQueue(context);
 
-			internalStreamerIssueCompletion(entry - s_files, StreamerOperation_Open, entry->m_result, entry->m_method);
+			issueStreamerCompletion(context, entry, StreamerOperation_Open);
 		}
 		break;
 
@@ -414,19 +702,21 @@ int internalStreamerIdle()
 
 			if (entry->m_target >= 0)
 			{
-				s_driver->close(s_driver, entry->m_target);
+				start = IODriver_GetTime();
+				context->m_driver->close(context->m_driver, entry->m_target);
+				statsDriverCall(context, entry, start);
 			}
 
 			entry->m_result = StreamerResult_Ok;
 
-			lockStreamerQueue();
+			lockStreamerQueue(context);
 			{
 				entry->m_mode = EntryMode_Free;
 				entryDetach(&(entry->m_header));
 			}
-			unlockStreamerQueue();
+			unlockStreamerQueue(context);
 
-			internalStreamerIssueCompletion(entry - s_files, StreamerOperation_Close, entry->m_result, entry->m_method);
+			issueStreamerCompletion(context, entry, StreamerOperation_Close);
 		}
 		break;
 
@@ -442,20 +732,22 @@ int internalStreamerIdle()
 
 					packet = packet > STREAMER_BUFFER_SIZE ? STREAMER_BUFFER_SIZE : packet;
 
-					result = s_driver->read(s_driver, entry->m_target, curr, packet);				
+					start = IODriver_GetTime();
+					result = context->m_driver->read(context->m_driver, entry->m_target, curr, packet);
+					statsRead(context, entry, result, start);
 
 					if (result < 0)
 					{
 						entry->m_result = StreamerResult_Error;
 
-						lockStreamerQueue();
+						lockStreamerQueue(context);
 						{
 							entry->m_mode &= ~EntryMode_Busy;
 							entryDetach(&(entry->m_header));
 						}
-						unlockStreamerQueue();
+						unlockStreamerQueue(context);
 
-						internalStreamerIssueCompletion(entry - s_files, StreamerOperation_Read, entry->m_result, entry->m_method);
+						issueStreamerCompletion(context, entry, StreamerOperation_Read);
 						break;
 					}
 
@@ -465,14 +757,14 @@ int internalStreamerIdle()
 					{
 						entry->m_result = entry->m_offset;
 
-						lockStreamerQueue();
+						lockStreamerQueue(context);
 						{
 							entry->m_mode &= ~EntryMode_Busy;
 							entryDetach(&(entry->m_header));
 						}
-						unlockStreamerQueue();
+						unlockStreamerQueue(context);
 
-						internalStreamerIssueCompletion(entry - s_files, StreamerOperation_Read, entry->m_result, entry->m_method);
+						issueStreamerCompletion(context, entry, StreamerOperation_Read);
 						break;
 					}
 				}
@@ -481,169 +773,1110 @@ int internalStreamerIdle()
 #if defined(STREAMER_PS2)
 				case StreamerCallMethod_SifRpc:
 				{
-					ps2ReadSifDma(entry);
+					ps2ReadSifDma(context, entry);
 				}
 				break;
 #endif
 			}
 
-			rescheduleStreamerQueue(entry);
+			rescheduleStreamerQueue(context, entry);
 		}
 		break;
 
 		case StreamerOperation_LSeek:
 		{
-			int result;
+			StreamerOffset result;
 
 			STREAMER_PRINTF(("Streamer: Seeking file %d\n", entry->m_target));
 
-			result = s_driver->lseek(s_driver, entry->m_target, entry->m_offset, entry->m_whence);
-			entry->m_result = result < 0 ? StreamerResult_Error : result;
+			start = IODriver_GetTime();
+			result = context->m_driver->lseek(context->m_driver, entry->m_target, entry->m_seek, entry->m_whence);
+			statsDriverCall(context, entry, start);
+
+			if (result < 0)
+			{
+				entry->m_result = StreamerResult_Error;
+			}
+			else if (entry->m_wide)
+			{
+				entry->m_result = StreamerResult_Ok;
+			}
+			else if (result > 0x7fffffff)
+			{
+				STREAMER_PRINTF(("Streamer: Seek position of file %d does not fit in result, use streamerLSeek64()\n", entry->m_target));
+				entry->m_result = StreamerResult_Error;
+
+				// A failed seek leaves the position alone, so move back to where the file was
+
+				result = context->m_driver->lseek(context->m_driver, entry->m_target, entry->m_position, StreamerSeekMode_Set);
+			}
+			else
+			{
+				entry->m_result = (int)result;
+			}
+
+			if (result >= 0)
+			{
+				entry->m_position = result;
+			}
 
-			lockStreamerQueue();
+			lockStreamerQueue(context);
 			{
 				entry->m_mode &= ~EntryMode_Busy;
 				entryDetach(&(entry->m_header));
 			}
-			unlockStreamerQueue();			
+			unlockStreamerQueue(context);			
 
-			internalStreamerIssueCompletion(entry - s_files, StreamerOperation_LSeek, entry->m_result, entry->m_method);
+			issueStreamerCompletion(context, entry, StreamerOperation_LSeek);
 		}
 		break;
-	}
 
-	return StreamerResult_Pending;
-}
+		case StreamerOperation_Stat:
+		{
+			StreamerStat* stats = (StreamerStat*)entry->m_buffer;
+			int i, n;
 
-#if defined(STREAMER_PS2)
-int ps2StreamerInitialize()
-{
-	iop_sema_t sema;
-	sema.attr = 1;
-	sema.option = 0;
-	sema.initial = 1;
-	sema.max = 1;
+			// Process a batch at a time, so large queries do not block other requests
 
-	s_queueSemaphore = CreateSema(&sema);
-	if (s_queueSemaphore < 0)
-	{
-		STREAMER_PRINTF(("Streamer: Failed initializing queue semaphore\n"));
-		return StreamerResult_Error;
-	}
+			for (i = 0, n = STREAMER_STAT_BATCH; (i < n) && (entry->m_offset < entry->m_length); ++i, ++entry->m_offset)
+			{
+				StreamerStat* stat = &(stats[entry->m_offset]);
 
-	s_streamBuffer = AllocSysMemory(ALLOC_FIRST, STREAMER_BUFFER_SIZE_ALIGN * 2, 0);
-	if (!s_streamBuffer)
-	{
-		STREAMER_PRINTF(("Streamer: Failed allocating stream buffers\n"));
-		DeleteSema(s_queueSemaphore);
-		return StreamerResult_Error;
-	}
+				stat->flags = 0;
+				start = IODriver_GetTime();
+				stat->result = context->m_driver->stat ? context->m_driver->stat(context->m_driver, stat->filename, stat) : StreamerResult_Error;
+				statsDriverCall(context, entry, start);
+				stat->result = stat->result < 0 ? StreamerResult_Error : StreamerResult_Ok;
 
-	s_transferBuffer = ((char*)s_streamBuffer) + STREAMER_BUFFER_SIZE_ALIGN;
+				if (stat->result == StreamerResult_Ok)
+				{
+					++entry->m_result;
+				}
+			}
 
-	return StreamerResult_Ok;
-}
-#endif
+			if (entry->m_offset < entry->m_length)
+			{
+				rescheduleStreamerQueue(context, entry);
+				break;
+			}
 
-int internalStreamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
-{
-	IODriver* native = 0;
-	IODriver* logic = 0;
-	int i;
+			lockStreamerQueue(context);
+			{
+				entry->m_mode = EntryMode_Free;
+				entry->m_buffer = 0;
+				entryDetach(&(entry->m_header));
+			}
+			unlockStreamerQueue(context);
 
-	switch (transport)
-	{
-		case StreamerTransport_FileIo:
-		{
-			native = FileIo_Create(root);
+			issueStreamerCompletion(context, entry, StreamerOperation_Stat);
 		}
 		break;
 
-		case StreamerTransport_Cdvd:
+		case StreamerOperation_DOpen:
 		{
-			native = Cdvd_Create();
-		}
-		break;
-	}
+			int fd;
 
-	if (!native)
-	{
-		STREAMER_PRINTF(("Streamer: Failed to initialize native layer\n"));
-		return StreamerResult_Error;
-	}
+			STREAMER_PRINTF(("Streamer: Opening directory \"%s\"\n", entry->m_filename));
 
-	switch (container)
-	{
-		case StreamerContainer_Direct:
-		{
-			logic = native;
+			start = IODriver_GetTime();
+			fd = context->m_driver->dopen ? context->m_driver->dopen(context->m_driver, entry->m_filename) : -1;
+			statsDriverCall(context, entry, start);
+
+			lockStreamerQueue(context);
+			{
+				if (fd < 0)
+				{
+					STREAMER_PRINTF(("Streamer: Failed opening directory\n"));
+
+					entry->m_mode = EntryMode_Free;
+					entry->m_result = StreamerResult_Error;
+				}
+				else
+				{
+					STREAMER_PRINTF(("Streamer: Opened directory, fd %d\n", fd));
+
+					entry->m_mode = EntryMode_Directory;
+					entry->m_target = fd;
+					entry->m_result = 0;
+				}
+				entryDetach(&(entry->m_header));
+			}
+			unlockStreamerQueue(context);
+
+			issueStreamerCompletion(context, entry, StreamerOperation_DOpen);
 		}
 		break;
 
-		case StreamerContainer_FileArchive:
+		case StreamerOperation_DClose:
 		{
-			logic = FileArchive_Create(native, file);
-		}
-		break;
-	}
+			STREAMER_PRINTF(("Closing directory %d\n", entry->m_target));
 
-	if (!logic)
-	{
-		STREAMER_PRINTF(("Streamer: Failed to initialize logical layer\n"));
-		native->destroy(native);
-		return StreamerResult_Error;
-	}
+			if (entry->m_target >= 0)
+			{
+				start = IODriver_GetTime();
+				context->m_driver->dclose(context->m_driver, entry->m_target);
+				statsDriverCall(context, entry, start);
+			}
 
-#if defined(STREAMER_WIN32)
-	InitializeCriticalSection(&s_queueCs);
-#elif defined(STREAMER_PS2)
-	if (ps2StreamerInitialize() < 0)
-	{
-		STREAMER_PRINTF(("Streamer: Failed to initialize PS2 logic\n"));
-		native->destroy(native);
-		return StreamerResult_Error;
-	}
-#endif
+			entry->m_result = StreamerResult_Ok;
 
-	entryInitialize(&s_active);
-	entryInitialize(&s_pending);
+			lockStreamerQueue(context);
+			{
+				entry->m_mode = EntryMode_Free;
+				entryDetach(&(entry->m_header));
+			}
+			unlockStreamerQueue(context);
 
-	s_driver = logic;
+			issueStreamerCompletion(context, entry, StreamerOperation_DClose);
+		}
+		break;
 
-	memset(s_files, 0, sizeof(s_files));
-	for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
-	{
-		entryInitialize(&(s_files[i].m_header));
-	}
+		case StreamerOperation_DRead:
+		{
+			int result;
 
-	return StreamerResult_Ok;
-}
+			start = IODriver_GetTime();
+			result = context->m_driver->dread(context->m_driver, entry->m_target, (StreamerDirEntry*)entry->m_buffer, entry->m_length);
+			statsDriverCall(context, entry, start);
+			entry->m_result = result < 0 ? StreamerResult_Error : result;
 
-#if defined(STREAMER_PS2)
-int ps2StreamerShutdown()
-{
-	DeleteSema(s_queueSemaphore);
-	return StreamerResult_Ok;
-}
-#endif
+			lockStreamerQueue(context);
+			{
+				entry->m_mode &= ~EntryMode_Busy;
+				entryDetach(&(entry->m_header));
+			}
+			unlockStreamerQueue(context);
+
+			issueStreamerCompletion(context, entry, StreamerOperation_DRead);
+		}
+		break;
+
+		case StreamerOperation_Mount:
+		{
+			MountArguments* args = (MountArguments*)entry->m_buffer;
+			int result;
+
+			result = Mount_Add(context->m_driver, args->container, args->root, args->file, args->priority);
+			entry->m_result = result < 0 ? StreamerResult_Error : result;
+
+#if defined(STREAMER_PS2)
+			FreeSysMemory(args);
+#else
+			free(args);
+#endif
+
+			lockStreamerQueue(context);
+			{
+				entry->m_mode = EntryMode_Free;
+				entry->m_buffer = 0;
+				entryDetach(&(entry->m_header));
+			}
+			unlockStreamerQueue(context);
+
+			issueStreamerCompletion(context, entry, StreamerOperation_Mount);
+		}
+		break;
+
+		case StreamerOperation_Unmount:
+		{
+			int result;
+
+			result = Mount_Remove(context->m_driver, entry->m_offset);
+			entry->m_result = result < 0 ? StreamerResult_Error : StreamerResult_Ok;
+
+			lockStreamerQueue(context);
+			{
+				entry->m_mode = EntryMode_Free;
+				entryDetach(&(entry->m_header));
+			}
+			unlockStreamerQueue(context);
+
+			issueStreamerCompletion(context, entry, StreamerOperation_Unmount);
+		}
+		break;
+
+		case StreamerOperation_LoadList:
+		{
+			IOListState* state = (IOListState*)entry->m_buffer;
+			unsigned int i;
+			int result;
+
+			start = IODriver_GetTime();
+			result = context->m_driver->loadlist ? context->m_driver->loadlist(context->m_driver, state) : IODriver_LoadList(context->m_driver, state);
+			statsDriverCall(context, entry, start);
+			if (result > 0)
+			{
+				rescheduleStreamerQueue(context, entry);
+				break;
+			}
+
+			STREAMER_PRINTF(("Streamer: Loaded %d of %d files in list\n", state->loaded, state->count));
+
+			for (i = 0; i < state->count; ++i)
+			{
+				if (state->requests[i].result > 0)
+				{
+					STREAMER_ATOMIC_ADD(context->m_stats.bytesRead, state->requests[i].result);
+				}
+			}
+
+			entry->m_result = result < 0 ? StreamerResult_Error : (int)state->loaded;
+
+#if defined(STREAMER_PS2)
+			FreeSysMemory(state);
+#else
+			free(state);
+#endif
+
+			lockStreamerQueue(context);
+			{
+				entry->m_mode = EntryMode_Free;
+				entry->m_buffer = 0;
+				entryDetach(&(entry->m_header));
+			}
+			unlockStreamerQueue(context);
+
+			issueStreamerCompletion(context, entry, StreamerOperation_LoadList);
+		}
+		break;
+	}
+
+	return StreamerResult_Pending;
+}
+
+#if defined(STREAMER_PS2)
+int ps2StreamerInitialize(StreamerContext* context)
+{
+	iop_sema_t sema;
+
+	context->m_activeDmaTransfer = -1;
+
+	sema.attr = 1;
+	sema.option = 0;
+	sema.initial = 1;
+	sema.max = 1;
+
+	context->m_queueSemaphore = CreateSema(&sema);
+	if (context->m_queueSemaphore < 0)
+	{
+		STREAMER_PRINTF(("Streamer: Failed initializing queue semaphore\n"));
+		return StreamerResult_Error;
+	}
+
+	context->m_streamBuffer = AllocSysMemory(ALLOC_FIRST, STREAMER_BUFFER_SIZE_ALIGN * 2, 0);
+	if (!context->m_streamBuffer)
+	{
+		STREAMER_PRINTF(("Streamer: Failed allocating stream buffers\n"));
+		DeleteSema(context->m_queueSemaphore);
+		return StreamerResult_Error;
+	}
+
+	context->m_transferBuffer = ((char*)context->m_streamBuffer) + STREAMER_BUFFER_SIZE_ALIGN;
+
+	return StreamerResult_Ok;
+}
+#endif
+
+StreamerContext* internalStreamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file, void* platform)
+{
+	StreamerContext* context;
+	IODriver* mount;
+	int i;
+
+#if defined(STREAMER_PS2)
+	context = AllocSysMemory(ALLOC_FIRST, sizeof(StreamerContext), 0);
+#else
+	context = malloc(sizeof(StreamerContext));
+#endif
+	if (!context)
+	{
+		STREAMER_PRINTF(("Streamer: Failed to allocate context\n"));
+		return 0;
+	}
+
+	memset(context, 0, sizeof(StreamerContext));
+
+	mount = Mount_Create(transport);
+	if (!mount)
+	{
+		STREAMER_PRINTF(("Streamer: Failed to initialize mount table\n"));
+#if defined(STREAMER_PS2)
+		FreeSysMemory(context);
+#else
+		free(context);
+#endif
+		return 0;
+	}
+
+	mount->stats = &(context->m_stats);
+	mount->trace = &(context->m_trace);
+
+	if (Mount_Add(mount, container, root, file, 0) < 0)
+	{
+		STREAMER_PRINTF(("Streamer: Failed to mount initial container\n"));
+		mount->destroy(mount);
+#if defined(STREAMER_PS2)
+		FreeSysMemory(context);
+#else
+		free(context);
+#endif
+		return 0;
+	}
+
+#if defined(STREAMER_WIN32)
+	InitializeCriticalSection(&(context->m_queueCs));
+#elif defined(STREAMER_PS2)
+	if (ps2StreamerInitialize(context) < 0)
+	{
+		STREAMER_PRINTF(("Streamer: Failed to initialize PS2 logic\n"));
+		mount->destroy(mount);
+		FreeSysMemory(context);
+		return 0;
+	}
+#elif defined(STREAMER_UNIX)
+	pthread_mutex_init(&(context->m_queueMutex), 0);
+#endif
+
+	entryInitialize(&context->m_active);
+	entryInitialize(&context->m_pending);
+
+	context->m_driver = mount;
+	context->m_platform = platform;
+
+	for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+	{
+		entryInitialize(&(context->m_files[i].m_header));
+	}
+
+	return context;
+}
+
+#if defined(STREAMER_PS2)
+int ps2StreamerShutdown(StreamerContext* context)
+{
+	DeleteSema(context->m_queueSemaphore);
+	FreeSysMemory(context->m_streamBuffer < context->m_transferBuffer ? context->m_streamBuffer : context->m_transferBuffer);
+	return StreamerResult_Ok;
+}
+#endif
+
+int internalStreamerShutdown(StreamerContext* context)
+{
+	int i;
+
+	for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+	{
+		QueueEntry* entry = &(context->m_files[i]);
+
+		switch (entry->m_mode & ~EntryMode_Busy)
+		{
+			case EntryMode_File: context->m_driver->close(context->m_driver, entry->m_target); break;
+			case EntryMode_Directory: context->m_driver->dclose(context->m_driver, entry->m_target); break;
+			default: break;
+		}
+	}
+
+	if (context->m_record.writer)
+	{
+		recordStreamerFlush(context);
+	}
+
+	context->m_driver->destroy(context->m_driver);
+	Trace_Destroy(&(context->m_trace));
+
+#if defined(STREAMER_WIN32)
+	DeleteCriticalSection(&(context->m_queueCs));
+#elif defined(STREAMER_PS2)
+	if (ps2StreamerShutdown(context) < 0)
+	{
+		return StreamerResult_Error;
+	}
+#elif defined(STREAMER_UNIX)
+	pthread_mutex_destroy(&(context->m_queueMutex));
+#endif
+
+#if defined(STREAMER_PS2)
+	FreeSysMemory(context);
+#else
+	free(context);
+#endif
+
+	return StreamerResult_Ok;
+}
+
+void* internalStreamerGetPlatform(StreamerContext* context)
+{
+	return context->m_platform;
+}
+
+int internalStreamerGetStats(StreamerContext* context, StreamerStats* stats)
+{
+	StreamerCounter* source = (StreamerCounter*)&(context->m_stats);
+	StreamerCounter* target = (StreamerCounter*)stats;
+	unsigned int i;
+
+	if (!stats)
+	{
+		return StreamerResult_Error;
+	}
+
+	for (i = 0; i < sizeof(StreamerStats) / sizeof(StreamerCounter); ++i)
+	{
+		target[i] = STREAMER_ATOMIC_LOAD(source[i]);
+	}
+
+	return StreamerResult_Ok;
+}
+
+int internalStreamerGetLatency(StreamerContext* context, StreamerLatencyStats* latency)
+{
+	StreamerCounter* source = (StreamerCounter*)&(context->m_latency);
+	StreamerCounter* target = (StreamerCounter*)latency;
+	unsigned int i;
+
+	if (!latency)
+	{
+		return StreamerResult_Error;
+	}
+
+	for (i = 0; i < sizeof(StreamerLatencyStats) / sizeof(StreamerCounter); ++i)
+	{
+		target[i] = STREAMER_ATOMIC_LOAD(source[i]);
+	}
+
+	return StreamerResult_Ok;
+}
+
+static char* formatText(char* out, char* end, const char* text)
+{
+	while (*text && (out < end))
+	{
+		*out++ = *text++;
+	}
+	return out;
+}
+
+static char* formatNumber(char* out, char* end, StreamerCounter value)
+{
+	char digits[24];
+	unsigned int count = 0;
+
+	do
+	{
+		digits[count++] = (char)('0' + (value % 10));
+		value /= 10;
+	}
+	while (value);
+
+	while (count && (out < end))
+	{
+		*out++ = digits[--count];
+	}
+	return out;
+}
+
+static char* formatSigned(char* out, char* end, int value)
+{
+	if (value < 0)
+	{
+		out = formatText(out, end, "-");
+		return formatNumber(out, end, (StreamerCounter)(-(value + 1)) + 1);
+	}
+	return formatNumber(out, end, (StreamerCounter)value);
+}
+
+static char* formatEscaped(char* out, char* end, const char* text)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	for (; *text && (out < end); ++text)
+	{
+		unsigned char c = (unsigned char)*text;
+		char escape[7];
+
+		if ((c == '"') || (c == '\\'))
+		{
+			escape[0] = '\\';
+			escape[1] = (char)c;
+			escape[2] = 0;
+			out = formatText(out, end, escape);
+		}
+		else if (c < 0x20)
+		{
+			escape[0] = '\\';
+			escape[1] = 'u';
+			escape[2] = '0';
+			escape[3] = '0';
+			escape[4] = hex[c >> 4];
+			escape[5] = hex[c & 15];
+			escape[6] = 0;
+			out = formatText(out, end, escape);
+		}
+		else
+		{
+			*out++ = (char)c;
+		}
+	}
+	return out;
+}
+
+static StreamerCounter latencyPercentile(const StreamerHistogram* histogram, unsigned int permille)
+{
+	StreamerCounter threshold = (histogram->count * permille + 999) / 1000;
+	StreamerCounter accumulated = 0;
+	unsigned int i;
+
+	// Reports the upper bound of the bucket containing the percentile, clamped to the largest sample
+
+	for (i = 0; i < STREAMER_LATENCY_BUCKETS; ++i)
+	{
+		accumulated += histogram->buckets[i];
+		if (accumulated >= threshold)
+		{
+			StreamerCounter bound = i ? ((((StreamerCounter)1) << i) - 1) : 0;
+			return bound < histogram->max ? bound : histogram->max;
+		}
+	}
+
+	return histogram->max;
+}
+
+int internalStreamerFormatLatency(const StreamerLatencyStats* latency, char* buffer, unsigned int size)
+{
+	static const char* operations[StreamerLatency_Count] = { "open", "read", "lseek", "close" };
+	static const char* names[] = { " p50=", " p90=", " p99=", " p999=" };
+	static const unsigned int permilles[] = { 500, 900, 990, 999 };
+
+	char* out = buffer;
+	char* end;
+	unsigned int i, j, k;
+
+	if (!latency || !buffer || !size)
+	{
+		return StreamerResult_Error;
+	}
+
+	end = buffer + size - 1;
+
+	// One line per histogram: "<operation> <wait|service> count=N mean=N p50=N p90=N p99=N p999=N max=N buckets=N,N,..."
+	// All times are in microseconds, trailing empty buckets are omitted
+
+	for (i = 0; i < StreamerLatency_Count; ++i)
+	{
+		for (j = 0; j < 2; ++j)
+		{
+			const StreamerHistogram* histogram = j ? &(latency->service[i]) : &(latency->wait[i]);
+			unsigned int used = 0;
+
+			for (k = 0; k < STREAMER_LATENCY_BUCKETS; ++k)
+			{
+				if (histogram->buckets[k])
+				{
+					used = k + 1;
+				}
+			}
+
+			out = formatText(out, end, operations[i]);
+			out = formatText(out, end, j ? " service count=" : " wait count=");
+			out = formatNumber(out, end, histogram->count);
+			out = formatText(out, end, " mean=");
+			out = formatNumber(out, end, histogram->count ? histogram->total / histogram->count : 0);
+
+			for (k = 0; k < sizeof(permilles) / sizeof(permilles[0]); ++k)
+			{
+				out = formatText(out, end, names[k]);
+				out = formatNumber(out, end, latencyPercentile(histogram, permilles[k]));
+			}
+
+			out = formatText(out, end, " max=");
+			out = formatNumber(out, end, histogram->max);
+			out = formatText(out, end, " buckets=");
+
+			for (k = 0; k < used; ++k)
+			{
+				out = formatText(out, end, k ? "," : "");
+				out = formatNumber(out, end, histogram->buckets[k]);
+			}
+
+			out = formatText(out, end, "\n");
+		}
+	}
+
+	*out = 0;
+	return (int)(out - buffer);
+}
+
+int internalStreamerTraceStart(StreamerContext* context, unsigned int capacity)
+{
+	if (!capacity)
+	{
+		return StreamerResult_Error;
+	}
+
+	return Trace_Start(&(context->m_trace), capacity) < 0 ? StreamerResult_Error : StreamerResult_Ok;
+}
+
+int internalStreamerTraceStop(StreamerContext* context)
+{
+	Trace_Stop(&(context->m_trace));
+	return StreamerResult_Ok;
+}
+
+int internalStreamerTraceExport(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	static const char* operations[] = { "open", "close", "read", "lseek", "loadlist", "dopen", "dclose", "dread", "stat", "mount", "unmount" };
+	static const char* phases[] = { "b", "n", "X", "X", "e" };
+
+	StreamerTrace* trace = &(context->m_trace);
+	unsigned int head, index;
+	char line[512];
+	char* end = line + sizeof(line) - 1;
+	char* out;
+
+	if (!writer)
+	{
+		return StreamerResult_Error;
+	}
+
+	// Requests are async spans keyed by file handle, driver reads and decompression are complete events on the streamer thread
+
+	out = formatText(line, end, "{\"traceEvents\":[\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"streamer\"}}");
+	if (writer(line, (unsigned int)(out - line), user) < 0)
+	{
+		return StreamerResult_Error;
+	}
+
+	head = index = 0;
+	if (trace->events)
+	{
+		head = trace->head;
+		index = ((head - trace->start) > (trace->mask + 1)) ? (head - (trace->mask + 1)) : trace->start;
+	}
+
+	for (; index != head; ++index)
+	{
+		TraceEvent event;
+
+		if (Trace_Fetch(trace, index, &event) < 0)
+		{
+			continue;
+		}
+
+		out = formatText(line, end, ",\n{\"name\":\"");
+		switch (event.type)
+		{
+			case TraceEvent_Read:
+			{
+				out = formatText(out, end, "driver read\",\"cat\":\"driver\",\"dur\":");
+				out = formatNumber(out, end, event.duration);
+			}
+			break;
+
+			case TraceEvent_Decompress:
+			{
+				out = formatText(out, end, "decompress\",\"cat\":\"container\",\"dur\":");
+				out = formatNumber(out, end, event.duration);
+			}
+			break;
+
+			default:
+			{
+				out = formatText(out, end, ((unsigned int)event.operation < (sizeof(operations) / sizeof(operations[0]))) ? operations[event.operation] : "unknown");
+				out = formatText(out, end, "\",\"cat\":\"request\",\"id\":");
+				out = formatSigned(out, end, event.fd);
+			}
+			break;
+		}
+
+		out = formatText(out, end, ",\"ph\":\"");
+		out = formatText(out, end, phases[event.type]);
+		out = formatText(out, end, "\",\"pid\":1,\"tid\":1,\"ts\":");
+		out = formatNumber(out, end, event.time);
+		out = formatText(out, end, ",\"args\":{\"fd\":");
+		out = formatSigned(out, end, event.fd);
+		out = formatText(out, end, ",\"path\":\"");
+		out = formatEscaped(out, end, event.path);
+		out = formatText(out, end, "\",\"offset\":");
+		out = formatNumber(out, end, event.offset);
+		out = formatText(out, end, ",\"bytes\":");
+		out = formatNumber(out, end, event.bytes);
+		out = formatText(out, end, event.type == TraceEvent_Decompress ? ",\"compressed\":" : ",\"result\":");
+		out = formatSigned(out, end, event.result);
+		out = formatText(out, end, "}}");
+
+		if (writer(line, (unsigned int)(out - line), user) < 0)
+		{
+			return StreamerResult_Error;
+		}
+	}
+
+	out = formatText(line, end, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	if (writer(line, (unsigned int)(out - line), user) < 0)
+	{
+		return StreamerResult_Error;
+	}
+
+	return StreamerResult_Ok;
+}
+
+int internalStreamerRecordStart(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	StreamerRecordHeader header;
+	int result = StreamerResult_Error;
+
+	if (!writer)
+	{
+		return StreamerResult_Error;
+	}
+
+	lockStreamerQueue(context);
+	do
+	{
+		if (context->m_record.writer)
+		{
+			STREAMER_PRINTF(("Streamer: Access recording already in progress\n"));
+			break;
+		}
+
+		header.magic = STREAMER_RECORD_MAGIC;
+		header.version = STREAMER_RECORD_VERSION;
+		header.reserved[0] = 0;
+		header.reserved[1] = 0;
+
+		context->m_record.writer = writer;
+		context->m_record.user = user;
+		context->m_record.start = IODriver_GetTime();
+
+		memcpy(context->m_record.buffer, &header, sizeof(header));
+		context->m_record.fill = sizeof(header);
+
+		result = StreamerResult_Ok;
+	}
+	while (0);
+	unlockStreamerQueue(context);
+
+	return result;
+}
+
+int internalStreamerRecordStop(StreamerContext* context)
+{
+	int result = StreamerResult_Error;
+
+	lockStreamerQueue(context);
+	if (context->m_record.writer)
+	{
+		recordStreamerFlush(context);
+		result = context->m_record.writer ? StreamerResult_Ok : StreamerResult_Error;
+		context->m_record.writer = 0;
+	}
+	unlockStreamerQueue(context);
+
+	return result;
+}
+
+int internalStreamerSetDeviceModel(StreamerContext* context, const StreamerDeviceModel* model)
+{
+	int result = StreamerResult_Error;
+	int i;
+
+	lockStreamerQueue(context);
+	do
+	{
+		for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+		{
+			if (context->m_files[i].m_mode != EntryMode_Free)
+			{
+				break;
+			}
+		}
+
+		if (i != STREAMER_MAX_FILEHANDLES)
+		{
+			STREAMER_PRINTF(("Streamer: Cannot change device model while handles are in use\n"));
+			break;
+		}
+
+		if (Mount_SetDeviceModel(context->m_driver, model) < 0)
+		{
+			break;
+		}
+
+		result = StreamerResult_Ok;
+	}
+	while (0);
+	unlockStreamerQueue(context);
+
+	return result;
+}
+
+int internalStreamerSetVerify(StreamerContext* context, int enable)
+{
+	lockStreamerQueue(context);
+	Mount_SetVerify(context->m_driver, enable);
+	unlockStreamerQueue(context);
+
+	return StreamerResult_Ok;
+}
+
+int internalStreamerSetDecompressionWorkers(int count)
+{
+	Decompressor_SetWorkers(count);
+	return StreamerResult_Ok;
+}
+
+int internalStreamerPoll(StreamerContext* context, int fd)
+{
+	int result = StreamerResult_Error;
+
+	if ((fd < 0) || (fd >= STREAMER_MAX_FILEHANDLES))
+	{
+		STREAMER_PRINTF(("Streamer: Bad file descriptor %d\n", fd));
+		return StreamerResult_Error;
+	}
+
+	lockStreamerQueue(context);
+	do
+	{
+		QueueEntry* entry = &context->m_files[fd];
+		int mode = entry->m_mode;
+
+		if (mode & EntryMode_Busy)
+		{
+			result = StreamerResult_Pending;
+			break;
+		}
+
+		if (entry->m_target < 0)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d has no target\n",  fd));
+			break;
+		}
+
+		result = entry->m_result;
+	}
+	while (0);
+
+	if (result != StreamerResult_Pending)
+	{
+		recordStreamerCall(context, StreamerRecordCall_Poll, fd, 0, 0, result, 0);
+	}
+	unlockStreamerQueue(context);
+
+	return result;
+}
+
+int internalStreamerOpen(StreamerContext* context, const char* filename, StreamerOpenMode mode, StreamerCallMethod method)
+{
+	int result = StreamerResult_Error;
+
+	STREAMER_PRINTF(("Streamer: open(\"%s\", %d)\n", filename, mode));
+
+	lockStreamerQueue(context);
+	do
+	{
+		QueueEntry* entry = 0;
+		int i;
+
+		for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+		{
+			if (context->m_files[i].m_mode == EntryMode_Free)
+			{
+				entry = &context->m_files[i];
+				result = i;
+				break;
+			}
+		}
+
+		if (!entry)
+		{
+			STREAMER_PRINTF(("Streamer: Out of available file entries\n"));
+			break;
+		}
+
+		strcpy(entry->m_filename, filename);
+		entry->m_openMode = mode;
+		entry->m_mode = EntryMode_Free|EntryMode_Busy;
+		entry->m_operation = StreamerOperation_Open;
+		entry->m_target = -1;
+		entry->m_method = method;
+
+		queueStreamerEntry(context, entry);
+	}
+	while (0);
+	recordStreamerCall(context, StreamerRecordCall_Open, result, mode, 0, result, filename);
+	unlockStreamerQueue(context);
+
+	return result;
+}
+
+int internalStreamerClose(StreamerContext* context, int fd, StreamerCallMethod method)
+{
+	int result = StreamerResult_Error;
+
+	STREAMER_PRINTF(("Streamer: close(%d)\n", fd));
+
+	if ((fd < 0) || (fd >= STREAMER_MAX_FILEHANDLES))
+	{
+		STREAMER_PRINTF(("Streamer: Bad file descriptor %d\n", fd));
+		return StreamerResult_Error;
+	}
+
+	lockStreamerQueue(context);
+	do
+	{
+		QueueEntry* entry = &context->m_files[fd];
+		int mode = entry->m_mode;
+
+		if ((mode & ~EntryMode_Busy) != EntryMode_File)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d is not a file\n", fd));
+			break;
+		}
+
+		if (mode & EntryMode_Busy)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d is busy\n", fd));
+			result = StreamerResult_Busy;
+			break;
+		}
+
+		if (entry->m_target < 0)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d has no target\n",  fd));
+			break;
+		}
+
+		entry->m_mode |= EntryMode_Busy;
+		entry->m_operation = StreamerOperation_Close;
+		entry->m_method = method;
+		queueStreamerEntry(context, entry);
+
+		result = StreamerResult_Ok;
+	}
+	while (0);
+	recordStreamerCall(context, StreamerRecordCall_Close, fd, 0, 0, result, 0);
+	unlockStreamerQueue(context);
+
+	return result;
+}
+
+int internalStreamerRead(StreamerContext* context, int fd, void* buffer, unsigned int length, void* head, void* tail, StreamerCallMethod method)
+{
+	int result = StreamerResult_Error;
+
+	if ((fd < 0) || (fd >= STREAMER_MAX_FILEHANDLES))
+	{
+		STREAMER_PRINTF(("Streamer: Bad file descriptor %d\n", fd));
+		return StreamerResult_Error;
+	}
+
+	lockStreamerQueue(context);
+	do
+	{
+		QueueEntry* entry = &context->m_files[fd];
+		int mode = entry->m_mode;
+
+		if ((mode & ~EntryMode_Busy) != EntryMode_File)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d is not a file\n", fd));
+			break;
+		}
+
+		if (mode & EntryMode_Busy)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d is busy\n", fd));
+			result = StreamerResult_Busy;
+			break;
+		}
+
+		if (entry->m_target < 0)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d has no target\n",  fd));
+			break;
+		}
+
+		entry->m_buffer = buffer;
+		entry->m_length = length;
+		entry->m_method = method;
+		entry->m_head = head;
+		entry->m_tail = tail;
+		entry->m_offset = 0;
+		entry->m_mode |= EntryMode_Busy;
+		entry->m_operation = StreamerOperation_Read;
+
+		queueStreamerEntry(context, entry);
+
+		result = StreamerResult_Ok;
+	}
+	while (0);
+	recordStreamerCall(context, StreamerRecordCall_Read, fd, (int)length, 0, result, 0);
+	unlockStreamerQueue(context);
+
+	return result;
+}
 
-int internalStreamerShutdown()
+static int queueStreamerSeek(StreamerContext* context, int fd, StreamerOffset offset, StreamerSeekMode whence, int wide, StreamerCallMethod method)
 {
-#if defined(STREAMER_WIN32)
-	DeleteCriticalSection(&s_queueCs);
-#elif defined(STREAMER_PS2)
-	if (ps2StreamerShutdown() < 0)
+	int result = StreamerResult_Error;
+
+	lockStreamerQueue(context);
+	do
 	{
-		return StreamerResult_Error;
+		QueueEntry* entry = &context->m_files[fd];
+		int mode = entry->m_mode;
+
+		if ((mode & ~EntryMode_Busy) != EntryMode_File)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d is not a file\n", fd));
+			break;
+		}
+
+		if (mode & EntryMode_Busy)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d is busy\n", fd));
+			result = StreamerResult_Busy;
+			break;
+		}
+
+		if (entry->m_target < 0)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d has no target\n",  fd));
+			break;
+		}
+
+		entry->m_seek = offset;
+		entry->m_wide = wide;
+		entry->m_whence = whence;
+		entry->m_operation = StreamerOperation_LSeek;
+		entry->m_mode |= EntryMode_Busy;
+		entry->m_method = method;
+
+		queueStreamerEntry(context, entry);
+
+		result = StreamerResult_Ok;
 	}
-#endif
+	while (0);
+	recordStreamerCall(context, wide ? StreamerRecordCall_LSeek64 : StreamerRecordCall_LSeek, fd, offset, whence, result, 0);
+	unlockStreamerQueue(context);
 
-	return StreamerResult_Ok;
+	return result;
 }
 
-int internalStreamerPoll(int fd)
+int internalStreamerLSeek(StreamerContext* context, int fd, int offset, StreamerSeekMode whence, StreamerCallMethod method)
 {
-	int result = StreamerResult_Error;
+	STREAMER_PRINTF(("Streamer: lseek(%d, %d, %d)\n", fd, offset, whence));
+	return queueStreamerSeek(context, fd, offset, whence, 0, method);
+}
+
+int internalStreamerLSeek64(StreamerContext* context, int fd, StreamerOffset offset, StreamerSeekMode whence, StreamerCallMethod method)
+{
+	STREAMER_PRINTF(("Streamer: lseek64(%d, %ld, %d)\n", fd, (long)offset, whence));
+	return queueStreamerSeek(context, fd, offset, whence, 1, method);
+}
+
+StreamerOffset internalStreamerTell64(StreamerContext* context, int fd)
+{
+	StreamerOffset result = StreamerResult_Error;
 
 	if ((fd < 0) || (fd >= STREAMER_MAX_FILEHANDLES))
 	{
@@ -651,39 +1884,167 @@ int internalStreamerPoll(int fd)
 		return StreamerResult_Error;
 	}
 
-	lockStreamerQueue();
+	lockStreamerQueue(context);
 	do
 	{
-		QueueEntry* entry = &s_files[fd];
+		QueueEntry* entry = &context->m_files[fd];
 		int mode = entry->m_mode;
 
+		if ((mode & ~EntryMode_Busy) != EntryMode_File)
+		{
+			STREAMER_PRINTF(("Streamer: File descriptor %d is not a file\n", fd));
+			break;
+		}
+
 		if (mode & EntryMode_Busy)
 		{
-			result = StreamerResult_Pending;
+			result = StreamerResult_Busy;
 			break;
 		}
 
-		if (entry->m_target < 0)
+		result = entry->m_position;
+	}
+	while (0);
+	unlockStreamerQueue(context);
+
+	return result;
+}
+
+int internalStreamerLoadList(StreamerContext* context, StreamerLoadRequest* requests, unsigned int count, StreamerCallMethod method)
+{
+	int result = StreamerResult_Error;
+	IOListState* state;
+	unsigned int i;
+
+	STREAMER_PRINTF(("Streamer: loadlist(%d)\n", count));
+
+#if defined(STREAMER_PS2)
+	state = AllocSysMemory(ALLOC_FIRST, sizeof(IOListState) + count * sizeof(IOListItem), 0);
+#else
+	state = malloc(sizeof(IOListState) + count * sizeof(IOListItem));
+#endif
+	if (!state)
+	{
+		STREAMER_PRINTF(("Streamer: Failed allocating list state\n"));
+		return StreamerResult_Error;
+	}
+
+	memset(state, 0, sizeof(IOListState));
+	state->requests = requests;
+	state->count = count;
+	state->items = (IOListItem*)(state + 1);
+	state->fd = -1;
+
+	for (i = 0; i < count; ++i)
+	{
+		state->items[i].index = i;
+		state->items[i].data = 0;
+
+		requests[i].result = StreamerResult_Pending;
+	}
+
+	lockStreamerQueue(context);
+	do
+	{
+		QueueEntry* entry = 0;
+
+		for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
 		{
-			STREAMER_PRINTF(("Streamer: File descriptor %d has no target\n",  fd));
+			if (context->m_files[i].m_mode == EntryMode_Free)
+			{
+				entry = &context->m_files[i];
+				result = i;
+				break;
+			}
+		}
+
+		if (!entry)
+		{
+			STREAMER_PRINTF(("Streamer: Out of available file entries\n"));
 			break;
 		}
 
-		result = entry->m_result;
+		entry->m_buffer = state;
+		entry->m_mode = EntryMode_Free|EntryMode_Busy;
+		entry->m_operation = StreamerOperation_LoadList;
+		entry->m_target = 0;
+		entry->m_method = method;
+
+		queueStreamerEntry(context, entry);
+		state = 0;
 	}
 	while (0);
-	unlockStreamerQueue();
+	unlockStreamerQueue(context);
+
+	if (state)
+	{
+#if defined(STREAMER_PS2)
+		FreeSysMemory(state);
+#else
+		free(state);
+#endif
+	}
 
 	return result;
 }
 
-int internalStreamerOpen(const char* filename, StreamerOpenMode mode, StreamerCallMethod method)
+int internalStreamerStat(StreamerContext* context, StreamerStat* stats, unsigned int count, StreamerCallMethod method)
 {
 	int result = StreamerResult_Error;
+	unsigned int i;
 
-	STREAMER_PRINTF(("Streamer: open(\"%s\", %d)\n", filename, mode));
+	STREAMER_PRINTF(("Streamer: stat(%d)\n", count));
+
+	for (i = 0; i < count; ++i)
+	{
+		stats[i].result = StreamerResult_Pending;
+	}
+
+	lockStreamerQueue(context);
+	do
+	{
+		QueueEntry* entry = 0;
+
+		for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+		{
+			if (context->m_files[i].m_mode == EntryMode_Free)
+			{
+				entry = &context->m_files[i];
+				result = i;
+				break;
+			}
+		}
+
+		if (!entry)
+		{
+			STREAMER_PRINTF(("Streamer: Out of available file entries\n"));
+			break;
+		}
+
+		entry->m_buffer = stats;
+		entry->m_offset = 0;
+		entry->m_length = count;
+		entry->m_result = 0;
+		entry->m_mode = EntryMode_Free|EntryMode_Busy;
+		entry->m_operation = StreamerOperation_Stat;
+		entry->m_target = 0;
+		entry->m_method = method;
 
-	lockStreamerQueue();
+		queueStreamerEntry(context, entry);
+	}
+	while (0);
+	unlockStreamerQueue(context);
+
+	return result;
+}
+
+int internalStreamerDOpen(StreamerContext* context, const char* pathname, StreamerCallMethod method)
+{
+	int result = StreamerResult_Error;
+
+	STREAMER_PRINTF(("Streamer: dopen(\"%s\")\n", pathname));
+
+	lockStreamerQueue(context);
 	do
 	{
 		QueueEntry* entry = 0;
@@ -691,9 +2052,9 @@ int internalStreamerOpen(const char* filename, StreamerOpenMode mode, StreamerCa
 
 		for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
 		{
-			if (s_files[i].m_mode == EntryMode_Free)
+			if (context->m_files[i].m_mode == EntryMode_Free)
 			{
-				entry = &s_files[i];
+				entry = &context->m_files[i];
 				result = i;
 				break;
 			}
@@ -705,26 +2066,25 @@ int internalStreamerOpen(const char* filename, StreamerOpenMode mode, StreamerCa
 			break;
 		}
 
-		strcpy(entry->m_filename, filename);
-		entry->m_openMode = mode;
+		strcpy(entry->m_filename, pathname);
 		entry->m_mode = EntryMode_Free|EntryMode_Busy;
-		entry->m_operation = StreamerOperation_Open;
+		entry->m_operation = StreamerOperation_DOpen;
 		entry->m_target = -1;
 		entry->m_method = method;
 
-		entryAttach(&s_pending, &(entry->m_header));
+		queueStreamerEntry(context, entry);
 	}
 	while (0);
-	unlockStreamerQueue();
+	unlockStreamerQueue(context);
 
 	return result;
 }
 
-int internalStreamerClose(int fd, StreamerCallMethod method)
+int internalStreamerDClose(StreamerContext* context, int fd, StreamerCallMethod method)
 {
 	int result = StreamerResult_Error;
 
-	STREAMER_PRINTF(("Streamer: close(%d)\n", fd));
+	STREAMER_PRINTF(("Streamer: dclose(%d)\n", fd));
 
 	if ((fd < 0) || (fd >= STREAMER_MAX_FILEHANDLES))
 	{
@@ -732,15 +2092,15 @@ int internalStreamerClose(int fd, StreamerCallMethod method)
 		return StreamerResult_Error;
 	}
 
-	lockStreamerQueue();
+	lockStreamerQueue(context);
 	do
 	{
-		QueueEntry* entry = &s_files[fd];
+		QueueEntry* entry = &context->m_files[fd];
 		int mode = entry->m_mode;
 
-		if ((mode & ~EntryMode_Busy) != EntryMode_File)
+		if ((mode & ~EntryMode_Busy) != EntryMode_Directory)
 		{
-			STREAMER_PRINTF(("Streamer: File descriptor %d is not a file\n", fd));
+			STREAMER_PRINTF(("Streamer: File descriptor %d is not a directory\n", fd));
 			break;
 		}
 
@@ -758,19 +2118,19 @@ int internalStreamerClose(int fd, StreamerCallMethod method)
 		}
 
 		entry->m_mode |= EntryMode_Busy;
-		entry->m_operation = StreamerOperation_Close;
+		entry->m_operation = StreamerOperation_DClose;
 		entry->m_method = method;
-		entryAttach(&s_pending, &(entry->m_header));
+		queueStreamerEntry(context, entry);
 
 		result = StreamerResult_Ok;
 	}
 	while (0);
-	unlockStreamerQueue();
+	unlockStreamerQueue(context);
 
 	return result;
 }
 
-int internalStreamerRead(int fd, void* buffer, unsigned int length, void* head, void* tail, StreamerCallMethod method)
+int internalStreamerDRead(StreamerContext* context, int fd, StreamerDirEntry* entries, unsigned int count, StreamerCallMethod method)
 {
 	int result = StreamerResult_Error;
 
@@ -780,15 +2140,15 @@ int internalStreamerRead(int fd, void* buffer, unsigned int length, void* head,
 		return StreamerResult_Error;
 	}
 
-	lockStreamerQueue();
+	lockStreamerQueue(context);
 	do
 	{
-		QueueEntry* entry = &s_files[fd];
+		QueueEntry* entry = &context->m_files[fd];
 		int mode = entry->m_mode;
 
-		if ((mode & ~EntryMode_Busy) != EntryMode_File)
+		if ((mode & ~EntryMode_Busy) != EntryMode_Directory)
 		{
-			STREAMER_PRINTF(("Streamer: File descriptor %d is not a file\n", fd));
+			STREAMER_PRINTF(("Streamer: File descriptor %d is not a directory\n", fd));
 			break;
 		}
 
@@ -805,68 +2165,135 @@ int internalStreamerRead(int fd, void* buffer, unsigned int length, void* head,
 			break;
 		}
 
-		entry->m_buffer = buffer;
-		entry->m_length = length;
+		entry->m_buffer = entries;
+		entry->m_length = count;
 		entry->m_method = method;
-		entry->m_head = head;
-		entry->m_tail = tail;
-		entry->m_offset = 0;
 		entry->m_mode |= EntryMode_Busy;
-		entry->m_operation = StreamerOperation_Read;
+		entry->m_operation = StreamerOperation_DRead;
 
-		entryAttach(&s_pending, &(entry->m_header));
+		queueStreamerEntry(context, entry);
 
 		result = StreamerResult_Ok;
 	}
 	while (0);
-	unlockStreamerQueue();
+	unlockStreamerQueue(context);
 
 	return result;
 }
 
-int internalStreamerLSeek(int fd, int offset, StreamerSeekMode whence, StreamerCallMethod method)
+int internalStreamerMount(StreamerContext* context, StreamerContainer container, const char* root, const char* file, int priority, StreamerCallMethod method)
 {
 	int result = StreamerResult_Error;
+	MountArguments* args;
+	int i;
 
-	STREAMER_PRINTF(("Streamer: lseek(%d, %d, %d)\n", fd, offset, whence));
+	STREAMER_PRINTF(("Streamer: mount(%d, \"%s\", \"%s\", %d)\n", container, root, file, priority));
+
+	if ((strlen(root) >= sizeof(args->root)) || (strlen(file) >= sizeof(args->file)))
+	{
+		STREAMER_PRINTF(("Streamer: Mount path too long\n"));
+		return StreamerResult_Error;
+	}
+
+#if defined(STREAMER_PS2)
+	args = AllocSysMemory(ALLOC_FIRST, sizeof(MountArguments), 0);
+#else
+	args = malloc(sizeof(MountArguments));
+#endif
+	if (!args)
+	{
+		STREAMER_PRINTF(("Streamer: Failed allocating mount arguments\n"));
+		return StreamerResult_Error;
+	}
 
-	lockStreamerQueue();
+	args->container = container;
+	args->priority = priority;
+	strcpy(args->root, root);
+	strcpy(args->file, file);
+
+	lockStreamerQueue(context);
 	do
 	{
-		QueueEntry* entry = &s_files[fd];
-		int mode = entry->m_mode;
+		QueueEntry* entry = 0;
 
-		if ((mode & ~EntryMode_Busy) != EntryMode_File)
+		for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
 		{
-			STREAMER_PRINTF(("Streamer: File descriptor %d is not a file\n", fd));
-			break;
+			if (context->m_files[i].m_mode == EntryMode_Free)
+			{
+				entry = &context->m_files[i];
+				result = i;
+				break;
+			}
 		}
 
-		if (mode & EntryMode_Busy)
+		if (!entry)
 		{
-			STREAMER_PRINTF(("Streamer: File descriptor %d is busy\n", fd));
-			result = StreamerResult_Busy;
+			STREAMER_PRINTF(("Streamer: Out of available file entries\n"));
 			break;
 		}
 
-		if (entry->m_target < 0)
+		entry->m_buffer = args;
+		entry->m_mode = EntryMode_Free|EntryMode_Busy;
+		entry->m_operation = StreamerOperation_Mount;
+		entry->m_target = 0;
+		entry->m_method = method;
+
+		queueStreamerEntry(context, entry);
+		args = 0;
+	}
+	while (0);
+	unlockStreamerQueue(context);
+
+	if (args)
+	{
+#if defined(STREAMER_PS2)
+		FreeSysMemory(args);
+#else
+		free(args);
+#endif
+	}
+
+	return result;
+}
+
+int internalStreamerUnmount(StreamerContext* context, int mount, StreamerCallMethod method)
+{
+	int result = StreamerResult_Error;
+	int i;
+
+	STREAMER_PRINTF(("Streamer: unmount(%d)\n", mount));
+
+	lockStreamerQueue(context);
+	do
+	{
+		QueueEntry* entry = 0;
+
+		for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
 		{
-			STREAMER_PRINTF(("Streamer: File descriptor %d has no target\n",  fd));
+			if (context->m_files[i].m_mode == EntryMode_Free)
+			{
+				entry = &context->m_files[i];
+				result = i;
+				break;
+			}
+		}
+
+		if (!entry)
+		{
+			STREAMER_PRINTF(("Streamer: Out of available file entries\n"));
 			break;
 		}
 
-		entry->m_offset = offset;
-		entry->m_whence = whence;
-		entry->m_operation = StreamerOperation_LSeek;
-		entry->m_mode |= EntryMode_Busy;
+		entry->m_offset = mount;
+		entry->m_mode = EntryMode_Free|EntryMode_Busy;
+		entry->m_operation = StreamerOperation_Unmount;
+		entry->m_target = 0;
 		entry->m_method = method;
 
-		entryAttach(&s_pending, &(entry->m_header));
-
-		result = StreamerResult_Ok;
+		queueStreamerEntry(context, entry);
 	}
 	while (0);
-	unlockStreamerQueue();
+	unlockStreamerQueue(context);
 
 	return result;
 }
@@ -34,25 +34,58 @@ SOFTWARE.
 extern "C" {
 #endif
 
-#define STREAMER_MAX_FILEHANDLES (8)
-
 typedef enum
 {
 	StreamerOperation_Open,
 	StreamerOperation_Close,
 	StreamerOperation_Read,
-	StreamerOperation_LSeek
+	StreamerOperation_LSeek,
+	StreamerOperation_LoadList,
+	StreamerOperation_DOpen,
+	StreamerOperation_DClose,
+	StreamerOperation_DRead,
+	StreamerOperation_Stat,
+	StreamerOperation_Mount,
+	StreamerOperation_Unmount
 } StreamerOperation;
 
-int internalStreamerIdle();
+int internalStreamerIdle(StreamerContext* context);
+
+StreamerContext* internalStreamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file, void* platform);
+int internalStreamerShutdown(StreamerContext* context);
+int internalStreamerPoll(StreamerContext* context, int fd);
+int internalStreamerOpen(StreamerContext* context, const char* filename, StreamerOpenMode mode, StreamerCallMethod method);
+int internalStreamerClose(StreamerContext* context, int fd, StreamerCallMethod method);
+int internalStreamerRead(StreamerContext* context, int fd, void* buffer, unsigned int length, void* head, void* tail, StreamerCallMethod method);
+int internalStreamerLSeek(StreamerContext* context, int fd, int offset, StreamerSeekMode whence, StreamerCallMethod method);
+int internalStreamerLSeek64(StreamerContext* context, int fd, StreamerOffset offset, StreamerSeekMode whence, StreamerCallMethod method);
+StreamerOffset internalStreamerTell64(StreamerContext* context, int fd);
+int internalStreamerLoadList(StreamerContext* context, StreamerLoadRequest* requests, unsigned int count, StreamerCallMethod method);
+int internalStreamerStat(StreamerContext* context, StreamerStat* stats, unsigned int count, StreamerCallMethod method);
+int internalStreamerDOpen(StreamerContext* context, const char* pathname, StreamerCallMethod method);
+int internalStreamerDClose(StreamerContext* context, int fd, StreamerCallMethod method);
+int internalStreamerDRead(StreamerContext* context, int fd, StreamerDirEntry* entries, unsigned int count, StreamerCallMethod method);
+int internalStreamerMount(StreamerContext* context, StreamerContainer container, const char* root, const char* file, int priority, StreamerCallMethod method);
+int internalStreamerUnmount(StreamerContext* context, int mount, StreamerCallMethod method);
+int internalStreamerGetStats(StreamerContext* context, StreamerStats* stats);
+int internalStreamerGetLatency(StreamerContext* context, StreamerLatencyStats* latency);
+int internalStreamerFormatLatency(const StreamerLatencyStats* latency, char* buffer, unsigned int size);
+int internalStreamerTraceStart(StreamerContext* context, unsigned int capacity);
+int internalStreamerTraceStop(StreamerContext* context);
+int internalStreamerTraceExport(StreamerContext* context, StreamerTraceWriter writer, void* user);
+int internalStreamerRecordStart(StreamerContext* context, StreamerTraceWriter writer, void* user);
+int internalStreamerRecordStop(StreamerContext* context);
+int internalStreamerSetDeviceModel(StreamerContext* context, const StreamerDeviceModel* model);
+int internalStreamerSetVerify(StreamerContext* context, int enable);
+int internalStreamerSetDecompressionWorkers(int count);
+
+/**
+ *
+ * internalStreamerGetPlatform - Return the platform data passed when the context was created
+ *
+**/
 
-int internalStreamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file);
-int internalStreamerShutdown();
-int internalStreamerPoll(int fd);
-int internalStreamerOpen(const char* filename, StreamerOpenMode mode, StreamerCallMethod method);
-int internalStreamerClose(int fd, StreamerCallMethod method);
-int internalStreamerRead(int fd, void* buffer, unsigned int length, void* head, void* tail, StreamerCallMethod method);
-int internalStreamerLSeek(int fd, int offset, StreamerSeekMode whence, StreamerCallMethod method);
+void* internalStreamerGetPlatform(StreamerContext* context);
 
 /**
  *
@@ -60,7 +93,7 @@ int internalStreamerLSeek(int fd, int offset, StreamerSeekMode whence, StreamerC
  *
 **/
 
-void internalStreamerSetEventFlag();
+void internalStreamerSetEventFlag(StreamerContext* context);
 
 /**
  *
@@ -70,7 +103,7 @@ void internalStreamerSetEventFlag();
  *
 **/
 
-void internalStreamerIssueResponse(int fd, int result, StreamerCallMethod method);
+void internalStreamerIssueResponse(StreamerContext* context, int fd, int result, StreamerCallMethod method);
 
 /**
  *
@@ -78,13 +111,14 @@ void internalStreamerIssueResponse(int fd, int result, StreamerCallMethod method
  *
  * This is implemented by the platform
  *
+ * \param context - Context that owns the handle
  * \param fd - Handle that completed its work
  * \param operation - What operation that was executed
  * \param result - The result of that operation
  * \param method - Method used for the operation
  *
 **/
-void internalStreamerIssueCompletion(int fd, int operation, int result, StreamerCallMethod method);
+void internalStreamerIssueCompletion(StreamerContext* context, int fd, int operation, int result, StreamerCallMethod method);
 
 #if defined(__cplusplus)
 }
@@ -0,0 +1,380 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "blockcache.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#if defined(_IOP)
+#include "../iop/irx_imports.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+#if defined(STREAMER_UNIX)
+#include <pthread.h>
+#endif
+
+#if defined(_WIN32)
+#define BLOCKCACHE_LOCK() AcquireSRWLockExclusive(&s_cache.lock)
+#define BLOCKCACHE_UNLOCK() ReleaseSRWLockExclusive(&s_cache.lock)
+#elif defined(STREAMER_UNIX)
+#define BLOCKCACHE_LOCK() pthread_mutex_lock(&s_cache.lock)
+#define BLOCKCACHE_UNLOCK() pthread_mutex_unlock(&s_cache.lock)
+#else
+#define BLOCKCACHE_LOCK()
+#define BLOCKCACHE_UNLOCK()
+#endif
+
+#define BLOCKCACHE_PAGES (BLOCKCACHE_SIZE / BLOCKCACHE_PAGE_SIZE)
+
+// Blocks are stored across as many pages as they need, so a slot per page covers the case where every block fits a page
+
+#define BLOCKCACHE_SLOTS BLOCKCACHE_PAGES
+
+typedef struct BlockCacheSlot
+{
+	const void* owner;		// Archive of cached block, NULL if slot is empty
+	uint64_t offset;		// Location of block header in archive
+	uint32_t original;		// Size of decompressed block
+	uint32_t usage;			// Size of block in archive, including header
+	int referenced;			// Set on hits, cleared as the clock hand passes
+	int next;			// Next slot in hash chain, or in the free list when empty, <0 at end of chain
+	int page;			// First page holding the block, <0 if none
+} BlockCacheSlot;
+
+static uint32_t BlockCache_Hash(const void* owner, uint64_t offset);
+static void BlockCache_Evict(BlockCacheSlot* slot);
+
+static struct
+{
+	int references;
+
+	BlockCacheSlot* slots;		// NULL if cache is not allocated
+	int* buckets;			// First slot in each hash chain, <0 if empty
+	int* pages;			// Next page of the same block for each page, or next free page
+	uint8_t* data;			// Page contents
+	uint32_t mask;
+	uint32_t hand;			// Next slot considered for eviction
+
+	int freeSlots;			// First empty slot, <0 if none
+	int freePages;			// First unused page, <0 if none
+	uint32_t available;		// Number of unused pages
+
+#if defined(_WIN32)
+	SRWLOCK lock;
+#elif defined(STREAMER_UNIX)
+	pthread_mutex_t lock;
+#endif
+} s_cache =
+{
+	0, 0, 0, 0, 0, 0, 0, -1, -1, 0,
+#if defined(_WIN32)
+	SRWLOCK_INIT
+#elif defined(STREAMER_UNIX)
+	PTHREAD_MUTEX_INITIALIZER
+#endif
+};
+
+void BlockCache_Acquire()
+{
+	BLOCKCACHE_LOCK();
+
+	if (s_cache.references++ == 0)
+	{
+		uint32_t buckets = 1, size, i;
+		uint8_t* buffer;
+
+		while (buckets < BLOCKCACHE_SLOTS)
+		{
+			buckets <<= 1;
+		}
+
+		size = BLOCKCACHE_SLOTS * sizeof(BlockCacheSlot) + buckets * sizeof(int) + BLOCKCACHE_PAGES * sizeof(int) + BLOCKCACHE_SIZE;
+
+#if defined(_IOP)
+		buffer = AllocSysMemory(ALLOC_FIRST, size, 0);
+#else
+		buffer = malloc(size);
+#endif
+		if (buffer)
+		{
+			s_cache.slots = (BlockCacheSlot*)buffer;
+			buffer += BLOCKCACHE_SLOTS * sizeof(BlockCacheSlot);
+			s_cache.buckets = (int*)buffer;
+			buffer += buckets * sizeof(int);
+			s_cache.pages = (int*)buffer;
+			buffer += BLOCKCACHE_PAGES * sizeof(int);
+			s_cache.data = buffer;
+
+			for (i = 0; i < BLOCKCACHE_SLOTS; ++i)
+			{
+				BlockCacheSlot* slot = &(s_cache.slots[i]);
+
+				slot->owner = 0;
+				slot->referenced = 0;
+				slot->next = (i + 1) < BLOCKCACHE_SLOTS ? (int)(i + 1) : -1;
+				slot->page = -1;
+			}
+
+			for (i = 0; i < BLOCKCACHE_PAGES; ++i)
+			{
+				s_cache.pages[i] = (i + 1) < BLOCKCACHE_PAGES ? (int)(i + 1) : -1;
+			}
+
+			for (i = 0; i < buckets; ++i)
+			{
+				s_cache.buckets[i] = -1;
+			}
+
+			s_cache.mask = buckets - 1;
+			s_cache.hand = 0;
+			s_cache.freeSlots = 0;
+			s_cache.freePages = 0;
+			s_cache.available = BLOCKCACHE_PAGES;
+		}
+		else
+		{
+			STREAMER_PRINTF(("BlockCache: Could not allocate %u bytes, running without block cache\n", size));
+		}
+	}
+
+	BLOCKCACHE_UNLOCK();
+}
+
+void BlockCache_Release()
+{
+	BLOCKCACHE_LOCK();
+
+	if ((--s_cache.references == 0) && s_cache.slots)
+	{
+#if defined(_IOP)
+		FreeSysMemory(s_cache.slots);
+#else
+		free(s_cache.slots);
+#endif
+		s_cache.slots = 0;
+		s_cache.buckets = 0;
+		s_cache.pages = 0;
+		s_cache.data = 0;
+	}
+
+	BLOCKCACHE_UNLOCK();
+}
+
+int BlockCache_Lookup(const void* owner, uint64_t offset, void* target, uint32_t capacity, uint32_t* usage)
+{
+	int index, result = -1;
+
+	if (!s_cache.slots)
+	{
+		return -1;
+	}
+
+	BLOCKCACHE_LOCK();
+
+	for (index = s_cache.buckets[BlockCache_Hash(owner, offset)]; index >= 0; index = s_cache.slots[index].next)
+	{
+		BlockCacheSlot* slot = &(s_cache.slots[index]);
+
+		if ((slot->owner == owner) && (slot->offset == offset))
+		{
+			if (slot->original <= capacity)
+			{
+				uint32_t copied = 0;
+				int page;
+
+				for (page = slot->page; copied < slot->original; page = s_cache.pages[page])
+				{
+					uint32_t length = (slot->original - copied) < BLOCKCACHE_PAGE_SIZE ? (slot->original - copied) : BLOCKCACHE_PAGE_SIZE;
+
+					memcpy(((uint8_t*)target) + copied, s_cache.data + (uint32_t)page * BLOCKCACHE_PAGE_SIZE, length);
+					copied += length;
+				}
+
+				slot->referenced = 1;
+			}
+
+			*usage = slot->usage;
+			result = (int)slot->original;
+			break;
+		}
+	}
+
+	BLOCKCACHE_UNLOCK();
+	return result;
+}
+
+void BlockCache_Insert(const void* owner, uint64_t offset, const void* data, uint32_t original, uint32_t usage)
+{
+	uint32_t needed = (original + BLOCKCACHE_PAGE_SIZE - 1) / BLOCKCACHE_PAGE_SIZE, copied = 0;
+	BlockCacheSlot* slot;
+	uint32_t hash;
+	int* link;
+	int index;
+
+	if (!s_cache.slots || !original || (original > BLOCKCACHE_BLOCK_MAX))
+	{
+		return;
+	}
+
+	hash = BlockCache_Hash(owner, offset);
+
+	BLOCKCACHE_LOCK();
+
+	// Another handle may have cached the block while we were decompressing it
+
+	for (index = s_cache.buckets[hash]; index >= 0; index = s_cache.slots[index].next)
+	{
+		if ((s_cache.slots[index].owner == owner) && (s_cache.slots[index].offset == offset))
+		{
+			BLOCKCACHE_UNLOCK();
+			return;
+		}
+	}
+
+	// New blocks start out unreferenced, so a block that is only streamed through once is the first to go. Every slot
+	// in use holds at least one page, so once enough pages are free there is an empty slot as well
+
+	while (s_cache.available < needed)
+	{
+		slot = &(s_cache.slots[s_cache.hand]);
+		s_cache.hand = (s_cache.hand + 1) % BLOCKCACHE_SLOTS;
+
+		if (!slot->owner)
+		{
+			continue;
+		}
+
+		if (slot->referenced)
+		{
+			slot->referenced = 0;
+			continue;
+		}
+
+		BlockCache_Evict(slot);
+	}
+
+	slot = &(s_cache.slots[s_cache.freeSlots]);
+	s_cache.freeSlots = slot->next;
+
+	slot->owner = owner;
+	slot->offset = offset;
+	slot->original = original;
+	slot->usage = usage;
+	slot->referenced = 0;
+
+	for (link = &(slot->page); copied < original; link = &(s_cache.pages[*link]))
+	{
+		uint32_t length = (original - copied) < BLOCKCACHE_PAGE_SIZE ? (original - copied) : BLOCKCACHE_PAGE_SIZE;
+
+		*link = s_cache.freePages;
+		s_cache.freePages = s_cache.pages[*link];
+		--s_cache.available;
+
+		memcpy(s_cache.data + (uint32_t)*link * BLOCKCACHE_PAGE_SIZE, ((const uint8_t*)data) + copied, length);
+		copied += length;
+	}
+	*link = -1;
+
+	slot->next = s_cache.buckets[hash];
+	s_cache.buckets[hash] = (int)(slot - s_cache.slots);
+
+	BLOCKCACHE_UNLOCK();
+}
+
+void BlockCache_Purge(const void* owner)
+{
+	uint32_t i;
+
+	if (!s_cache.slots)
+	{
+		return;
+	}
+
+	BLOCKCACHE_LOCK();
+
+	for (i = 0; i < BLOCKCACHE_SLOTS; ++i)
+	{
+		if (s_cache.slots[i].owner == owner)
+		{
+			BlockCache_Evict(&(s_cache.slots[i]));
+		}
+	}
+
+	BLOCKCACHE_UNLOCK();
+}
+
+static uint32_t BlockCache_Hash(const void* owner, uint64_t offset)
+{
+	uint64_t key = ((uint64_t)(size_t)owner) ^ (offset * 0x9e3779b97f4a7c15ull);
+
+	return (uint32_t)(key ^ (key >> 29) ^ (key >> 47)) & s_cache.mask;
+}
+
+/**
+ *
+ * Remove slot from its hash chain, returning it and its pages to the free lists
+ *
+ * \note Must be called with the cache locked
+ *
+**/
+static void BlockCache_Evict(BlockCacheSlot* slot)
+{
+	int index = (int)(slot - s_cache.slots);
+	int* link;
+
+	if (!slot->owner)
+	{
+		return;
+	}
+
+	for (link = &(s_cache.buckets[BlockCache_Hash(slot->owner, slot->offset)]); *link >= 0; link = &(s_cache.slots[*link].next))
+	{
+		if (*link == index)
+		{
+			*link = slot->next;
+			break;
+		}
+	}
+
+	while (slot->page >= 0)
+	{
+		int page = slot->page;
+
+		slot->page = s_cache.pages[page];
+		s_cache.pages[page] = s_cache.freePages;
+		s_cache.freePages = page;
+		++s_cache.available;
+	}
+
+	slot->owner = 0;
+	slot->referenced = 0;
+	slot->next = s_cache.freeSlots;
+	s_cache.freeSlots = index;
+}
@@ -0,0 +1,85 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef streamer_common_blockcache_h
+#define streamer_common_blockcache_h
+
+#include "driver.h"
+#include "../filearchive.h"
+
+#if defined(_IOP)
+#define BLOCKCACHE_SIZE (64 * 1024)
+#else
+#define BLOCKCACHE_SIZE (4 * 1024 * 1024)
+#endif
+
+#define BLOCKCACHE_PAGE_SIZE (4 * 1024)
+#define BLOCKCACHE_BLOCK_MAX (BLOCKCACHE_SIZE / 4)	// Largest block cached, so a few of them fit at once
+
+/**
+ *
+ * Reference the process wide cache of decompressed blocks, allocating it on first use
+ *
+ * \note If the cache cannot be allocated, lookups always miss and inserts are ignored
+ *
+**/
+void BlockCache_Acquire();
+
+/**
+ *
+ * Release a reference to the cache, freeing it with the last reference
+ *
+**/
+void BlockCache_Release();
+
+/**
+ *
+ * Copy a cached block into target
+ *
+ * \param owner - Archive the block belongs to
+ * \param offset - Location of block header in archive
+ * \param capacity - Room in target, nothing is copied if the block is larger
+ * \param usage - Receives the size of the block in the archive, including header
+ * \return Size of decompressed block, <0 if the block is not cached
+ *
+**/
+int BlockCache_Lookup(const void* owner, uint64_t offset, void* target, uint32_t capacity, uint32_t* usage);
+
+/**
+ *
+ * Add a decompressed block to the cache, evicting the least recently used blocks with a CLOCK sweep until there
+ * are enough BLOCKCACHE_PAGE_SIZE pages free to hold it
+ *
+ * \note Blocks larger than BLOCKCACHE_BLOCK_MAX are not cached
+ *
+**/
+void BlockCache_Insert(const void* owner, uint64_t offset, const void* data, uint32_t original, uint32_t usage);
+
+/**
+ *
+ * Drop all blocks belonging to an archive
+ *
+**/
+void BlockCache_Purge(const void* owner);
+
+#endif
@@ -0,0 +1,56 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef streamer_common_crc32c_h
+#define streamer_common_crc32c_h
+
+#include "../filearchive.h"
+
+/**
+ *
+ * Continue a CRC32C (Castagnoli) over more data
+ *
+ * Uses the CRC32 instructions of SSE 4.2 when the CPU has them (checked on first use), or of ARMv8 when the build
+ * targets them, and a table driven fallback otherwise
+ *
+ * \param crc - Result of the previous call, 0 for the first call
+ * \return CRC32C of all data so far
+ *
+**/
+uint32_t Crc32c_Update(uint32_t crc, const void* data, uint32_t length);
+
+/**
+ *
+ * Table driven Crc32c_Update(), always giving the same result
+ *
+**/
+uint32_t Crc32c_UpdateSoftware(uint32_t crc, const void* data, uint32_t length);
+
+/**
+ *
+ * \return Non-zero if Crc32c_Update() uses CRC32 instructions
+ *
+**/
+int Crc32c_Hardware();
+
+#endif
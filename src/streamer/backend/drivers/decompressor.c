@@ -0,0 +1,457 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "decompressor.h"
+#include "crc32c.h"
+#include <fastlz/fastlz.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#if defined(_IOP)
+#include "../iop/irx_imports.h"
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
+
+#if defined(STREAMER_UNIX)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+#define DECOMPRESSOR_THREADS
+#define DECOMPRESSOR_LOCK() AcquireSRWLockExclusive(&s_pool.lock)
+#define DECOMPRESSOR_UNLOCK() ReleaseSRWLockExclusive(&s_pool.lock)
+#define DECOMPRESSOR_WAIT(cond) SleepConditionVariableSRW(&(cond), &s_pool.lock, INFINITE, 0)
+#define DECOMPRESSOR_SIGNAL(cond) WakeConditionVariable(&(cond))
+#define DECOMPRESSOR_BROADCAST(cond) WakeAllConditionVariable(&(cond))
+#elif defined(STREAMER_UNIX)
+#define DECOMPRESSOR_THREADS
+#define DECOMPRESSOR_LOCK() pthread_mutex_lock(&s_pool.lock)
+#define DECOMPRESSOR_UNLOCK() pthread_mutex_unlock(&s_pool.lock)
+#define DECOMPRESSOR_WAIT(cond) pthread_cond_wait(&(cond), &s_pool.lock)
+#define DECOMPRESSOR_SIGNAL(cond) pthread_cond_signal(&(cond))
+#define DECOMPRESSOR_BROADCAST(cond) pthread_cond_broadcast(&(cond))
+#else
+#define DECOMPRESSOR_LOCK()
+#define DECOMPRESSOR_UNLOCK()
+#endif
+
+static int Decompressor_Run(DecompressorBatch* batch, DecompressorBlock* block);
+
+#if defined(DECOMPRESSOR_THREADS)
+static DecompressorBlock* Decompressor_Claim(DecompressorBatch* batch);
+static int Decompressor_CountCores();
+#if defined(_WIN32)
+static DWORD WINAPI Decompressor_Thread(LPVOID arg);
+#else
+static void* Decompressor_Thread(void* arg);
+#endif
+#endif
+
+static struct
+{
+	int references;
+	int count;			// Number of worker threads running
+	int workers;			// Number of worker threads to start, <0 for one per additional core
+	int shutdown;
+
+	DecompressorBatch* head;	// Batches with unclaimed blocks, in submission order
+	DecompressorBatch* tail;
+
+#if defined(_WIN32)
+	SRWLOCK lock;
+	CONDITION_VARIABLE work;	// Signalled when a batch is queued
+	CONDITION_VARIABLE done;	// Signalled when the last pending block of a batch completes
+	HANDLE threads[DECOMPRESSOR_MAX_THREADS];
+#elif defined(STREAMER_UNIX)
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+	pthread_t threads[DECOMPRESSOR_MAX_THREADS];
+#endif
+} s_pool =
+{
+	0, 0, -1, 0, 0, 0,
+#if defined(_WIN32)
+	SRWLOCK_INIT, CONDITION_VARIABLE_INIT, CONDITION_VARIABLE_INIT, { 0 }
+#elif defined(STREAMER_UNIX)
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, { 0 }
+#endif
+};
+
+int Decompressor_Acquire()
+{
+	int count;
+
+	DECOMPRESSOR_LOCK();
+
+	if (s_pool.references++ == 0)
+	{
+#if defined(DECOMPRESSOR_THREADS)
+		int target = s_pool.workers < 0 ? Decompressor_CountCores() - 1 : s_pool.workers;
+
+		target = target > DECOMPRESSOR_MAX_THREADS ? DECOMPRESSOR_MAX_THREADS : target;
+		s_pool.shutdown = 0;
+
+		for (s_pool.count = 0; s_pool.count < target; ++s_pool.count)
+		{
+#if defined(_WIN32)
+			s_pool.threads[s_pool.count] = CreateThread(0, 0, Decompressor_Thread, 0, 0, 0);
+			if (!s_pool.threads[s_pool.count])
+			{
+				break;
+			}
+#else
+			if (pthread_create(&(s_pool.threads[s_pool.count]), 0, Decompressor_Thread, 0))
+			{
+				break;
+			}
+#endif
+		}
+
+		STREAMER_PRINTF(("Decompressor: Started %d worker threads\n", s_pool.count));
+#endif
+	}
+
+	count = s_pool.count;
+
+	DECOMPRESSOR_UNLOCK();
+	return count;
+}
+
+void Decompressor_SetWorkers(int count)
+{
+	DECOMPRESSOR_LOCK();
+	s_pool.workers = count;
+	DECOMPRESSOR_UNLOCK();
+}
+
+void Decompressor_Release()
+{
+#if defined(DECOMPRESSOR_THREADS)
+	int i, count;
+
+	DECOMPRESSOR_LOCK();
+
+	if (--s_pool.references > 0)
+	{
+		DECOMPRESSOR_UNLOCK();
+		return;
+	}
+
+	count = s_pool.count;
+	s_pool.shutdown = 1;
+	DECOMPRESSOR_BROADCAST(s_pool.work);
+
+	DECOMPRESSOR_UNLOCK();
+
+	// Joined outside the lock, the last reference is gone so no new batches can be submitted in the meantime
+
+	for (i = 0; i < count; ++i)
+	{
+#if defined(_WIN32)
+		WaitForSingleObject(s_pool.threads[i], INFINITE);
+		CloseHandle(s_pool.threads[i]);
+#else
+		pthread_join(s_pool.threads[i], 0);
+#endif
+	}
+
+	DECOMPRESSOR_LOCK();
+	s_pool.count = 0;
+	DECOMPRESSOR_UNLOCK();
+#else
+	--s_pool.references;
+#endif
+}
+
+void Decompressor_Submit(DecompressorBatch* batch)
+{
+	batch->next = 0;
+	batch->pending = batch->count;
+	batch->failed = 0;
+	batch->link = 0;
+
+	if (!batch->count || !s_pool.count)
+	{
+		return;
+	}
+
+#if defined(DECOMPRESSOR_THREADS)
+	DECOMPRESSOR_LOCK();
+
+	if (s_pool.tail)
+	{
+		s_pool.tail->link = batch;
+	}
+	else
+	{
+		s_pool.head = batch;
+	}
+	s_pool.tail = batch;
+
+	if (batch->count > 1)
+	{
+		DECOMPRESSOR_BROADCAST(s_pool.work);
+	}
+	else
+	{
+		DECOMPRESSOR_SIGNAL(s_pool.work);
+	}
+
+	DECOMPRESSOR_UNLOCK();
+#endif
+}
+
+int Decompressor_Wait(DecompressorBatch* batch)
+{
+	DecompressorBlock* block;
+
+	if (!s_pool.count)
+	{
+		// No workers, everything is decompressed here
+
+		while (batch->next < batch->count)
+		{
+			block = &(batch->blocks[batch->next++]);
+			if (Decompressor_Run(batch, block) < 0)
+			{
+				batch->failed = 1;
+			}
+		}
+
+		batch->pending = 0;
+		return batch->failed ? -1 : 0;
+	}
+
+#if defined(DECOMPRESSOR_THREADS)
+	DECOMPRESSOR_LOCK();
+
+	// Help out with our own blocks rather than idling while the workers catch up
+
+	while ((block = Decompressor_Claim(batch)) != 0)
+	{
+		int result;
+
+		DECOMPRESSOR_UNLOCK();
+		result = Decompressor_Run(batch, block);
+		DECOMPRESSOR_LOCK();
+
+		batch->failed |= result < 0;
+		--batch->pending;
+	}
+
+	while (batch->pending > 0)
+	{
+		DECOMPRESSOR_WAIT(s_pool.done);
+	}
+
+	DECOMPRESSOR_UNLOCK();
+#endif
+
+	return batch->failed ? -1 : 0;
+}
+
+/**
+ *
+ * Decompress a single block into its target
+ *
+ * \return 0 on success, <0 if the block is invalid, fails its checksum or did not decompress to its original size
+ *
+**/
+static int Decompressor_Run(DecompressorBatch* batch, DecompressorBlock* block)
+{
+	if (batch->verify)
+	{
+		fa_block32_t header;
+
+		// The checksum covers the size fields as stored in the block header
+
+		header.original = block->original;
+		header.compressed = block->stored ? (block->size | FA_COMPRESSION_SIZE_IGNORE_32) : block->size;
+
+		if (Crc32c_Update(Crc32c_Update(0, &header, sizeof(header)), block->source, block->size) != block->checksum)
+		{
+			STREAMER_PRINTF(("Decompressor: Block checksum mismatch in \"%s\"\n", batch->path ? batch->path : ""));
+			STREAMER_STATS_ADD(batch->stats, checksumErrors, 1);
+			return -1;
+		}
+	}
+
+	if (block->stored)
+	{
+		if (block->size != block->original)
+		{
+			STREAMER_PRINTF(("Decompressor: Uncompressed block size mismatch\n"));
+			return -1;
+		}
+
+		memcpy(block->target, block->source, block->original);
+		return 0;
+	}
+
+	switch (batch->compression)
+	{
+		case FA_COMPRESSION_FASTLZ:
+		{
+			StreamerCounter start = IODriver_GetTime();
+			int result = fastlz_decompress(block->source, block->size, block->target, block->original);
+
+			StreamerCounter elapsed = IODriver_GetTime() - start;
+
+			STREAMER_STATS_ADD(batch->stats, decompressTime, elapsed);
+			STREAMER_STATS_ADD(batch->stats, bytesDecompressed, result > 0 ? result : 0);
+			Trace_Record(batch->trace, TraceEvent_Decompress, -1, start, elapsed, batch->fd, block->offset, result > 0 ? result : 0, block->size, batch->path);
+
+			if (result != (int)block->original)
+			{
+				STREAMER_PRINTF(("Decompressor: Failed to decompress fastlz block\n"));
+				return -1;
+			}
+		}
+		break;
+
+		default:
+		{
+			STREAMER_PRINTF(("Decompressor: Unsupported compression scheme\n"));
+			return -1;
+		}
+		break;
+	}
+
+	return 0;
+}
+
+#if defined(DECOMPRESSOR_THREADS)
+
+/**
+ *
+ * Claim next block of a batch, unlinking the batch from the queue once its last block has been claimed
+ *
+ * \note Must be called with the pool locked
+ *
+**/
+static DecompressorBlock* Decompressor_Claim(DecompressorBatch* batch)
+{
+	DecompressorBlock* block;
+
+	if (batch->next >= batch->count)
+	{
+		return 0;
+	}
+
+	block = &(batch->blocks[batch->next++]);
+
+	if (batch->next == batch->count)
+	{
+		DecompressorBatch* prev = 0;
+		DecompressorBatch* curr;
+
+		for (curr = s_pool.head; curr && (curr != batch); curr = curr->link)
+		{
+			prev = curr;
+		}
+
+		if (curr)
+		{
+			if (prev)
+			{
+				prev->link = curr->link;
+			}
+			else
+			{
+				s_pool.head = curr->link;
+			}
+
+			if (s_pool.tail == curr)
+			{
+				s_pool.tail = prev;
+			}
+
+			curr->link = 0;
+		}
+	}
+
+	return block;
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI Decompressor_Thread(LPVOID arg)
+#else
+static void* Decompressor_Thread(void* arg)
+#endif
+{
+	(void)arg;
+
+	DECOMPRESSOR_LOCK();
+
+	while (!s_pool.shutdown)
+	{
+		DecompressorBatch* batch = s_pool.head;
+		DecompressorBlock* block;
+		int result;
+
+		if (!batch)
+		{
+			DECOMPRESSOR_WAIT(s_pool.work);
+			continue;
+		}
+
+		block = Decompressor_Claim(batch);
+
+		DECOMPRESSOR_UNLOCK();
+		result = Decompressor_Run(batch, block);
+		DECOMPRESSOR_LOCK();
+
+		batch->failed |= result < 0;
+		if (--batch->pending == 0)
+		{
+			DECOMPRESSOR_BROADCAST(s_pool.done);
+		}
+	}
+
+	DECOMPRESSOR_UNLOCK();
+	return 0;
+}
+
+static int Decompressor_CountCores()
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+#else
+	return 1;
+#endif
+}
+
+#endif
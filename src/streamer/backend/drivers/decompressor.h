@@ -0,0 +1,108 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef streamer_common_decompressor_h
+#define streamer_common_decompressor_h
+
+#include "driver.h"
+#include "../filearchive.h"
+
+#define DECOMPRESSOR_MAX_THREADS 8
+
+typedef struct DecompressorBlock
+{
+	const uint8_t* source;		// Compressed (or stored) block data, excluding block header
+	uint8_t* target;		// Destination of decompressed block, must have room for original bytes
+	uint32_t size;			// Size of block data
+	uint32_t original;		// Size of block when decompressed
+	int stored;			// Block data is stored uncompressed
+	uint32_t checksum;		// CRC32C from the fa_block_crc_t header, checked if the batch verifies
+	StreamerCounter offset;		// Uncompressed offset of block in file (trace only)
+} DecompressorBlock;
+
+typedef struct DecompressorBatch
+{
+	DecompressorBlock* blocks;
+	unsigned int count;
+	uint32_t compression;		// Compression scheme of entry (FA_COMPRESSION_*)
+	int verify;			// Check the checksum of each block before decompressing it
+
+	StreamerStats* stats;		// Counters updated by the workers, may be NULL
+	StreamerTrace* trace;		// Timeline events recorded by the workers, may be NULL
+	const char* path;		// Path of entry (trace only)
+	int fd;				// Handle of entry (trace only)
+
+	// Owned by the decompressor while submitted
+
+	unsigned int next;		// Next block to claim
+	unsigned int pending;		// Blocks not yet finished
+	int failed;
+	struct DecompressorBatch* link;
+} DecompressorBatch;
+
+/**
+ *
+ * Reference the shared decompression pool, starting the worker threads on first use
+ *
+ * \note One worker is started for each additional core, targets without threads decompress inline in Decompressor_Wait()
+ *
+ * \return Number of worker threads in pool
+ *
+**/
+int Decompressor_Acquire();
+
+/**
+ *
+ * Override the number of worker threads, taking effect the next time the pool is started
+ *
+ * \note Counts above DECOMPRESSOR_MAX_THREADS are clamped, <0 restores one worker per additional core
+ *
+**/
+void Decompressor_SetWorkers(int count);
+
+/**
+ *
+ * Release a reference to the pool, stopping the worker threads with the last reference
+ *
+**/
+void Decompressor_Release();
+
+/**
+ *
+ * Queue the blocks of a batch for decompression
+ *
+ * Blocks are independent and may complete in any order, the batch must stay untouched until Decompressor_Wait() has returned
+ *
+**/
+void Decompressor_Submit(DecompressorBatch* batch);
+
+/**
+ *
+ * Wait for all blocks in a batch to complete, decompressing unclaimed blocks on the calling thread
+ *
+ * \return 0 if all blocks were decompressed to their original size (and matched their checksums), <0 otherwise
+ *
+**/
+int Decompressor_Wait(DecompressorBatch* batch);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "driver.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#if defined(_IOP)
+#include "../iop/irx_imports.h"
+#else
+#include <stdio.h>
+#endif
+
+#if defined(STREAMER_UNIX)
+#include <time.h>
+#endif
+
+#define IODRIVER_LIST_PACKET_SIZE (128 * 1024)
+
+StreamerCounter IODriver_GetTime()
+{
+#if defined(_WIN32)
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+
+	if (!frequency.QuadPart)
+	{
+		QueryPerformanceFrequency(&frequency);
+	}
+
+	QueryPerformanceCounter(&counter);
+	return (StreamerCounter)((counter.QuadPart / frequency.QuadPart) * 1000000 + ((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart);
+#elif defined(_IOP)
+	iop_sys_clock_t clock;
+	u32 seconds, microseconds;
+
+	GetSystemTime(&clock);
+	SysClock2USec(&clock, &seconds, &microseconds);
+
+	return ((StreamerCounter)seconds) * 1000000 + microseconds;
+#elif defined(STREAMER_UNIX)
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((StreamerCounter)now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#else
+	return 0;
+#endif
+}
+
+int IODriver_LoadList(IODriver* driver, IOListState* state)
+{
+	StreamerLoadRequest* request;
+	int packet, result;
+
+	if (state->cursor == state->count)
+	{
+		return 0;
+	}
+
+	request = &(state->requests[state->items[state->cursor].index]);
+
+	if (state->fd < 0)
+	{
+		state->fd = driver->open(driver, request->filename, StreamerOpenMode_Read);
+		state->progress = 0;
+
+		if (state->fd < 0)
+		{
+			STREAMER_PRINTF(("IODriver: Failed opening \"%s\" for list load\n", request->filename));
+
+			request->result = StreamerResult_Error;
+			++state->cursor;
+			return state->cursor < state->count;
+		}
+	}
+
+	packet = request->length - state->progress;
+	packet = packet > IODRIVER_LIST_PACKET_SIZE ? IODRIVER_LIST_PACKET_SIZE : packet;
+
+	if (packet > 0)
+	{
+		result = driver->read(driver, state->fd, ((char*)request->buffer) + state->progress, packet);
+	}
+	else
+	{
+		char overflow;
+
+		// Buffer is full, make sure that we actually reached the end of the file
+
+		result = driver->read(driver, state->fd, &overflow, sizeof(overflow));
+		if (result > 0)
+		{
+			STREAMER_PRINTF(("IODriver: Buffer too small when loading \"%s\"\n", request->filename));
+			result = StreamerResult_Error;
+		}
+	}
+
+	if (result < 0)
+	{
+		request->result = StreamerResult_Error;
+	}
+	else
+	{
+		state->progress += result;
+
+		if ((packet > 0) && (result == packet))
+		{
+			return 1;
+		}
+
+		request->result = state->progress;
+		++state->loaded;
+	}
+
+	driver->close(driver, state->fd);
+	state->fd = -1;
+
+	++state->cursor;
+	return state->cursor < state->count;
+}
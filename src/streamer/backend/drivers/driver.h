@@ -25,6 +25,27 @@ SOFTWARE.
 #define streamer_common_driver_h
 
 #include "../../io.h"
+#include "trace.h"
+
+typedef struct IOListItem
+{
+	unsigned int index;		// Index of request in list
+	const void* data;		// Driver specific data associated with the request
+} IOListItem;
+
+typedef struct IOListState
+{
+	StreamerLoadRequest* requests;
+	unsigned int count;
+
+	IOListItem* items;		// Load order, can be rearranged by the driver
+	unsigned int cursor;		// Current item in load order
+	unsigned int progress;		// Driver specific progress within current item
+	int fd;				// Driver specific handle for current item
+	unsigned int loaded;		// Number of files loaded successfully
+	int prepared;			// Set by the driver when the list has been prepared
+	void* data;			// Driver specific data associated with the list, must be released by the driver when done
+} IOListState;
 
 typedef struct IODriver
 {
@@ -33,19 +54,66 @@ typedef struct IODriver
 	int (*open)(struct IODriver* driver, const char* filename, StreamerOpenMode mode);
 	int (*close)(struct IODriver* driver, int fd);
 	int (*read)(struct IODriver* driver, int fd, void* buffer, unsigned int length);
-	int (*lseek)(struct IODriver* driver, int fd, int offset, StreamerSeekMode whence);
+	StreamerOffset (*lseek)(struct IODriver* driver, int fd, StreamerOffset offset, StreamerSeekMode whence);
+	int (*pread)(struct IODriver* driver, int fd, void* buffer, unsigned int length, StreamerOffset offset);	// Read at offset, leaves the file position undefined; may be NULL
+	void* (*map)(struct IODriver* driver, int fd, StreamerOffset offset, unsigned int length);	// Map part of a file read-only, NULL on failure; may be NULL
+	void (*unmap)(struct IODriver* driver, void* data, unsigned int length);	// Release a view returned by map
 
 	int (*dopen)(struct IODriver* driver, const char* pathname);
 	int (*dclose)(struct IODriver* driver, int fd);
-	int (*dread)(struct IODriver* driver, int fd, const char* buffer, unsigned int length);
+	int (*dread)(struct IODriver* driver, int fd, StreamerDirEntry* entries, unsigned int count);	// Returns number of entries read, 0 at end of directory
 
 	int (*align)(struct IODriver* driver);
+
+	int (*stat)(struct IODriver* driver, const char* filename, StreamerStat* info);
+
+	int (*loadlist)(struct IODriver* driver, IOListState* state);	// Returns >0 while there is more work to do, 0 when done, <0 on failure
+
+	StreamerStats* stats;		// Counters updated by the driver, may be NULL
+	StreamerTrace* trace;		// Timeline events recorded by the driver, may be NULL
 } IODriver;
 
 #if defined(_MSC_VER)
 #pragma warning(disable: 4100 4127)
 #endif
 
+/**
+ *
+ * Relaxed atomic counter updates, cheap enough to be left enabled in release builds
+ *
+ * Targets without 64-bit atomics (IOP) use plain updates, counters may then occasionally lose an update
+ *
+**/
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#define STREAMER_ATOMIC_ADD(target, value) _InterlockedExchangeAdd64((volatile __int64*)&(target), (__int64)(value))
+#define STREAMER_ATOMIC_LOAD(target) (target)
+#elif defined(__GNUC__) && !defined(_IOP) && !defined(_EE) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 7)))
+#define STREAMER_ATOMIC_ADD(target, value) __atomic_fetch_add(&(target), (value), __ATOMIC_RELAXED)
+#define STREAMER_ATOMIC_LOAD(target) __atomic_load_n(&(target), __ATOMIC_RELAXED)
+#else
+#define STREAMER_ATOMIC_ADD(target, value) ((target) += (value))
+#define STREAMER_ATOMIC_LOAD(target) (target)
+#endif
+
+#define STREAMER_STATS_ADD(stats, field, value) do { if (stats) { STREAMER_ATOMIC_ADD((stats)->field, (value)); } } while (0)
+
+/**
+ *
+ * Monotonic time in microseconds, used for timing driver calls
+ *
+**/
+StreamerCounter IODriver_GetTime();
+
+/**
+ *
+ * Generic list load, loading each file in list order through open/read/close
+ *
+ * Used for drivers that do not implement loadlist, and by drivers that forward lists to other drivers
+ *
+**/
+int IODriver_LoadList(IODriver* driver, IOListState* state);
+
 #if !defined(STREAMER_FINAL)
 #if defined(STREAMER_WIN32)
 extern void streamer_dprintf(const char* fmt, ...);
@@ -24,6 +24,7 @@ SOFTWARE.
 #define _CRT_SECURE_NO_WARNINGS
 
 #include "filearchive.h"
+#include "crc32c.h"
 #include <fastlz/fastlz.h>
 
 
@@ -38,20 +39,81 @@ SOFTWARE.
 
 #define FILEARCHIVE_CACHE_SIZE (128 * 1024)
 #define FILEARCHIVE_BUFFER_SIZE (16 * 1024)
+#define FILEARCHIVE_LIST_GAP (16 * 1024)
+#define FILEARCHIVE_HASH_SEED (2166136261u)
+#define FILEARCHIVE_PIPELINE_SIZE (512 * 1024)
+#define FILEARCHIVE_PIPELINE_MIN (64 * 1024)
+#define FILEARCHIVE_WINDOW_MIN (48 * 1024)	// Must fit the largest block of version 1 and 2 archives
+#define FILEARCHIVE_INDEX_LOOKUPS (64)		// Lookups made before a lazily touched TOC is indexed
+
+#if defined(_IOP)
+#define FILEARCHIVE_WINDOW_BUDGET(window) (96 * 1024)
+#else
+#define FILEARCHIVE_WINDOW_BUDGET(window) (FILEARCHIVE_MAX_HANDLES * (window))
+#endif
+
+static const unsigned int s_sortGaps[] = { 1035871, 460387, 204617, 90941, 40412, 17961, 7983, 3548, 1577, 701, 301, 132, 57, 23, 10, 4, 1 };
 
 static void FileArchive_Destroy(struct IODriver* driver);
 static int FileArchive_Open(struct IODriver* driver, const char* filename, StreamerOpenMode mode);
 static int FileArchive_Close(struct IODriver* driver, int fd);
 static int FileArchive_Read(struct IODriver* driver, int fd, void* buffer, unsigned int length);
-static int FileArchive_LSeek(struct IODriver* driver, int fd, int offset, StreamerSeekMode whence);
+static StreamerOffset FileArchive_LSeek(struct IODriver* driver, int fd, StreamerOffset offset, StreamerSeekMode whence);
+static int FileArchive_LoadList(struct IODriver* driver, IOListState* state);
+static int FileArchive_LoadStored(FileArchiveDriver* driver, IOListState* state, const fa_entry_t* file, StreamerLoadRequest* request);
+static int FileArchive_LoadCompressed(FileArchiveDriver* driver, IOListState* state, const fa_entry_t* file, StreamerLoadRequest* request);
+
+static int FileArchive_Stat(struct IODriver* driver, const char* filename, StreamerStat* info);
 
+static int FileArchive_DOpen(struct IODriver* driver, const char* pathname);
+static int FileArchive_DClose(struct IODriver* driver, int fd);
+static int FileArchive_DRead(struct IODriver* driver, int fd, StreamerDirEntry* entries, unsigned int count);
+
+static const fa_entry_t* FileArchive_Find(FileArchiveDriver* driver, const char* filename);
+static const fa_container_t* FileArchive_FindContainer(FileArchiveDriver* driver, const char* begin, const char* end);
 static const fa_entry_t* FileArchive_FindByName(FileArchiveDriver* driver, const char* filename);
+static const fa_entry_t* FileArchive_FindInTree(FileArchiveDriver* driver, const char* filename);
 static const fa_entry_t* FileArchive_FindByHash(FileArchiveDriver* driver, const fa_hash_t* hash);
 
-static int FileArchive_LoadTOC(FileArchiveDriver* driver);
-static uint32_t FileArchive_LocateFooter(FileArchiveDriver* driver);
+static uint64_t FileArchive_Data(FileArchiveDriver* driver, const fa_entry_t* file);
+static uint64_t FileArchive_Original(FileArchiveDriver* driver, const fa_entry_t* file);
+static uint64_t FileArchive_Compressed(FileArchiveDriver* driver, const fa_entry_t* file);
+static uint32_t FileArchive_BlockSize(FileArchiveDriver* driver, const fa_entry_t* file);
+static int FileArchive_LargestBlock(FileArchiveDriver* driver);
+static void FileArchive_ParseBlock(FileArchiveDriver* driver, const uint8_t* source, FileArchiveBlock* block);
+static int FileArchive_VerifyBlock(FileArchiveDriver* driver, const uint8_t* source, const FileArchiveBlock* block);
+static int FileArchive_ReadNative(FileArchiveDriver* driver, uint64_t offset, void* buffer, uint32_t length);
 
-static int FileArchive_FillCache(FileArchiveDriver* driver, FileArchiveHandle* handle, const fa_entry_t* file, int minFill);
+static int FileArchive_LoadTOC(FileArchiveDriver* driver);
+static int FileArchive_ReadTOC(FileArchiveDriver* driver, const fa_footer64_t* footer, uint64_t offset);
+static int FileArchive_LoadPages(FileArchiveDriver* driver, uint64_t position, uint32_t length);
+static int FileArchive_LoadPage(FileArchiveDriver* driver, uint32_t page);
+static void FileArchive_FreePages(FileArchiveDriver* driver);
+static const void* FileArchive_Toc(FileArchiveDriver* driver, uint32_t offset, uint32_t length);
+static const char* FileArchive_TocName(FileArchiveDriver* driver, fa_offset_t offset);
+static int FileArchive_Touch(FileArchiveDriver* driver, const fa_entry_t* entry);
+static int FileArchive_BuildIndex(FileArchiveDriver* driver);
+static void FileArchive_CountLookup(FileArchiveDriver* driver);
+static void FileArchive_SortHashes(FileArchiveDriver* driver);
+static int FileArchive_MatchPath(FileArchiveDriver* driver, const fa_entry_t* file, const char* begin, const char* end);
+static uint32_t FileArchive_Hash(uint32_t hash, const char* begin, const char* end);
+static int FileArchive_LocateFooter(FileArchiveDriver* driver, uint64_t* location);
+
+static int FileArchive_LoadBlock(FileArchiveDriver* driver, int fd, uint8_t* target, uint32_t capacity);
+static int FileArchive_SeekBlock(FileArchiveDriver* driver, int fd, uint64_t offset);
+static int FileArchive_BuildBlocks(FileArchiveDriver* driver, int fd);
+static void FileArchive_FreeBlocks(FileArchiveHandle* handle);
+static int FileArchive_ResizeBuffer(FileArchiveDriver* driver, int fd, uint32_t size);
+static void FileArchive_OpenWindow(FileArchiveDriver* driver, FileArchiveHandle* handle);
+static void FileArchive_CloseWindow(FileArchiveDriver* driver, FileArchiveHandle* handle);
+static void FileArchive_ClaimWindow(FileArchiveDriver* driver, int fd);
+static int FileArchive_FillWindow(FileArchiveDriver* driver, FileArchiveHandle* handle, const fa_entry_t* file, int minFill);
+static int FileArchive_ReadPipelined(FileArchiveDriver* driver, int fd, uint8_t* buffer, unsigned int length);
+static void FileArchive_BeginBatch(FileArchiveDriver* driver, const fa_entry_t* file, int fd, const char* path);
+static int FileArchive_QueueBlock(FileArchiveDriver* driver, uint64_t position, const uint8_t* source, const FileArchiveBlock* block, uint8_t* target, StreamerCounter offset);
+static int FileArchive_FinishBatch(FileArchiveDriver* driver);
+static int FileArchive_FillListCache(FileArchiveDriver* driver, IOListState* state, uint64_t position);
+static void FileArchive_SortList(FileArchiveDriver* driver, IOListItem* items, unsigned int count);
 
 IODriver* FileArchive_Create(IODriver* native, const char* file)
 {
@@ -65,12 +127,18 @@ IODriver* FileArchive_Create(IODriver* native, const char* file)
 	buffer += sizeof(FileArchiveDriver);
 
 	memset(driver, 0, sizeof(FileArchiveDriver));
+	driver->cache.size = FILEARCHIVE_CACHE_SIZE;
 
 	driver->interface.destroy = FileArchive_Destroy;
 	driver->interface.open = FileArchive_Open;
 	driver->interface.close = FileArchive_Close;
 	driver->interface.read = FileArchive_Read;
 	driver->interface.lseek = FileArchive_LSeek;
+	driver->interface.stat = FileArchive_Stat;
+	driver->interface.dopen = FileArchive_DOpen;
+	driver->interface.dclose = FileArchive_DClose;
+	driver->interface.dread = FileArchive_DRead;
+	driver->interface.loadlist = FileArchive_LoadList;
 
 	if (native->align && native->align(native) > 0)
 	{
@@ -91,6 +159,7 @@ IODriver* FileArchive_Create(IODriver* native, const char* file)
 	for (i = 0; i < FILEARCHIVE_MAX_HANDLES; ++i)
 	{
 		driver->handles[i].buffer.data = buffer;
+		driver->handles[i].buffer.size = FILEARCHIVE_BUFFER_SIZE;
 		buffer += FILEARCHIVE_BUFFER_SIZE;
 	}
 	driver->cache.data = buffer;
@@ -102,24 +171,114 @@ IODriver* FileArchive_Create(IODriver* native, const char* file)
 		return 0;
 	}
 
+	// Handles without a window of their own, and list loads, need at least one whole block in the shared cache
+
+	if (driver->header + driver->blockSize > FILEARCHIVE_CACHE_SIZE)
+	{
+		uint32_t size = driver->header + driver->blockSize;
+
+#if defined(_IOP)
+		buffer = AllocSysMemory(ALLOC_FIRST, size, 0);
+#else
+		buffer = malloc(size);
+#endif
+		if (!buffer)
+		{
+			STREAMER_PRINTF(("FileArchive: Could not allocate %u byte cache for large blocks\n", size));
+			FileArchive_Destroy(&(driver->interface));
+			return 0;
+		}
+
+		driver->cache.data = buffer;
+		driver->cache.size = size;
+	}
+
+	driver->decompress.threads = Decompressor_Acquire();
+	driver->decompress.acquired = 1;
+	BlockCache_Acquire();
+
 	STREAMER_PRINTF(("FileArchive: Driver created\n"));
 
 	driver->cache.owner = -1;
 	return &(driver->interface);
 }
 
+void FileArchive_SetVerify(IODriver* driver, int verify)
+{
+	FileArchiveDriver* local = (FileArchiveDriver*)driver;
+
+	local->verify = verify && (local->header == sizeof(fa_block_crc_t));
+}
+
+int FileArchive_Hashes(IODriver* driver, const fa_hash_t** hashes)
+{
+	FileArchiveDriver* local = (FileArchiveDriver*)driver;
+
+	*hashes = NULL;
+
+	if (!local->toc || !local->toc->entries.count)
+	{
+		return local->toc ? 0 : -1;
+	}
+
+	*hashes = (const fa_hash_t*)FileArchive_Toc(local, local->toc->hashes, local->toc->entries.count * sizeof(fa_hash_t));
+	return *hashes ? (int)local->toc->entries.count : -1;
+}
+
 static void FileArchive_Destroy(struct IODriver* driver)
 {
 	FileArchiveDriver* local = (FileArchiveDriver*)driver;
+	int i;
+
+	if (local->mapped)
+	{
+		local->native.driver->unmap(local->native.driver, local->toc, local->pages.total);
+		local->toc = NULL;
+	}
+
+	FileArchive_FreePages(local);
 
 	if (local->native.driver && (local->native.fd >= 0))
 	{
 		local->native.driver->close(local->native.driver, local->native.fd);
 	}
 
+	if (local->decompress.acquired)
+	{
+		BlockCache_Purge(local);
+		BlockCache_Release();
+		Decompressor_Release();
+	}
+
+	for (i = 0; i < FILEARCHIVE_MAX_HANDLES; ++i)
+	{
+		FileArchive_CloseWindow(local, &(local->handles[i]));
+		FileArchive_FreeBlocks(&(local->handles[i]));
+		FileArchive_ResizeBuffer(local, i, 0);
+	}
+
 #if defined(_IOP)
+	if (local->cache.size > FILEARCHIVE_CACHE_SIZE)
+	{
+		FreeSysMemory(local->cache.data);
+	}
+	if (local->index.table)
+	{
+		FreeSysMemory(local->index.table);
+	}
+	if (local->toc)
+	{
+		FreeSysMemory(local->toc);
+	}
 	FreeSysMemory(driver);
 #else
+	if (local->cache.size > FILEARCHIVE_CACHE_SIZE)
+	{
+		free(local->cache.data);
+	}
+	free(local->decompress.stage);
+	free(local->index.table);
+	free(local->toc);
 	free(driver);
 #endif
 
@@ -146,49 +305,7 @@ static int FileArchive_Open(struct IODriver* driver, const char* filename, Strea
 		return -1;
 	}
 
-	if (*filename == '@')
-	{
-		fa_hash_t hash;
-		const char* begin = filename + 1;
-
-		memset(&hash, 0, sizeof(hash));
-		for (i = 0; (i < sizeof(hash.data) * 2) && *begin; ++i, ++begin)
-		{
-			uint8_t value;
-
-			if ((*begin >= '0') && (*begin <= '9'))
-			{
-				value = *begin - '0';
-			}
-			else if ((*begin >= 'A') && (*begin <= 'F'))
-			{
-				value = 10 + (*begin - 'A');
-			}
-			else if ((*begin >= 'a') && (*begin <= 'f'))
-			{
-				value = 10 + (*begin - 'a');
-			}
-			else
-			{
-				break;
-			}
-
-			hash.data[i >> 1] |= (value << (((i & 1)^1) * 4));
-		}
-
-		if (i != sizeof(hash.data) * 2)
-		{
-			STREAMER_PRINTF(("FileArchive: Invalid hash length (%d != %d)\n", i, (int)sizeof(hash.data) * 2));
-			return -1;
-		}
-
-		entry = FileArchive_FindByHash(local, &hash);
-	}
-	else
-	{
-		entry = FileArchive_FindByName(local, filename);
-	}
-
+	entry = FileArchive_Find(local, filename);
 	if (entry == NULL)
 	{
 		return -1;
@@ -211,6 +328,17 @@ static int FileArchive_Open(struct IODriver* driver, const char* filename, Strea
 		handle->buffer.offset = 0;
 		handle->buffer.fill = 0;
 
+		if (entry->compression != FA_COMPRESSION_NONE)
+		{
+			if (FileArchive_ResizeBuffer(local, i, FileArchive_BlockSize(local, entry)) < 0)
+			{
+				handle->file = 0;
+				return -1;
+			}
+
+			FileArchive_OpenWindow(local, handle);
+		}
+
 		return i;
 	}
 
@@ -241,6 +369,10 @@ static int FileArchive_Close(struct IODriver* driver, int fd)
 		local->cache.owner = -1;
 	}
 
+	FileArchive_CloseWindow(local, &(local->handles[fd]));
+	FileArchive_FreeBlocks(&(local->handles[fd]));
+	FileArchive_ResizeBuffer(local, fd, 0);
+
 	local->handles[fd].file = 0;
 	return 0;
 }
@@ -250,6 +382,7 @@ static int FileArchive_Read(struct IODriver* driver, int fd, void* buffer, unsig
 	FileArchiveDriver* local = (FileArchiveDriver*)driver;
 	FileArchiveHandle* handle;
 	const fa_entry_t* file;
+	uint64_t size;
 	int compression;
 
 	if ((fd < 0) || (fd >= FILEARCHIVE_MAX_HANDLES))
@@ -266,20 +399,15 @@ static int FileArchive_Read(struct IODriver* driver, int fd, void* buffer, unsig
 		return -1;
 	}
 
+	size = FileArchive_Original(local, file);
+
 	compression = handle->file->compression;
 	if (compression == FA_COMPRESSION_NONE)
 	{
-		int maxRead = (file->size.original - handle->offset.original) < length ? (file->size.original - handle->offset.original) : length;
+		int maxRead = (size - handle->offset.original) < length ? (int)(size - handle->offset.original) : (int)length;
 		int result;
 
-		result = local->native.driver->lseek(local->native.driver, local->native.fd, local->base + file->data + handle->offset.original, StreamerSeekMode_Set);
-		if (result < 0)
-		{
-			STREAMER_PRINTF(("FileArchive: Failed seeking to uncompressed location (%d)\n", result));
-			return result;
-		}
-
-		result = local->native.driver->read(local->native.driver, local->native.fd, buffer, maxRead);
+		result = FileArchive_ReadNative(local, local->base + FileArchive_Data(local, file) + handle->offset.original, buffer, maxRead);
 		if (result != maxRead)
 		{
 			STREAMER_PRINTF(("FileArchive: Failed reading %d uncompressed bytes from archive (%d)\n", maxRead, result));
@@ -293,83 +421,45 @@ static int FileArchive_Read(struct IODriver* driver, int fd, void* buffer, unsig
 	{
 		int actual = 0;
 
-		if (local->cache.owner != fd)
+		FileArchive_ClaimWindow(local, fd);
+
+		length = length < (size - handle->offset.original) ? length : (unsigned int)(size - handle->offset.original);
+
+		if ((local->decompress.threads > 0) && (length >= FILEARCHIVE_PIPELINE_MIN) && (handle->buffer.fill == handle->buffer.offset))
 		{
-			local->cache.offset = 0;
-			local->cache.fill = 0;
-			local->cache.owner = fd;
+			actual = FileArchive_ReadPipelined(local, fd, buffer, length);
+			if (actual < 0)
+			{
+				return -1;
+			}
+
+			buffer = ((char*)buffer) + actual;
+			length -= actual;
 		}
 
-		length = length < (unsigned int)(file->size.original - handle->offset.original) ? length : (file->size.original - handle->offset.original);
 		while (length > 0)
 		{
 			int maxRead, bufferRead;
 
 			if (handle->buffer.fill == handle->buffer.offset)
 			{
-				fa_block_t block;
-				uint32_t cacheUsage;
-
-				if (FileArchive_FillCache(local, handle, file, sizeof(fa_block_t)) < 0)
-				{
-					STREAMER_PRINTF(("FileArchive: Error while filling compression cache\n"));
-					return -1;
-				}
+				// Blocks that are wanted in full skip the handle buffer
 
-				memcpy(&block, local->cache.data + local->cache.offset, sizeof(fa_block_t));
-
-				if (block.original > FILEARCHIVE_BUFFER_SIZE)
-				{
-					STREAMER_PRINTF(("FileArchive: Decompressed block too large (max: %d, was: %d)\n", FILEARCHIVE_BUFFER_SIZE, block.original));
-					return -1;
-				}
-
-				if (FileArchive_FillCache(local, handle, file, sizeof(fa_block_t) + (block.compressed & ~FA_COMPRESSION_SIZE_IGNORE)) < 0)
+				int direct = FileArchive_LoadBlock(local, fd, buffer, length);
+				if (direct < 0)
 				{
-					STREAMER_PRINTF(("FileArchive: Error while filling compression cache\n"));
 					return -1;
 				}
 
-				if (block.compressed & FA_COMPRESSION_SIZE_IGNORE)
-				{
-					if ((block.compressed & ~FA_COMPRESSION_SIZE_IGNORE) != block.original)
-					{
-						STREAMER_PRINTF(("FileArchive: Uncompressed block size mismatch\n"));
-						return -1;
-					}
-
-					memcpy(handle->buffer.data, local->cache.data + local->cache.offset + sizeof(fa_block_t), block.original);
-				}
-				else
+				if (direct > 0)
 				{
-					switch (compression)
-					{
-						case FA_COMPRESSION_FASTLZ:
-						{
-							int result = fastlz_decompress(local->cache.data + local->cache.offset + sizeof(fa_block_t), block.compressed, handle->buffer.data, FILEARCHIVE_BUFFER_SIZE);
-							if (result != block.original)
-							{
-								STREAMER_PRINTF(("FileArchive: Failed to decompress fastlz block\n"));
-								return -1;
-							}
-						}
-						break;
+					buffer = ((char*)buffer) + direct;
+					length -= direct;
+					actual += direct;
 
-						default:
-						{
-							STREAMER_PRINTF(("FileArchive: Unsupported compression scheme\n"));
-							return -1;
-						}
-						break;
-					}
+					handle->offset.original += direct;
+					continue;
 				}
-
-				cacheUsage = (block.compressed & ~FA_COMPRESSION_SIZE_IGNORE) + sizeof(fa_block_t);
-				handle->offset.compressed += cacheUsage;
-				local->cache.offset += cacheUsage;
-
-				handle->buffer.offset = 0;
-				handle->buffer.fill = block.original;
 			}
 
 			bufferRead = handle->buffer.fill - handle->buffer.offset;
@@ -394,14 +484,14 @@ static int FileArchive_Read(struct IODriver* driver, int fd, void* buffer, unsig
 	}
 }
 
-static int FileArchive_LSeek(struct IODriver* driver, int fd, int offset, StreamerSeekMode whence)
+static StreamerOffset FileArchive_LSeek(struct IODriver* driver, int fd, StreamerOffset offset, StreamerSeekMode whence)
 {
 	FileArchiveDriver* local = (FileArchiveDriver*)driver;
 	FileArchiveHandle* handle;
 	const fa_entry_t* file;
-	int newOffset = 0;
+	StreamerOffset newOffset = 0, size;
 
-	STREAMER_PRINTF(("FileArchive: lseek(%d, %d, %d)\n", fd, offset, whence));
+	STREAMER_PRINTF(("FileArchive: lseek(%d, %ld, %d)\n", fd, (long)offset, whence));
 
 	if ((fd < 0) || (fd >= FILEARCHIVE_MAX_HANDLES))
 	{
@@ -417,16 +507,18 @@ static int FileArchive_LSeek(struct IODriver* driver, int fd, int offset, Stream
 		return -1;
 	}
 
+	size = (StreamerOffset)FileArchive_Original(local, file);
+
 	if (file->compression == FA_COMPRESSION_NONE)
 	{
 		switch (whence)
 		{
 			case StreamerSeekMode_Set: newOffset = offset; break;
-			case StreamerSeekMode_Current: newOffset = handle->offset.original + offset; break;
-			case StreamerSeekMode_End: newOffset = file->size.original + offset; break;
+			case StreamerSeekMode_Current: newOffset = (StreamerOffset)handle->offset.original + offset; break;
+			case StreamerSeekMode_End: newOffset = size + offset; break;
 		}
 
-		if ((newOffset < 0) || (newOffset > (int)file->size.original))
+		if ((newOffset < 0) || (newOffset > size))
 		{
 			STREAMER_PRINTF(("FileArchive: Seeking out of bounds\n"));
 			return -1;
@@ -436,414 +528,2402 @@ static int FileArchive_LSeek(struct IODriver* driver, int fd, int offset, Stream
 	}
 	else
 	{
-		// TODO: since compression is block-based, we can do seeking (although it'll be somewhat expensive) - investigate
-
-		if (offset != 0)
+		switch (whence)
 		{
-			STREAMER_PRINTF(("FileArchive: Can only seek to beginning or end of compressed files\n"));
-			return -1;
+			case StreamerSeekMode_Set: newOffset = offset; break;
+			case StreamerSeekMode_Current: newOffset = (StreamerOffset)handle->offset.original + offset; break;
+			case StreamerSeekMode_End: newOffset = size + offset; break;
 		}
 
-		if (fd == local->cache.owner)
+		if ((newOffset < 0) || (newOffset > size))
 		{
-			local->cache.owner = -1;
+			STREAMER_PRINTF(("FileArchive: Seeking out of bounds\n"));
+			return -1;
 		}
 
-		switch (whence)
+		if (FileArchive_SeekBlock(local, fd, (uint64_t)newOffset) < 0)
 		{
-			case StreamerSeekMode_Set:
-			{
-				handle->offset.original = 0;
-				handle->offset.compressed = 0;
-			}
-			break;
-
-			case StreamerSeekMode_Current:
-			{
-				STREAMER_PRINTF(("FileArchive: Cannot seek within compressed files\n"));
-				return -1;
-			}
-			break;
-
-			case StreamerSeekMode_End:
-			{
-				handle->offset.original = file->size.original;
-				handle->offset.compressed = file->size.compressed;
-			}
-			break;
+			STREAMER_PRINTF(("FileArchive: Failed seeking in compressed file\n"));
+			return -1;
 		}
-
-		handle->buffer.offset = 0;
-		handle->buffer.fill = 0;
 	}
 
-	return handle->offset.original;
+	return (StreamerOffset)handle->offset.original;
 }
 
-static const fa_entry_t* FileArchive_FindByName(FileArchiveDriver* driver, const char* filename)
+static int FileArchive_Stat(struct IODriver* driver, const char* filename, StreamerStat* info)
 {
-	const fa_container_t* container;
+	FileArchiveDriver* local = (FileArchiveDriver*)driver;
 	const fa_entry_t* entry;
-	const char* begin = filename;
-	const char* end = begin + strlen(filename);
-	unsigned int i, n;
+	const fa_hash_t* hashes;
 
-	container = (const fa_container_t*)(((const char*)driver->toc) + driver->toc->containers.offset);
-	do
+	if (local->toc == NULL)
 	{
-		uint32_t offset;
-		const char* curr = begin;
-		while ((curr != end) && (*curr != '/'))
-		{
-			++curr;
-		}
+		STREAMER_PRINTF(("FileArchive: Archive TOC not available\n"));
+		return -1;
+	}
 
-		if (curr == end)
-		{
-			break;
-		}
+	entry = FileArchive_Find(local, filename);
+	if (entry == NULL)
+	{
+		return -1;
+	}
 
-		for (offset = container->children; offset != FA_INVALID_OFFSET; offset = container->next)		
-		{
-			const char* name;
+	hashes = (const fa_hash_t*)(((const uint8_t*)(local->toc)) + local->toc->hashes);
 
-			container = (const fa_container_t*)(((const char*)driver->toc) + offset);
-			name = container->name != FA_INVALID_OFFSET ? ((const char*)driver->toc) + container->name : "";
+	info->size = FileArchive_Original(local, entry);
+	info->compressedSize = FileArchive_Compressed(local, entry);
+	info->compression = entry->compression;
 
-			if (strlen(name) != (size_t)(curr-begin))
-			{
-				continue;
-			}
+	memcpy(info->hash, hashes[entry - local->files].data, sizeof(info->hash));
+	info->flags |= StreamerStatFlag_Hash;
 
-			if (!memcmp(name, begin, (curr-begin)))
-			{
-				break;
-			}
-		}
+	return 0;
+}
 
-		if (offset == FA_INVALID_OFFSET)
-		{
-			STREAMER_PRINTF(("FileArchive: Could not locate container for '%s'\n", filename));
-			return NULL;
-		}
+static int FileArchive_DOpen(struct IODriver* driver, const char* pathname)
+{
+	FileArchiveDriver* local = (FileArchiveDriver*)driver;
+	const fa_container_t* container;
+	int i;
 
-		begin = curr + 1;
+	STREAMER_PRINTF(("FileArchive: dopen(\"%s\")\n", pathname));
+
+	if (local->toc == NULL)
+	{
+		STREAMER_PRINTF(("FileArchive: Archive TOC not available\n"));
+		return -1;
 	}
-	while (1);
 
-	if (begin == end)
+	container = FileArchive_FindContainer(local, pathname, pathname + strlen(pathname));
+	if (!container)
 	{
-		STREAMER_PRINTF(("FileArchive: Invalid filename when opening '%s'\n", filename));
-		return NULL;
+		STREAMER_PRINTF(("FileArchive: Could not locate container '%s'\n", pathname));
+		return -1;
 	}
 
-	entry = (const fa_entry_t*)(((const char*)driver->toc) + container->entries.offset);
-	for (i = 0, n = container->entries.count; i < n; ++i, ++entry)
+	for (i = 0; i < FILEARCHIVE_MAX_HANDLES; ++i)
 	{
-		const char* name = entry->name != FA_INVALID_OFFSET ? ((const char*)driver->toc) + entry->name : "";
-		if (strlen(name) != (size_t)(end - begin))
+		FileArchiveDirectory* directory = &(local->directories[i]);
+
+		if (directory->container)
 		{
 			continue;
 		}
 
-		if (!memcmp(name, begin, end-begin))
-		{
-			break;
-		}
-	}
+		directory->container = container;
+		directory->child = container->children;
+		directory->entry = 0;
 
-	if (i == n)
-	{
-		STREAMER_PRINTF(("FileArchive: Could not find file '%s'\n", filename));
-		return NULL;
+		return i;
 	}
 
-	return entry;
+	STREAMER_PRINTF(("FileArchive: No directory handle available\n"));
+	return -1;
 }
 
-static const fa_entry_t* FileArchive_FindByHash(FileArchiveDriver* driver, const fa_hash_t* hash)
+static int FileArchive_DClose(struct IODriver* driver, int fd)
 {
-	const fa_hash_t* begin = (const fa_hash_t*)(((const uint8_t*)(driver->toc)) + driver->toc->hashes);
-	const fa_hash_t* end = begin + driver->toc->entries.count;
-	const fa_entry_t* files = (const fa_entry_t*)(((const uint8_t*)(driver->toc)) + driver->toc->entries.offset);
-	const fa_hash_t* curr = begin;
-
-	for (; begin < end; ++begin)
-	{
-		if (!memcmp(hash, begin, sizeof(fa_hash_t)))
-		{
-			break;
-		}
+	FileArchiveDriver* local = (FileArchiveDriver*)driver;
 
-	}
+	STREAMER_PRINTF(("FileArchive: dclose(%d)\n", fd));
 
-	if (begin == end)
+	if ((fd < 0) || (fd >= FILEARCHIVE_MAX_HANDLES) || !local->directories[fd].container)
 	{
-		STREAMER_PRINTF(("FileArchive: Could not find hash\n"));
-		return NULL;
+		STREAMER_PRINTF(("FileArchive: Invalid directory handle\n"));
+		return -1;
 	}
 
-	return files + (curr - begin);
+	local->directories[fd].container = 0;
+	return 0;
 }
 
-static int FileArchive_LoadTOC(FileArchiveDriver* driver)
+static int FileArchive_DRead(struct IODriver* driver, int fd, StreamerDirEntry* entries, unsigned int count)
 {
-	uint32_t tail = FA_INVALID_OFFSET;
-	fa_footer_t footer;
-	int ret;
+	FileArchiveDriver* local = (FileArchiveDriver*)driver;
+	FileArchiveDirectory* directory;
+	unsigned int n = 0;
 
-	tail = FileArchive_LocateFooter(driver);
-	if (tail == FA_INVALID_OFFSET)
+	if ((fd < 0) || (fd >= FILEARCHIVE_MAX_HANDLES) || !local->directories[fd].container)
 	{
-		STREAMER_PRINTF(("FileArchive: Failed to locate footer for archive\n"));
+		STREAMER_PRINTF(("FileArchive: Invalid directory handle\n"));
 		return -1;
 	}
 
-	ret = driver->native.driver->lseek(driver->native.driver, driver->native.fd, tail, StreamerSeekMode_Set);
-	if (ret < 0)
-	{
-		STREAMER_PRINTF(("FileArchive: Failed seeking to tail\n"));
-		return -1;
-	}
+	directory = &(local->directories[fd]);
 
-	ret = driver->native.driver->read(driver->native.driver, driver->native.fd, &footer, sizeof(footer));
-	if (ret != sizeof(footer))
+	// Child containers are listed first, then the entries
+
+	while ((n < count) && (directory->child != FA_INVALID_OFFSET))
+	{
+		const fa_container_t* child = (const fa_container_t*)FileArchive_Toc(local, directory->child, sizeof(fa_container_t));
+		const char* name = child ? FileArchive_TocName(local, child->name) : NULL;
+
+		if (!name)
+		{
+			return -1;
+		}
+
+		strncpy(entries[n].name, name, sizeof(entries[n].name) - 1);
+		entries[n].name[sizeof(entries[n].name) - 1] = '\0';
+		entries[n].size = 0;
+		entries[n].type = StreamerDirEntryType_Directory;
+
+		directory->child = child->next;
+		++n;
+	}
+
+	while ((n < count) && (directory->entry < directory->container->entries.count))
+	{
+		const fa_entry_t* entry = ((const fa_entry_t*)(((const char*)local->toc) + directory->container->entries.offset)) + directory->entry;
+
+		if (FileArchive_Touch(local, entry) < 0)
+		{
+			return -1;
+		}
+
+		strncpy(entries[n].name, FileArchive_TocName(local, entry->name), sizeof(entries[n].name) - 1);
+		entries[n].name[sizeof(entries[n].name) - 1] = '\0';
+		entries[n].size = FileArchive_Original(local, entry);
+		entries[n].type = StreamerDirEntryType_File;
+
+		++directory->entry;
+		++n;
+	}
+
+	return n;
+}
+
+static int FileArchive_LoadList(struct IODriver* driver, IOListState* state)
+{
+	FileArchiveDriver* local = (FileArchiveDriver*)driver;
+	int cacheFilled = 0;
+
+	if (local->toc == NULL)
+	{
+		STREAMER_PRINTF(("FileArchive: Archive TOC not available\n"));
+		return -1;
+	}
+
+	if (!state->prepared)
+	{
+		unsigned int i;
+
+		for (i = 0; i < state->count; ++i)
+		{
+			IOListItem* item = &(state->items[i]);
+			item->data = FileArchive_Find(local, state->requests[item->index].filename);
+		}
+
+		FileArchive_SortList(local, state->items, state->count);
+
+		state->cursor = 0;
+		state->progress = 0;
+		state->prepared = 1;
+	}
+
+	if (local->cache.owner != FILEARCHIVE_CACHE_OWNER_LIST)
+	{
+		local->cache.offset = 0;
+		local->cache.fill = 0;
+		local->cache.position = 0;
+		local->cache.owner = FILEARCHIVE_CACHE_OWNER_LIST;
+	}
+
+	while (state->cursor < state->count)
+	{
+		const fa_entry_t* file = (const fa_entry_t*)state->items[state->cursor].data;
+		StreamerLoadRequest* request = &(state->requests[state->items[state->cursor].index]);
+		int result;
+
+		if (!file || (FileArchive_Original(local, file) > request->length) || (FileArchive_Compressed(local, file) > 0xffffffff))
+		{
+			STREAMER_PRINTF(("FileArchive: Could not load '%s'\n", request->filename));
+
+			request->result = -1;
+			++state->cursor;
+			continue;
+		}
+
+		if (state->progress == 0)
+		{
+			request->result = 0;
+		}
+
+		result = file->compression == FA_COMPRESSION_NONE ? FileArchive_LoadStored(local, state, file, request) : FileArchive_LoadCompressed(local, state, file, request);
+
+		if (result > 0)
+		{
+			uint64_t position = FileArchive_Data(local, file) + state->progress;
+			uint32_t remaining = (uint32_t)FileArchive_Compressed(local, file) - state->progress;
+
+			// Only issue one read per call, so that other requests get serviced in between
+
+			if (cacheFilled)
+			{
+				return 1;
+			}
+			cacheFilled = 1;
+
+			if ((file->compression == FA_COMPRESSION_NONE) && (remaining >= FILEARCHIVE_CACHE_SIZE))
+			{
+				// Large uncompressed files are read straight into the destination buffer
+
+				if (FileArchive_ReadNative(local, local->base + position, ((uint8_t*)request->buffer) + state->progress, remaining) == (int)remaining)
+				{
+					state->progress += remaining;
+					continue;
+				}
+			}
+			else if (FileArchive_FillListCache(local, state, position) >= 0)
+			{
+				continue;
+			}
+
+			result = -1;
+		}
+
+		if (result < 0)
+		{
+			STREAMER_PRINTF(("FileArchive: Failed loading '%s'\n", request->filename));
+			request->result = -1;
+		}
+		else
+		{
+			++state->loaded;
+		}
+
+		state->progress = 0;
+		++state->cursor;
+	}
+
+	return 0;
+}
+
+static int FileArchive_LoadStored(FileArchiveDriver* driver, IOListState* state, const fa_entry_t* file, StreamerLoadRequest* request)
+{
+	uint64_t position = FileArchive_Data(driver, file) + state->progress;
+	uint32_t remaining = (uint32_t)FileArchive_Original(driver, file) - state->progress;
+
+	if ((remaining > 0) && (position >= driver->cache.position) && (position < driver->cache.position + driver->cache.fill))
+	{
+		uint32_t cached = (uint32_t)((driver->cache.position + driver->cache.fill) - position);
+		uint32_t maxRead = cached > remaining ? remaining : cached;
+
+		memcpy(((uint8_t*)request->buffer) + state->progress, driver->cache.data + (position - driver->cache.position), maxRead);
+
+		state->progress += maxRead;
+		remaining -= maxRead;
+	}
+
+	if (remaining > 0)
+	{
+		return 1;
+	}
+
+	request->result = (int)FileArchive_Original(driver, file);
+	return 0;
+}
+
+static int FileArchive_LoadCompressed(FileArchiveDriver* driver, IOListState* state, const fa_entry_t* file, StreamerLoadRequest* request)
+{
+	uint32_t compressed = (uint32_t)FileArchive_Compressed(driver, file);
+	uint32_t progress = state->progress;
+	uint32_t produced = (uint32_t)request->result;
+	DecompressorBatch* batch = &(driver->decompress.batch);
+	int result = 0;
+
+	// Complete blocks in the cache are gathered into a batch and decompressed in parallel straight into the destination buffer
+
+	FileArchive_BeginBatch(driver, file, -1, request->filename);
+
+	while (progress < compressed)
+	{
+		uint64_t position = FileArchive_Data(driver, file) + progress;
+		uint32_t remaining = compressed - progress;
+		uint32_t cached = 0, blockSize;
+		const uint8_t* source;
+		FileArchiveBlock block;
+
+		if ((position >= driver->cache.position) && (position < driver->cache.position + driver->cache.fill))
+		{
+			cached = (uint32_t)((driver->cache.position + driver->cache.fill) - position);
+		}
+
+		if (remaining < driver->header)
+		{
+			STREAMER_PRINTF(("FileArchive: Truncated block header\n"));
+			result = -1;
+			break;
+		}
+
+		if (cached < driver->header)
+		{
+			result = 1;
+			break;
+		}
+
+		source = driver->cache.data + (position - driver->cache.position);
+		FileArchive_ParseBlock(driver, source, &block);
+
+		blockSize = driver->header + block.compressed;
+		if (blockSize > remaining)
+		{
+			STREAMER_PRINTF(("FileArchive: Truncated block\n"));
+			result = -1;
+			break;
+		}
+
+		if (cached < blockSize)
+		{
+			result = 1;
+			break;
+		}
+
+		if (block.original > (request->length - produced))
+		{
+			STREAMER_PRINTF(("FileArchive: Decompressed data does not fit in buffer\n"));
+			result = -1;
+			break;
+		}
+
+		if (batch->count == FILEARCHIVE_BATCH_BLOCKS)
+		{
+			Decompressor_Submit(batch);
+			if (FileArchive_FinishBatch(driver) < 0)
+			{
+				return -1;
+			}
+		}
+
+		FileArchive_QueueBlock(driver, position, source, &block, ((uint8_t*)request->buffer) + produced, produced);
+
+		progress += blockSize;
+		produced += block.original;
+	}
+
+	// The cache is refilled when we return, so everything referencing it has to be finished first
+
+	Decompressor_Submit(batch);
+	if ((FileArchive_FinishBatch(driver) < 0) || (result < 0))
+	{
+		return -1;
+	}
+
+	state->progress = progress;
+	request->result = (int)produced;
+
+	if (result > 0)
+	{
+		return 1;
+	}
+
+	if ((uint64_t)request->result != FileArchive_Original(driver, file))
+	{
+		STREAMER_PRINTF(("FileArchive: Decompressed size mismatch\n"));
+		return -1;
+	}
+
+	return 0;
+}
+
+static const fa_entry_t* FileArchive_Find(FileArchiveDriver* driver, const char* filename)
+{
+	const fa_entry_t* entry;
+	int i;
+
+	if (*filename == '@')
+	{
+		fa_hash_t hash;
+		const char* begin = filename + 1;
+
+		memset(&hash, 0, sizeof(hash));
+		for (i = 0; (i < sizeof(hash.data) * 2) && *begin; ++i, ++begin)
+		{
+			uint8_t value;
+
+			if ((*begin >= '0') && (*begin <= '9'))
+			{
+				value = *begin - '0';
+			}
+			else if ((*begin >= 'A') && (*begin <= 'F'))
+			{
+				value = 10 + (*begin - 'A');
+			}
+			else if ((*begin >= 'a') && (*begin <= 'f'))
+			{
+				value = 10 + (*begin - 'a');
+			}
+			else
+			{
+				break;
+			}
+
+			hash.data[i >> 1] |= (value << (((i & 1)^1) * 4));
+		}
+
+		if (i != sizeof(hash.data) * 2)
+		{
+			STREAMER_PRINTF(("FileArchive: Invalid hash length (%d != %d)\n", i, (int)sizeof(hash.data) * 2));
+			return NULL;
+		}
+
+		entry = FileArchive_FindByHash(driver, &hash);
+	}
+	else
+	{
+		entry = FileArchive_FindByName(driver, filename);
+	}
+
+	if (!entry)
+	{
+		return NULL;
+	}
+
+	if (FileArchive_Touch(driver, entry) < 0)
+	{
+		STREAMER_PRINTF(("FileArchive: Could not read TOC for '%s'\n", filename));
+		return NULL;
+	}
+
+	// Block sizes are checked as entries are found, so startup does not have to visit every entry
+
+	if ((entry->compression != FA_COMPRESSION_NONE) && (!FileArchive_BlockSize(driver, entry) || (FileArchive_BlockSize(driver, entry) > driver->blockSize)))
+	{
+		STREAMER_PRINTF(("FileArchive: Unsupported block size %u for '%s'\n", FileArchive_BlockSize(driver, entry), filename));
+		return NULL;
+	}
+
+	return entry;
+}
+
+static const fa_container_t* FileArchive_FindContainer(FileArchiveDriver* driver, const char* begin, const char* end)
+{
+	const fa_container_t* container;
+
+	container = (const fa_container_t*)FileArchive_Toc(driver, driver->toc->containers.offset, sizeof(fa_container_t));
+	while (container && (begin < end))
+	{
+		uint32_t offset;
+		const char* curr = begin;
+		while ((curr != end) && (*curr != '/'))
+		{
+			++curr;
+		}
+
+		if (curr != begin)
+		{
+			for (offset = container->children; offset != FA_INVALID_OFFSET; offset = container->next)
+			{
+				const char* name;
+
+				container = (const fa_container_t*)FileArchive_Toc(driver, offset, sizeof(fa_container_t));
+				name = container ? FileArchive_TocName(driver, container->name) : NULL;
+
+				if (!name)
+				{
+					return NULL;
+				}
+
+				if (strlen(name) != (size_t)(curr-begin))
+				{
+					continue;
+				}
+
+				if (!memcmp(name, begin, (curr-begin)))
+				{
+					break;
+				}
+			}
+
+			if (offset == FA_INVALID_OFFSET)
+			{
+				return NULL;
+			}
+		}
+
+		begin = curr + 1;
+	}
+
+	return container;
+}
+
+static const fa_entry_t* FileArchive_FindByName(FileArchiveDriver* driver, const char* filename)
+{
+	const char* curr = filename;
+	const char* begin = 0;
+	const char* end = 0;
+	uint32_t hash = FILEARCHIVE_HASH_SEED, slot;
+
+	FileArchive_CountLookup(driver);
+
+	if (!driver->index.table)
+	{
+		return FileArchive_FindInTree(driver, filename);
+	}
+
+	// Hash the path the same way the index was built, ignoring empty components
+
+	while (*curr)
+	{
+		if (*curr == '/')
+		{
+			++curr;
+			continue;
+		}
+
+		if (begin)
+		{
+			hash = FileArchive_Hash(hash, "/", "/" + 1);
+		}
+
+		for (begin = curr; *curr && (*curr != '/'); ++curr);
+		end = curr;
+
+		hash = FileArchive_Hash(hash, begin, end);
+	}
+
+	if (!begin || (end != curr))
+	{
+		STREAMER_PRINTF(("FileArchive: Invalid filename when opening '%s'\n", filename));
+		return NULL;
+	}
+
+	for (slot = hash & driver->index.mask; driver->index.table[slot].entry; slot = (slot + 1) & driver->index.mask)
+	{
+		const fa_entry_t* entry = driver->files + (driver->index.table[slot].entry - 1);
+
+		if ((driver->index.table[slot].hash == hash) && FileArchive_MatchPath(driver, entry, filename, end))
+		{
+			return entry;
+		}
+	}
+
+	STREAMER_PRINTF(("FileArchive: Could not find file '%s'\n", filename));
+	return NULL;
+}
+
+static const fa_entry_t* FileArchive_FindInTree(FileArchiveDriver* driver, const char* filename)
+{
+	const fa_container_t* container;
+	const fa_entry_t* entry;
+	const char* begin = strrchr(filename, '/');
+	const char* end = filename + strlen(filename);
+	unsigned int i, n;
+
+	begin = begin ? begin + 1 : filename;
+
+	container = FileArchive_FindContainer(driver, filename, begin);
+	if (!container)
+	{
+		STREAMER_PRINTF(("FileArchive: Could not locate container for '%s'\n", filename));
+		return NULL;
+	}
+
+	if (begin == end)
+	{
+		STREAMER_PRINTF(("FileArchive: Invalid filename when opening '%s'\n", filename));
+		return NULL;
+	}
+
+	entry = (const fa_entry_t*)FileArchive_Toc(driver, container->entries.offset, container->entries.count * sizeof(fa_entry_t));
+	for (i = 0, n = entry ? container->entries.count : 0; i < n; ++i, ++entry)
+	{
+		const char* name = FileArchive_TocName(driver, entry->name);
+		if (!name)
+		{
+			return NULL;
+		}
+
+		if (strlen(name) != (size_t)(end - begin))
+		{
+			continue;
+		}
+
+		if (!memcmp(name, begin, end-begin))
+		{
+			break;
+		}
+	}
+
+	if (i == n)
+	{
+		STREAMER_PRINTF(("FileArchive: Could not find file '%s'\n", filename));
+		return NULL;
+	}
+
+	return entry;
+}
+
+static const fa_entry_t* FileArchive_FindByHash(FileArchiveDriver* driver, const fa_hash_t* hash)
+{
+	const fa_hash_t* begin;
+	const fa_hash_t* end;
+	const fa_hash_t* curr;
+
+	FileArchive_CountLookup(driver);
+
+	begin = (const fa_hash_t*)FileArchive_Toc(driver, driver->toc->hashes, driver->toc->entries.count * sizeof(fa_hash_t));
+	end = begin + driver->toc->entries.count;
+	curr = begin;
+
+	if (!begin)
+	{
+		STREAMER_PRINTF(("FileArchive: Could not read content hashes\n"));
+		return NULL;
+	}
+
+	if (driver->index.table)
+	{
+		uint32_t low = 0, high = driver->toc->entries.count;
+
+		// Lower bound search, so duplicate contents resolve to the first entry
+
+		while (low < high)
+		{
+			uint32_t middle = low + (high - low) / 2;
+
+			if (memcmp(&(begin[driver->index.hashes[middle]]), hash, sizeof(fa_hash_t)) < 0)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		if ((low < driver->toc->entries.count) && !memcmp(&(begin[driver->index.hashes[low]]), hash, sizeof(fa_hash_t)))
+		{
+			return driver->files + driver->index.hashes[low];
+		}
+
+		STREAMER_PRINTF(("FileArchive: Could not find hash\n"));
+		return NULL;
+	}
+
+	for (; curr < end; ++curr)
+	{
+		if (!memcmp(hash, curr, sizeof(fa_hash_t)))
+		{
+			break;
+		}
+	}
+
+	if (curr == end)
+	{
+		STREAMER_PRINTF(("FileArchive: Could not find hash\n"));
+		return NULL;
+	}
+
+	return driver->files + (curr - begin);
+}
+
+static uint64_t FileArchive_Data(FileArchiveDriver* driver, const fa_entry_t* file)
+{
+	return driver->extents ? ((((uint64_t)driver->extents[file - driver->files].data) << 32) | file->data) : file->data;
+}
+
+static uint64_t FileArchive_Original(FileArchiveDriver* driver, const fa_entry_t* file)
+{
+	return driver->extents ? ((((uint64_t)driver->extents[file - driver->files].original) << 32) | file->size.original) : file->size.original;
+}
+
+static uint64_t FileArchive_Compressed(FileArchiveDriver* driver, const fa_entry_t* file)
+{
+	return driver->extents ? ((((uint64_t)driver->extents[file - driver->files].compressed) << 32) | file->size.compressed) : file->size.compressed;
+}
+
+static uint32_t FileArchive_BlockSize(FileArchiveDriver* driver, const fa_entry_t* file)
+{
+	if (file->compression == FA_COMPRESSION_NONE)
+	{
+		return 0;
+	}
+
+	// Older archives have 16-bit block headers, so their blocks always fit the handle buffers
+
+	return driver->toc->version >= FA_VERSION_3 ? file->blockSize : FILEARCHIVE_BUFFER_SIZE;
+}
+
+/**
+ *
+ * Find the largest block of any compressed entry, for archives with headers that do not record it
+ *
+**/
+static int FileArchive_LargestBlock(FileArchiveDriver* driver)
+{
+	uint32_t i;
+
+	if ((driver->toc->entries.count > (driver->pages.total / sizeof(fa_entry_t))) || !FileArchive_Toc(driver, driver->toc->entries.offset, driver->toc->entries.count * sizeof(fa_entry_t)))
+	{
+		STREAMER_PRINTF(("FileArchive: Invalid entry table\n"));
+		return -1;
+	}
+
+	driver->blockSize = 0;
+
+	for (i = 0; i < driver->toc->entries.count; ++i)
+	{
+		uint32_t blockSize = FileArchive_BlockSize(driver, &(driver->files[i]));
+
+		if ((driver->files[i].compression != FA_COMPRESSION_NONE) && ((blockSize == 0) || (blockSize > FA_BLOCK_SIZE_MAX)))
+		{
+			STREAMER_PRINTF(("FileArchive: Unsupported block size %u\n", blockSize));
+			return -1;
+		}
+
+		driver->blockSize = blockSize > driver->blockSize ? blockSize : driver->blockSize;
+	}
+
+	return 0;
+}
+
+static void FileArchive_ParseBlock(FileArchiveDriver* driver, const uint8_t* source, FileArchiveBlock* block)
+{
+	if (driver->header == sizeof(fa_block_crc_t))
+	{
+		fa_block_crc_t header;
+
+		memcpy(&header, source, sizeof(header));
+		block->original = header.original;
+		block->compressed = header.compressed & ~FA_COMPRESSION_SIZE_IGNORE_32;
+		block->stored = (header.compressed & FA_COMPRESSION_SIZE_IGNORE_32) != 0;
+		block->checksum = header.checksum;
+	}
+	else if (driver->header == sizeof(fa_block32_t))
+	{
+		fa_block32_t header;
+
+		memcpy(&header, source, sizeof(header));
+		block->original = header.original;
+		block->compressed = header.compressed & ~FA_COMPRESSION_SIZE_IGNORE_32;
+		block->stored = (header.compressed & FA_COMPRESSION_SIZE_IGNORE_32) != 0;
+		block->checksum = 0;
+	}
+	else
+	{
+		fa_block_t header;
+
+		memcpy(&header, source, sizeof(header));
+		block->original = header.original;
+		block->compressed = header.compressed & ~FA_COMPRESSION_SIZE_IGNORE;
+		block->stored = (header.compressed & FA_COMPRESSION_SIZE_IGNORE) != 0;
+		block->checksum = 0;
+	}
+}
+
+/**
+ *
+ * Check a block against its checksum when verifying reads
+ *
+ * \param source - Block header followed by block data
+ * \return 0 if the block matches or is not verified, <0 otherwise
+ *
+**/
+static int FileArchive_VerifyBlock(FileArchiveDriver* driver, const uint8_t* source, const FileArchiveBlock* block)
+{
+	if (!driver->verify)
+	{
+		return 0;
+	}
+
+	if (Crc32c_Update(Crc32c_Update(0, source, sizeof(fa_block32_t)), source + driver->header, block->compressed) != block->checksum)
+	{
+		STREAMER_PRINTF(("FileArchive: Block checksum mismatch\n"));
+		STREAMER_STATS_ADD(driver->interface.stats, checksumErrors, 1);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int FileArchive_ReadNative(FileArchiveDriver* driver, uint64_t offset, void* buffer, uint32_t length)
+{
+	IODriver* native = driver->native.driver;
+
+	// Positioned reads save a seek call per read where the native layer supports them
+
+	if (native->pread)
+	{
+		return native->pread(native, driver->native.fd, buffer, length, (StreamerOffset)offset);
+	}
+
+	if (native->lseek(native, driver->native.fd, (StreamerOffset)offset, StreamerSeekMode_Set) < 0)
+	{
+		STREAMER_PRINTF(("FileArchive: Failed seeking in archive\n"));
+		return -1;
+	}
+
+	return native->read(native, driver->native.fd, buffer, length);
+}
+
+static int FileArchive_LoadTOC(FileArchiveDriver* driver)
+{
+	uint64_t tail;
+	fa_footer64_t footer;
+	int ret;
+
+	if (FileArchive_LocateFooter(driver, &tail) < 0)
+	{
+		STREAMER_PRINTF(("FileArchive: Failed to locate footer for archive\n"));
+		return -1;
+	}
+
+	// Version 1 footers are a prefix of the wide footer, except for the data sizes
+
+	ret = FileArchive_ReadNative(driver, tail, &footer, sizeof(fa_footer_t));
+	if (ret != sizeof(fa_footer_t))
+	{
+		STREAMER_PRINTF(("FileArchive: Failed reading tail\n"));
+		return -1;
+	}
+
+	if (footer.cookie == FA_MAGIC_COOKIE_FOOTER)
+	{
+		fa_footer_t narrow;
+
+		memcpy(&narrow, &footer, sizeof(narrow));
+		footer.data.original = narrow.data.original;
+		footer.data.compressed = narrow.data.compressed;
+	}
+	else if (footer.cookie == FA_MAGIC_COOKIE_FOOTER_64)
+	{
+		ret = FileArchive_ReadNative(driver, tail, &footer, sizeof(footer));
+		if (ret != sizeof(footer))
+		{
+			STREAMER_PRINTF(("FileArchive: Failed reading tail\n"));
+			return -1;
+		}
+	}
+	else
+	{
+		STREAMER_PRINTF(("FileArchive: Mismatching magic cookie\n"));
+		return -1;
+	}
+
+	if ((footer.toc.compressed > tail) || (footer.data.compressed > tail - footer.toc.compressed))
+	{
+		STREAMER_PRINTF(("FileArchive: Invalid data location\n"));
+		return -1;
+	}
+
+	driver->pages.total = footer.toc.original;
+
+	// Uncompressed TOCs are used in place where the native driver can map them, so the OS pages them in on demand.
+	// Archives from before far aligned the TOC are read into memory instead, as the structures in it would be misaligned
+
+	if ((footer.toc.compression == FA_COMPRESSION_NONE) && driver->native.driver->map && !((tail - footer.toc.compressed) % 8))
+	{
+		driver->toc = driver->native.driver->map(driver->native.driver, driver->native.fd, tail - footer.toc.compressed, footer.toc.original);
+		driver->mapped = driver->toc != NULL;
+	}
+
+	if (footer.toc.compression == FA_COMPRESSION_FASTLZ_PAGED)
+	{
+		ret = FileArchive_LoadPages(driver, tail - footer.toc.compressed, footer.toc.compressed);
+	}
+	else
+	{
+		ret = driver->mapped ? 0 : FileArchive_ReadTOC(driver, &footer, tail - footer.toc.compressed);
+	}
+
+	if ((ret < 0) || !FileArchive_Toc(driver, 0, sizeof(fa_header_t)))
+	{
+		STREAMER_PRINTF(("FileArchive: Failed to load TOC\n"));
+		return -1;
+	}
+
+	if ((driver->toc->version < FA_VERSION_1) || (driver->toc->version > FA_VERSION_CURRENT))
+	{
+		STREAMER_PRINTF(("FileArchive: Unsupported archive version %u\n", driver->toc->version));
+		return -1;
+	}
+
+	driver->files = (const fa_entry_t*)(((const uint8_t*)(driver->toc)) + driver->toc->entries.offset);
+	driver->extents = driver->toc->version >= FA_VERSION_2 ? (const fa_extent_t*)(((const uint8_t*)(driver->toc)) + driver->toc->extents) : NULL;
+	driver->header = driver->toc->version >= FA_VERSION_4 ? sizeof(fa_block_crc_t) : driver->toc->version >= FA_VERSION_3 ? sizeof(fa_block32_t) : sizeof(fa_block_t);
+	driver->blockSize = FILEARCHIVE_BUFFER_SIZE;
+
+	// The first version 3 archives were written before fa_header_t.blockSize, their containers start where it would be
+
+	if ((driver->toc->version >= FA_VERSION_3) && (driver->toc->containers.offset >= sizeof(fa_header_t)) && (driver->toc->entries.offset >= sizeof(fa_header_t)))
+	{
+		driver->blockSize = driver->toc->blockSize;
+	}
+	else if ((driver->toc->version >= FA_VERSION_3) && (FileArchive_LargestBlock(driver) < 0))
+	{
+		return -1;
+	}
+
+	if (driver->blockSize > FA_BLOCK_SIZE_MAX)
+	{
+		STREAMER_PRINTF(("FileArchive: Unsupported block size %u\n", driver->blockSize));
+		return -1;
+	}
+
+	driver->base = tail - (footer.toc.compressed + footer.data.compressed);
+
+	// Without an index lookups fall back to walking the container tree. Building it touches the whole TOC,
+	// so TOCs that are touched lazily wait until the archive has seen some use
+
+	if (driver->mapped || driver->pages.resident)
+	{
+		driver->index.pending = FILEARCHIVE_INDEX_LOOKUPS;
+	}
+	else if (FileArchive_BuildIndex(driver) < 0)
+	{
+		STREAMER_PRINTF(("FileArchive: Could not build path index, using slow lookups\n"));
+	}
+
+	return 0;
+}
+
+static int FileArchive_ReadTOC(FileArchiveDriver* driver, const fa_footer64_t* footer, uint64_t offset)
+{
+	int ret;
+
+	if (driver->native.driver->lseek(driver->native.driver, driver->native.fd, offset, StreamerSeekMode_Set) < 0)
+	{
+		STREAMER_PRINTF(("FileArchive: Could not seek to TOC\n"));
+		return -1;
+	}
+
+#if defined(_IOP)
+	driver->toc = AllocSysMemory(ALLOC_FIRST, footer->toc.original, 0);
+#else
+	driver->toc = malloc(footer->toc.original);
+#endif
+	if (!driver->toc)
+	{
+		STREAMER_PRINTF(("FileArchive: Failed to allocate memory for TOC\n"));
+		return -1;
+	}
+
+	if (footer->toc.compression == FA_COMPRESSION_NONE)
+	{
+		ret = driver->native.driver->read(driver->native.driver, driver->native.fd, driver->toc, footer->toc.original);
+		if ((uint32_t)ret != footer->toc.original)
+		{
+			STREAMER_PRINTF(("FileArchive: Failed to read TOC\n"));
+			return -1;
+		}
+	}
+	else
+	{
+		uint32_t length = footer->toc.compressed;
+		uint32_t offset = 0, cacheUsage = 0;
+
+		switch (footer->toc.compression)
+		{
+			case FA_COMPRESSION_NONE: case FA_COMPRESSION_FASTLZ: break;
+			default:
+			{
+				STREAMER_PRINTF(("FileArchive: Unsupported compression scheme used for TOC\n"));
+				return -1;
+			}
+			break;
+		}
+
+		while ((offset != footer->toc.original) && (length > 0))
+		{
+			size_t maxRead = (FILEARCHIVE_CACHE_SIZE - cacheUsage) > length ? length : (FILEARCHIVE_CACHE_SIZE - cacheUsage);
+			uint8_t* begin;
+			uint8_t* end;
+
+			ret = driver->native.driver->read(driver->native.driver, driver->native.fd, driver->cache.data + cacheUsage, maxRead);
+			if ((uint32_t)ret != maxRead)
+			{
+				STREAMER_PRINTF(("FileArchive: Short read while reading TOC block\n"));
+				return -1;
+			}
+
+			begin = driver->cache.data;
+			end = begin + maxRead + cacheUsage;
+
+			while (begin != end)
+			{
+				fa_block_t block;
+
+				if ((end - begin) < sizeof(fa_block_t))
+				{
+					break;
+				}
+
+				memcpy(&block, begin, sizeof(fa_block_t));
+
+				if (block.compressed & FA_COMPRESSION_SIZE_IGNORE)
+				{
+					if ((block.compressed & ~FA_COMPRESSION_SIZE_IGNORE) != block.original)
+					{
+						STREAMER_PRINTF(("FileArchive: Invalid compressed TOC block\n"));
+						return -1;
+					}
+
+					if (block.original > ((end - begin) - sizeof(fa_block_t)))
+					{
+						break;
+					}
+
+					memcpy(((uint8_t*)driver->toc) + offset, begin + sizeof(fa_block_t), block.original);
+				}
+				else
+				{
+					if (block.compressed > ((end - begin) - sizeof(fa_block_t)))
+					{
+						break;
+					}
+
+					switch (footer->toc.compression)
+					{
+						case FA_COMPRESSION_FASTLZ:
+						{
+							ret = fastlz_decompress(begin + sizeof(fa_block_t), block.compressed, ((uint8_t*)driver->toc) + offset, FILEARCHIVE_BUFFER_SIZE > (footer->toc.original - offset) ? (footer->toc.original - offset) : FILEARCHIVE_BUFFER_SIZE);
+							if (ret != block.original)
+							{
+								STREAMER_PRINTF(("FileArchive: Failed to decompress TOC block\n"));
+								return -1;
+							}
+						}
+						break;
+					}
+				}
+
+				offset += block.original;
+				begin += sizeof(fa_block_t) + (block.compressed & ~FA_COMPRESSION_SIZE_IGNORE);
+			}
+
+			memcpy(driver->cache.data, begin, end-begin);
+			cacheUsage = end-begin;
+
+			length -= maxRead;
+		}
+
+		if ((offset != footer->toc.original) || (length > 0))
+		{
+			STREAMER_PRINTF(("FileArchive: Failed to read compressed TOC\n"));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ *
+ * Read the page table of a paged TOC, leaving the pages to be decompressed as they are first touched
+ *
+**/
+static int FileArchive_LoadPages(FileArchiveDriver* driver, uint64_t position, uint32_t length)
+{
+	fa_pages_t pages;
+	uint8_t* buffer;
+	uint32_t i;
+
+	if ((length < sizeof(pages)) || (FileArchive_ReadNative(driver, position, &pages, sizeof(pages)) != sizeof(pages)))
+	{
+		STREAMER_PRINTF(("FileArchive: Failed reading TOC page table\n"));
+		return -1;
+	}
+
+	if ((pages.size < sizeof(fa_header_t)) || (pages.size >= FA_COMPRESSION_SIZE_IGNORE) || (pages.count != (driver->pages.total + pages.size - 1) / pages.size) || (pages.count >= (length - sizeof(pages)) / sizeof(uint32_t)))
+	{
+		STREAMER_PRINTF(("FileArchive: Invalid TOC page table\n"));
+		return -1;
+	}
+
+	// Page offsets, residency flags and room for one compressed page share an allocation
+
+#if defined(_IOP)
+	buffer = AllocSysMemory(ALLOC_FIRST, (pages.count + 1) * sizeof(uint32_t) + pages.count + sizeof(fa_block_t) + pages.size, 0);
+	driver->toc = AllocSysMemory(ALLOC_FIRST, driver->pages.total, 0);
+#else
+	buffer = malloc((pages.count + 1) * sizeof(uint32_t) + pages.count + sizeof(fa_block_t) + pages.size);
+	driver->toc = malloc(driver->pages.total);
+#endif
+	driver->pages.offsets = (uint32_t*)buffer;
+	if (!buffer || !driver->toc)
+	{
+		STREAMER_PRINTF(("FileArchive: Failed to allocate memory for TOC\n"));
+		return -1;
+	}
+
+	driver->pages.resident = buffer + (pages.count + 1) * sizeof(uint32_t);
+	driver->pages.scratch = driver->pages.resident + pages.count;
+	driver->pages.position = position;
+	driver->pages.size = pages.size;
+	driver->pages.count = pages.count;
+	driver->pages.loaded = 0;
+
+	memset(driver->pages.resident, 0, pages.count);
+
+	if (FileArchive_ReadNative(driver, position + sizeof(pages), driver->pages.offsets, (pages.count + 1) * sizeof(uint32_t)) != (int)((pages.count + 1) * sizeof(uint32_t)))
+	{
+		STREAMER_PRINTF(("FileArchive: Failed reading TOC page table\n"));
+		return -1;
+	}
+
+	for (i = 0; i < pages.count; ++i)
+	{
+		uint32_t size = driver->pages.offsets[i + 1] - driver->pages.offsets[i];
+
+		if ((driver->pages.offsets[i] > driver->pages.offsets[i + 1]) || (driver->pages.offsets[i + 1] > length) || (size < sizeof(fa_block_t)) || (size > sizeof(fa_block_t) + pages.size))
+		{
+			STREAMER_PRINTF(("FileArchive: Invalid TOC page table\n"));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int FileArchive_LoadPage(FileArchiveDriver* driver, uint32_t page)
+{
+	uint32_t length = driver->pages.offsets[page + 1] - driver->pages.offsets[page];
+	uint32_t offset = page * driver->pages.size;
+	uint32_t expected = (driver->pages.total - offset) > driver->pages.size ? driver->pages.size : (driver->pages.total - offset);
+	fa_block_t block;
+	int ret;
+
+	if (FileArchive_ReadNative(driver, driver->pages.position + driver->pages.offsets[page], driver->pages.scratch, length) != (int)length)
+	{
+		STREAMER_PRINTF(("FileArchive: Short read while reading TOC page\n"));
+		return -1;
+	}
+
+	memcpy(&block, driver->pages.scratch, sizeof(fa_block_t));
+
+	if (block.compressed & FA_COMPRESSION_SIZE_IGNORE)
+	{
+		if ((block.original != expected) || ((block.compressed & ~FA_COMPRESSION_SIZE_IGNORE) != expected) || (length != sizeof(fa_block_t) + expected))
+		{
+			STREAMER_PRINTF(("FileArchive: Invalid stored TOC page\n"));
+			return -1;
+		}
+
+		memcpy(((uint8_t*)driver->toc) + offset, driver->pages.scratch + sizeof(fa_block_t), expected);
+	}
+	else
+	{
+		ret = length == sizeof(fa_block_t) + block.compressed ? fastlz_decompress(driver->pages.scratch + sizeof(fa_block_t), block.compressed, ((uint8_t*)driver->toc) + offset, expected) : -1;
+		if ((ret != (int)expected) || (block.original != expected))
+		{
+			STREAMER_PRINTF(("FileArchive: Failed to decompress TOC page\n"));
+			return -1;
+		}
+	}
+
+	driver->pages.resident[page] = 1;
+
+	// Once every page is resident the bookkeeping is no longer needed
+
+	if (++driver->pages.loaded == driver->pages.count)
+	{
+		FileArchive_FreePages(driver);
+	}
+
+	return 0;
+}
+
+static void FileArchive_FreePages(FileArchiveDriver* driver)
+{
+	if (driver->pages.offsets)
+	{
+#if defined(_IOP)
+		FreeSysMemory(driver->pages.offsets);
+#else
+		free(driver->pages.offsets);
+#endif
+	}
+
+	driver->pages.offsets = NULL;
+	driver->pages.resident = NULL;
+	driver->pages.scratch = NULL;
+}
+
+/**
+ *
+ * Make part of the TOC resident, decompressing any pages not touched before
+ *
+ * \return Pointer to TOC data at offset, NULL if out of range or the pages could not be read
+ *
+**/
+static const void* FileArchive_Toc(FileArchiveDriver* driver, uint32_t offset, uint32_t length)
+{
+	uint32_t page, last;
+
+	if ((offset > driver->pages.total) || (length > driver->pages.total - offset))
+	{
+		STREAMER_PRINTF(("FileArchive: TOC access out of range\n"));
+		return NULL;
+	}
+
+	if (driver->pages.resident && length)
+	{
+		for (page = offset / driver->pages.size, last = (offset + length - 1) / driver->pages.size; driver->pages.resident && (page <= last); ++page)
+		{
+			if (!driver->pages.resident[page] && (FileArchive_LoadPage(driver, page) < 0))
+			{
+				return NULL;
+			}
+		}
+	}
+
+	return ((const uint8_t*)driver->toc) + offset;
+}
+
+static const char* FileArchive_TocName(FileArchiveDriver* driver, fa_offset_t offset)
+{
+	const char* toc = (const char*)driver->toc;
+	uint32_t curr, end;
+
+	if (offset == FA_INVALID_OFFSET)
+	{
+		return "";
+	}
+
+	if (!driver->pages.resident)
+	{
+		return (const char*)FileArchive_Toc(driver, offset, 1);
+	}
+
+	// Names are not length prefixed, so pages are touched until the terminator turns up
+
+	for (curr = offset; curr < driver->pages.total; curr = end)
+	{
+		end = (curr / driver->pages.size + 1) * driver->pages.size;
+		end = end > driver->pages.total ? driver->pages.total : end;
+
+		if (!FileArchive_Toc(driver, curr, end - curr))
+		{
+			return NULL;
+		}
+
+		if (memchr(toc + curr, 0, end - curr))
+		{
+			return toc + offset;
+		}
+	}
+
+	STREAMER_PRINTF(("FileArchive: Unterminated name in TOC\n"));
+	return NULL;
+}
+
+/**
+ *
+ * Make everything the driver reads for an entry resident; its extent, content hash and name
+ *
+**/
+static int FileArchive_Touch(FileArchiveDriver* driver, const fa_entry_t* entry)
+{
+	uint32_t index = (uint32_t)(entry - driver->files);
+
+	if (!FileArchive_Toc(driver, (uint32_t)(((const uint8_t*)entry) - ((const uint8_t*)driver->toc)), sizeof(fa_entry_t)))
+	{
+		return -1;
+	}
+
+	if (!FileArchive_Toc(driver, driver->toc->hashes + index * sizeof(fa_hash_t), sizeof(fa_hash_t)))
+	{
+		return -1;
+	}
+
+	if (driver->extents && !FileArchive_Toc(driver, driver->toc->extents + index * sizeof(fa_extent_t), sizeof(fa_extent_t)))
+	{
+		return -1;
+	}
+
+	return FileArchive_TocName(driver, entry->name) ? 0 : -1;
+}
+
+static int FileArchive_BuildIndex(FileArchiveDriver* driver)
+{
+	const char* toc = (const char*)driver->toc;
+	uint32_t count = driver->toc->entries.count;
+	uint32_t containers = driver->toc->containers.count;
+	uint32_t first = driver->toc->containers.offset;
+	uint32_t size = 16, offset = first, visited = 0;
+	uint8_t* buffer;
+
+	if (!containers)
+	{
+		return 0;
+	}
+
+	if (!FileArchive_Toc(driver, 0, driver->pages.total))
+	{
+		return -1;
+	}
+
+	while (size < count * 2)
+	{
+		size <<= 1;
+	}
+
+#if defined(_IOP)
+	buffer = AllocSysMemory(ALLOC_FIRST, size * sizeof(FileArchiveSlot) + (count * 2 + containers) * sizeof(uint32_t), 0);
+#else
+	buffer = malloc(size * sizeof(FileArchiveSlot) + (count * 2 + containers) * sizeof(uint32_t));
+#endif
+	if (!buffer)
+	{
+		return -1;
+	}
+
+	driver->index.table = (FileArchiveSlot*)buffer;
+	driver->index.parents = (uint32_t*)(driver->index.table + size);
+	driver->index.hashes = driver->index.parents + count;
+	driver->index.paths = driver->index.hashes + count;
+	driver->index.mask = size - 1;
+
+	memset(driver->index.table, 0, size * sizeof(FileArchiveSlot));
+	memset(driver->index.parents, 0xff, count * sizeof(uint32_t));
+
+	FileArchive_SortHashes(driver);
+
+	// Walk the container tree depth first, in the same order as the tree lookup visits it, so
+	// the first of any duplicate paths wins. Containers without a name cannot be reached by path
+
+	driver->index.paths[0] = FILEARCHIVE_HASH_SEED;
+	for (;;)
+	{
+		const fa_container_t* container = (const fa_container_t*)(toc + offset);
+		uint32_t path = driver->index.paths[(offset - first) / sizeof(fa_container_t)];
+		int reachable = (container->parent == FA_INVALID_OFFSET) || ((container->name != FA_INVALID_OFFSET) && toc[container->name]);
+		uint32_t next, i;
+
+		if (++visited > containers)
+		{
+			STREAMER_PRINTF(("FileArchive: Container tree is malformed\n"));
+			break;
+		}
+
+		for (i = 0; reachable && (i < container->entries.count); ++i)
+		{
+			uint32_t index = (container->entries.offset - driver->toc->entries.offset) / sizeof(fa_entry_t) + i;
+			const char* name;
+			uint32_t hash, slot;
+
+			if (index >= count)
+			{
+				break;
+			}
+
+			name = driver->files[index].name != FA_INVALID_OFFSET ? toc + driver->files[index].name : "";
+			if (!*name)
+			{
+				continue;
+			}
+
+			hash = FileArchive_Hash(path, name, name + strlen(name));
+			for (slot = hash & driver->index.mask; driver->index.table[slot].entry; slot = (slot + 1) & driver->index.mask);
+
+			driver->index.table[slot].hash = hash;
+			driver->index.table[slot].entry = index + 1;
+			driver->index.parents[index] = offset;
+		}
+
+		if (reachable && (container->children != FA_INVALID_OFFSET))
+		{
+			next = container->children;
+		}
+		else
+		{
+			while ((container->parent != FA_INVALID_OFFSET) && (container->next == FA_INVALID_OFFSET))
+			{
+				container = (const fa_container_t*)(toc + container->parent);
+			}
+
+			if (container->parent == FA_INVALID_OFFSET)
+			{
+				return 0;
+			}
+
+			next = container->next;
+		}
+
+		// Container paths include the trailing separator, except for the root which is empty
+
+		container = (const fa_container_t*)(toc + next);
+		path = driver->index.paths[(container->parent - first) / sizeof(fa_container_t)];
+
+		if ((container->name != FA_INVALID_OFFSET) && toc[container->name])
+		{
+			path = FileArchive_Hash(path, toc + container->name, toc + container->name + strlen(toc + container->name));
+			path = FileArchive_Hash(path, "/", "/" + 1);
+		}
+
+		driver->index.paths[(next - first) / sizeof(fa_container_t)] = path;
+		offset = next;
+	}
+
+#if defined(_IOP)
+	FreeSysMemory(driver->index.table);
+#else
+	free(driver->index.table);
+#endif
+	driver->index.table = NULL;
+	return -1;
+}
+
+/**
+ *
+ * Count a lookup against a lazily touched TOC, indexing it once enough lookups have been made to pay for touching
+ * all of it. Path and content hash lookups both count, as the index sorts the content hashes as well
+ *
+**/
+static void FileArchive_CountLookup(FileArchiveDriver* driver)
+{
+	if (driver->index.pending && !--driver->index.pending && (FileArchive_BuildIndex(driver) < 0))
 	{
-		STREAMER_PRINTF(("FileArchive: Failed reading tail\n"));
+		STREAMER_PRINTF(("FileArchive: Could not build path index, using slow lookups\n"));
+	}
+}
+
+static void FileArchive_SortHashes(FileArchiveDriver* driver)
+{
+	const fa_hash_t* hashes = (const fa_hash_t*)(((const uint8_t*)(driver->toc)) + driver->toc->hashes);
+	uint32_t* order = driver->index.hashes;
+	unsigned int count = driver->toc->entries.count;
+	unsigned int g, i, j;
+
+	for (i = 0; i < count; ++i)
+	{
+		order[i] = i;
+	}
+
+	// Shell sort on content hash, ties ordered by entry so lookups find the first match like a linear scan
+
+	for (g = 0; g < sizeof(s_sortGaps) / sizeof(s_sortGaps[0]); ++g)
+	{
+		unsigned int gap = s_sortGaps[g];
+
+		for (i = gap; i < count; ++i)
+		{
+			uint32_t index = order[i];
+
+			for (j = i; j >= gap; j -= gap)
+			{
+				int compare = memcmp(&(hashes[order[j - gap]]), &(hashes[index]), sizeof(fa_hash_t));
+
+				if ((compare < 0) || (!compare && (order[j - gap] < index)))
+				{
+					break;
+				}
+
+				order[j] = order[j - gap];
+			}
+
+			order[j] = index;
+		}
+	}
+}
+
+static int FileArchive_MatchPath(FileArchiveDriver* driver, const fa_entry_t* file, const char* begin, const char* end)
+{
+	const char* toc = (const char*)driver->toc;
+	uint32_t offset = driver->index.parents[file - driver->files];
+	const char* name = toc + file->name;
+
+	// Compare components from the back, the entry name first and then each container up to the root
+
+	while (offset != FA_INVALID_OFFSET)
+	{
+		const fa_container_t* container = (const fa_container_t*)(toc + offset);
+		const char* curr;
+		size_t length = strlen(name);
+
+		while ((end != begin) && (end[-1] == '/'))
+		{
+			--end;
+		}
+
+		for (curr = end; (curr != begin) && (curr[-1] != '/'); --curr);
+
+		if (((size_t)(end - curr) != length) || memcmp(curr, name, length))
+		{
+			return 0;
+		}
+
+		end = curr;
+
+		if (container->parent == FA_INVALID_OFFSET)
+		{
+			break;
+		}
+
+		name = toc + container->name;
+		offset = container->parent;
+	}
+
+	while ((end != begin) && (end[-1] == '/'))
+	{
+		--end;
+	}
+
+	return end == begin;
+}
+
+static uint32_t FileArchive_Hash(uint32_t hash, const char* begin, const char* end)
+{
+	while (begin != end)
+	{
+		hash = (hash ^ (uint8_t)*begin++) * 16777619u;
+	}
+
+	return hash;
+}
+
+static int FileArchive_LocateFooter(FileArchiveDriver* driver, uint64_t* location)
+{
+	StreamerOffset eof, target;
+	fa_trailer_t trailer;
+	int offset, ret, length;
+
+	eof = driver->native.driver->lseek(driver->native.driver, driver->native.fd, 0, StreamerSeekMode_End);
+	if (eof < 0)
+	{
+		STREAMER_PRINTF(("FileArchive: Failed seeking to end of file\n"));
+		return -1;
+	}
+
+	// The trailer records where the footer is, so only archives written without one need the tail scanned
+
+	if ((eof >= (StreamerOffset)(sizeof(trailer) + sizeof(fa_footer_t))) && (FileArchive_ReadNative(driver, eof - sizeof(trailer), &trailer, sizeof(trailer)) == sizeof(trailer)) && (trailer.cookie == FA_MAGIC_COOKIE_TRAILER))
+	{
+		if ((trailer.version < FA_VERSION_1) || (trailer.version > FA_VERSION_CURRENT))
+		{
+			STREAMER_PRINTF(("FileArchive: Unsupported archive version %u\n", trailer.version));
+			return -1;
+		}
+
+		// Trailer cookies can occur in data that happens to end an archive, so the footer it points at has to agree
+
+		if ((trailer.footer >= sizeof(fa_footer_t)) && (trailer.footer <= eof - sizeof(trailer)))
+		{
+			uint32_t magic;
+
+			target = eof - sizeof(trailer) - trailer.footer;
+
+			if ((FileArchive_ReadNative(driver, target, &magic, sizeof(magic)) == sizeof(magic)) && ((magic == FA_MAGIC_COOKIE_FOOTER) || (magic == FA_MAGIC_COOKIE_FOOTER_64)))
+			{
+				*location = target;
+				return 0;
+			}
+		}
+
+		STREAMER_PRINTF(("FileArchive: Invalid trailer, scanning for footer\n"));
+	}
+
+	target = eof > FILEARCHIVE_CACHE_SIZE ? eof - FILEARCHIVE_CACHE_SIZE : 0;
+	length = (int)(eof - target);
+
+	ret = FileArchive_ReadNative(driver, target, driver->cache.data, length);
+	if (ret != length)
+	{
+		STREAMER_PRINTF(("FileArchive: Failed reading buffer for tail\n"));
+		return -1;
+	}
+
+	for (offset = length - 4; offset >= 0; --offset)
+	{
+		uint32_t magic;
+		memcpy(&magic, driver->cache.data + offset, sizeof(magic)); 
+
+		if (((magic != FA_MAGIC_COOKIE_FOOTER) && (magic != FA_MAGIC_COOKIE_FOOTER_64)) || (offset < 4))
+		{
+			continue;
+		}
+
+		*location = target + offset;
+		return 0;
+	}
+
+	STREAMER_PRINTF(("FileArchive: Failed locating tail\n"));
+	return -1;
+}
+
+/**
+ *
+ * Read and decompress the next block of a compressed handle
+ *
+ * The block is written straight to target if it fits within capacity, otherwise it goes into the handle buffer
+ *
+ * \return Number of bytes written to target, 0 if the block was loaded into the handle buffer, <0 on failure
+ *
+**/
+static int FileArchive_LoadBlock(FileArchiveDriver* driver, int fd, uint8_t* target, uint32_t capacity)
+{
+	FileArchiveHandle* handle = &(driver->handles[fd]);
+	const fa_entry_t* file = handle->file;
+	int compression = file->compression;
+	uint64_t position = FileArchive_Data(driver, file) + handle->offset.compressed;
+	uint8_t* destination;
+	FileArchiveBlock block;
+	uint32_t cacheUsage;
+	int cached;
+
+	cached = BlockCache_Lookup(driver, position, target, target ? capacity : 0, &cacheUsage);
+	if ((cached >= 0) && (!target || ((uint32_t)cached > capacity)))
+	{
+		cached = BlockCache_Lookup(driver, position, handle->buffer.data, handle->buffer.size, &cacheUsage);
+		target = 0;
+	}
+
+	if (cached >= 0)
+	{
+		STREAMER_STATS_ADD(driver->interface.stats, blockHits, 1);
+
+		// Skip the block in the window as well, dropping the window if the block was never read into it
+
+		if (cacheUsage <= handle->window.fill - handle->window.offset)
+		{
+			handle->window.offset += cacheUsage;
+		}
+		else
+		{
+			handle->window.offset = 0;
+			handle->window.fill = 0;
+		}
+
+		handle->offset.compressed += cacheUsage;
+		handle->buffer.offset = 0;
+		handle->buffer.fill = target ? 0 : cached;
+		return target ? cached : 0;
+	}
+
+	STREAMER_STATS_ADD(driver->interface.stats, blockMisses, 1);
+
+	if (FileArchive_FillWindow(driver, handle, file, driver->header) < 0)
+	{
+		STREAMER_PRINTF(("FileArchive: Error while filling compression cache\n"));
+		return -1;
+	}
+
+	FileArchive_ParseBlock(driver, handle->window.data + handle->window.offset, &block);
+
+	if ((block.original > handle->buffer.size) || (driver->header + block.compressed > handle->window.size))
+	{
+		STREAMER_PRINTF(("FileArchive: Block too large (max: %u, was: %u)\n", handle->buffer.size, block.original));
+		return -1;
+	}
+
+	if (FileArchive_FillWindow(driver, handle, file, driver->header + block.compressed) < 0)
+	{
+		STREAMER_PRINTF(("FileArchive: Error while filling compression cache\n"));
+		return -1;
+	}
+
+	if (FileArchive_VerifyBlock(driver, handle->window.data + handle->window.offset, &block) < 0)
+	{
+		return -1;
+	}
+
+	destination = (target && (block.original > 0) && (block.original <= capacity)) ? target : handle->buffer.data;
+
+	if (block.stored)
+	{
+		if (block.compressed != block.original)
+		{
+			STREAMER_PRINTF(("FileArchive: Uncompressed block size mismatch\n"));
+			return -1;
+		}
+
+		memcpy(destination, handle->window.data + handle->window.offset + driver->header, block.original);
+	}
+	else
+	{
+		switch (compression)
+		{
+			case FA_COMPRESSION_FASTLZ:
+			{
+				StreamerCounter start = IODriver_GetTime();
+				int result = fastlz_decompress(handle->window.data + handle->window.offset + driver->header, block.compressed, destination, block.original);
+
+				StreamerCounter elapsed = IODriver_GetTime() - start;
+
+				STREAMER_STATS_ADD(driver->interface.stats, decompressTime, elapsed);
+				STREAMER_STATS_ADD(driver->interface.stats, bytesDecompressed, result > 0 ? result : 0);
+				Trace_Record(driver->interface.trace, TraceEvent_Decompress, -1, start, elapsed, fd, handle->offset.original, result > 0 ? result : 0, block.compressed, ((const char*)driver->toc) + file->name);
+
+				if (result != (int)block.original)
+				{
+					STREAMER_PRINTF(("FileArchive: Failed to decompress fastlz block\n"));
+					return -1;
+				}
+			}
+			break;
+
+			default:
+			{
+				STREAMER_PRINTF(("FileArchive: Unsupported compression scheme\n"));
+				return -1;
+			}
+			break;
+		}
+	}
+
+	cacheUsage = driver->header + block.compressed;
+	BlockCache_Insert(driver, position, destination, block.original, cacheUsage);
+
+	handle->offset.compressed += cacheUsage;
+	handle->window.offset += cacheUsage;
+
+	handle->buffer.offset = 0;
+	if (destination == target)
+	{
+		handle->buffer.fill = 0;
+		return (int)block.original;
+	}
+
+	handle->buffer.fill = block.original;
+	return 0;
+}
+
+/**
+ *
+ * Position a compressed handle at an uncompressed offset
+ *
+ * Seeks within the buffered block are free, the start and end of the entry are known up front, and anything else goes
+ * through the block index to decompress just the block that contains the offset.
+ *
+**/
+static int FileArchive_SeekBlock(FileArchiveDriver* driver, int fd, uint64_t offset)
+{
+	FileArchiveHandle* handle = &(driver->handles[fd]);
+	const fa_entry_t* file = handle->file;
+	uint64_t bufferStart = handle->offset.original - handle->buffer.offset;
+	uint32_t low, high;
+
+	if ((offset >= bufferStart) && (offset < bufferStart + handle->buffer.fill))
+	{
+		handle->buffer.offset = (uint32_t)(offset - bufferStart);
+		handle->offset.original = offset;
+		return 0;
+	}
+
+	handle->window.offset = 0;
+	handle->window.fill = 0;
+	handle->buffer.offset = 0;
+	handle->buffer.fill = 0;
+
+	if ((offset == 0) || (offset == FileArchive_Original(driver, file)))
+	{
+		handle->offset.original = offset;
+		handle->offset.compressed = offset ? FileArchive_Compressed(driver, file) : 0;
+		return 0;
+	}
+
+	if (!handle->blocks.points && (FileArchive_BuildBlocks(driver, fd) < 0))
+	{
+		return -1;
+	}
+
+	// Last block starting at or before offset
+
+	low = 0;
+	high = handle->blocks.count;
+	while (high - low > 1)
+	{
+		uint32_t mid = low + (high - low) / 2;
+
+		if (handle->blocks.points[mid].original <= offset)
+		{
+			low = mid;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	handle->offset.original = handle->blocks.points[low].original;
+	handle->offset.compressed = handle->blocks.points[low].compressed;
+
+	FileArchive_ClaimWindow(driver, fd);
+	if (FileArchive_LoadBlock(driver, fd, 0, 0) < 0)
+	{
+		return -1;
+	}
+
+	if (offset - handle->offset.original > handle->buffer.fill)
+	{
+		STREAMER_PRINTF(("FileArchive: Block index does not match block contents\n"));
 		return -1;
 	}
 
-	if (footer.cookie != FA_MAGIC_COOKIE_FOOTER)
+	handle->buffer.offset = (uint32_t)(offset - handle->offset.original);
+	handle->offset.original = offset;
+	return 0;
+}
+
+/**
+ *
+ * Build the block index of a compressed handle by walking the block headers
+ *
+ * The entry is read sequentially through the handle window, so the walk costs one pass over the compressed data but
+ * no decompression.
+ *
+**/
+static int FileArchive_BuildBlocks(FileArchiveDriver* driver, int fd)
+{
+	FileArchiveHandle* handle = &(driver->handles[fd]);
+	const fa_entry_t* file = handle->file;
+	uint64_t size = FileArchive_Compressed(driver, file);
+	uint64_t compressed = 0, original = 0, windowStart = 0;
+	uint32_t windowFill = 0, capacity = (uint32_t)(FileArchive_Original(driver, file) / FileArchive_BlockSize(driver, file)) + 1;
+	FileArchiveSeekPoint* points;
+	uint32_t count = 0;
+
+	FileArchive_ClaimWindow(driver, fd);
+
+	handle->window.offset = 0;
+	handle->window.fill = 0;
+
+#if defined(_IOP)
+	points = AllocSysMemory(ALLOC_FIRST, capacity * sizeof(FileArchiveSeekPoint), 0);
+#else
+	points = malloc(capacity * sizeof(FileArchiveSeekPoint));
+#endif
+
+	while (points && (compressed < size))
+	{
+		FileArchiveBlock block;
+
+		if ((compressed < windowStart) || (compressed + driver->header > windowStart + windowFill))
+		{
+			uint32_t length = (size - compressed) > handle->window.size ? handle->window.size : (uint32_t)(size - compressed);
+
+			if ((length < driver->header) || (FileArchive_ReadNative(driver, driver->base + FileArchive_Data(driver, file) + compressed, handle->window.data, length) != (int)length))
+			{
+				STREAMER_PRINTF(("FileArchive: Failed reading block header at %u\n", (uint32_t)compressed));
+				break;
+			}
+
+			windowStart = compressed;
+			windowFill = length;
+		}
+
+		FileArchive_ParseBlock(driver, handle->window.data + (compressed - windowStart), &block);
+
+		if (count == capacity)
+		{
+			FileArchiveSeekPoint* grown;
+
+			capacity *= 2;
+#if defined(_IOP)
+			grown = AllocSysMemory(ALLOC_FIRST, capacity * sizeof(FileArchiveSeekPoint), 0);
+			if (grown)
+			{
+				memcpy(grown, points, count * sizeof(FileArchiveSeekPoint));
+			}
+			FreeSysMemory(points);
+#else
+			grown = realloc(points, capacity * sizeof(FileArchiveSeekPoint));
+			if (!grown)
+			{
+				free(points);
+			}
+#endif
+			points = grown;
+			if (!points)
+			{
+				break;
+			}
+		}
+
+		points[count].original = original;
+		points[count].compressed = compressed;
+		++count;
+
+		compressed += driver->header + block.compressed;
+		original += block.original;
+	}
+
+	// The window was used as scratch space
+
+	handle->window.offset = 0;
+	handle->window.fill = 0;
+
+	if (!points || (compressed != size) || (original != FileArchive_Original(driver, file)) || !count)
 	{
-		STREAMER_PRINTF(("FileArchive: Mismatching magic cookie\n"));
+		STREAMER_PRINTF(("FileArchive: Could not build block index\n"));
+		handle->blocks.points = points;
+		FileArchive_FreeBlocks(handle);
 		return -1;
 	}
 
-	if ((footer.toc.compressed > tail) || (footer.data.compressed > tail))
+	handle->blocks.points = points;
+	handle->blocks.count = count;
+	return 0;
+}
+
+static void FileArchive_FreeBlocks(FileArchiveHandle* handle)
+{
+	if (handle->blocks.points)
 	{
-		STREAMER_PRINTF(("FileArchive: Invalid data location\n"));
-		return -1;
+#if defined(_IOP)
+		FreeSysMemory(handle->blocks.points);
+#else
+		free(handle->blocks.points);
+#endif
 	}
 
-	ret = driver->native.driver->lseek(driver->native.driver, driver->native.fd, tail - footer.toc.compressed, StreamerSeekMode_Set);
-	if (ret < 0)
+	handle->blocks.points = 0;
+	handle->blocks.count = 0;
+}
+
+/**
+ *
+ * Size the handle buffer to hold one decompressed block, growing past the built-in buffer for large block archives
+ *
+ * \note A size of 0 returns the handle to its built-in buffer
+ *
+**/
+static int FileArchive_ResizeBuffer(FileArchiveDriver* driver, int fd, uint32_t size)
+{
+	FileArchiveHandle* handle = &(driver->handles[fd]);
+	uint8_t* data = ((uint8_t*)driver) + sizeof(FileArchiveDriver) + fd * FILEARCHIVE_BUFFER_SIZE;
+
+	if (size > FILEARCHIVE_BUFFER_SIZE)
 	{
-		STREAMER_PRINTF(("FileArchive: Could not seek to TOC\n"));
-		return -1;
+#if defined(_IOP)
+		data = AllocSysMemory(ALLOC_FIRST, size, 0);
+#else
+		data = malloc(size);
+#endif
+		if (!data)
+		{
+			STREAMER_PRINTF(("FileArchive: Could not allocate %u byte block buffer\n", size));
+			return -1;
+		}
 	}
 
+	if (handle->buffer.size > FILEARCHIVE_BUFFER_SIZE)
+	{
 #if defined(_IOP)
-	driver->toc = AllocSysMemory(ALLOC_FIRST, footer.toc.original, 0);
+		FreeSysMemory(handle->buffer.data);
 #else
-	driver->toc = malloc(footer.toc.original);
+		free(handle->buffer.data);
 #endif
-	if (!driver->toc)
+	}
+
+	handle->buffer.data = data;
+	handle->buffer.size = size > FILEARCHIVE_BUFFER_SIZE ? size : FILEARCHIVE_BUFFER_SIZE;
+	return 0;
+}
+
+/**
+ *
+ * Give a compressed handle its own read-ahead window, funded from the driver wide window budget
+ *
+ * The remaining budget is split evenly between the handles that could still be opened, so early handles cannot starve
+ * later ones; when the share drops below what is needed to hold a block, the handle falls back to the shared cache.
+ *
+**/
+static void FileArchive_OpenWindow(FileArchiveDriver* driver, FileArchiveHandle* handle)
+{
+	uint32_t size, slots = 0, minimum = driver->header + FileArchive_BlockSize(driver, handle->file);
+	uint8_t* data;
+	int i;
+
+	handle->window.offset = 0;
+	handle->window.fill = 0;
+	handle->window.size = driver->cache.size;
+	handle->window.data = driver->cache.data;
+
+	for (i = 0; i < FILEARCHIVE_MAX_HANDLES; ++i)
 	{
-		STREAMER_PRINTF(("FileArchive: Failed to allocate memory for TOC\n"));
-		return -1;
+		slots += (driver->handles[i].window.data == 0) || (driver->handles[i].window.data == driver->cache.data);
 	}
 
-	if (footer.toc.compression == FA_COMPRESSION_NONE)
+	size = (FILEARCHIVE_WINDOW_BUDGET(driver->cache.size) - driver->cache.budget) / (slots ? slots : 1);
+	size = size > driver->cache.size ? driver->cache.size : size;
+	minimum = minimum < FILEARCHIVE_WINDOW_MIN ? FILEARCHIVE_WINDOW_MIN : minimum;
+	if (size < minimum)
 	{
-		ret = driver->native.driver->read(driver->native.driver, driver->native.fd, driver->toc, footer.toc.original);
-		if ((uint32_t)ret != footer.toc.original)
-		{
-			STREAMER_PRINTF(("FileArchive: Failed to read TOC\n"));
-			return -1;
-		}
+		size = minimum;
 	}
-	else
+
+	if (driver->cache.budget + size > FILEARCHIVE_WINDOW_BUDGET(driver->cache.size))
 	{
-		uint32_t length = footer.toc.compressed;
-		uint32_t offset = 0, cacheUsage = 0;
+		STREAMER_PRINTF(("FileArchive: Window budget exhausted, handle shares the cache\n"));
+		return;
+	}
 
-		switch (footer.toc.compression)
-		{
-			case FA_COMPRESSION_NONE: case FA_COMPRESSION_FASTLZ: break;
-			default:
-			{
-				STREAMER_PRINTF(("FileArchive: Unsupported compression scheme used for TOC\n"));
-				return -1;
-			}
-			break;
-		}
+#if defined(_IOP)
+	data = AllocSysMemory(ALLOC_FIRST, size, 0);
+#else
+	data = malloc(size);
+#endif
+	if (!data)
+	{
+		return;
+	}
 
-		while ((offset != footer.toc.original) && (length > 0))
-		{
-			size_t maxRead = (FILEARCHIVE_CACHE_SIZE - cacheUsage) > length ? length : (FILEARCHIVE_CACHE_SIZE - cacheUsage);
-			uint8_t* begin;
-			uint8_t* end;
+	handle->window.size = size;
+	handle->window.data = data;
+	driver->cache.budget += size;
+}
 
-			ret = driver->native.driver->read(driver->native.driver, driver->native.fd, driver->cache.data + cacheUsage, maxRead);
-			if ((uint32_t)ret != maxRead)
-			{
-				STREAMER_PRINTF(("FileArchive: Short read while reading TOC block\n"));
-				return -1;
-			}
+static void FileArchive_CloseWindow(FileArchiveDriver* driver, FileArchiveHandle* handle)
+{
+	if (handle->window.data && (handle->window.data != driver->cache.data))
+	{
+#if defined(_IOP)
+		FreeSysMemory(handle->window.data);
+#else
+		free(handle->window.data);
+#endif
+		driver->cache.budget -= handle->window.size;
+	}
 
-			begin = driver->cache.data;
-			end = begin + maxRead + cacheUsage;
+	handle->window.data = 0;
+	handle->window.size = 0;
+	handle->window.offset = 0;
+	handle->window.fill = 0;
+}
 
-			while (begin != end)
-			{
-				fa_block_t block;
+/**
+ *
+ * Handles without a window of their own take turns on the shared cache, losing their read-ahead whenever someone else used it
+ *
+**/
+static void FileArchive_ClaimWindow(FileArchiveDriver* driver, int fd)
+{
+	FileArchiveHandle* handle = &(driver->handles[fd]);
 
-				if ((end - begin) < sizeof(fa_block_t))
-				{
-					break;
-				}
+	if ((handle->window.data == driver->cache.data) && (driver->cache.owner != fd))
+	{
+		handle->window.offset = 0;
+		handle->window.fill = 0;
+		driver->cache.owner = fd;
+	}
+}
 
-				memcpy(&block, begin, sizeof(fa_block_t));
+static int FileArchive_FillWindow(FileArchiveDriver* driver, FileArchiveHandle* handle, const fa_entry_t* file, int minFill)
+{
+	int windowFill = handle->window.fill - handle->window.offset;
+	int windowMax, readMax, ret;
+	uint64_t fileMax;
 
-				if (block.compressed & FA_COMPRESSION_SIZE_IGNORE)
-				{
-					if ((block.compressed & ~FA_COMPRESSION_SIZE_IGNORE) != block.original)
-					{
-						STREAMER_PRINTF(("FileArchive: Invalid compressed TOC block\n"));
-						return -1;
-					}
+	if (windowFill >= minFill)
+	{
+		STREAMER_STATS_ADD(driver->interface.stats, cacheHits, 1);
+		return windowFill;
+	}
 
-					if (block.original > ((end - begin) - sizeof(fa_block_t)))
-					{
-						break;
-					}
+	STREAMER_STATS_ADD(driver->interface.stats, cacheMisses, 1);
 
-					memcpy(((uint8_t*)driver->toc) + offset, begin + sizeof(fa_block_t), block.original);
-				}
-				else
-				{
-					if (block.compressed > ((end - begin) - sizeof(fa_block_t)))
-					{
-						break;
-					}
+	windowMax = handle->window.size - windowFill;
+	fileMax = FileArchive_Compressed(driver, file) - handle->offset.compressed - windowFill;
 
-					switch (footer.toc.compression)
-					{
-						case FA_COMPRESSION_FASTLZ:
-						{
-							ret = fastlz_decompress(begin + sizeof(fa_block_t), block.compressed, ((uint8_t*)driver->toc) + offset, FILEARCHIVE_BUFFER_SIZE > (footer.toc.original - offset) ? (footer.toc.original - offset) : FILEARCHIVE_BUFFER_SIZE);
-							if (ret != block.original)
-							{
-								STREAMER_PRINTF(("FileArchive: Failed to decompress TOC block\n"));
-								return -1;
-							}
-						}
-						break;
-					}
-				}
+	readMax = (uint64_t)windowMax > fileMax ? (int)fileMax : windowMax;
 
-				offset += block.original;
-				begin += sizeof(fa_block_t) + (block.compressed & ~FA_COMPRESSION_SIZE_IGNORE);
-			}
+	memmove(handle->window.data, handle->window.data + handle->window.offset, windowFill);
 
-			memcpy(driver->cache.data, begin, end-begin);
-			cacheUsage = end-begin;
+	ret = FileArchive_ReadNative(driver, driver->base + FileArchive_Data(driver, file) + handle->offset.compressed + windowFill, handle->window.data + windowFill, readMax);
+	if (ret != readMax)
+	{
+		STREAMER_PRINTF(("FileArchive: Failed reading %d bytes from archive (ret: %d)\n", readMax, ret));
+		return -1;
+	}
 
-			length -= maxRead;
-		}
+	handle->window.offset = 0;
+	handle->window.fill = windowFill + readMax;
 
-		if ((offset != footer.toc.original) || (length > 0))
-		{
-			STREAMER_PRINTF(("FileArchive: Failed to read compressed TOC\n"));
-			return -1;
-		}
+	if ((int)handle->window.fill < minFill)
+	{
+		STREAMER_PRINTF(("FileArchive: Failed filling window, wanted %d bytes but could only get %d bytes\n", minFill, handle->window.fill));
+		return -1;
 	}
 
-	driver->base = tail - (footer.toc.compressed + footer.data.compressed);
-	return 0;
+	return handle->window.fill;
 }
 
-static uint32_t FileArchive_LocateFooter(FileArchiveDriver* driver)
+/**
+ *
+ * Read whole blocks straight into the destination, decompressing them on the worker pool while the next range is read
+ *
+ * Compressed data is staged in two halves; blocks in one half are decompressed while the native read fills the other.
+ * Whatever is left over when the request ends is handed back to the window, and any trailing partial block is left for the
+ * buffered path.
+ *
+ * \return Number of bytes decompressed into buffer, <0 on failure
+ *
+**/
+static int FileArchive_ReadPipelined(FileArchiveDriver* driver, int fd, uint8_t* buffer, unsigned int length)
 {
-	int eof, target, offset, ret, location;
+#if !defined(_IOP)
+	FileArchiveHandle* handle = &(driver->handles[fd]);
+	const fa_entry_t* file = handle->file;
+	DecompressorBatch* batch = &(driver->decompress.batch);
+	uint64_t data = driver->base + FileArchive_Data(driver, file);
+	uint64_t end = FileArchive_Compressed(driver, file);
+	uint64_t fetched;
+	uint32_t fill, leftover, half = FILEARCHIVE_PIPELINE_SIZE > 4 * driver->cache.size ? FILEARCHIVE_PIPELINE_SIZE : 4 * driver->cache.size;
+	unsigned int actual = 0;
+	uint8_t* stage;
+	int ret;
 
-	eof = driver->native.driver->lseek(driver->native.driver, driver->native.fd, 0, StreamerSeekMode_End);
-	if (eof < 0)
+	// Each half holds several of the largest blocks, so large block archives still keep the workers busy
+
+	if (!driver->decompress.stage)
 	{
-		STREAMER_PRINTF(("FileArchive: Failed seeking to end of file\n"));
-		return FA_INVALID_OFFSET;
+		driver->decompress.stage = malloc(half * 2);
+		if (!driver->decompress.stage)
+		{
+			STREAMER_PRINTF(("FileArchive: Could not allocate pipeline buffers, reading without pipeline\n"));
+			driver->decompress.threads = 0;
+			return 0;
+		}
 	}
 
-	target = eof > FILEARCHIVE_CACHE_SIZE ? eof - FILEARCHIVE_CACHE_SIZE : 0;
+	// Pick up where the window left off
 
-	offset = driver->native.driver->lseek(driver->native.driver, driver->native.fd, target, StreamerSeekMode_Set);
-	if (offset != target)
-	{
-		STREAMER_PRINTF(("FileArchive: Failed seeking to tail of file\n"));
-		return FA_INVALID_OFFSET;
-	}
+	stage = driver->decompress.stage;
+	fill = handle->window.fill - handle->window.offset;
+	fill = fill > half ? half : fill;
+	memcpy(stage, handle->window.data + handle->window.offset, fill);
+
+	fetched = handle->offset.compressed + fill;
+	leftover = (end - fetched) > (half - fill) ? (half - fill) : (uint32_t)(end - fetched);
 
-	ret = driver->native.driver->read(driver->native.driver, driver->native.fd, driver->cache.data, eof - target);
-	if (ret != (eof - target))
+	ret = FileArchive_ReadNative(driver, data + fetched, stage + fill, leftover);
+	if (ret != (int)leftover)
 	{
-		STREAMER_PRINTF(("FileArchive: Failed reading buffer for tail\n"));
-		return FA_INVALID_OFFSET;
+		STREAMER_PRINTF(("FileArchive: Failed reading %d bytes from archive (ret: %d)\n", leftover, ret));
+		return -1;
 	}
 
-	location = -1;
-	for (offset = (eof - target) - 4; offset >= 0; --offset)
+	fill += leftover;
+	fetched += leftover;
+
+	for (;;)
 	{
-		uint32_t magic;
-		memcpy(&magic, driver->cache.data + offset, sizeof(magic)); 
+		uint8_t* next = stage == driver->decompress.stage ? stage + half : driver->decompress.stage;
+		uint32_t offset = 0, produced = 0, fetch = 0;
+
+		FileArchive_BeginBatch(driver, file, fd, ((const char*)driver->toc) + file->name);
 
-		if ((magic != FA_MAGIC_COOKIE_FOOTER) || (offset < 4))
+		while ((batch->count < FILEARCHIVE_BATCH_BLOCKS) && ((fill - offset) >= driver->header))
 		{
-			continue;
+			uint32_t blockSize;
+			FileArchiveBlock block;
+
+			FileArchive_ParseBlock(driver, stage + offset, &block);
+			blockSize = driver->header + block.compressed;
+
+			if ((blockSize > (fill - offset)) || (block.original > (length - actual - produced)))
+			{
+				break;
+			}
+
+			FileArchive_QueueBlock(driver, FileArchive_Data(driver, file) + handle->offset.compressed + offset, stage + offset, &block, buffer + actual + produced, handle->offset.original + produced);
+
+			offset += blockSize;
+			produced += block.original;
+		}
+
+		if (!offset)
+		{
+			break;
 		}
 
-		location = target + offset;
-		break;
+		Decompressor_Submit(batch);
+
+		// Move the unused tail into the other half and top it up while the workers are busy
+
+		leftover = fill - offset;
+		memcpy(next, stage + offset, leftover);
+
+		ret = 0;
+		if ((actual + produced) < length)
+		{
+			fetch = (end - fetched) > (half - leftover) ? (half - leftover) : (uint32_t)(end - fetched);
+			ret = FileArchive_ReadNative(driver, data + fetched, next + leftover, fetch);
+		}
+
+		if ((FileArchive_FinishBatch(driver) < 0) || (ret != (int)fetch))
+		{
+			STREAMER_PRINTF(("FileArchive: Pipelined read failed\n"));
+			return -1;
+		}
+
+		handle->offset.compressed += offset;
+		handle->offset.original += produced;
+		actual += produced;
+
+		stage = next;
+		fill = leftover + fetch;
+		fetched += fetch;
 	}
 
-	if (location < 0)
+	// Hand the remainder back to the window, anything that does not fit is simply read again later
+
+	fill = fill > handle->window.size ? handle->window.size : fill;
+	memcpy(handle->window.data, stage, fill);
+
+	handle->window.offset = 0;
+	handle->window.fill = fill;
+
+	return (int)actual;
+#else
+	return 0;
+#endif
+}
+
+static void FileArchive_BeginBatch(FileArchiveDriver* driver, const fa_entry_t* file, int fd, const char* path)
+{
+	DecompressorBatch* batch = &(driver->decompress.batch);
+
+	batch->blocks = driver->decompress.blocks;
+	batch->count = 0;
+	batch->compression = file->compression;
+	batch->verify = driver->verify;
+	batch->stats = driver->interface.stats;
+	batch->trace = driver->interface.trace;
+	batch->path = path;
+	batch->fd = fd;
+}
+
+/**
+ *
+ * Add a block to the current batch, unless the block cache can provide it right away
+ *
+ * \param position - Location of block header (Relative to start of data)
+ * \param source - Block header followed by block data
+ * \return 1 if the block was copied from the block cache, 0 if it was queued
+ *
+**/
+static int FileArchive_QueueBlock(FileArchiveDriver* driver, uint64_t position, const uint8_t* source, const FileArchiveBlock* block, uint8_t* target, StreamerCounter offset)
+{
+	DecompressorBatch* batch = &(driver->decompress.batch);
+	DecompressorBlock* entry;
+	uint32_t usage;
+
+	if ((block->original <= BLOCKCACHE_BLOCK_MAX) && (BlockCache_Lookup(driver, position, target, block->original, &usage) == (int)block->original))
 	{
-		STREAMER_PRINTF(("FileArchive: Failed locating tail\n"));
-		return FA_INVALID_OFFSET;
+		STREAMER_STATS_ADD(driver->interface.stats, blockHits, 1);
+		return 1;
 	}
 
-	return location;
+	STREAMER_STATS_ADD(driver->interface.stats, blockMisses, 1);
+
+	driver->decompress.positions[batch->count] = position;
+
+	entry = &(batch->blocks[batch->count++]);
+	entry->source = source + driver->header;
+	entry->target = target;
+	entry->size = block->compressed;
+	entry->original = block->original;
+	entry->stored = block->stored;
+	entry->checksum = block->checksum;
+	entry->offset = offset;
+	return 0;
 }
 
-static int FileArchive_FillCache(FileArchiveDriver* driver, FileArchiveHandle* handle, const fa_entry_t* file, int minFill)
+/**
+ *
+ * Wait for a submitted batch and publish its blocks in the block cache
+ *
+**/
+static int FileArchive_FinishBatch(FileArchiveDriver* driver)
 {
-	int cacheFill = driver->cache.fill - driver->cache.offset;
-	int cacheMax, fileMax, readMax, ret;
+	DecompressorBatch* batch = &(driver->decompress.batch);
+	unsigned int i;
+
+	if (Decompressor_Wait(batch) < 0)
+	{
+		return -1;
+	}
 
-	if (cacheFill >= minFill)
+	for (i = 0; i < batch->count; ++i)
 	{
-		return cacheFill;
+		DecompressorBlock* entry = &(batch->blocks[i]);
+		BlockCache_Insert(driver, driver->decompress.positions[i], entry->target, entry->original, driver->header + entry->size);
 	}
 
-	cacheMax = FILEARCHIVE_CACHE_SIZE - cacheFill;
-	fileMax = file->size.compressed - handle->offset.compressed - cacheFill;
+	batch->count = 0;
+	return 0;
+}
+
+static int FileArchive_FillListCache(FileArchiveDriver* driver, IOListState* state, uint64_t position)
+{
+	const fa_entry_t* file = (const fa_entry_t*)state->items[state->cursor].data;
+	uint64_t end = FileArchive_Data(driver, file) + FileArchive_Compressed(driver, file);
+	uint32_t keep = 0, total;
+	unsigned int i;
+	int ret;
 
-	readMax = cacheMax > fileMax ? fileMax : cacheMax;
+	// Extend the read across following files as long as they are close enough to be worth reading through
 
-	ret = driver->native.driver->lseek(driver->native.driver, driver->native.fd, driver->base + file->data + handle->offset.compressed + cacheFill, StreamerSeekMode_Set);
-	if (ret < 0)
+	for (i = state->cursor + 1; (i < state->count) && ((end - position) < driver->cache.size); ++i)
 	{
-		STREAMER_PRINTF(("FileArchive: Failed seeking to %d in archive\n", driver->base + file->data + handle->offset.compressed + cacheFill));
-		return -1;
+		const fa_entry_t* next = (const fa_entry_t*)state->items[i].data;
+		uint64_t data = FileArchive_Data(driver, next);
+
+		if (data > end + FILEARCHIVE_LIST_GAP)
+		{
+			break;
+		}
+
+		end = (data + FileArchive_Compressed(driver, next)) > end ? (data + FileArchive_Compressed(driver, next)) : end;
 	}
 
-	memcpy(driver->cache.data, driver->cache.data + driver->cache.offset, cacheFill);
+	total = (end - position) > driver->cache.size ? driver->cache.size : (uint32_t)(end - position);
 
-	ret = driver->native.driver->read(driver->native.driver, driver->native.fd, driver->cache.data + cacheFill, readMax);
-	if (ret != readMax)
+	if ((position >= driver->cache.position) && (position < driver->cache.position + driver->cache.fill))
 	{
-		STREAMER_PRINTF(("FileArchive: Failed reading %d bytes from archive (ret: %d)\n", readMax, ret));
-		return -1;
+		keep = (uint32_t)((driver->cache.position + driver->cache.fill) - position);
+		keep = keep > total ? total : keep;
+
+		memmove(driver->cache.data, driver->cache.data + (position - driver->cache.position), keep);
 	}
 
 	driver->cache.offset = 0;
-	driver->cache.fill = cacheFill + readMax;
+	driver->cache.fill = 0;
+	driver->cache.position = position;
 
-	if ((int)driver->cache.fill < minFill)
+	ret = FileArchive_ReadNative(driver, driver->base + position + keep, driver->cache.data + keep, total - keep);
+	if (ret != (int)(total - keep))
 	{
-		STREAMER_PRINTF(("FileArchive: Failed filling cache, wanted %d bytes but could only get %d bytes\n", minFill, driver->cache.fill));
+		STREAMER_PRINTF(("FileArchive: Failed reading %d bytes from archive (ret: %d)\n", total - keep, ret));
 		return -1;
 	}
 
-	return driver->cache.fill;
+	driver->cache.fill = total;
+	return total;
 }
 
+static void FileArchive_SortList(FileArchiveDriver* driver, IOListItem* items, unsigned int count)
+{
+	unsigned int g, i, j;
+
+	// Shell sort on data offset, with unresolved files placed first
+
+	for (g = 0; g < sizeof(s_sortGaps) / sizeof(s_sortGaps[0]); ++g)
+	{
+		unsigned int gap = s_sortGaps[g];
+
+		for (i = gap; i < count; ++i)
+		{
+			IOListItem item = items[i];
+			const fa_entry_t* file = (const fa_entry_t*)item.data;
+
+			for (j = i; j >= gap; j -= gap)
+			{
+				const fa_entry_t* other = (const fa_entry_t*)items[j - gap].data;
+
+				if (!other || (file && (FileArchive_Data(driver, other) <= FileArchive_Data(driver, file))))
+				{
+					break;
+				}
+
+				items[j] = items[j - gap];
+			}
+
+			items[j] = item;
+		}
+	}
+}
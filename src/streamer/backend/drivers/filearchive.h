@@ -25,12 +25,35 @@ SOFTWARE.
 #define streamer_common_filearchive_h
 
 #include "driver.h"
+#include "blockcache.h"
+#include "decompressor.h"
 #include "../filearchive.h"
 
 #define FILEARCHIVE_MAX_HANDLES 8
+#define FILEARCHIVE_BATCH_BLOCKS 64
+
+#define FILEARCHIVE_CACHE_OWNER_LIST (-2)
 
 typedef struct FileArchiveHandle FileArchiveHandle;
+typedef struct FileArchiveDirectory FileArchiveDirectory;
 typedef struct FileArchiveDriver FileArchiveDriver;
+typedef struct FileArchiveSlot FileArchiveSlot;
+typedef struct FileArchiveSeekPoint FileArchiveSeekPoint;
+typedef struct FileArchiveBlock FileArchiveBlock;
+
+struct FileArchiveSeekPoint
+{
+	uint64_t original;			// Uncompressed offset of block
+	uint64_t compressed;			// Offset of block header (Relative to start of entry data)
+};
+
+struct FileArchiveBlock
+{
+	uint32_t original;			// Size of block when decompressed
+	uint32_t compressed;			// Size of block data following the header
+	int stored;				// Block data is stored uncompressed
+	uint32_t checksum;			// CRC32C of block, only set for version 4 archives
+};
 
 struct FileArchiveHandle
 {
@@ -38,16 +61,45 @@ struct FileArchiveHandle
 
 	struct
 	{
-		uint32_t original;
-		uint32_t compressed;
+		uint64_t original;
+		uint64_t compressed;
 	} offset;
 
 	struct
 	{
 		uint32_t offset;
 		uint32_t fill;
-		uint8_t* data;
+		uint32_t size;
+		uint8_t* data;		// Points at the driver allocation unless the entry has blocks larger than FILEARCHIVE_BUFFER_SIZE
 	} buffer;
+
+	struct
+	{
+		uint32_t offset;
+		uint32_t fill;
+		uint32_t size;
+		uint8_t* data;		// Compressed read-ahead, points at the shared cache if the handle did not get a window of its own
+	} window;
+
+	struct
+	{
+		FileArchiveSeekPoint* points;	// One point per block, built on the first seek into the entry
+		uint32_t count;
+	} blocks;
+};
+
+struct FileArchiveDirectory
+{
+	const fa_container_t* container;	// Container being listed, NULL if not in use
+
+	uint32_t child;				// Next child container to list (Relative to start of TOC)
+	uint32_t entry;				// Index of next entry to list
+};
+
+struct FileArchiveSlot
+{
+	uint32_t hash;				// Hash of full path to entry
+	uint32_t entry;				// Index of entry + 1, 0 if slot is empty
 };
 
 struct FileArchiveDriver
@@ -55,13 +107,45 @@ struct FileArchiveDriver
 	IODriver interface;
 
 	fa_header_t* toc;
-	uint32_t base;
+	uint64_t base;
+	int mapped;			// TOC is a view mapped by the native driver
+
+	struct
+	{
+		uint32_t* offsets;	// Location of each compressed page (Relative to the fa_pages_t header)
+		uint8_t* resident;	// Set for each page once decompressed, NULL when the whole TOC is resident
+		uint8_t* scratch;	// Compressed page being read
+		uint64_t position;	// Location of the fa_pages_t header in archive
+		uint32_t size;		// Bytes of TOC per page
+		uint32_t count;		// Number of pages
+		uint32_t loaded;	// Number of resident pages
+		uint32_t total;		// Size of TOC
+	} pages;
+
+	const fa_entry_t* files;	// Entries in TOC
+	const fa_extent_t* extents;	// High words of entry offsets and sizes, NULL for version 1 archives
+	uint32_t header;		// Size of block headers, fa_block_crc_t from version 4, fa_block32_t from version 3 and fa_block_t before
+	uint32_t blockSize;		// Largest block of any compressed entry
+	int verify;			// Check block checksums before decompressing, version 4 archives only
+
+	struct
+	{
+		FileArchiveSlot* table;		// Open addressed path index, NULL if not available
+		uint32_t* parents;		// Container of each entry (Relative to start of TOC)
+		uint32_t* paths;		// Path hash of each container, including trailing separator
+		uint32_t* hashes;		// Entry indices ordered by content hash
+		uint32_t mask;
+		uint32_t pending;		// Tree lookups left before the index is built, for TOCs that are touched lazily
+	} index;
 
 	struct
 	{
 		uint32_t offset;
 		uint32_t fill;
+		uint64_t position;	// Location of cached data relative to start of data (list loads only)
 		int32_t owner;
+		uint32_t budget;	// Bytes of the window budget handed out to handles
+		uint32_t size;		// Grown past FILEARCHIVE_CACHE_SIZE to hold the largest block
 		uint8_t* data;
 	} cache;
 
@@ -71,10 +155,37 @@ struct FileArchiveDriver
 		int fd;
 	} native;
 
+	struct
+	{
+		DecompressorBatch batch;
+		DecompressorBlock blocks[FILEARCHIVE_BATCH_BLOCKS];
+		uint64_t positions[FILEARCHIVE_BATCH_BLOCKS];	// Location of each block in batch, for the block cache
+		uint8_t* stage;		// Double buffer for pipelined reads, allocated on first use
+		int threads;		// Decompression workers available, 0 if decompressing inline
+		int acquired;
+	} decompress;
+
 	FileArchiveHandle handles[FILEARCHIVE_MAX_HANDLES];
+	FileArchiveDirectory directories[FILEARCHIVE_MAX_HANDLES];
 };
 
 IODriver* FileArchive_Create(IODriver* native, const char* file);
 
+/**
+ *
+ * Enable or disable checking block checksums as blocks are read, archives without checksums are read as before
+ *
+**/
+void FileArchive_SetVerify(IODriver* driver, int verify);
+
+/**
+ *
+ * Get the content hashes of all entries, in entry order
+ *
+ * \return Number of hashes, <0 if the TOC could not be read
+ *
+**/
+int FileArchive_Hashes(IODriver* driver, const fa_hash_t** hashes);
+
 #endif
 
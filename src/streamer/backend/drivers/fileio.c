@@ -21,6 +21,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 
 */
+#if defined(STREAMER_UNIX) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64	// off_t is 64-bit, lseek() and pread() become lseek64() and pread64() on 32-bit targets
+#endif
+
 #include "fileio.h"
 #include "../backend.h"
 
@@ -44,10 +48,8 @@ SOFTWARE.
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
-#endif
-
-#if defined(_WIN32)
-static HANDLE s_handles[STREAMER_MAX_FILEHANDLES];
+#include <dirent.h>
+#include <sys/mman.h>
 #endif
 
 IODriver* FileIo_Create(const char* root)
@@ -56,29 +58,51 @@ IODriver* FileIo_Create(const char* root)
 	FileIoDriver* driver = AllocSysMemory(ALLOC_FIRST, sizeof(FileIoDriver),0);
 #else
 	FileIoDriver* driver = malloc(sizeof(FileIoDriver));
-#if defined(_WIN32)
-	int i;
-#endif
 #endif
+	int i;
 
 	driver->interface.destroy = FileIo_Destroy;
 	driver->interface.open = FileIo_Open;
 	driver->interface.close = FileIo_Close;
 	driver->interface.read = FileIo_Read;
 	driver->interface.lseek = FileIo_LSeek;
+#if defined(_IOP)
+	driver->interface.pread = 0;
+#else
+	driver->interface.pread = FileIo_PRead;
+#endif
+#if defined(_WIN32) || defined(STREAMER_UNIX)
+	driver->interface.map = FileIo_Map;
+	driver->interface.unmap = FileIo_Unmap;
+#else
+	driver->interface.map = 0;
+	driver->interface.unmap = 0;
+#endif
 
-	driver->interface.dopen = 0;
-	driver->interface.dclose = 0;
-	driver->interface.dread = 0;
+	driver->interface.dopen = FileIo_DOpen;
+	driver->interface.dclose = FileIo_DClose;
+	driver->interface.dread = FileIo_DRead;
 
 	driver->interface.align = 0;
 
+	driver->interface.stat = FileIo_Stat;
+
+	driver->interface.loadlist = 0;
+
+	driver->interface.stats = 0;
+	driver->interface.trace = 0;
+
 	strcpy(driver->root,root); // TODO: overflow check
 
+	for (i = 0; i < FILEIO_MAX_DIRECTORIES; ++i)
+	{
+		driver->directories[i] = 0;
+	}
+
 #if defined(_WIN32)
-	for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+	for (i = 0; i < FILEIO_MAX_HANDLES; ++i)
 	{
-		s_handles[i] = INVALID_HANDLE_VALUE;
+		driver->handles[i] = INVALID_HANDLE_VALUE;
 	}
 #endif
 
@@ -116,9 +140,9 @@ int FileIo_Open(struct IODriver* driver, const char* filename, StreamerOpenMode
 	STREAMER_PRINTF(("FileIo: open(\"%s\", %d)\n", filename, mode));
 
 #if defined(_WIN32)
-	for (i = 0; i < STREAMER_MAX_FILEHANDLES; ++i)
+	for (i = 0; i < FILEIO_MAX_HANDLES; ++i)
 	{
-		if (s_handles[i] == INVALID_HANDLE_VALUE)
+		if (local->handles[i] == INVALID_HANDLE_VALUE)
 		{
 			hindex = i;
 			break;
@@ -131,8 +155,8 @@ int FileIo_Open(struct IODriver* driver, const char* filename, StreamerOpenMode
 		return -1;
 	}
 
-	s_handles[hindex] = CreateFile(buffer, access[mode], share[mode], 0, disposition[mode], FILE_ATTRIBUTE_NORMAL, 0);
-	if (s_handles[hindex] == INVALID_HANDLE_VALUE)
+	local->handles[hindex] = CreateFile(buffer, access[mode], share[mode], 0, disposition[mode], FILE_ATTRIBUTE_NORMAL, 0);
+	if (local->handles[hindex] == INVALID_HANDLE_VALUE)
 	{
 		STREAMER_PRINTF(("FileIo: Could not open file\n"));
 		return -1;
@@ -146,23 +170,27 @@ int FileIo_Open(struct IODriver* driver, const char* filename, StreamerOpenMode
 
 int FileIo_Close(struct IODriver* driver, int fd)
 {
+#if defined(_WIN32)
+	FileIoDriver* local = (FileIoDriver*)driver;
+#endif
+
 	STREAMER_PRINTF(("FileIo: close(%d)\n", fd));
 
 #if defined(_WIN32)
-	if ((fd < 0) || (fd >= STREAMER_MAX_FILEHANDLES))
+	if ((fd < 0) || (fd >= FILEIO_MAX_HANDLES))
 	{
 		STREAMER_PRINTF(("FileIo: Invalid file handle\n"));
 		return -1;
 	}
 
-	if (s_handles[fd] == INVALID_HANDLE_VALUE)
+	if (local->handles[fd] == INVALID_HANDLE_VALUE)
 	{
 		STREAMER_PRINTF(("FileIo: File handle not open\n"));
 		return -1;
 	}
 
-	CloseHandle(s_handles[fd]);
-	s_handles[fd] = INVALID_HANDLE_VALUE;
+	CloseHandle(local->handles[fd]);
+	local->handles[fd] = INVALID_HANDLE_VALUE;
 	return 0;
 #else
 	return close(fd);
@@ -172,21 +200,22 @@ int FileIo_Close(struct IODriver* driver, int fd)
 int FileIo_Read(struct IODriver* driver, int fd, void* buffer, unsigned int length)
 {
 #if defined(_WIN32)
+	FileIoDriver* local = (FileIoDriver*)driver;
 	DWORD bytesRead;
 
-	if ((fd < 0) || (fd >= STREAMER_MAX_FILEHANDLES))
+	if ((fd < 0) || (fd >= FILEIO_MAX_HANDLES))
 	{
 		STREAMER_PRINTF(("FileIo: Invalid file handle\n"));
 		return -1;
 	}
 
-	if (s_handles[fd] == INVALID_HANDLE_VALUE)
+	if (local->handles[fd] == INVALID_HANDLE_VALUE)
 	{
 		STREAMER_PRINTF(("FileIo: File handle not open\n"));
 		return -1;
 	}
 
-	if (!ReadFile(s_handles[fd],buffer,(DWORD)length,&bytesRead,0))
+	if (!ReadFile(local->handles[fd],buffer,(DWORD)length,&bytesRead,0))
 	{
 		STREAMER_PRINTF(("FileIo: Read request failed (0x%08lx, %d)\n", GetLastError(), GetLastError()));
 		return -1;
@@ -197,30 +226,415 @@ int FileIo_Read(struct IODriver* driver, int fd, void* buffer, unsigned int leng
 #endif
 }
 
-int FileIo_LSeek(struct IODriver* driver, int fd, int offset, StreamerSeekMode whence)
+StreamerOffset FileIo_LSeek(struct IODriver* driver, int fd, StreamerOffset offset, StreamerSeekMode whence)
 {
 #if defined(_WIN32)
+	FileIoDriver* local = (FileIoDriver*)driver;
 	DWORD moveMethods[] = { FILE_BEGIN, FILE_CURRENT, FILE_END };
 	LARGE_INTEGER in, out;
 
-	if ((fd < 0) || (fd >= STREAMER_MAX_FILEHANDLES))
+	if ((fd < 0) || (fd >= FILEIO_MAX_HANDLES))
 	{
 		STREAMER_PRINTF(("FileIo: Invalid file handle\n"));
 		return -1;
 	}
 
-	if (s_handles[fd] == INVALID_HANDLE_VALUE)
+	if (local->handles[fd] == INVALID_HANDLE_VALUE)
 	{
 		STREAMER_PRINTF(("FileIo: File handle not open\n"));
 		return -1;
 	}
 
 	in.QuadPart = offset;
-	if (!SetFilePointerEx(s_handles[fd], in, &out, moveMethods[whence]))
+	if (!SetFilePointerEx(local->handles[fd], in, &out, moveMethods[whence]))
+		return -1;
+
+	return out.QuadPart;
+#elif defined(_IOP)
+	if ((offset > 0x7fffffff) || (offset < -0x7fffffff))
+	{
+		STREAMER_PRINTF(("FileIo: Seek offset out of range\n"));
 		return -1;
+	}
 
-	return out.LowPart;
+	return lseek(fd,(int)offset,whence);
 #else
-	return lseek(fd,offset,whence);
+	return lseek(fd,(off_t)offset,whence);
 #endif
 }
+
+#if !defined(_IOP)
+int FileIo_PRead(struct IODriver* driver, int fd, void* buffer, unsigned int length, StreamerOffset offset)
+{
+#if defined(_WIN32)
+	FileIoDriver* local = (FileIoDriver*)driver;
+	OVERLAPPED overlapped;
+	DWORD bytesRead;
+
+	if ((fd < 0) || (fd >= FILEIO_MAX_HANDLES))
+	{
+		STREAMER_PRINTF(("FileIo: Invalid file handle\n"));
+		return -1;
+	}
+
+	if (local->handles[fd] == INVALID_HANDLE_VALUE)
+	{
+		STREAMER_PRINTF(("FileIo: File handle not open\n"));
+		return -1;
+	}
+
+	// On synchronous handles the read happens at the given offset and also moves the file pointer
+
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+	if (!ReadFile(local->handles[fd],buffer,(DWORD)length,&bytesRead,&overlapped))
+	{
+		if (GetLastError() == ERROR_HANDLE_EOF)
+		{
+			return 0;
+		}
+
+		STREAMER_PRINTF(("FileIo: Read request failed (0x%08lx, %d)\n", GetLastError(), GetLastError()));
+		return -1;
+	}
+	return bytesRead;
+#else
+	return pread(fd, buffer, length, (off_t)offset);
+#endif
+}
+#endif
+
+#if defined(_WIN32) || defined(STREAMER_UNIX)
+void* FileIo_Map(struct IODriver* driver, int fd, StreamerOffset offset, unsigned int length)
+{
+#if defined(_WIN32)
+	FileIoDriver* local = (FileIoDriver*)driver;
+	SYSTEM_INFO info;
+	StreamerOffset start;
+	HANDLE mapping;
+	char* view;
+
+	if ((fd < 0) || (fd >= FILEIO_MAX_HANDLES))
+	{
+		STREAMER_PRINTF(("FileIo: Invalid file handle\n"));
+		return 0;
+	}
+
+	if (local->handles[fd] == INVALID_HANDLE_VALUE)
+	{
+		STREAMER_PRINTF(("FileIo: File handle not open\n"));
+		return 0;
+	}
+
+	// Views start on allocation granularity boundaries, the offset into the view is handed back
+
+	GetSystemInfo(&info);
+	start = offset - (offset % info.dwAllocationGranularity);
+
+	mapping = CreateFileMapping(local->handles[fd], 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+	{
+		STREAMER_PRINTF(("FileIo: Could not create file mapping (0x%08lx)\n", GetLastError()));
+		return 0;
+	}
+
+	view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, (SIZE_T)(offset - start) + length);
+	CloseHandle(mapping);	// The view keeps the mapping alive
+	if (!view)
+	{
+		STREAMER_PRINTF(("FileIo: Could not map view of file (0x%08lx)\n", GetLastError()));
+		return 0;
+	}
+
+	return view + (offset - start);
+#else
+	off_t start = (off_t)(offset - (offset % sysconf(_SC_PAGESIZE)));
+	char* view;
+
+	// Views start on page boundaries, the offset into the view is handed back
+
+	view = mmap(0, (size_t)(offset - start) + length, PROT_READ, MAP_SHARED, fd, start);
+	if (view == MAP_FAILED)
+	{
+		STREAMER_PRINTF(("FileIo: Could not map file\n"));
+		return 0;
+	}
+
+	return view + (offset - start);
+#endif
+}
+
+void FileIo_Unmap(struct IODriver* driver, void* data, unsigned int length)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	UnmapViewOfFile(((char*)data) - ((size_t)data % info.dwAllocationGranularity));
+#else
+	size_t start = (size_t)data % sysconf(_SC_PAGESIZE);
+
+	munmap(((char*)data) - start, start + length);
+#endif
+}
+#endif
+
+int FileIo_Stat(struct IODriver* driver, const char* filename, StreamerStat* info)
+{
+	FileIoDriver* local = (FileIoDriver*)driver;
+	char buffer[256];
+#if defined(_WIN32)
+	WIN32_FILE_ATTRIBUTE_DATA data;
+#elif defined(_IOP)
+	io_stat_t st;
+#else
+	struct stat st;
+#endif
+
+	strcpy(buffer,local->root);
+	strcat(buffer,filename); // TODO: overflow check
+
+#if defined(_WIN32)
+	if (!GetFileAttributesEx(buffer, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+	{
+		return -1;
+	}
+
+	info->size = (((StreamerOffset)data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+#elif defined(_IOP)
+	if ((getstat(buffer, &st) < 0) || FIO_SO_ISDIR(st.mode))
+	{
+		return -1;
+	}
+
+	info->size = (((StreamerOffset)st.hisize) << 32) | st.size;
+#else
+	if ((stat(buffer, &st) < 0) || S_ISDIR(st.st_mode))
+	{
+		return -1;
+	}
+
+	info->size = st.st_size;
+#endif
+
+	info->compressedSize = info->size;
+	info->compression = 0;
+	return 0;
+}
+
+#if defined(_WIN32)
+typedef struct FileIoDirectory
+{
+	HANDLE handle;
+	WIN32_FIND_DATA data;
+	BOOL pending;
+} FileIoDirectory;
+#endif
+
+int FileIo_DOpen(struct IODriver* driver, const char* pathname)
+{
+	FileIoDriver* local = (FileIoDriver*)driver;
+	char buffer[256];
+#if !defined(_IOP)
+	int i;
+#endif
+
+	strcpy(buffer,local->root);
+	strcat(buffer,pathname); // TODO: overflow check
+
+	STREAMER_PRINTF(("FileIo: dopen(\"%s\")\n", pathname));
+
+#if defined(_IOP)
+	return dopen(buffer);
+#else
+	for (i = 0; i < FILEIO_MAX_DIRECTORIES; ++i)
+	{
+		if (!local->directories[i])
+		{
+			break;
+		}
+	}
+
+	if (i == FILEIO_MAX_DIRECTORIES)
+	{
+		STREAMER_PRINTF(("FileIo: Out of available directory handles\n"));
+		return -1;
+	}
+
+#if defined(_WIN32)
+	{
+		FileIoDirectory* directory = malloc(sizeof(FileIoDirectory));
+
+		strcat(buffer, *buffer ? "\\*" : "*");
+
+		directory->handle = FindFirstFile(buffer, &(directory->data));
+		if (directory->handle == INVALID_HANDLE_VALUE)
+		{
+			STREAMER_PRINTF(("FileIo: Could not open directory\n"));
+			free(directory);
+			return -1;
+		}
+
+		directory->pending = TRUE;
+		local->directories[i] = directory;
+	}
+#else
+	local->directories[i] = opendir(*buffer ? buffer : ".");
+	if (!local->directories[i])
+	{
+		STREAMER_PRINTF(("FileIo: Could not open directory\n"));
+		return -1;
+	}
+#endif
+
+	return i;
+#endif
+}
+
+int FileIo_DClose(struct IODriver* driver, int fd)
+{
+#if !defined(_IOP)
+	FileIoDriver* local = (FileIoDriver*)driver;
+#endif
+
+	STREAMER_PRINTF(("FileIo: dclose(%d)\n", fd));
+
+#if defined(_IOP)
+	return dclose(fd);
+#else
+	if ((fd < 0) || (fd >= FILEIO_MAX_DIRECTORIES) || !local->directories[fd])
+	{
+		STREAMER_PRINTF(("FileIo: Invalid directory handle\n"));
+		return -1;
+	}
+
+#if defined(_WIN32)
+	FindClose(((FileIoDirectory*)local->directories[fd])->handle);
+	free(local->directories[fd]);
+#else
+	closedir((DIR*)local->directories[fd]);
+#endif
+
+	local->directories[fd] = 0;
+	return 0;
+#endif
+}
+
+int FileIo_DRead(struct IODriver* driver, int fd, StreamerDirEntry* entries, unsigned int count)
+{
+#if !defined(_IOP)
+	FileIoDriver* local = (FileIoDriver*)driver;
+#endif
+	unsigned int n = 0;
+
+#if defined(_IOP)
+	io_dirent_t dirent;
+
+	while (n < count)
+	{
+		int result = dread(fd, &dirent);
+		if (result < 0)
+		{
+			STREAMER_PRINTF(("FileIo: Failed reading directory (%d)\n", result));
+			return -1;
+		}
+
+		if (result == 0)
+		{
+			break;
+		}
+
+		if (!strcmp(dirent.name, ".") || !strcmp(dirent.name, ".."))
+		{
+			continue;
+		}
+
+		strncpy(entries[n].name, dirent.name, sizeof(entries[n].name) - 1);
+		entries[n].name[sizeof(entries[n].name) - 1] = '\0';
+		entries[n].type = FIO_SO_ISDIR(dirent.stat.mode) ? StreamerDirEntryType_Directory : StreamerDirEntryType_File;
+		entries[n].size = entries[n].type == StreamerDirEntryType_File ? ((((StreamerOffset)dirent.stat.hisize) << 32) | dirent.stat.size) : 0;
+		++n;
+	}
+#else
+	if ((fd < 0) || (fd >= FILEIO_MAX_DIRECTORIES) || !local->directories[fd])
+	{
+		STREAMER_PRINTF(("FileIo: Invalid directory handle\n"));
+		return -1;
+	}
+
+#if defined(_WIN32)
+	{
+		FileIoDirectory* directory = (FileIoDirectory*)local->directories[fd];
+
+		while (n < count)
+		{
+			WIN32_FIND_DATA* data = &(directory->data);
+
+			if (!directory->pending)
+			{
+				if (!FindNextFile(directory->handle, data))
+				{
+					break;
+				}
+			}
+			directory->pending = FALSE;
+
+			if (!strcmp(data->cFileName, ".") || !strcmp(data->cFileName, ".."))
+			{
+				continue;
+			}
+
+			strncpy(entries[n].name, data->cFileName, sizeof(entries[n].name) - 1);
+			entries[n].name[sizeof(entries[n].name) - 1] = '\0';
+			entries[n].type = (data->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? StreamerDirEntryType_Directory : StreamerDirEntryType_File;
+			entries[n].size = entries[n].type == StreamerDirEntryType_File ? ((((StreamerOffset)data->nFileSizeHigh) << 32) | data->nFileSizeLow) : 0;
+			++n;
+		}
+	}
+#else
+	{
+		// readdir() fetches entries from the kernel in batches (getdents), so only
+		// entries that do not report their type up front need an extra stat call
+
+		DIR* directory = (DIR*)local->directories[fd];
+		struct dirent* dirent;
+
+		while ((n < count) && ((dirent = readdir(directory)) != NULL))
+		{
+			struct stat st;
+
+			if (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, ".."))
+			{
+				continue;
+			}
+
+			strncpy(entries[n].name, dirent->d_name, sizeof(entries[n].name) - 1);
+			entries[n].name[sizeof(entries[n].name) - 1] = '\0';
+			entries[n].type = StreamerDirEntryType_Directory;
+			entries[n].size = 0;
+
+			if (dirent->d_type != DT_DIR)
+			{
+				if (fstatat(dirfd(directory), dirent->d_name, &st, 0) < 0)
+				{
+					STREAMER_PRINTF(("FileIo: Failed querying '%s'\n", dirent->d_name));
+					continue;
+				}
+
+				if (!S_ISDIR(st.st_mode))
+				{
+					entries[n].type = StreamerDirEntryType_File;
+					entries[n].size = st.st_size;
+				}
+			}
+
+			++n;
+		}
+	}
+#endif
+#endif
+
+	return n;
+}
@@ -26,10 +26,18 @@ SOFTWARE.
 
 #include "driver.h"
 
+#define FILEIO_MAX_DIRECTORIES 8
+#define FILEIO_MAX_HANDLES 8
+
 typedef struct FileIoDriver
 {
 	IODriver interface;
 	char root[256];
+
+	void* directories[FILEIO_MAX_DIRECTORIES];	// Platform specific directory state
+#if defined(_WIN32)
+	void* handles[FILEIO_MAX_HANDLES];	// HANDLE for each open file
+#endif
 } FileIoDriver;
 
 #if defined(__cplusplus)
@@ -42,7 +50,15 @@ void FileIo_Destroy(struct IODriver* driver);
 int FileIo_Open(struct IODriver* driver, const char* filename, StreamerOpenMode mode);
 int FileIo_Close(struct IODriver* driver, int fd);
 int FileIo_Read(struct IODriver* driver, int fd, void* buffer, unsigned int length);
-int FileIo_LSeek(struct IODriver* driver, int fd, int offset, StreamerSeekMode whence);
+StreamerOffset FileIo_LSeek(struct IODriver* driver, int fd, StreamerOffset offset, StreamerSeekMode whence);
+int FileIo_PRead(struct IODriver* driver, int fd, void* buffer, unsigned int length, StreamerOffset offset);
+void* FileIo_Map(struct IODriver* driver, int fd, StreamerOffset offset, unsigned int length);
+void FileIo_Unmap(struct IODriver* driver, void* data, unsigned int length);
+int FileIo_Stat(struct IODriver* driver, const char* filename, StreamerStat* info);
+
+int FileIo_DOpen(struct IODriver* driver, const char* pathname);
+int FileIo_DClose(struct IODriver* driver, int fd);
+int FileIo_DRead(struct IODriver* driver, int fd, StreamerDirEntry* entries, unsigned int count);
 
 #if defined(__cplusplus)
 }
@@ -0,0 +1,1398 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "mount.h"
+#include "fileio.h"
+#include "cdvd.h"
+#include "filearchive.h"
+
+#if defined(_IOP)
+#include "../iop/irx_imports.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+#define MOUNT_INDEX_MIN_SIZE (256)
+#define MOUNT_INDEX_BATCH (16)
+
+typedef struct MountList
+{
+	IOListState sub;		// State for the group of requests currently forwarded to a source
+	MountSource* source;		// Source of current group, NULL if no group is active
+	unsigned int end;		// End of current group
+	int failed;
+} MountList;
+
+static void Mount_Destroy(struct IODriver* driver);
+static int Mount_Open(struct IODriver* driver, const char* filename, StreamerOpenMode mode);
+static int Mount_Close(struct IODriver* driver, int fd);
+static int Mount_Read(struct IODriver* driver, int fd, void* buffer, unsigned int length);
+static StreamerOffset Mount_LSeek(struct IODriver* driver, int fd, StreamerOffset offset, StreamerSeekMode whence);
+static int Mount_Stat(struct IODriver* driver, const char* filename, StreamerStat* info);
+static int Mount_LoadList(struct IODriver* driver, IOListState* state);
+
+static int Mount_DOpen(struct IODriver* driver, const char* pathname);
+static int Mount_DClose(struct IODriver* driver, int fd);
+static int Mount_DRead(struct IODriver* driver, int fd, StreamerDirEntry* entries, unsigned int count);
+
+static void* Mount_Alloc(unsigned int size);
+static void Mount_Free(void* data);
+static int Mount_Reserve(void** data, unsigned int used, unsigned int size);
+
+static int Mount_Normalize(const char* path, char* buffer);
+static int Mount_HashKey(const char* filename, char* buffer);
+static unsigned int Mount_Hash(const char* key);
+static int Mount_Join(char* buffer, const char* path, const char* name);
+
+static const MountIndexEntry* Mount_Lookup(MountDriver* driver, const char* key);
+static int Mount_Insert(MountDriver* driver, const char* key, int source, int type);
+static void Mount_Rehash(MountDriver* driver, unsigned int* table, unsigned int size);
+static void Mount_Clear(MountDriver* driver);
+static int Mount_Rebuild(MountDriver* driver);
+static int Mount_IndexSource(MountDriver* driver, int source);
+static int Mount_IndexHashes(MountDriver* driver, int source);
+static void Mount_Reassign(MountDriver* driver, int slot);
+
+static int Mount_Rank(MountDriver* driver, int slot);
+static void Mount_Unlink(MountDriver* driver, int slot);
+static int Mount_Probe(MountSource* source, const char* path, int type);
+static MountSource* Mount_Locate(MountDriver* driver, const char* filename);
+static int Mount_Visible(MountDriver* driver, MountDirectory* directory, const StreamerDirEntry* entry);
+
+IODriver* Mount_Create(StreamerTransport transport)
+{
+	MountDriver* driver = Mount_Alloc(sizeof(MountDriver));
+	int i;
+
+	if (!driver)
+	{
+		STREAMER_PRINTF(("Mount: Failed allocating driver\n"));
+		return 0;
+	}
+
+	memset(driver, 0, sizeof(MountDriver));
+
+	driver->interface.destroy = Mount_Destroy;
+	driver->interface.open = Mount_Open;
+	driver->interface.close = Mount_Close;
+	driver->interface.read = Mount_Read;
+	driver->interface.lseek = Mount_LSeek;
+	driver->interface.stat = Mount_Stat;
+	driver->interface.dopen = Mount_DOpen;
+	driver->interface.dclose = Mount_DClose;
+	driver->interface.dread = Mount_DRead;
+	driver->interface.loadlist = Mount_LoadList;
+
+	driver->transport = transport;
+	Simulated_SetModel(&(driver->device), 0);
+
+	for (i = 0; i < MOUNT_MAX_HANDLES; ++i)
+	{
+		driver->handles[i].source = -1;
+		driver->directories[i].rank = -1;
+	}
+
+	STREAMER_PRINTF(("Mount: Driver created\n"));
+	return &(driver->interface);
+}
+
+int Mount_Add(IODriver* driver, StreamerContainer container, const char* root, const char* file, int priority)
+{
+	MountDriver* local = (MountDriver*)driver;
+	MountSource* source;
+	IODriver* native = 0;
+	IODriver* logic = 0;
+	int slot, rank, result = 0, i;
+
+	STREAMER_PRINTF(("Mount: add(%d, \"%s\", \"%s\", %d)\n", container, root, file, priority));
+
+	for (i = 0; i < MOUNT_MAX_HANDLES; ++i)
+	{
+		if (local->directories[i].rank >= 0)
+		{
+			STREAMER_PRINTF(("Mount: Cannot change mounts while directories are open\n"));
+			return -1;
+		}
+	}
+
+	for (slot = 0; slot < MOUNT_MAX_SOURCES; ++slot)
+	{
+		if (!local->sources[slot].native)
+		{
+			break;
+		}
+	}
+
+	if (slot == MOUNT_MAX_SOURCES)
+	{
+		STREAMER_PRINTF(("Mount: Out of available mount slots\n"));
+		return -1;
+	}
+
+	switch (local->transport)
+	{
+		case StreamerTransport_FileIo:
+		{
+			native = FileIo_Create(root);
+		}
+		break;
+
+		case StreamerTransport_Cdvd:
+		{
+			native = Cdvd_Create();
+		}
+		break;
+
+		case StreamerTransport_Simulated:
+		{
+			native = Simulated_Create(root, &(local->device));
+		}
+		break;
+	}
+
+	if (!native)
+	{
+		STREAMER_PRINTF(("Mount: Failed to initialize native layer\n"));
+		return -1;
+	}
+
+	switch (container)
+	{
+		case StreamerContainer_Direct:
+		{
+			logic = native;
+		}
+		break;
+
+		case StreamerContainer_FileArchive:
+		{
+			logic = FileArchive_Create(native, file);
+			if (logic)
+			{
+				FileArchive_SetVerify(logic, local->verify);
+			}
+		}
+		break;
+	}
+
+	if (!logic)
+	{
+		STREAMER_PRINTF(("Mount: Failed to initialize logical layer\n"));
+		native->destroy(native);
+		return -1;
+	}
+
+	native->stats = local->interface.stats;
+	logic->stats = local->interface.stats;
+	native->trace = local->interface.trace;
+	logic->trace = local->interface.trace;
+
+	source = &(local->sources[slot]);
+	source->native = native;
+	source->driver = logic;
+	source->container = container;
+	source->priority = priority;
+
+	// Most recently mounted source wins among sources with equal priority
+
+	for (rank = 0; rank < local->count; ++rank)
+	{
+		if (local->sources[local->order[rank]].priority <= priority)
+		{
+			break;
+		}
+	}
+
+	for (i = local->count; i > rank; --i)
+	{
+		local->order[i] = local->order[i-1];
+	}
+	local->order[rank] = slot;
+	++local->count;
+
+	// Once the index is built only the new source is walked, taking over the paths it outranks
+
+	if (!local->indexed)
+	{
+		result = Mount_Rebuild(local);
+	}
+	else if (container == StreamerContainer_FileArchive)
+	{
+		result = Mount_IndexSource(local, slot);
+		STREAMER_PRINTF(("Mount: Indexed %u paths and content hashes from %d sources\n", local->index.count, local->count));
+	}
+
+	if (result < 0)
+	{
+		STREAMER_PRINTF(("Mount: Failed indexing mounted source\n"));
+		Mount_Unlink(local, slot);
+		Mount_Rebuild(local);
+		return -1;
+	}
+
+	return slot;
+}
+
+int Mount_Remove(IODriver* driver, int id)
+{
+	MountDriver* local = (MountDriver*)driver;
+	StreamerContainer container;
+	int i;
+
+	STREAMER_PRINTF(("Mount: remove(%d)\n", id));
+
+	if ((id < 0) || (id >= MOUNT_MAX_SOURCES) || !local->sources[id].native)
+	{
+		STREAMER_PRINTF(("Mount: Invalid mount id\n"));
+		return -1;
+	}
+
+	for (i = 0; i < MOUNT_MAX_HANDLES; ++i)
+	{
+		if (local->handles[i].source == id)
+		{
+			STREAMER_PRINTF(("Mount: Cannot remove source while files are open in it\n"));
+			return -1;
+		}
+
+		if (local->directories[i].rank >= 0)
+		{
+			STREAMER_PRINTF(("Mount: Cannot change mounts while directories are open\n"));
+			return -1;
+		}
+	}
+
+	if (local->lists > 0)
+	{
+		STREAMER_PRINTF(("Mount: Cannot remove source while lists are loading\n"));
+		return -1;
+	}
+
+	container = local->sources[id].container;
+	Mount_Unlink(local, id);
+
+	// Only the paths the source provided need a new owner, unless a lone source remains which is not indexed
+
+	if (local->indexed && (local->count > 1))
+	{
+		if (container == StreamerContainer_FileArchive)
+		{
+			Mount_Reassign(local, id);
+		}
+	}
+	else if (Mount_Rebuild(local) < 0)
+	{
+		STREAMER_PRINTF(("Mount: Failed indexing remaining sources\n"));
+	}
+
+	return 0;
+}
+
+int Mount_SetDeviceModel(IODriver* driver, const StreamerDeviceModel* model)
+{
+	MountDriver* local = (MountDriver*)driver;
+
+	if (local->transport != StreamerTransport_Simulated)
+	{
+		STREAMER_PRINTF(("Mount: Device model requires the simulated transport\n"));
+		return -1;
+	}
+
+	Simulated_SetModel(&(local->device), model);
+	return 0;
+}
+
+void Mount_SetVerify(IODriver* driver, int verify)
+{
+	MountDriver* local = (MountDriver*)driver;
+	int i;
+
+	local->verify = verify;
+
+	for (i = 0; i < MOUNT_MAX_SOURCES; ++i)
+	{
+		MountSource* source = &(local->sources[i]);
+
+		if (source->native && (source->container == StreamerContainer_FileArchive))
+		{
+			FileArchive_SetVerify(source->driver, verify);
+		}
+	}
+}
+
+static void Mount_Destroy(struct IODriver* driver)
+{
+	MountDriver* local = (MountDriver*)driver;
+	int i;
+
+	for (i = 0; i < MOUNT_MAX_SOURCES; ++i)
+	{
+		MountSource* source = &(local->sources[i]);
+
+		if (!source->native)
+		{
+			continue;
+		}
+
+		if (source->driver != source->native)
+		{
+			source->driver->destroy(source->driver);
+		}
+		source->native->destroy(source->native);
+	}
+
+	Mount_Clear(local);
+	Mount_Free(local->index.table);
+	Mount_Free(local->index.entries);
+	Mount_Free(local->index.names);
+	Mount_Free(local);
+
+	STREAMER_PRINTF(("Mount: Driver destroyed\n"));
+}
+
+static int Mount_Open(struct IODriver* driver, const char* filename, StreamerOpenMode mode)
+{
+	MountDriver* local = (MountDriver*)driver;
+	const MountIndexEntry* hit = 0;
+	MountHandle* handle = 0;
+	char key[MOUNT_MAX_PATH];
+	int fd = -1, rank, i;
+
+	for (i = 0; i < MOUNT_MAX_HANDLES; ++i)
+	{
+		if (local->handles[i].source < 0)
+		{
+			handle = &(local->handles[i]);
+			break;
+		}
+	}
+
+	if (!handle)
+	{
+		STREAMER_PRINTF(("Mount: Out of available file handles\n"));
+		return -1;
+	}
+
+	if ((mode == StreamerOpenMode_Read) && (filename[0] == '@'))
+	{
+		hit = Mount_HashKey(filename, key) < 0 ? 0 : Mount_Lookup(local, key);
+	}
+	else if (mode == StreamerOpenMode_Read)
+	{
+		if (Mount_Normalize(filename, key) < 0)
+		{
+			STREAMER_PRINTF(("Mount: Path too long '%s'\n", filename));
+			return -1;
+		}
+		hit = Mount_Lookup(local, key);
+	}
+
+	for (rank = 0; rank < local->count; ++rank)
+	{
+		int slot = local->order[rank];
+		MountSource* source = &(local->sources[slot]);
+
+		// Indexed sources are only visited when the index says they provide the file, by path or by content hash
+
+		if (local->indexed && (source->container != StreamerContainer_Direct) && (!hit || (hit->source != slot)))
+		{
+			continue;
+		}
+
+		fd = source->driver->open(source->driver, filename, mode);
+		if (fd >= 0)
+		{
+			handle->source = slot;
+			handle->fd = fd;
+			return handle - local->handles;
+		}
+
+		// Writes only go to the highest priority direct source
+
+		if ((mode != StreamerOpenMode_Read) || (hit && (hit->source == slot)))
+		{
+			break;
+		}
+	}
+
+	STREAMER_PRINTF(("Mount: Could not find file '%s'\n", filename));
+	return -1;
+}
+
+static int Mount_Close(struct IODriver* driver, int fd)
+{
+	MountDriver* local = (MountDriver*)driver;
+	MountHandle* handle;
+	IODriver* target;
+
+	if ((fd < 0) || (fd >= MOUNT_MAX_HANDLES) || (local->handles[fd].source < 0))
+	{
+		STREAMER_PRINTF(("Mount: Invalid file handle\n"));
+		return -1;
+	}
+
+	handle = &(local->handles[fd]);
+	target = local->sources[handle->source].driver;
+	handle->source = -1;
+
+	return target->close(target, handle->fd);
+}
+
+static int Mount_Read(struct IODriver* driver, int fd, void* buffer, unsigned int length)
+{
+	MountDriver* local = (MountDriver*)driver;
+	IODriver* target;
+
+	if ((fd < 0) || (fd >= MOUNT_MAX_HANDLES) || (local->handles[fd].source < 0))
+	{
+		STREAMER_PRINTF(("Mount: Invalid file handle\n"));
+		return -1;
+	}
+
+	target = local->sources[local->handles[fd].source].driver;
+	return target->read(target, local->handles[fd].fd, buffer, length);
+}
+
+static StreamerOffset Mount_LSeek(struct IODriver* driver, int fd, StreamerOffset offset, StreamerSeekMode whence)
+{
+	MountDriver* local = (MountDriver*)driver;
+	IODriver* target;
+
+	if ((fd < 0) || (fd >= MOUNT_MAX_HANDLES) || (local->handles[fd].source < 0))
+	{
+		STREAMER_PRINTF(("Mount: Invalid file handle\n"));
+		return -1;
+	}
+
+	target = local->sources[local->handles[fd].source].driver;
+	return target->lseek(target, local->handles[fd].fd, offset, whence);
+}
+
+static int Mount_Stat(struct IODriver* driver, const char* filename, StreamerStat* info)
+{
+	MountDriver* local = (MountDriver*)driver;
+	MountSource* source = Mount_Locate(local, filename);
+
+	if (!source || !source->driver->stat)
+	{
+		return -1;
+	}
+
+	return source->driver->stat(source->driver, filename, info);
+}
+
+static int Mount_LoadList(struct IODriver* driver, IOListState* state)
+{
+	MountDriver* local = (MountDriver*)driver;
+	MountList* list = (MountList*)state->data;
+	int result;
+
+	if (!state->prepared)
+	{
+		IOListItem* sorted;
+		unsigned int counts[MOUNT_MAX_SOURCES + 1];
+		unsigned int i;
+
+		list = Mount_Alloc(sizeof(MountList) + state->count * sizeof(IOListItem));
+		if (!list)
+		{
+			STREAMER_PRINTF(("Mount: Failed allocating list state\n"));
+			return -1;
+		}
+		memset(list, 0, sizeof(MountList));
+		sorted = (IOListItem*)(list + 1);
+
+		// Group requests by source, unresolved requests first
+
+		memset(counts, 0, sizeof(counts));
+		for (i = 0; i < state->count; ++i)
+		{
+			IOListItem* item = &(state->items[i]);
+			MountSource* source = Mount_Locate(local, state->requests[item->index].filename);
+
+			item->data = source;
+			++counts[source ? (source - local->sources) + 1 : 0];
+
+			if (!source)
+			{
+				state->requests[item->index].result = StreamerResult_Error;
+			}
+		}
+
+		for (i = 1; i <= MOUNT_MAX_SOURCES; ++i)
+		{
+			counts[i] += counts[i-1];
+		}
+
+		for (i = state->count; i > 0; --i)
+		{
+			const IOListItem* item = &(state->items[i-1]);
+			const MountSource* source = (const MountSource*)item->data;
+
+			sorted[--counts[source ? (source - local->sources) + 1 : 0]] = *item;
+		}
+
+		for (i = 0; (i < state->count) && !sorted[i].data; ++i);
+		memcpy(state->items, sorted, state->count * sizeof(IOListItem));
+
+		list->end = i;
+
+		state->data = list;
+		state->cursor = i;
+		state->prepared = 1;
+
+		++local->lists;
+	}
+
+	if (list->source)
+	{
+		IODriver* target = list->source->driver;
+
+		result = target->loadlist ? target->loadlist(target, &(list->sub)) : IODriver_LoadList(target, &(list->sub));
+		if (result > 0)
+		{
+			return 1;
+		}
+
+		if (result < 0)
+		{
+			unsigned int i;
+
+			for (i = 0; i < list->sub.count; ++i)
+			{
+				StreamerLoadRequest* request = &(state->requests[list->sub.items[i].index]);
+				if (request->result == StreamerResult_Pending)
+				{
+					request->result = StreamerResult_Error;
+				}
+			}
+
+			list->failed = 1;
+		}
+
+		state->loaded += list->sub.loaded;
+		state->cursor = list->end;
+		list->source = 0;
+	}
+
+	if (state->cursor == state->count)
+	{
+		result = list->failed ? -1 : 0;
+
+		Mount_Free(list);
+		state->data = 0;
+		--local->lists;
+
+		return result;
+	}
+
+	// Forward the next group of requests to its source
+
+	list->source = (MountSource*)state->items[state->cursor].data;
+	for (list->end = state->cursor; (list->end < state->count) && (state->items[list->end].data == list->source); ++list->end)
+	{
+		state->items[list->end].data = 0;
+	}
+
+	memset(&(list->sub), 0, sizeof(IOListState));
+	list->sub.requests = state->requests;
+	list->sub.count = list->end - state->cursor;
+	list->sub.items = &(state->items[state->cursor]);
+	list->sub.fd = -1;
+
+	return 1;
+}
+
+static int Mount_DOpen(struct IODriver* driver, const char* pathname)
+{
+	MountDriver* local = (MountDriver*)driver;
+	MountDirectory* directory = 0;
+	int rank, i;
+
+	for (i = 0; i < MOUNT_MAX_HANDLES; ++i)
+	{
+		if (local->directories[i].rank < 0)
+		{
+			directory = &(local->directories[i]);
+			break;
+		}
+	}
+
+	if (!directory)
+	{
+		STREAMER_PRINTF(("Mount: Out of available directory handles\n"));
+		return -1;
+	}
+
+	if ((strlen(pathname) >= MOUNT_MAX_PATH) || (Mount_Normalize(pathname, directory->key) < 0))
+	{
+		STREAMER_PRINTF(("Mount: Path too long '%s'\n", pathname));
+		return -1;
+	}
+
+	// Merged listing starts at the highest priority source that has the directory
+
+	for (rank = 0; rank < local->count; ++rank)
+	{
+		IODriver* target = local->sources[local->order[rank]].driver;
+
+		if (!target->dopen)
+		{
+			continue;
+		}
+
+		directory->fd = target->dopen(target, pathname);
+		if (directory->fd >= 0)
+		{
+			strcpy(directory->path, pathname);
+			directory->rank = rank;
+			return directory - local->directories;
+		}
+	}
+
+	STREAMER_PRINTF(("Mount: Could not find directory '%s'\n", pathname));
+	return -1;
+}
+
+static int Mount_DClose(struct IODriver* driver, int fd)
+{
+	MountDriver* local = (MountDriver*)driver;
+	MountDirectory* directory;
+
+	if ((fd < 0) || (fd >= MOUNT_MAX_HANDLES) || (local->directories[fd].rank < 0))
+	{
+		STREAMER_PRINTF(("Mount: Invalid directory handle\n"));
+		return -1;
+	}
+
+	directory = &(local->directories[fd]);
+	if ((directory->fd >= 0) && (directory->rank < local->count))
+	{
+		IODriver* target = local->sources[local->order[directory->rank]].driver;
+		target->dclose(target, directory->fd);
+	}
+
+	directory->rank = -1;
+	return 0;
+}
+
+static int Mount_DRead(struct IODriver* driver, int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	MountDriver* local = (MountDriver*)driver;
+	MountDirectory* directory;
+	unsigned int n = 0;
+
+	if ((fd < 0) || (fd >= MOUNT_MAX_HANDLES) || (local->directories[fd].rank < 0))
+	{
+		STREAMER_PRINTF(("Mount: Invalid directory handle\n"));
+		return -1;
+	}
+
+	directory = &(local->directories[fd]);
+	while ((n < count) && (directory->rank < local->count))
+	{
+		IODriver* target = local->sources[local->order[directory->rank]].driver;
+		unsigned int kept;
+		int result, i;
+
+		if (directory->fd < 0)
+		{
+			directory->fd = target->dopen ? target->dopen(target, directory->path) : -1;
+			if (directory->fd < 0)
+			{
+				++directory->rank;
+				continue;
+			}
+		}
+
+		result = target->dread(target, directory->fd, entries + n, count - n);
+		if (result <= 0)
+		{
+			target->dclose(target, directory->fd);
+			directory->fd = -1;
+			++directory->rank;
+			continue;
+		}
+
+		// Drop entries shadowed by higher priority sources
+
+		for (i = 0, kept = n; i < result; ++i)
+		{
+			if (!Mount_Visible(local, directory, &(entries[n + i])))
+			{
+				continue;
+			}
+
+			if (kept != (n + i))
+			{
+				entries[kept] = entries[n + i];
+			}
+			++kept;
+		}
+		n = kept;
+	}
+
+	return n;
+}
+
+static void* Mount_Alloc(unsigned int size)
+{
+#if defined(_IOP)
+	return AllocSysMemory(ALLOC_FIRST, size, 0);
+#else
+	return malloc(size);
+#endif
+}
+
+static void Mount_Free(void* data)
+{
+	if (!data)
+	{
+		return;
+	}
+
+#if defined(_IOP)
+	FreeSysMemory(data);
+#else
+	free(data);
+#endif
+}
+
+static int Mount_Reserve(void** data, unsigned int used, unsigned int size)
+{
+	void* buffer = Mount_Alloc(size);
+	if (!buffer)
+	{
+		return -1;
+	}
+
+	if (*data)
+	{
+		memcpy(buffer, *data, used);
+		Mount_Free(*data);
+	}
+
+	*data = buffer;
+	return 0;
+}
+
+static int Mount_Normalize(const char* path, char* buffer)
+{
+	int length = 0;
+
+	// Drop empty path components, matching how containers resolve paths
+
+	while (*path)
+	{
+		if (*path == '/')
+		{
+			++path;
+			continue;
+		}
+
+		if (length > 0)
+		{
+			if (length >= MOUNT_MAX_PATH - 1)
+			{
+				return -1;
+			}
+			buffer[length++] = '/';
+		}
+
+		while (*path && (*path != '/'))
+		{
+			if (length >= MOUNT_MAX_PATH - 1)
+			{
+				return -1;
+			}
+			buffer[length++] = *path++;
+		}
+	}
+
+	buffer[length] = 0;
+	return length;
+}
+
+/**
+ *
+ * Build the index key of a content hash path, '@' followed by the hash in lower case hex
+ *
+ * \return Length of key, <0 if filename does not start with a complete hash
+ *
+**/
+static int Mount_HashKey(const char* filename, char* buffer)
+{
+	int length;
+
+	buffer[0] = '@';
+	for (length = 1; length <= (int)sizeof(fa_hash_t) * 2; ++length)
+	{
+		char c = filename[length];
+
+		if ((c >= 'A') && (c <= 'F'))
+		{
+			c += 'a' - 'A';
+		}
+		else if (!(((c >= '0') && (c <= '9')) || ((c >= 'a') && (c <= 'f'))))
+		{
+			return -1;
+		}
+
+		buffer[length] = c;
+	}
+
+	buffer[length] = 0;
+	return length;
+}
+
+static unsigned int Mount_Hash(const char* key)
+{
+	unsigned int hash = 2166136261u;
+
+	while (*key)
+	{
+		hash = (hash ^ (unsigned char)*key++) * 16777619u;
+	}
+
+	return hash;
+}
+
+static int Mount_Join(char* buffer, const char* path, const char* name)
+{
+	unsigned int length = strlen(path);
+
+	if ((length + strlen(name) + 2) > MOUNT_MAX_PATH)
+	{
+		return -1;
+	}
+
+	strcpy(buffer, path);
+	if ((length > 0) && (buffer[length-1] != '/'))
+	{
+		buffer[length++] = '/';
+	}
+	strcpy(buffer + length, name);
+
+	return 0;
+}
+
+static const MountIndexEntry* Mount_Lookup(MountDriver* driver, const char* key)
+{
+	unsigned int hash, slot;
+
+	if (!driver->index.count)
+	{
+		return 0;
+	}
+
+	hash = Mount_Hash(key);
+	for (slot = hash & driver->index.mask; driver->index.table[slot]; slot = (slot + 1) & driver->index.mask)
+	{
+		const MountIndexEntry* entry = &(driver->index.entries[driver->index.table[slot] - 1]);
+
+		if ((entry->hash == hash) && !strcmp(driver->index.names + entry->name, key))
+		{
+			return entry;
+		}
+	}
+
+	return 0;
+}
+
+static int Mount_Insert(MountDriver* driver, const char* key, int source, int type)
+{
+	unsigned int length = strlen(key) + 1;
+	unsigned int hash = Mount_Hash(key);
+	MountIndexEntry* entry;
+	unsigned int slot;
+
+	// Keep the table at most half full
+
+	if (((driver->index.count + 1) * 2) > (driver->index.mask + 1))
+	{
+		unsigned int size = driver->index.table ? (driver->index.mask + 1) * 2 : MOUNT_INDEX_MIN_SIZE;
+		unsigned int* table = Mount_Alloc(size * sizeof(unsigned int));
+
+		if (!table)
+		{
+			return -1;
+		}
+
+		Mount_Rehash(driver, table, size);
+
+		Mount_Free(driver->index.table);
+		driver->index.table = table;
+		driver->index.mask = size - 1;
+	}
+
+	for (slot = hash & driver->index.mask; driver->index.table[slot]; slot = (slot + 1) & driver->index.mask)
+	{
+		entry = &(driver->index.entries[driver->index.table[slot] - 1]);
+		if ((entry->hash == hash) && !strcmp(driver->index.names + entry->name, key))
+		{
+			// Sources indexed after the owner take the path over when they outrank it
+
+			if (Mount_Rank(driver, source) < Mount_Rank(driver, entry->source))
+			{
+				entry->source = (unsigned short)source;
+				entry->type = (unsigned short)type;
+			}
+
+			return driver->index.table[slot] - 1;
+		}
+	}
+
+	if (driver->index.count == driver->index.capacity)
+	{
+		unsigned int capacity = driver->index.capacity ? driver->index.capacity * 2 : MOUNT_INDEX_MIN_SIZE;
+
+		if (Mount_Reserve((void**)&(driver->index.entries), driver->index.count * sizeof(MountIndexEntry), capacity * sizeof(MountIndexEntry)) < 0)
+		{
+			return -1;
+		}
+		driver->index.capacity = capacity;
+	}
+
+	if ((driver->index.size + length) > driver->index.reserved)
+	{
+		unsigned int reserved = driver->index.reserved ? driver->index.reserved : MOUNT_INDEX_MIN_SIZE * 16;
+
+		while ((driver->index.size + length) > reserved)
+		{
+			reserved *= 2;
+		}
+
+		if (Mount_Reserve((void**)&(driver->index.names), driver->index.size, reserved) < 0)
+		{
+			return -1;
+		}
+		driver->index.reserved = reserved;
+	}
+
+	entry = &(driver->index.entries[driver->index.count]);
+	entry->hash = hash;
+	entry->name = driver->index.size;
+	entry->source = (unsigned short)source;
+	entry->type = (unsigned short)type;
+
+	memcpy(driver->index.names + driver->index.size, key, length);
+	driver->index.size += length;
+
+	driver->index.table[slot] = ++driver->index.count;
+	return driver->index.count - 1;
+}
+
+/**
+ *
+ * Fill an open addressed table of the given size, a power of two, with all entries
+ *
+**/
+static void Mount_Rehash(MountDriver* driver, unsigned int* table, unsigned int size)
+{
+	unsigned int slot, i;
+
+	memset(table, 0, size * sizeof(unsigned int));
+	for (i = 0; i < driver->index.count; ++i)
+	{
+		for (slot = driver->index.entries[i].hash & (size - 1); table[slot]; slot = (slot + 1) & (size - 1));
+		table[slot] = i + 1;
+	}
+}
+
+static void Mount_Clear(MountDriver* driver)
+{
+	if (driver->index.table)
+	{
+		memset(driver->index.table, 0, (driver->index.mask + 1) * sizeof(unsigned int));
+	}
+
+	driver->index.count = 0;
+	driver->index.size = 0;
+}
+
+static int Mount_Rebuild(MountDriver* driver)
+{
+	int rank;
+
+	Mount_Clear(driver);
+
+	// A lone source has nothing to shadow, so it is not walked up front and lookups go straight to it
+
+	driver->indexed = driver->count > 1;
+	if (!driver->indexed)
+	{
+		return 0;
+	}
+
+	// Index in priority order, so the first source to insert a path owns it and no paths have to change hands
+
+	for (rank = 0; rank < driver->count; ++rank)
+	{
+		int slot = driver->order[rank];
+
+		if (driver->sources[slot].container != StreamerContainer_FileArchive)
+		{
+			continue;
+		}
+
+		if (Mount_IndexSource(driver, slot) < 0)
+		{
+			Mount_Clear(driver);
+			return -1;
+		}
+	}
+
+	STREAMER_PRINTF(("Mount: Indexed %u paths and content hashes from %d sources\n", driver->index.count, driver->count));
+	return 0;
+}
+
+static int Mount_IndexSource(MountDriver* driver, int source)
+{
+	IODriver* target = driver->sources[source].driver;
+	StreamerDirEntry* entries;
+	unsigned int* pending = 0;
+	unsigned int head = 0, tail = 0, capacity = 0;
+	char path[MOUNT_MAX_PATH];
+	char key[MOUNT_MAX_PATH];
+	int result = 0;
+
+	if (!target->dopen)
+	{
+		return 0;
+	}
+
+	entries = Mount_Alloc(MOUNT_INDEX_BATCH * sizeof(StreamerDirEntry));
+	if (!entries)
+	{
+		return -1;
+	}
+
+	// Breadth first walk, so that only one directory handle is used at a time
+
+	path[0] = 0;
+	do
+	{
+		int fd, count, i;
+
+		fd = target->dopen(target, path);
+		if (fd < 0)
+		{
+			STREAMER_PRINTF(("Mount: Failed listing '%s'\n", path));
+			result = -1;
+			break;
+		}
+
+		while ((count = target->dread(target, fd, entries, MOUNT_INDEX_BATCH)) > 0)
+		{
+			for (i = 0; i < count; ++i)
+			{
+				int index;
+
+				if ((Mount_Join(key, path, entries[i].name) < 0) || ((index = Mount_Insert(driver, key, source, entries[i].type)) < 0))
+				{
+					result = -1;
+					break;
+				}
+
+				if (entries[i].type != StreamerDirEntryType_Directory)
+				{
+					continue;
+				}
+
+				if ((tail == capacity) && (Mount_Reserve((void**)&pending, tail * sizeof(unsigned int), (capacity = capacity ? capacity * 2 : MOUNT_INDEX_BATCH) * sizeof(unsigned int)) < 0))
+				{
+					result = -1;
+					break;
+				}
+				pending[tail++] = driver->index.entries[index].name;
+			}
+
+			if (result < 0)
+			{
+				break;
+			}
+		}
+
+		target->dclose(target, fd);
+
+		if ((result < 0) || (head == tail))
+		{
+			break;
+		}
+
+		strcpy(path, driver->index.names + pending[head++]);
+	}
+	while (1);
+
+	Mount_Free(pending);
+	Mount_Free(entries);
+
+	return result < 0 ? result : Mount_IndexHashes(driver, source);
+}
+
+static int Mount_IndexHashes(MountDriver* driver, int source)
+{
+	static const char digits[] = "0123456789abcdef";
+	const fa_hash_t* hashes;
+	char key[sizeof(fa_hash_t) * 2 + 2];
+	int count, i, j;
+
+	// Content hashes are keyed like the paths that open them, so '@' lookups resolve to a source the same way
+
+	count = FileArchive_Hashes(driver->sources[source].driver, &hashes);
+	if (count < 0)
+	{
+		STREAMER_PRINTF(("Mount: Failed reading content hashes\n"));
+		return -1;
+	}
+
+	key[0] = '@';
+	key[sizeof(key) - 1] = 0;
+
+	for (i = 0; i < count; ++i)
+	{
+		for (j = 0; j < (int)sizeof(fa_hash_t); ++j)
+		{
+			key[1 + j * 2] = digits[hashes[i].data[j] >> 4];
+			key[2 + j * 2] = digits[hashes[i].data[j] & 15];
+		}
+
+		if (Mount_Insert(driver, key, source, StreamerDirEntryType_File) < 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ *
+ * Hand the paths and content hashes of a removed source to the highest priority remaining source that provides them,
+ * dropping those that no other source provides
+ *
+ * \note Must be called after the source is unlinked, other sources are probed so only the affected paths are visited
+ *
+**/
+static void Mount_Reassign(MountDriver* driver, int slot)
+{
+	unsigned int count = 0, size = 0, i;
+
+	// Names are pooled in entry order, so entries and names are compacted in place as dropped paths are skipped
+
+	for (i = 0; i < driver->index.count; ++i)
+	{
+		MountIndexEntry entry = driver->index.entries[i];
+		const char* key = driver->index.names + entry.name;
+		unsigned int length = strlen(key) + 1;
+
+		if (entry.source == slot)
+		{
+			int rank;
+
+			for (rank = 0; rank < driver->count; ++rank)
+			{
+				MountSource* source = &(driver->sources[driver->order[rank]]);
+
+				if (source->container != StreamerContainer_FileArchive)
+				{
+					continue;
+				}
+
+				if (Mount_Probe(source, key, StreamerDirEntryType_File))
+				{
+					entry.type = StreamerDirEntryType_File;
+					break;
+				}
+
+				if ((key[0] != '@') && Mount_Probe(source, key, StreamerDirEntryType_Directory))
+				{
+					entry.type = StreamerDirEntryType_Directory;
+					break;
+				}
+			}
+
+			if (rank == driver->count)
+			{
+				continue;
+			}
+
+			entry.source = (unsigned short)driver->order[rank];
+		}
+
+		memmove(driver->index.names + size, key, length);
+		entry.name = size;
+		size += length;
+
+		driver->index.entries[count++] = entry;
+	}
+
+	driver->index.count = count;
+	driver->index.size = size;
+
+	if (driver->index.table)
+	{
+		Mount_Rehash(driver, driver->index.table, driver->index.mask + 1);
+	}
+
+	STREAMER_PRINTF(("Mount: Indexed %u paths and content hashes from %d sources\n", driver->index.count, driver->count));
+}
+
+static int Mount_Rank(MountDriver* driver, int slot)
+{
+	int rank;
+
+	for (rank = 0; (rank < driver->count) && (driver->order[rank] != slot); ++rank);
+	return rank;
+}
+
+static void Mount_Unlink(MountDriver* driver, int slot)
+{
+	MountSource* source = &(driver->sources[slot]);
+	int rank = Mount_Rank(driver, slot), i;
+
+	for (i = rank + 1; i < driver->count; ++i)
+	{
+		driver->order[i-1] = driver->order[i];
+	}
+	--driver->count;
+
+	if (source->driver != source->native)
+	{
+		source->driver->destroy(source->driver);
+	}
+	source->native->destroy(source->native);
+	source->native = source->driver = 0;
+}
+
+static int Mount_Probe(MountSource* source, const char* path, int type)
+{
+	IODriver* target = source->driver;
+	int fd;
+
+	if (type == StreamerDirEntryType_Directory)
+	{
+		if (!target->dopen || ((fd = target->dopen(target, path)) < 0))
+		{
+			return 0;
+		}
+
+		target->dclose(target, fd);
+		return 1;
+	}
+
+	if (target->stat)
+	{
+		StreamerStat info;
+
+		memset(&info, 0, sizeof(info));
+		info.filename = path;
+
+		return target->stat(target, path, &info) >= 0;
+	}
+
+	if ((fd = target->open(target, path, StreamerOpenMode_Read)) < 0)
+	{
+		return 0;
+	}
+
+	target->close(target, fd);
+	return 1;
+}
+
+static MountSource* Mount_Locate(MountDriver* driver, const char* filename)
+{
+	const MountIndexEntry* hit = 0;
+	char key[MOUNT_MAX_PATH];
+	int rank;
+
+	if (filename[0] == '@')
+	{
+		hit = Mount_HashKey(filename, key) < 0 ? 0 : Mount_Lookup(driver, key);
+	}
+	else if (Mount_Normalize(filename, key) < 0)
+	{
+		return 0;
+	}
+	else
+	{
+		hit = Mount_Lookup(driver, key);
+	}
+
+	for (rank = 0; rank < driver->count; ++rank)
+	{
+		int slot = driver->order[rank];
+		MountSource* source = &(driver->sources[slot]);
+
+		if (hit && (hit->source == slot))
+		{
+			return (hit->type == StreamerDirEntryType_File) ? source : 0;
+		}
+
+		if (driver->indexed && (source->container != StreamerContainer_Direct))
+		{
+			continue;
+		}
+
+		if (Mount_Probe(source, filename, StreamerDirEntryType_File))
+		{
+			return source;
+		}
+	}
+
+	return 0;
+}
+
+static int Mount_Visible(MountDriver* driver, MountDirectory* directory, const StreamerDirEntry* entry)
+{
+	const MountIndexEntry* hit;
+	char key[MOUNT_MAX_PATH];
+	char path[MOUNT_MAX_PATH];
+	int rank;
+
+	if ((Mount_Join(key, directory->key, entry->name) < 0) || (Mount_Join(path, directory->path, entry->name) < 0))
+	{
+		return 1;
+	}
+
+	hit = Mount_Lookup(driver, key);
+	for (rank = 0; rank < directory->rank; ++rank)
+	{
+		int slot = driver->order[rank];
+		MountSource* source = &(driver->sources[slot]);
+
+		if (hit && (hit->source == slot))
+		{
+			return 0;
+		}
+
+		if ((source->container == StreamerContainer_Direct) && Mount_Probe(source, path, entry->type))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
@@ -0,0 +1,146 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef streamer_common_mount_h
+#define streamer_common_mount_h
+
+#include "driver.h"
+#include "simulated.h"
+
+#define MOUNT_MAX_SOURCES 8
+#define MOUNT_MAX_HANDLES 8
+#define MOUNT_MAX_PATH 256
+
+typedef struct MountSource MountSource;
+typedef struct MountIndexEntry MountIndexEntry;
+typedef struct MountHandle MountHandle;
+typedef struct MountDirectory MountDirectory;
+typedef struct MountDriver MountDriver;
+
+struct MountSource
+{
+	IODriver* native;		// Native layer, NULL if source is not in use
+	IODriver* driver;		// Logical layer, equal to native for direct sources
+	StreamerContainer container;
+	int priority;
+};
+
+struct MountIndexEntry
+{
+	unsigned int hash;		// Hash of key
+	unsigned int name;		// Offset to key, a normalized path or '@' and a content hash (Relative to start of name pool)
+	unsigned short source;		// Source slot providing the path
+	unsigned short type;		// StreamerDirEntryType of the path
+};
+
+struct MountHandle
+{
+	int source;			// Source slot, <0 if handle is not in use
+	int fd;				// Handle in source
+};
+
+struct MountDirectory
+{
+	int rank;			// Current source in priority order, <0 if directory is not in use
+	int fd;				// Directory handle in current source, <0 if not yet opened
+	char path[MOUNT_MAX_PATH];	// Path of directory, as passed to sources
+	char key[MOUNT_MAX_PATH];	// Normalized path of directory
+};
+
+struct MountDriver
+{
+	IODriver interface;
+
+	StreamerTransport transport;
+	SimulatedDevice device;		// Media shared by all sources (Simulated transport only)
+
+	MountSource sources[MOUNT_MAX_SOURCES];
+	int order[MOUNT_MAX_SOURCES];	// Source slots, sorted by descending priority
+	int count;			// Number of mounted sources
+	int lists;			// Number of list loads in progress
+	int indexed;			// Set when archive sources are indexed, a lone source is asked directly
+	int verify;			// Archive sources check block checksums, applied to sources as they are added
+
+	struct
+	{
+		MountIndexEntry* entries;
+		unsigned int count;
+		unsigned int capacity;
+
+		unsigned int* table;	// Open addressed table of entry indices (+1), 0 if empty
+		unsigned int mask;
+
+		char* names;
+		unsigned int size;
+		unsigned int reserved;
+	} index;
+
+	MountHandle handles[MOUNT_MAX_HANDLES];
+	MountDirectory directories[MOUNT_MAX_HANDLES];
+};
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+IODriver* Mount_Create(StreamerTransport transport);
+
+/**
+ *
+ * Mount a source into the mount table
+ *
+ * Sources are searched in descending priority order, the most recently mounted source wins if priorities are equal.
+ * Paths and content hashes in FileArchive sources are indexed when mounting; Direct sources are probed in priority
+ * order on lookup.
+ *
+ * \return Mount id (>= 0) on success, <0 if an error occured
+ *
+**/
+int Mount_Add(IODriver* driver, StreamerContainer container, const char* root, const char* file, int priority);
+
+/**
+ *
+ * Remove a source from the mount table, fails if there are open handles into the source
+ *
+**/
+int Mount_Remove(IODriver* driver, int id);
+
+/**
+ *
+ * Change the device model shared by all sources, fails unless the mount table uses the Simulated transport
+ *
+**/
+int Mount_SetDeviceModel(IODriver* driver, const StreamerDeviceModel* model);
+
+/**
+ *
+ * Enable or disable block checksum verification for all archive sources, current and future
+ *
+**/
+void Mount_SetVerify(IODriver* driver, int verify);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,390 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "simulated.h"
+#include "fileio.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#if defined(_IOP)
+#include "../iop/irx_imports.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+#if defined(STREAMER_UNIX)
+#include <unistd.h>
+#endif
+
+static void Simulated_Destroy(struct IODriver* driver);
+static int Simulated_Open(struct IODriver* driver, const char* filename, StreamerOpenMode mode);
+static int Simulated_Close(struct IODriver* driver, int fd);
+static int Simulated_Read(struct IODriver* driver, int fd, void* buffer, unsigned int length);
+static int Simulated_PRead(struct IODriver* driver, int fd, void* buffer, unsigned int length, StreamerOffset offset);
+static StreamerOffset Simulated_LSeek(struct IODriver* driver, int fd, StreamerOffset offset, StreamerSeekMode whence);
+static int Simulated_Stat(struct IODriver* driver, const char* filename, StreamerStat* info);
+
+static int Simulated_DOpen(struct IODriver* driver, const char* pathname);
+static int Simulated_DClose(struct IODriver* driver, int fd);
+static int Simulated_DRead(struct IODriver* driver, int fd, StreamerDirEntry* entries, unsigned int count);
+
+static void Simulated_Transfer(SimulatedDriver* driver, SimulatedHandle* handle, StreamerCounter offset, int length);
+static void Simulated_Charge(SimulatedDriver* driver, StreamerCounter cost);
+static void Simulated_Wait(StreamerCounter deadline);
+
+void Simulated_SetModel(SimulatedDevice* device, const StreamerDeviceModel* model)
+{
+	if (model)
+	{
+		device->model = *model;
+	}
+	else
+	{
+		device->model.overhead = 500;
+		device->model.seekTime = 30000;
+		device->model.seekRate = 20;
+		device->model.bandwidth = 5000;
+		device->model.capacity = 4480;
+		device->model.virtualClock = 0;
+	}
+
+	device->head = 0;
+	device->ready = 0;
+}
+
+IODriver* Simulated_Create(const char* root, SimulatedDevice* device)
+{
+	SimulatedDriver* driver;
+	IODriver* native;
+	int i;
+
+	native = FileIo_Create(root);
+	if (!native)
+	{
+		return 0;
+	}
+
+#if defined(_IOP)
+	driver = AllocSysMemory(ALLOC_FIRST, sizeof(SimulatedDriver), 0);
+#else
+	driver = malloc(sizeof(SimulatedDriver));
+#endif
+	if (!driver)
+	{
+		STREAMER_PRINTF(("Simulated: Failed allocating driver\n"));
+		native->destroy(native);
+		return 0;
+	}
+
+	driver->interface.destroy = Simulated_Destroy;
+	driver->interface.open = Simulated_Open;
+	driver->interface.close = Simulated_Close;
+	driver->interface.read = Simulated_Read;
+	driver->interface.lseek = Simulated_LSeek;
+	driver->interface.pread = native->pread ? Simulated_PRead : 0;
+	driver->interface.map = 0;	// Mapped reads would bypass the device model
+	driver->interface.unmap = 0;
+
+	driver->interface.dopen = Simulated_DOpen;
+	driver->interface.dclose = Simulated_DClose;
+	driver->interface.dread = Simulated_DRead;
+
+	driver->interface.align = 0;
+
+	driver->interface.stat = Simulated_Stat;
+
+	driver->interface.loadlist = 0;
+
+	driver->interface.stats = 0;
+	driver->interface.trace = 0;
+
+	driver->native = native;
+	driver->device = device;
+
+	for (i = 0; i < SIMULATED_MAX_HANDLES; ++i)
+	{
+		driver->handles[i].fd = -1;
+	}
+
+	STREAMER_PRINTF(("Simulated: Driver created (overhead %u us, seek %u us + %u us/MB, %u KB/s%s)\n", device->model.overhead, device->model.seekTime, device->model.seekRate, device->model.bandwidth, device->model.virtualClock ? ", virtual clock" : ""));
+	return &(driver->interface);
+}
+
+static void Simulated_Destroy(struct IODriver* driver)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+	int i;
+
+	for (i = 0; i < SIMULATED_MAX_HANDLES; ++i)
+	{
+		if (local->handles[i].fd >= 0)
+		{
+			local->native->close(local->native, local->handles[i].fd);
+		}
+	}
+
+	local->native->destroy(local->native);
+
+#if defined(_IOP)
+	FreeSysMemory(local);
+#else
+	free(local);
+#endif
+
+	STREAMER_PRINTF(("Simulated: Driver destroyed\n"));
+}
+
+static int Simulated_Open(struct IODriver* driver, const char* filename, StreamerOpenMode mode)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+	StreamerCounter sectors = ((StreamerCounter)local->device->model.capacity << 20) / SIMULATED_SECTOR_SIZE;
+	unsigned int hash = 2166136261u;
+	const char* curr;
+	int i, fd;
+
+	for (i = 0; i < SIMULATED_MAX_HANDLES; ++i)
+	{
+		if (local->handles[i].fd < 0)
+		{
+			break;
+		}
+	}
+
+	if (i == SIMULATED_MAX_HANDLES)
+	{
+		STREAMER_PRINTF(("Simulated: Out of available file handles\n"));
+		return -1;
+	}
+
+	Simulated_Charge(local, local->device->model.overhead);
+
+	fd = local->native->open(local->native, filename, mode);
+	if (fd < 0)
+	{
+		return fd;
+	}
+
+	for (curr = filename; *curr; ++curr)
+	{
+		hash = (hash ^ (unsigned char)*curr) * 16777619u;
+	}
+
+	local->handles[i].fd = fd;
+	local->handles[i].base = sectors ? (hash % sectors) * SIMULATED_SECTOR_SIZE : 0;
+	local->handles[i].position = 0;
+
+	return i;
+}
+
+static int Simulated_Close(struct IODriver* driver, int fd)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+	int result;
+
+	if ((fd < 0) || (fd >= SIMULATED_MAX_HANDLES) || (local->handles[fd].fd < 0))
+	{
+		STREAMER_PRINTF(("Simulated: Invalid file handle\n"));
+		return -1;
+	}
+
+	result = local->native->close(local->native, local->handles[fd].fd);
+	local->handles[fd].fd = -1;
+
+	return result;
+}
+
+static int Simulated_Read(struct IODriver* driver, int fd, void* buffer, unsigned int length)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+	SimulatedHandle* handle;
+	int result;
+
+	if ((fd < 0) || (fd >= SIMULATED_MAX_HANDLES) || (local->handles[fd].fd < 0))
+	{
+		STREAMER_PRINTF(("Simulated: Invalid file handle\n"));
+		return -1;
+	}
+
+	handle = &(local->handles[fd]);
+
+	result = local->native->read(local->native, handle->fd, buffer, length);
+	if (result < 0)
+	{
+		return result;
+	}
+
+	Simulated_Transfer(local, handle, handle->position, result);
+	handle->position += result;
+
+	return result;
+}
+
+static int Simulated_PRead(struct IODriver* driver, int fd, void* buffer, unsigned int length, StreamerOffset offset)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+	SimulatedHandle* handle;
+	int result;
+
+	if ((fd < 0) || (fd >= SIMULATED_MAX_HANDLES) || (local->handles[fd].fd < 0))
+	{
+		STREAMER_PRINTF(("Simulated: Invalid file handle\n"));
+		return -1;
+	}
+
+	handle = &(local->handles[fd]);
+
+	result = local->native->pread(local->native, handle->fd, buffer, length, offset);
+	if (result < 0)
+	{
+		return result;
+	}
+
+	Simulated_Transfer(local, handle, (StreamerCounter)offset, result);
+
+	return result;
+}
+
+static StreamerOffset Simulated_LSeek(struct IODriver* driver, int fd, StreamerOffset offset, StreamerSeekMode whence)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+	StreamerOffset result;
+
+	if ((fd < 0) || (fd >= SIMULATED_MAX_HANDLES) || (local->handles[fd].fd < 0))
+	{
+		STREAMER_PRINTF(("Simulated: Invalid file handle\n"));
+		return -1;
+	}
+
+	// Only the file position moves, the head travels when the next read is issued
+
+	result = local->native->lseek(local->native, local->handles[fd].fd, offset, whence);
+	if (result >= 0)
+	{
+		local->handles[fd].position = result;
+	}
+
+	return result;
+}
+
+static int Simulated_Stat(struct IODriver* driver, const char* filename, StreamerStat* info)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+
+	Simulated_Charge(local, local->device->model.overhead);
+	return local->native->stat(local->native, filename, info);
+}
+
+static int Simulated_DOpen(struct IODriver* driver, const char* pathname)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+
+	Simulated_Charge(local, local->device->model.overhead);
+	return local->native->dopen(local->native, pathname);
+}
+
+static int Simulated_DClose(struct IODriver* driver, int fd)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+	return local->native->dclose(local->native, fd);
+}
+
+static int Simulated_DRead(struct IODriver* driver, int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	SimulatedDriver* local = (SimulatedDriver*)driver;
+	return local->native->dread(local->native, fd, entries, count);
+}
+
+static void Simulated_Transfer(SimulatedDriver* driver, SimulatedHandle* handle, StreamerCounter offset, int length)
+{
+	SimulatedDevice* device = driver->device;
+	StreamerCounter position = handle->base + offset;
+	StreamerCounter distance, cost;
+
+	// Charge what the device would have spent: moving to the start of the transfer and then streaming it
+
+	cost = device->model.overhead;
+
+	if (position != device->head)
+	{
+		distance = position > device->head ? position - device->head : device->head - position;
+		cost += device->model.seekTime + ((distance * device->model.seekRate) >> 20);
+
+		STREAMER_STATS_ADD(driver->interface.stats, deviceSeeks, 1);
+	}
+
+	if (device->model.bandwidth)
+	{
+		cost += ((StreamerCounter)length * 1000000) / ((StreamerCounter)device->model.bandwidth * 1024);
+	}
+
+	device->head = position + length;
+
+	Simulated_Charge(driver, cost);
+}
+
+static void Simulated_Charge(SimulatedDriver* driver, StreamerCounter cost)
+{
+	SimulatedDevice* device = driver->device;
+	StreamerCounter now;
+
+	STREAMER_STATS_ADD(driver->interface.stats, deviceTime, cost);
+
+	if (device->model.virtualClock)
+	{
+		return;
+	}
+
+	// Work queues up behind work already issued, so the wait is measured from when the device becomes idle
+
+	now = IODriver_GetTime();
+	if (device->ready < now)
+	{
+		device->ready = now;
+	}
+	device->ready += cost;
+
+	Simulated_Wait(device->ready);
+}
+
+static void Simulated_Wait(StreamerCounter deadline)
+{
+	StreamerCounter now;
+
+	while ((now = IODriver_GetTime()) < deadline)
+	{
+		StreamerCounter remaining = deadline - now;
+
+#if defined(_WIN32)
+		Sleep(remaining >= 1000 ? (DWORD)(remaining / 1000) : 0);
+#elif defined(_IOP)
+		DelayThread((int)remaining);
+#else
+		usleep((useconds_t)remaining);
+#endif
+	}
+}
@@ -0,0 +1,82 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef streamer_common_simulated_h
+#define streamer_common_simulated_h
+
+#include "driver.h"
+
+#define SIMULATED_MAX_HANDLES 8
+#define SIMULATED_SECTOR_SIZE 2048
+
+typedef struct SimulatedDevice
+{
+	StreamerDeviceModel model;
+
+	StreamerCounter head;		// Media position where the last transfer ended, in bytes
+	StreamerCounter ready;		// Time when the device is done with issued work (Real clock only)
+} SimulatedDevice;
+
+typedef struct SimulatedHandle
+{
+	int fd;				// Handle in native layer, <0 if handle is not in use
+	StreamerCounter base;		// Media position of start of file
+	StreamerCounter position;	// Current offset in file
+} SimulatedHandle;
+
+typedef struct SimulatedDriver
+{
+	IODriver interface;
+
+	IODriver* native;
+	SimulatedDevice* device;	// Shared by all drivers reading from the same media
+
+	SimulatedHandle handles[SIMULATED_MAX_HANDLES];
+} SimulatedDriver;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ *
+ * Reset device to a model, NULL selects the default model (Roughly a DVD drive)
+ *
+**/
+void Simulated_SetModel(SimulatedDevice* device, const StreamerDeviceModel* model);
+
+/**
+ *
+ * Create a driver reading files below root through FileIo, delaying each request by the cost computed by the device model
+ *
+ * Files are placed on the simulated media by hashing their path, so seeks between loose files cost a pseudo-random distance
+ * while seeks within one file (such as an archive) cost their actual distance.
+ *
+**/
+IODriver* Simulated_Create(const char* root, SimulatedDevice* device);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#include "trace.h"
+#include "driver.h"
+
+#if defined(_IOP)
+#include "../iop/irx_imports.h"
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+// Events are guarded like a seqlock: the writer retires the sequence before touching the payload and publishes it
+// afterwards, readers check the sequence on both sides of their copy
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRACE_CLAIM(target) ((unsigned int)_InterlockedExchangeAdd((volatile long*)&(target), 1))
+#define TRACE_RETIRE(target) do { (target) = 0; _ReadWriteBarrier(); } while (0)
+#define TRACE_PUBLISH(target, value) do { _ReadWriteBarrier(); (target) = (value); } while (0)
+#define TRACE_LOAD(target) (target)
+#define TRACE_FENCE_ACQUIRE() _ReadWriteBarrier()
+#elif defined(__GNUC__) && !defined(_IOP) && !defined(_EE) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 7)))
+#define TRACE_CLAIM(target) __atomic_fetch_add(&(target), 1, __ATOMIC_RELAXED)
+#define TRACE_RETIRE(target) do { __atomic_store_n(&(target), 0, __ATOMIC_RELAXED); __atomic_thread_fence(__ATOMIC_RELEASE); } while (0)
+#define TRACE_PUBLISH(target, value) __atomic_store_n(&(target), (value), __ATOMIC_RELEASE)
+#define TRACE_LOAD(target) __atomic_load_n(&(target), __ATOMIC_ACQUIRE)
+#define TRACE_FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#else
+#define TRACE_CLAIM(target) ((target)++)
+#define TRACE_RETIRE(target) ((target) = 0)
+#define TRACE_PUBLISH(target, value) ((target) = (value))
+#define TRACE_LOAD(target) (target)
+#define TRACE_FENCE_ACQUIRE()
+#endif
+
+int Trace_Start(StreamerTrace* trace, unsigned int capacity)
+{
+	if (!trace->events)
+	{
+		unsigned int size = 1;
+
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+
+#if defined(_IOP)
+		trace->events = AllocSysMemory(ALLOC_FIRST, size * sizeof(TraceEvent), 0);
+#else
+		trace->events = malloc(size * sizeof(TraceEvent));
+#endif
+		if (!trace->events)
+		{
+			STREAMER_PRINTF(("Trace: Failed to allocate %d events\n", size));
+			return -1;
+		}
+
+		memset(trace->events, 0, size * sizeof(TraceEvent));
+		trace->mask = size - 1;
+	}
+
+	// Events are never cleared, the recording starts at the current head so writers in flight are unaffected
+
+	trace->start = trace->head;
+	trace->enabled = 1;
+	return 0;
+}
+
+void Trace_Stop(StreamerTrace* trace)
+{
+	trace->enabled = 0;
+}
+
+void Trace_Destroy(StreamerTrace* trace)
+{
+	trace->enabled = 0;
+
+	if (trace->events)
+	{
+#if defined(_IOP)
+		FreeSysMemory(trace->events);
+#else
+		free(trace->events);
+#endif
+		trace->events = 0;
+	}
+}
+
+void Trace_Record(StreamerTrace* trace, TraceEventType type, int operation, StreamerCounter time, StreamerCounter duration, int fd, StreamerCounter offset, unsigned int bytes, int result, const char* path)
+{
+	unsigned int index, length;
+	TraceEvent* event;
+
+	if (!trace || !trace->enabled)
+	{
+		return;
+	}
+
+	index = TRACE_CLAIM(trace->head);
+	event = &(trace->events[index & trace->mask]);
+
+	// The cleared sequence has to be visible before any of the payload is overwritten
+
+	TRACE_RETIRE(event->sequence);
+	event->type = (unsigned short)type;
+	event->operation = (short)operation;
+	event->time = time;
+	event->duration = duration;
+	event->fd = fd;
+	event->offset = offset;
+	event->bytes = bytes;
+	event->result = result;
+
+	length = path ? strlen(path) : 0;
+	if (length >= TRACE_MAX_PATH)
+	{
+		path += length - (TRACE_MAX_PATH - 1);
+		length = TRACE_MAX_PATH - 1;
+	}
+	memcpy(event->path, path ? path : "", length);
+	event->path[length] = 0;
+
+	TRACE_PUBLISH(event->sequence, index + 1);
+}
+
+int Trace_Fetch(StreamerTrace* trace, unsigned int index, TraceEvent* event)
+{
+	const TraceEvent* source = &(trace->events[index & trace->mask]);
+
+	if (TRACE_LOAD(source->sequence) != (index + 1))
+	{
+		return -1;
+	}
+
+	memcpy(event, source, sizeof(TraceEvent));
+
+	// Reads of the payload must complete before the sequence is checked again
+
+	TRACE_FENCE_ACQUIRE();
+
+	if ((source->sequence != (index + 1)) || (event->sequence != (index + 1)))
+	{
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,107 @@
+/*
+
+Copyright (c) 2006-2010 Jesper Svennevid
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+of the Software, and to permit persons to whom the Software is furnished to do
+so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+#ifndef streamer_common_trace_h
+#define streamer_common_trace_h
+
+#include "../../io.h"
+
+#define TRACE_MAX_PATH 48
+
+typedef enum
+{
+	TraceEvent_Submit,		// Request queued (async begin)
+	TraceEvent_Dequeue,		// Request picked up by the streamer thread (async instant)
+	TraceEvent_Read,		// Driver read chunk (complete event)
+	TraceEvent_Decompress,		// Container block decompressed (complete event)
+	TraceEvent_Complete		// Request completed (async end)
+} TraceEventType;
+
+typedef struct TraceEvent
+{
+	volatile unsigned int sequence;	// Index of event + 1 once the event is written, used to detect torn reads
+	unsigned short type;		// TraceEventType
+	short operation;		// StreamerOperation of request, <0 for container events
+
+	StreamerCounter time;		// Start of event, in microseconds
+	StreamerCounter duration;	// Duration of event, in microseconds
+
+	int fd;
+	StreamerCounter offset;		// File offset of event
+	unsigned int bytes;		// Bytes transferred or produced
+	int result;			// Result of request, or compressed size of decompressed blocks
+
+	char path[TRACE_MAX_PATH];	// Tail of path, truncated from the front if too long
+} TraceEvent;
+
+typedef struct StreamerTrace
+{
+	TraceEvent* events;		// Ring buffer, allocated when tracing is first started
+	unsigned int mask;		// Capacity of ring - 1
+	volatile unsigned int head;	// Index of next event to write
+	volatile unsigned int start;	// Index of first event in current recording
+	volatile int enabled;
+} StreamerTrace;
+
+/**
+ *
+ * Allocate the ring (first call only) and start recording
+ *
+ * \note Capacity is rounded up to a power of two, and is fixed once the ring has been allocated
+ *
+**/
+int Trace_Start(StreamerTrace* trace, unsigned int capacity);
+
+/**
+ *
+ * Stop recording, keeping recorded events for export
+ *
+**/
+void Trace_Stop(StreamerTrace* trace);
+
+/**
+ *
+ * Release the ring
+ *
+**/
+void Trace_Destroy(StreamerTrace* trace);
+
+/**
+ *
+ * Record an event, does nothing if trace is NULL or not recording
+ *
+ * Slots are claimed with an atomic increment so recording never blocks; when the ring is full the oldest events are overwritten
+ *
+**/
+void Trace_Record(StreamerTrace* trace, TraceEventType type, int operation, StreamerCounter time, StreamerCounter duration, int fd, StreamerCounter offset, unsigned int bytes, int result, const char* path);
+
+/**
+ *
+ * Copy event with the given index out of the ring
+ *
+ * \return 0 if the event was copied, <0 if it has been overwritten or is still being written
+ *
+**/
+int Trace_Fetch(StreamerTrace* trace, unsigned int index, TraceEvent* event);
+
+#endif
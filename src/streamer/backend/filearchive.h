@@ -30,6 +30,7 @@ typedef unsigned char uint8_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
 typedef int int32_t;
+typedef unsigned long long uint64_t;
 #else
 #include <stdint.h>
 #endif
@@ -37,29 +38,41 @@ typedef int int32_t;
 typedef struct fa_container_t fa_container_t;
 typedef struct fa_entry_t fa_entry_t;
 typedef struct fa_block_t fa_block_t;
+typedef struct fa_block32_t fa_block32_t;
+typedef struct fa_block_crc_t fa_block_crc_t;
 typedef struct fa_header_t fa_header_t;
 typedef struct fa_footer_t fa_footer_t;
+typedef struct fa_footer64_t fa_footer64_t;
+typedef struct fa_extent_t fa_extent_t;
 typedef struct fa_hash_t fa_hash_t;
+typedef struct fa_pages_t fa_pages_t;
+typedef struct fa_trailer_t fa_trailer_t;
 
 typedef uint32_t fa_offset_t;
 
 typedef enum
 {
 	FA_COMPRESSION_NONE = (0),
-	FA_COMPRESSION_FASTLZ = (('F' << 24) | ('L' << 16) | ('Z' << 8) | ('0'))
+	FA_COMPRESSION_FASTLZ = (('F' << 24) | ('L' << 16) | ('Z' << 8) | ('0')),
+	FA_COMPRESSION_FASTLZ_PAGED = (('F' << 24) | ('L' << 16) | ('Z' << 8) | ('P'))	// TOC only, laid out as described by fa_pages_t
 } fa_compression_t;
 
 typedef enum
 {
 	FA_VERSION_1 = 1,
+	FA_VERSION_2 = 2,		// Adds fa_extent_t table, for data offsets and sizes beyond 4GB
+	FA_VERSION_3 = 3,		// Entry data uses fa_block32_t headers, with blocks up to FA_BLOCK_SIZE_MAX as given by fa_entry_t.blockSize
+	FA_VERSION_4 = 4,		// Entry data uses fa_block_crc_t headers, adding a checksum to each block
 
-	FA_VERSION_CURRENT = FA_VERSION_1
+	FA_VERSION_CURRENT = FA_VERSION_4
 } fa_version_t;
 
 typedef enum
 {
 	FA_MAGIC_COOKIE_HEADER = (('F' << 24)|('A' << 16)|('R' << 8)|('H')),
-	FA_MAGIC_COOKIE_FOOTER = (('F' << 24)|('A' << 16)|('R' << 8)|('F'))
+	FA_MAGIC_COOKIE_FOOTER = (('F' << 24)|('A' << 16)|('R' << 8)|('F')),
+	FA_MAGIC_COOKIE_FOOTER_64 = (('F' << 24)|('A' << 16)|('R' << 8)|('8')),
+	FA_MAGIC_COOKIE_TRAILER = (('F' << 24)|('A' << 16)|('R' << 8)|('T'))
 } fa_magic_cookie_t;
 
 struct fa_container_t
@@ -92,12 +105,32 @@ struct fa_entry_t
 	} size;
 };
 
+struct fa_extent_t
+{
+	uint32_t data;			// High 32 bits of offset to file data
+	uint32_t original;		// High 32 bits of original file size
+	uint32_t compressed;		// High 32 bits of compressed file size
+};
+
 struct fa_block_t
 {
 	uint16_t original;
 	uint16_t compressed; 		// If the highest bit (FILEARCHIVE_COMPRESSION_SIZE_IGNORE) is set, the block is uncompressed
 };
 
+struct fa_block32_t
+{
+	uint32_t original;
+	uint32_t compressed;		// If the highest bit (FA_COMPRESSION_SIZE_IGNORE_32) is set, the block is uncompressed
+};
+
+struct fa_block_crc_t
+{
+	uint32_t original;
+	uint32_t compressed;		// If the highest bit (FA_COMPRESSION_SIZE_IGNORE_32) is set, the block is uncompressed
+	uint32_t checksum;		// CRC32C of original and compressed followed by the block data
+};
+
 struct fa_hash_t
 {
 	uint8_t data[20];
@@ -125,6 +158,23 @@ struct fa_header_t
 	} entries;
 
 	fa_offset_t hashes;		// Offset to content hashes
+
+	// Version 2
+
+	fa_offset_t extents;		// Offset to extents, one per entry (relative to start of TOC)
+
+	// Version 3
+
+	uint32_t blockSize;		// Largest block of any entry, missing from the first version 3 archives (containers.offset tells)
+};
+
+struct fa_pages_t
+{
+	uint32_t size;			// Bytes of TOC per page, the last page may be shorter
+	uint32_t count;			// Number of pages
+
+	// Followed by count + 1 offsets (relative to start of fa_pages_t) to the fa_block_t of each page, the last one
+	// marking the end of the final page. Pages are compressed independently so they can be decompressed on demand
 };
 
 struct fa_footer_t
@@ -133,7 +183,7 @@ struct fa_footer_t
 
 	struct
 	{
-		uint32_t compression;	// TOC compression format
+		uint32_t compression;	// TOC compression format, compressed TOCs always use fa_block_t headers
 		uint32_t original;	// TOC size, uncompressed
 		uint32_t compressed;	// TOC size, compressed
 		fa_hash_t hash;		// TOC hash
@@ -146,7 +196,38 @@ struct fa_footer_t
 	} data;
 };
 
+struct fa_footer64_t
+{
+	uint32_t cookie;		// Magic cookie (FA_MAGIC_COOKIE_FOOTER_64)
+
+	struct
+	{
+		uint32_t compression;	// TOC compression format
+		uint32_t original;	// TOC size, uncompressed
+		uint32_t compressed;	// TOC size, compressed
+		fa_hash_t hash;		// TOC hash
+	} toc;
+
+	uint32_t reserved;		// Aligns data sizes
+
+	struct
+	{
+		uint64_t original;	// Data size, uncompressed
+		uint64_t compressed;	// Data size, compressed
+	} data;
+};
+
+struct fa_trailer_t
+{
+	uint32_t footer;		// Distance from start of footer to start of trailer
+	uint32_t version;		// Version of archive
+	uint32_t cookie;		// Magic cookie (FA_MAGIC_COOKIE_TRAILER), always the last bytes of the archive
+};
+
 #define FA_COMPRESSION_SIZE_IGNORE (0x8000)
+#define FA_COMPRESSION_SIZE_IGNORE_32 (0x80000000)
+
+#define FA_BLOCK_SIZE_MAX (1024 * 1024)
 
 #define FA_INVALID_OFFSET (0xffffffff)
 
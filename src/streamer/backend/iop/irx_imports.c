@@ -34,6 +34,10 @@ I_close
 I_read
 I_write
 I_lseek
+I_dopen
+I_dclose
+I_dread
+I_getstat
 ioman_IMPORTS_end
 
 stdio_IMPORTS_start
@@ -50,6 +54,8 @@ I_ExitDeleteThread
 I_DelayThread
 I_RotateThreadReadyQueue
 I_WakeupThread
+I_GetSystemTime
+I_SysClock2USec
 thbase_IMPORTS_end
 
 thevent_IMPORTS_start
@@ -89,6 +95,9 @@ I_memcmp
 I_strcat
 I_strncpy
 I_strlen
+I_strcmp
+I_strrchr
+I_memmove
 sysclib_IMPORTS_end
 
 sysmem_IMPORTS_start
@@ -36,6 +36,7 @@ static SifRpcServerData_t serverData;
 static void* rpcBuffer = 0;
 static int s_remoteHandles[STREAMER_MAX_FILEHANDLES];
 static StreamerClientState* s_response = 0;
+static StreamerContext* s_context = 0;
 
 #define RPC_BUFFER_SIZE (4096)
 
@@ -52,7 +53,11 @@ void* RpcServer(int action, void* data, int size)
 			}
 
 			volatile StreamerInitArguments* args = (StreamerInitArguments*)data;
-			args->result = streamerInitialize(args->mode, args->container, (const char*)args->root, (const char*)args->file);
+			if (!s_context)
+			{
+				s_context = streamerCreateContext(args->mode, args->container, (const char*)args->root, (const char*)args->file);
+			}
+			args->result = s_context ? StreamerResult_Ok : StreamerResult_Error;
 			s_response = args->response;
 			return data;
 		}
@@ -64,17 +69,17 @@ void* RpcServer(int action, void* data, int size)
 			int result;
 
 			s_remoteHandles[args->result] = args->remote;
-			internalStreamerIssueResponse(args->remote, StreamerResult_Pending, StreamerCallMethod_SifRpc);
+			internalStreamerIssueResponse(s_context, args->remote, StreamerResult_Pending, StreamerCallMethod_SifRpc);
 
-			result = internalStreamerOpen((char*)args->filename, args->mode, StreamerCallMethod_SifRpc);
+			result = internalStreamerOpen(s_context, (char*)args->filename, args->mode, StreamerCallMethod_SifRpc);
 			if (args->result >= 0)
 			{
-				internalStreamerSetEventFlag();
+				internalStreamerSetEventFlag(s_context);
 			}
 			else
 			{
 				s_remoteHandles[args->result] = -1;
-				internalStreamerIssueResponse(args->remote, StreamerResult_Error, StreamerCallMethod_SifRpc);
+				internalStreamerIssueResponse(s_context, args->remote, StreamerResult_Error, StreamerCallMethod_SifRpc);
 			}
 			return data;
 		}
@@ -93,16 +98,16 @@ void* RpcServer(int action, void* data, int size)
 				}
 			}
 
-			internalStreamerIssueResponse(args->fd, StreamerResult_Pending, StreamerCallMethod_SifRpc);
+			internalStreamerIssueResponse(s_context, args->fd, StreamerResult_Pending, StreamerCallMethod_SifRpc);
 
-			result = (remote < STREAMER_MAX_FILEHANDLES) ? internalStreamerClose(remote, StreamerCallMethod_SifRpc) : StreamerResult_Error;
+			result = (remote < STREAMER_MAX_FILEHANDLES) ? internalStreamerClose(s_context, remote, StreamerCallMethod_SifRpc) : StreamerResult_Error;
 			if (args->result >= 0)
 			{
-				internalStreamerSetEventFlag();
+				internalStreamerSetEventFlag(s_context);
 			}
 			else
 			{
-				internalStreamerIssueResponse(args->fd, StreamerResult_Error, StreamerCallMethod_SifRpc);
+				internalStreamerIssueResponse(s_context, args->fd, StreamerResult_Error, StreamerCallMethod_SifRpc);
 			}
 			return data;
 		}
@@ -121,16 +126,16 @@ void* RpcServer(int action, void* data, int size)
 				}
 			}
 
-			internalStreamerIssueResponse(args->fd, StreamerResult_Pending, StreamerCallMethod_SifRpc);
+			internalStreamerIssueResponse(s_context, args->fd, StreamerResult_Pending, StreamerCallMethod_SifRpc);
 
-			result = (remote < STREAMER_MAX_FILEHANDLES) ? internalStreamerRead(args->fd, (void*)args->buffer, args->length, (void*)args->head, (void*)args->tail, StreamerCallMethod_SifRpc) : StreamerResult_Error;
+			result = (remote < STREAMER_MAX_FILEHANDLES) ? internalStreamerRead(s_context, args->fd, (void*)args->buffer, args->length, (void*)args->head, (void*)args->tail, StreamerCallMethod_SifRpc) : StreamerResult_Error;
 			if (args->result >= 0)
 			{
-				internalStreamerSetEventFlag();
+				internalStreamerSetEventFlag(s_context);
 			}
 			else
 			{
-				internalStreamerIssueResponse(args->fd, StreamerResult_Error, StreamerCallMethod_SifRpc);
+				internalStreamerIssueResponse(s_context, args->fd, StreamerResult_Error, StreamerCallMethod_SifRpc);
 			}
 			return data;
 		}
@@ -149,16 +154,16 @@ void* RpcServer(int action, void* data, int size)
 				}
 			}
 
-			internalStreamerIssueResponse(args->fd, StreamerResult_Pending, StreamerCallMethod_SifRpc);
+			internalStreamerIssueResponse(s_context, args->fd, StreamerResult_Pending, StreamerCallMethod_SifRpc);
 
-			result = (remote < STREAMER_MAX_FILEHANDLES) ? internalStreamerLSeek(args->fd, args->offset, args->whence, StreamerCallMethod_SifRpc) : StreamerResult_Error;
+			result = (remote < STREAMER_MAX_FILEHANDLES) ? internalStreamerLSeek(s_context, args->fd, args->offset, args->whence, StreamerCallMethod_SifRpc) : StreamerResult_Error;
 			if (args->result >= 0)
 			{
-				internalStreamerSetEventFlag();
+				internalStreamerSetEventFlag(s_context);
 			}
 			else
 			{
-				internalStreamerIssueResponse(args->fd, StreamerResult_Error, StreamerCallMethod_SifRpc);
+				internalStreamerIssueResponse(s_context, args->fd, StreamerResult_Error, StreamerCallMethod_SifRpc);
 			}
 			return data;
 		}
@@ -222,7 +227,7 @@ int internalStreamerStartRpcIOP()
 	return 0;
 }
 
-void internalStreamerIssueResponse(int fd, int result, StreamerCallMethod method)
+void internalStreamerIssueResponse(StreamerContext* context, int fd, int result, StreamerCallMethod method)
 {
 	if ((fd < 0) || (fd > STREAMER_MAX_FILEHANDLES))
 	{
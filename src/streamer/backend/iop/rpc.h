@@ -26,7 +26,7 @@ SOFTWARE.
 
 #define STREAMER_RPCID_IOP	0x54424c01
 
-#include "../../io.h"
+#include "../../streamer.h"
 
 typedef enum
 {
@@ -117,7 +117,7 @@ typedef struct StreamerSeekArguments
 #if defined(_IOP)
 int internalStreamerStartRpcIOP();
 void internalStreamerInitializeResponse(void* response);
-void internalStreamerIssueResponse(int fd, int result, StreamerCallMethod method);
+void internalStreamerIssueResponse(StreamerContext* context, int fd, int result, StreamerCallMethod method);
 #endif
 
 #endif
@@ -26,18 +26,27 @@ SOFTWARE.
 
 #include "irx_imports.h"
 
-static volatile int s_shutdown = 0;
-static int s_thread = 0;
-static int s_event = -1;
+typedef struct StreamerThread
+{
+	volatile int m_shutdown;
+	int m_thread;
+	int m_event;
+	int m_caller;
+} StreamerThread;
+
+static StreamerContext* s_context = 0;
 
 int streamerThread(void* argv)
 {
+	StreamerContext* context = (StreamerContext*)argv;
+	StreamerThread* thread = (StreamerThread*)internalStreamerGetPlatform(context);
+
 	STREAMER_PRINTF(("Streamer: Thread started\n"));
-	WakeupThread((int)argv);
+	WakeupThread(thread->m_caller);
 
-	while (!s_shutdown)
+	while (!thread->m_shutdown)
 	{
-		switch (internalStreamerIdle())
+		switch (internalStreamerIdle(context))
 		{
 			case StreamerResult_Pending:
 			{
@@ -48,138 +57,453 @@ int streamerThread(void* argv)
 			default:
 			{
 				u32 result;
-				WaitEventFlag(s_event, 1, WEF_AND|WEF_CLEAR, &result);
+				WaitEventFlag(thread->m_event, 1, WEF_AND|WEF_CLEAR, &result);
 			}
 			break;
 		}
 	}
 
-	s_shutdown = 0;
+	thread->m_shutdown = 0;
 
 	STREAMER_PRINTF(("Streamer: Thread stopped\n"));
 	return 0;
 }
 
-int streamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
+StreamerContext* streamerCreateContext(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
 {
 	int result;
 
-	iop_thread_t thread;
+	StreamerContext* context;
+	StreamerThread* thread;
+	iop_thread_t threadParam;
 	iop_event_t event;
 
+	thread = AllocSysMemory(ALLOC_FIRST, sizeof(StreamerThread), 0);
+	if (!thread)
+	{
+		STREAMER_PRINTF(("Streamer: Failed allocating thread data\n"));
+		return 0;
+	}
+
+	thread->m_shutdown = 0;
+	thread->m_caller = GetThreadId();
+
 	event.attr = 0;
 	event.option = 0;
 	event.bits = 0;
 
-	s_event = CreateEventFlag(&event);
-	if (s_event < 0)
+	thread->m_event = CreateEventFlag(&event);
+	if (thread->m_event < 0)
 	{
-		STREAMER_PRINTF(("Streamer: Failed to create event (err: %d)\n", s_event));
-		return StreamerResult_Error;
+		STREAMER_PRINTF(("Streamer: Failed to create event (err: %d)\n", thread->m_event));
+		FreeSysMemory(thread);
+		return 0;
 	}
 
-	thread.attr = TH_C;
-	thread.option = 0;
-	thread.thread = (void*)&streamerThread;
-	thread.stacksize = 8192;
-	thread.priority = 20;
+	threadParam.attr = TH_C;
+	threadParam.option = 0;
+	threadParam.thread = (void*)&streamerThread;
+	threadParam.stacksize = 8192;
+	threadParam.priority = 20;
 
-	s_thread = CreateThread(&thread);
-	if (s_thread <= 0)
+	thread->m_thread = CreateThread(&threadParam);
+	if (thread->m_thread <= 0)
 	{
-		STREAMER_PRINTF(("Streamer: Failed to create thread (err: %d).\n", s_thread));
-		DeleteEventFlag(s_event);
-		s_event = -1;
-		return StreamerResult_Error;
+		STREAMER_PRINTF(("Streamer: Failed to create thread (err: %d).\n", thread->m_thread));
+		DeleteEventFlag(thread->m_event);
+		FreeSysMemory(thread);
+		return 0;
 	}
 
-	if (internalStreamerInitialize(transport, container, root, file) < 0)
+	context = internalStreamerInitialize(transport, container, root, file, thread);
+	if (!context)
 	{
 		STREAMER_PRINTF(("Streamer: Failed initializing streamer engine\n"));
-		DeleteThread(s_thread);
-		DeleteEventFlag(s_event);
-		s_thread = 0;
-		s_event = -1;
-		return StreamerResult_Error;
+		DeleteThread(thread->m_thread);
+		DeleteEventFlag(thread->m_event);
+		FreeSysMemory(thread);
+		return 0;
 	}
 
-	if ((result = StartThread(s_thread, (void*)GetThreadId())) < 0)
+	if ((result = StartThread(thread->m_thread, context)) < 0)
 	{
 		STREAMER_PRINTF(("Streamer: failed to start streamer thread. (%d)\n", result));
-		DeleteThread(s_thread);
-		DeleteEventFlag(s_event);
-		s_thread = 0;
-		s_event = -1;
-		return StreamerResult_Error;
+		internalStreamerShutdown(context);
+		DeleteThread(thread->m_thread);
+		DeleteEventFlag(thread->m_event);
+		FreeSysMemory(thread);
+		return 0;
 	}
 	SleepThread();
 
-	return StreamerResult_Ok;
+	return context;
 }
 
-int streamerShutdown()
+int streamerDestroyContext(StreamerContext* context)
 {
-	STREAMER_PRINTF(("Streamer: Shutting down streamer is unsupported on PS2\n"));
+	StreamerThread* thread;
+	int result = StreamerResult_Ok;
 
-	// TODO: add support for shutting down
+	if (!context)
+	{
+		return StreamerResult_Error;
+	}
 
-	return StreamerResult_Error;
+	thread = (StreamerThread*)internalStreamerGetPlatform(context);
+
+	thread->m_shutdown = 1;
+	SetEventFlag(thread->m_event, 1);
+
+	while (thread->m_shutdown)
+	{
+		DelayThread(1000);
+	}
+
+	DeleteThread(thread->m_thread);
+	DeleteEventFlag(thread->m_event);
+
+	if (internalStreamerShutdown(context) < 0)
+	{
+		STREAMER_PRINTF(("Streamer: Failed shutting down streamer engine\n"));
+		result = StreamerResult_Error;
+	}
+
+	FreeSysMemory(thread);
+	return result;
 }
 
-int streamerPoll(int fd)
+int streamerContextPoll(StreamerContext* context, int fd)
 {
-	return internalStreamerPoll(fd);
+	return internalStreamerPoll(context, fd);
 }
 
-int streamerOpen(const char* filename, StreamerOpenMode mode)
+int streamerContextOpen(StreamerContext* context, const char* filename, StreamerOpenMode mode)
 {
-	int result = internalStreamerOpen(filename, mode, StreamerCallMethod_Normal);
+	int result = internalStreamerOpen(context, filename, mode, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-int streamerClose(int fd)
+int streamerContextClose(StreamerContext* context, int fd)
 {
-	int result = internalStreamerClose(fd, StreamerCallMethod_Normal);
+	int result = internalStreamerClose(context, fd, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-int streamerRead(int fd, void* buffer, unsigned int length)
+int streamerContextRead(StreamerContext* context, int fd, void* buffer, unsigned int length)
 {
-	int result = internalStreamerRead(fd, buffer, length, 0, 0, StreamerCallMethod_Normal);
+	int result = internalStreamerRead(context, fd, buffer, length, 0, 0, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-int streamerLSeek(int fd, int offset, StreamerSeekMode whence)
+int streamerContextLSeek(StreamerContext* context, int fd, int offset, StreamerSeekMode whence)
+{
+	int result = internalStreamerLSeek(context, fd, offset, whence, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextLSeek64(StreamerContext* context, int fd, StreamerOffset offset, StreamerSeekMode whence)
 {
-	int result = internalStreamerLSeek(fd, offset, whence, StreamerCallMethod_Normal);
+	int result = internalStreamerLSeek64(context, fd, offset, whence, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-void internalStreamerSetEventFlag()
+StreamerOffset streamerContextTell64(StreamerContext* context, int fd)
 {
-	if (s_event >= 0)
+	return internalStreamerTell64(context, fd);
+}
+
+int streamerContextLoadList(StreamerContext* context, StreamerLoadRequest* requests, unsigned int count)
+{
+	int result = internalStreamerLoadList(context, requests, count, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextStat(StreamerContext* context, StreamerStat* stats, unsigned int count)
+{
+	int result = internalStreamerStat(context, stats, count, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextDOpen(StreamerContext* context, const char* pathname)
+{
+	int result = internalStreamerDOpen(context, pathname, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextDClose(StreamerContext* context, int fd)
+{
+	int result = internalStreamerDClose(context, fd, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextDRead(StreamerContext* context, int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	int result = internalStreamerDRead(context, fd, entries, count, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextMount(StreamerContext* context, StreamerContainer container, const char* root, const char* file, int priority)
+{
+	int result = internalStreamerMount(context, container, root, file, priority, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextUnmount(StreamerContext* context, int mount)
+{
+	int result = internalStreamerUnmount(context, mount, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextGetStats(StreamerContext* context, StreamerStats* stats)
+{
+	return internalStreamerGetStats(context, stats);
+}
+
+int streamerContextGetLatency(StreamerContext* context, StreamerLatencyStats* latency)
+{
+	return internalStreamerGetLatency(context, latency);
+}
+
+int streamerContextTraceStart(StreamerContext* context, unsigned int capacity)
+{
+	return internalStreamerTraceStart(context, capacity);
+}
+
+int streamerContextTraceStop(StreamerContext* context)
+{
+	return internalStreamerTraceStop(context);
+}
+
+int streamerContextTraceExport(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	return internalStreamerTraceExport(context, writer, user);
+}
+
+int streamerContextRecordStart(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	return internalStreamerRecordStart(context, writer, user);
+}
+
+int streamerContextRecordStop(StreamerContext* context)
+{
+	return internalStreamerRecordStop(context);
+}
+
+int streamerContextSetDeviceModel(StreamerContext* context, const StreamerDeviceModel* model)
+{
+	return internalStreamerSetDeviceModel(context, model);
+}
+
+int streamerContextSetVerify(StreamerContext* context, int enable)
+{
+	return internalStreamerSetVerify(context, enable);
+}
+
+int streamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
+{
+	if (s_context)
+	{
+		STREAMER_PRINTF(("Streamer: Already initialized\n"));
+		return StreamerResult_Error;
+	}
+
+	s_context = streamerCreateContext(transport, container, root, file);
+	if (!s_context)
+	{
+		return StreamerResult_Error;
+	}
+
+	return StreamerResult_Ok;
+}
+
+int streamerShutdown()
+{
+	STREAMER_PRINTF(("Streamer: Shutting down the default streamer context is unsupported on PS2\n"));
+
+	// TODO: add support for shutting down; contexts created through streamerCreateContext() can be destroyed
+
+	return StreamerResult_Error;
+}
+
+int streamerPoll(int fd)
+{
+	return streamerContextPoll(s_context, fd);
+}
+
+int streamerOpen(const char* filename, StreamerOpenMode mode)
+{
+	return streamerContextOpen(s_context, filename, mode);
+}
+
+int streamerClose(int fd)
+{
+	return streamerContextClose(s_context, fd);
+}
+
+int streamerRead(int fd, void* buffer, unsigned int length)
+{
+	return streamerContextRead(s_context, fd, buffer, length);
+}
+
+int streamerLSeek(int fd, int offset, StreamerSeekMode whence)
+{
+	return streamerContextLSeek(s_context, fd, offset, whence);
+}
+
+int streamerLSeek64(int fd, StreamerOffset offset, StreamerSeekMode whence)
+{
+	return streamerContextLSeek64(s_context, fd, offset, whence);
+}
+
+StreamerOffset streamerTell64(int fd)
+{
+	return streamerContextTell64(s_context, fd);
+}
+
+int streamerLoadList(StreamerLoadRequest* requests, unsigned int count)
+{
+	return streamerContextLoadList(s_context, requests, count);
+}
+
+int streamerStat(StreamerStat* stats, unsigned int count)
+{
+	return streamerContextStat(s_context, stats, count);
+}
+
+int streamerDOpen(const char* pathname)
+{
+	return streamerContextDOpen(s_context, pathname);
+}
+
+int streamerDClose(int fd)
+{
+	return streamerContextDClose(s_context, fd);
+}
+
+int streamerDRead(int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	return streamerContextDRead(s_context, fd, entries, count);
+}
+
+int streamerMount(StreamerContainer container, const char* root, const char* file, int priority)
+{
+	return streamerContextMount(s_context, container, root, file, priority);
+}
+
+int streamerUnmount(int mount)
+{
+	return streamerContextUnmount(s_context, mount);
+}
+
+int streamerGetStats(StreamerStats* stats)
+{
+	return streamerContextGetStats(s_context, stats);
+}
+
+int streamerGetLatency(StreamerLatencyStats* latency)
+{
+	return streamerContextGetLatency(s_context, latency);
+}
+
+int streamerFormatLatency(const StreamerLatencyStats* latency, char* buffer, unsigned int size)
+{
+	return internalStreamerFormatLatency(latency, buffer, size);
+}
+
+int streamerTraceStart(unsigned int capacity)
+{
+	return streamerContextTraceStart(s_context, capacity);
+}
+
+int streamerTraceStop()
+{
+	return streamerContextTraceStop(s_context);
+}
+
+int streamerTraceExport(StreamerTraceWriter writer, void* user)
+{
+	return streamerContextTraceExport(s_context, writer, user);
+}
+
+int streamerRecordStart(StreamerTraceWriter writer, void* user)
+{
+	return streamerContextRecordStart(s_context, writer, user);
+}
+
+int streamerRecordStop()
+{
+	return streamerContextRecordStop(s_context);
+}
+
+int streamerSetDeviceModel(const StreamerDeviceModel* model)
+{
+	return streamerContextSetDeviceModel(s_context, model);
+}
+
+int streamerSetVerify(int enable)
+{
+	return streamerContextSetVerify(s_context, enable);
+}
+
+void internalStreamerSetEventFlag(StreamerContext* context)
+{
+	StreamerThread* thread = (StreamerThread*)internalStreamerGetPlatform(context);
+
+	if (thread->m_event >= 0)
 	{
-		SetEventFlag(s_event, 1);
+		SetEventFlag(thread->m_event, 1);
 	}
 }
 
-void internalStreamerIssueCompletion(int fd, int operation, int result, StreamerCallMethod method)
+void internalStreamerIssueCompletion(StreamerContext* context, int fd, int operation, int result, StreamerCallMethod method)
 {
 	switch (method)
 	{
@@ -188,7 +512,7 @@ void internalStreamerIssueCompletion(int fd, int operation, int result, Streamer
 
 		case StreamerCallMethod_SifRpc:
 		{
-			internalStreamerIssueResponse(fd, result, method);
+			internalStreamerIssueResponse(context, fd, result, method);
 		}
 		break;
 	}
@@ -509,6 +509,249 @@ int streamerLSeek(int fd, int offset, StreamerSeekMode whence)
 	return StreamerResult_Ok;
 }
 
+int streamerLSeek64(int fd, StreamerOffset offset, StreamerSeekMode whence)
+{
+	STREAMER_PRINTF(("Streamer: 64-bit seeking not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+StreamerOffset streamerTell64(int fd)
+{
+	STREAMER_PRINTF(("Streamer: 64-bit seeking not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerLoadList(StreamerLoadRequest* requests, unsigned int count)
+{
+	STREAMER_PRINTF(("Streamer: List loading not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerStat(StreamerStat* stats, unsigned int count)
+{
+	STREAMER_PRINTF(("Streamer: Stat not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerDOpen(const char* pathname)
+{
+	STREAMER_PRINTF(("Streamer: Directory access not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerDClose(int fd)
+{
+	STREAMER_PRINTF(("Streamer: Directory access not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerDRead(int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	STREAMER_PRINTF(("Streamer: Directory access not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerMount(StreamerContainer container, const char* root, const char* file, int priority)
+{
+	STREAMER_PRINTF(("Streamer: Mounting not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerUnmount(int mount)
+{
+	STREAMER_PRINTF(("Streamer: Mounting not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerGetStats(StreamerStats* stats)
+{
+	STREAMER_PRINTF(("Streamer: Statistics not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerGetLatency(StreamerLatencyStats* latency)
+{
+	STREAMER_PRINTF(("Streamer: Statistics not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerFormatLatency(const StreamerLatencyStats* latency, char* buffer, unsigned int size)
+{
+	return StreamerResult_Error;
+}
+
+int streamerTraceStart(unsigned int capacity)
+{
+	STREAMER_PRINTF(("Streamer: Tracing not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerTraceStop()
+{
+	return StreamerResult_Error;
+}
+
+int streamerTraceExport(StreamerTraceWriter writer, void* user)
+{
+	return StreamerResult_Error;
+}
+
+int streamerRecordStart(StreamerTraceWriter writer, void* user)
+{
+	STREAMER_PRINTF(("Streamer: Access recording not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerRecordStop()
+{
+	return StreamerResult_Error;
+}
+
+int streamerSetDeviceModel(const StreamerDeviceModel* model)
+{
+	STREAMER_PRINTF(("Streamer: Simulated transport not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerSetVerify(int enable)
+{
+	STREAMER_PRINTF(("Streamer: Block verification not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerSetDecompressionWorkers(int count)
+{
+	STREAMER_PRINTF(("Streamer: Decompression workers not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+StreamerContext* streamerCreateContext(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
+{
+	STREAMER_PRINTF(("Streamer: Contexts not supported over RPC\n"));
+	return 0;
+}
+
+int streamerDestroyContext(StreamerContext* context)
+{
+	STREAMER_PRINTF(("Streamer: Contexts not supported over RPC\n"));
+	return StreamerResult_Error;
+}
+
+int streamerContextPoll(StreamerContext* context, int fd)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextOpen(StreamerContext* context, const char* filename, StreamerOpenMode mode)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextClose(StreamerContext* context, int fd)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextRead(StreamerContext* context, int fd, void* buffer, unsigned int length)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextLSeek(StreamerContext* context, int fd, int offset, StreamerSeekMode whence)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextLSeek64(StreamerContext* context, int fd, StreamerOffset offset, StreamerSeekMode whence)
+{
+	return StreamerResult_Error;
+}
+
+StreamerOffset streamerContextTell64(StreamerContext* context, int fd)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextLoadList(StreamerContext* context, StreamerLoadRequest* requests, unsigned int count)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextStat(StreamerContext* context, StreamerStat* stats, unsigned int count)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextDOpen(StreamerContext* context, const char* pathname)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextDClose(StreamerContext* context, int fd)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextDRead(StreamerContext* context, int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextMount(StreamerContext* context, StreamerContainer container, const char* root, const char* file, int priority)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextUnmount(StreamerContext* context, int mount)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextGetStats(StreamerContext* context, StreamerStats* stats)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextGetLatency(StreamerContext* context, StreamerLatencyStats* latency)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextTraceStart(StreamerContext* context, unsigned int capacity)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextTraceStop(StreamerContext* context)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextTraceExport(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextRecordStart(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextRecordStop(StreamerContext* context)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextSetDeviceModel(StreamerContext* context, const StreamerDeviceModel* model)
+{
+	return StreamerResult_Error;
+}
+
+int streamerContextSetVerify(StreamerContext* context, int enable)
+{
+	return StreamerResult_Error;
+}
+
 extern char* _streamer_embedded_irx_start;
 extern char* _streamer_embedded_irx_end;
 extern int _streamer_embedded_irx_size;
@@ -24,6 +24,14 @@ SOFTWARE.
 #ifndef streamer_common_io_h
 #define streamer_common_io_h
 
+#define STREAMER_MAX_FILEHANDLES (8)
+
+#if defined(_MSC_VER)
+typedef __int64 StreamerOffset;
+#else
+typedef long long StreamerOffset;
+#endif
+
 typedef enum
 {
 	StreamerResult_Ok = 0,
@@ -48,7 +56,8 @@ typedef enum
 typedef enum
 {
 	StreamerTransport_FileIo,
-	StreamerTransport_Cdvd
+	StreamerTransport_Cdvd,
+	StreamerTransport_Simulated	// FileIo delayed by a device model, see StreamerDeviceModel
 } StreamerTransport;
 
 typedef enum
@@ -57,6 +66,167 @@ typedef enum
 	StreamerContainer_FileArchive
 } StreamerContainer;
 
+typedef struct StreamerLoadRequest
+{
+	const char* filename;		// File to load
+	void* buffer;			// Buffer receiving the file contents
+	unsigned int length;		// Size of buffer, must be large enough to hold the entire file
+	int result;			// Number of bytes loaded, <0 if the file could not be loaded
+} StreamerLoadRequest;
+
+typedef enum
+{
+	StreamerStatFlag_Hash = (1 << 0)	// Content hash is available
+} StreamerStatFlag;
+
+typedef struct StreamerStat
+{
+	const char* filename;		// File to query
+	int result;			// 0 if the file was found, <0 if an error occured
+
+	StreamerOffset size;		// Size of file
+	StreamerOffset compressedSize;	// Size of file as stored, equal to size for uncompressed files
+	unsigned int compression;	// Compression method used for file, 0 if uncompressed
+	unsigned int flags;		// Combination of StreamerStatFlag
+	unsigned char hash[20];		// SHA-1 of file contents, valid if StreamerStatFlag_Hash is set
+} StreamerStat;
+
+typedef enum
+{
+	StreamerDirEntryType_File = 0,
+	StreamerDirEntryType_Directory
+} StreamerDirEntryType;
+
+typedef struct StreamerDirEntry
+{
+	char name[256];			// Name of entry, relative to the directory
+	StreamerOffset size;		// Size of file, 0 for directories
+	StreamerDirEntryType type;	// Type of entry
+} StreamerDirEntry;
+
+#if defined(_MSC_VER)
+typedef unsigned __int64 StreamerCounter;
+#else
+typedef unsigned long long StreamerCounter;
+#endif
+
+typedef struct StreamerDeviceModel
+{
+	unsigned int overhead;		// Fixed cost of each open, stat, directory open and read, in microseconds
+	unsigned int seekTime;		// Fixed cost of a read that does not start where the previous read ended, in microseconds
+	unsigned int seekRate;		// Additional seek cost per megabyte of distance travelled, in microseconds
+	unsigned int bandwidth;		// Transfer rate in kilobytes per second, 0 for unlimited
+	unsigned int capacity;		// Size of media in megabytes, loose files are spread across it
+	int virtualClock;		// Non-zero to only account for the cost instead of waiting for it
+} StreamerDeviceModel;
+
+typedef struct StreamerHandleStats
+{
+	StreamerCounter operations;		// Operations issued on handle since it was opened
+	StreamerCounter bytesRequested;		// Bytes requested by reads
+	StreamerCounter bytesRead;		// Bytes returned by reads
+	StreamerCounter chunks;			// Driver reads used to service the reads
+	StreamerCounter driverTime;		// Time spent in driver calls, in microseconds
+} StreamerHandleStats;
+
+typedef struct StreamerStats
+{
+	StreamerCounter opens;			// Number of open requests
+	StreamerCounter closes;			// Number of close requests
+	StreamerCounter reads;			// Number of read requests
+	StreamerCounter seeks;			// Number of seek requests
+	StreamerCounter lists;			// Number of list load requests
+	StreamerCounter stats;			// Number of stat requests
+	StreamerCounter directories;		// Number of directory requests (open, close and read)
+	StreamerCounter mounts;			// Number of mount and unmount requests
+
+	StreamerCounter bytesRequested;		// Bytes requested by reads
+	StreamerCounter bytesRead;		// Bytes returned by reads and list loads
+	StreamerCounter bytesDecompressed;	// Bytes produced by decompression in containers
+	StreamerCounter chunks;			// Driver reads used to service reads
+
+	StreamerCounter queueDepthMax;		// Highest number of requests queued or in progress at once
+
+	StreamerCounter cacheHits;		// Container read cache hits
+	StreamerCounter cacheMisses;		// Container read cache misses
+	StreamerCounter blockHits;		// Blocks served from the decompressed block cache
+	StreamerCounter blockMisses;		// Blocks that had to be decompressed
+	StreamerCounter checksumErrors;		// Blocks that failed checksum verification, see streamerSetVerify()
+
+	StreamerCounter driverTime;		// Time spent in driver calls, in microseconds (includes decompressTime)
+	StreamerCounter decompressTime;		// Time spent decompressing in containers, in microseconds
+
+	StreamerCounter deviceTime;		// Cost computed by the simulated transport, in microseconds
+	StreamerCounter deviceSeeks;		// Reads on the simulated transport that had to seek
+
+	StreamerHandleStats handles[STREAMER_MAX_FILEHANDLES];
+} StreamerStats;
+
+#define STREAMER_LATENCY_BUCKETS (32)
+
+typedef enum
+{
+	StreamerLatency_Open,
+	StreamerLatency_Read,
+	StreamerLatency_LSeek,
+	StreamerLatency_Close,
+
+	StreamerLatency_Count
+} StreamerLatencyOperation;
+
+typedef struct StreamerHistogram
+{
+	StreamerCounter count;					// Number of samples
+	StreamerCounter total;					// Sum of all samples, in microseconds
+	StreamerCounter max;					// Largest sample, in microseconds
+	StreamerCounter buckets[STREAMER_LATENCY_BUCKETS];	// Bucket 0 counts samples below 1us, bucket n samples in [2^(n-1), 2^n) us
+} StreamerHistogram;
+
+typedef struct StreamerLatencyStats
+{
+	StreamerHistogram wait[StreamerLatency_Count];		// Time from submission until the streamer thread starts servicing the request
+	StreamerHistogram service[StreamerLatency_Count];	// Time from first service until the request completes
+} StreamerLatencyStats;
+
+typedef int (*StreamerTraceWriter)(const char* data, unsigned int length, void* user);	// Receives trace output, return <0 to abort
+
+// Access recording format: a StreamerRecordHeader followed by StreamerRecordEntry structures, each followed by 'path' bytes of path (no terminator)
+// All fields are stored in the byte order of the recording machine
+
+#define STREAMER_RECORD_MAGIC ((('S') << 24) | (('T') << 16) | (('R') << 8) | ('C'))
+#define STREAMER_RECORD_VERSION (3)
+
+typedef enum
+{
+	StreamerRecordCall_Open = 1,
+	StreamerRecordCall_Read,
+	StreamerRecordCall_LSeek,
+	StreamerRecordCall_Close,
+	StreamerRecordCall_Poll,	// Only polls that did not return StreamerResult_Pending are recorded
+	StreamerRecordCall_LSeek64	// Seek through streamerLSeek64(), completing with 0 instead of the new position
+} StreamerRecordCall;
+
+typedef struct StreamerRecordHeader
+{
+	unsigned int magic;		// STREAMER_RECORD_MAGIC
+	unsigned int version;		// STREAMER_RECORD_VERSION
+	unsigned int reserved[2];
+} StreamerRecordHeader;
+
+typedef struct StreamerRecordEntry
+{
+	StreamerCounter time;		// Microseconds since recording started (32 bits before version 3)
+	unsigned char call;		// StreamerRecordCall
+	unsigned char reserved;
+	unsigned short path;		// Length of path following the entry (open only)
+	int fd;				// Handle passed to the call, or handle returned by open
+	int argument;			// Open: mode, Read: length, LSeek: offset (truncated to 32 bits)
+	int whence;			// LSeek: whence
+	int result;			// Value returned by the call
+	unsigned int align;		// Aligns offset, always 0
+	StreamerOffset offset;		// Argument at full width, missing from version 1 entries
+} StreamerRecordEntry;
+
 typedef enum
 {
 	StreamerCallMethod_Normal		// Normal call, no further action required
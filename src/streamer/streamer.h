@@ -112,7 +112,7 @@ int streamerRead(int fd, void* buffer, unsigned int length);
  * Seek into an open stream
  *
  * \note Call returns immediately after being scheduled, use streamerPoll() to query for the result of the operation
- * \note Returns the new stream location on success, <0 if an error occured
+ * \note Returns the new stream location on success, <0 if an error occured (including locations beyond 2GB, use streamerLSeek64() for those)
  *
  * \param fd - File handle to seek in
  * \param offset - Offset to use when seeking
@@ -121,6 +121,349 @@ int streamerRead(int fd, void* buffer, unsigned int length);
 **/
 int streamerLSeek(int fd, int offset, StreamerSeekMode whence);
 
+/**
+ *
+ * Seek into an open stream using a 64-bit offset
+ *
+ * \note Call returns immediately after being scheduled, use streamerPoll() to query for the result of the operation
+ * \note Returns 0 on success, <0 if an error occured; use streamerTell64() for the new stream location
+ *
+ * \param fd - File handle to seek in
+ * \param offset - Offset to use when seeking
+ * \param whence - What seek mode to use
+ *
+**/
+int streamerLSeek64(int fd, StreamerOffset offset, StreamerSeekMode whence);
+
+/**
+ *
+ * Query the location of an open stream
+ *
+ * \note Call is synchronous, reflecting all completed reads and seeks on the stream
+ *
+ * \param fd - File handle to query
+ * \return Stream location, StreamerResult_Busy while a request is in progress, <0 if an error occured
+ *
+**/
+StreamerOffset streamerTell64(int fd);
+
+/**
+ *
+ * Load a list of files into memory
+ *
+ * \note Call returns immediately after being scheduled, use streamerPoll() to query for the result using the returned file handle
+ * \note Returns the number of files loaded on success, <0 if an error occured; the file handle is automatically released internally after the poll
+ * \note Containers that support it will load the files in storage order rather than list order, coalescing reads of adjacent files
+ * \note The request list and all buffers must stay valid until the operation has completed
+ *
+ * \param requests - Files to load, the result of each load is stored in the request
+ * \param count - Number of requests in list
+ * \return File handle used for tracking the request, or <0 if an error occured
+ *
+**/
+int streamerLoadList(StreamerLoadRequest* requests, unsigned int count);
+
+/**
+ *
+ * Query information about one or more files without opening them
+ *
+ * \note Call returns immediately after being scheduled, use streamerPoll() to query for the result using the returned file handle
+ * \note Returns the number of files found on success, <0 if an error occured; the file handle is automatically released internally after the poll
+ * \note The stat list must stay valid until the operation has completed
+ *
+ * \param stats - Files to query, the filename of each entry must be set
+ * \param count - Number of entries in list
+ * \return File handle used for tracking the request, or <0 if an error occured
+ *
+**/
+int streamerStat(StreamerStat* stats, unsigned int count);
+
+/**
+ *
+ * Open a directory for enumeration
+ *
+ * \note Call returns immediately after being scheduled, use streamerPoll() to query for the result using the returned file handle
+ * \note Returns 0 if operation was successful, <0 if an error occured; in the case of an error the file handle is automatically released internally after the poll
+ *
+ * \param pathname - Directory to open, an empty string opens the root
+ * \return File handle used for directory access, or <0 if an error occured
+ *
+**/
+int streamerDOpen(const char* pathname);
+
+/**
+ *
+ * Close an open directory handle
+ *
+ * \note Call returns immediately after being scheduled, use streamerPoll() to query for the result of the operation
+ *
+ * \param fd - Directory handle to close
+ * \return 0 if request has been scheduled correctly, <0 if an error occured
+ *
+**/
+int streamerDClose(int fd);
+
+/**
+ *
+ * Read entries from an open directory handle
+ *
+ * \note Call returns immediately after being scheduled, use streamerPoll() to query for the result of the operation
+ * \note Returns the number of entries read on success, 0 when there are no more entries, <0 if an error occured
+ * \note The entries "." and ".." are never returned
+ *
+ * \param fd - Directory handle to read from
+ * \param entries - Array receiving directory entries
+ * \param count - Maximum number of entries to read
+ *
+**/
+int streamerDRead(int fd, StreamerDirEntry* entries, unsigned int count);
+
+/**
+ *
+ * Mount an additional container into the mount table
+ *
+ * \note Call returns immediately after being scheduled, use streamerPoll() to query for the result using the returned file handle
+ * \note Returns the mount id (>= 0) on success, <0 if an error occured; the file handle is automatically released internally after the poll
+ * \note Lookups resolve to the highest priority source that has the file; among sources of equal priority, the most recently mounted wins
+ * \note The container passed to streamerInitialize() is mounted with priority 0
+ * \note FileArchive containers are indexed by path and content hash when mounted, so opening files does not get slower as more archives are mounted
+ * \note Mounts cannot be changed while directories are open
+ *
+ * \param container - Logical layer used for accessing files
+ * \param root - Root path for native layer
+ * \param file - Logical file stored in the native layer
+ * \param priority - Priority of mount, higher priorities override lower ones
+ * \return File handle used for tracking the request, or <0 if an error occured
+ *
+**/
+int streamerMount(StreamerContainer container, const char* root, const char* file, int priority);
+
+/**
+ *
+ * Remove a container from the mount table
+ *
+ * \note Call returns immediately after being scheduled, use streamerPoll() to query for the result using the returned file handle
+ * \note Fails if files in the container are still open
+ *
+ * \param mount - Mount id returned by streamerMount()
+ * \return File handle used for tracking the request, or <0 if an error occured
+ *
+**/
+int streamerUnmount(int mount);
+
+/**
+ *
+ * Take a snapshot of the runtime I/O counters
+ *
+ * \note Call is synchronous, counters are updated as requests are processed and are never reset
+ * \note Individual counters are read atomically where the platform allows it, but the snapshot as a whole is not
+ * \note Per-handle counters are reset when a handle is reused by streamerOpen()
+ *
+ * \param stats - Structure receiving the counters
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int streamerGetStats(StreamerStats* stats);
+
+/**
+ *
+ * Take a snapshot of the latency histograms for open, read, seek and close requests
+ *
+ * \note Call is synchronous, histograms are never reset
+ * \note Wait time covers submission until the request is first serviced, service time covers the rest until completion
+ *
+ * \param latency - Structure receiving the histograms
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int streamerGetLatency(StreamerLatencyStats* latency);
+
+/**
+ *
+ * Format latency histograms as text, one line per operation and phase
+ *
+ * \note Each line reads "<operation> <wait|service> count=N mean=N p50=N p90=N p99=N p999=N max=N buckets=N,N,..." with times in microseconds
+ * \note Percentiles report the upper bound of the bucket holding them, so they are accurate to within a factor of two
+ * \note Output is truncated if the buffer is too small, but is always terminated
+ *
+ * \param latency - Histograms to format, as returned by streamerGetLatency()
+ * \param buffer - Buffer receiving the text
+ * \param size - Size of buffer, in bytes
+ * \return Number of characters written (excluding terminator), or <0 if an error occured
+ *
+**/
+int streamerFormatLatency(const StreamerLatencyStats* latency, char* buffer, unsigned int size);
+
+/**
+ *
+ * Start recording a timeline of streamer activity
+ *
+ * \note Records submission, dequeue and completion of every request, each driver read and each decompressed container block
+ * \note Events are written to a ring that is allocated on the first call, so recording never allocates or locks; when full, the oldest events are overwritten
+ * \note Capacity is rounded up to a power of two and cannot be changed once the ring has been allocated; each event uses about 100 bytes
+ * \note Starting a new recording discards events from the previous one
+ *
+ * \param capacity - Number of events to keep
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int streamerTraceStart(unsigned int capacity);
+
+/**
+ *
+ * Stop recording, keeping the recorded events for streamerTraceExport()
+ *
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int streamerTraceStop();
+
+/**
+ *
+ * Write the recorded events as Chrome trace JSON (loadable in chrome://tracing and Perfetto)
+ *
+ * \note Timestamps are in microseconds, using the same monotonic clock as the driver timings in StreamerStats
+ * \note Requests appear as async spans keyed by file handle, driver reads and block decompression as complete events on the streamer thread
+ * \note Can be called while recording, events being overwritten during the export are skipped
+ *
+ * \param writer - Callback receiving the output in pieces
+ * \param user - User data passed to writer
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int streamerTraceExport(StreamerTraceWriter writer, void* user);
+
+/**
+ *
+ * Start recording calls to streamerOpen(), streamerRead(), streamerLSeek(), streamerClose() and streamerPoll()
+ *
+ * \note The recording is a compact binary stream (see StreamerRecordHeader and StreamerRecordEntry) that can be replayed with streamer.replay
+ * \note Calls are buffered internally; writer is invoked from the calling thread while the request queue is locked, so it should not block for long
+ * \note Polls returning StreamerResult_Pending are not recorded
+ *
+ * \param writer - Callback receiving the recording
+ * \param user - User data passed to writer
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int streamerRecordStart(StreamerTraceWriter writer, void* user);
+
+/**
+ *
+ * Stop recording, flushing buffered calls to the writer
+ *
+ * \return 0 if successful, <0 if no recording was active or the writer failed
+ *
+**/
+int streamerRecordStop();
+
+/**
+ *
+ * Change the cost model of the simulated device (StreamerTransport_Simulated)
+ *
+ * \note Call is synchronous and fails while any file handle is in use
+ * \note The model is shared by all mounts in the context; changing it also moves the simulated head back to the start of the media
+ *
+ * \param model - Model to use, NULL selects the default model
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int streamerSetDeviceModel(const StreamerDeviceModel* model);
+
+/**
+ *
+ * Verify archive blocks as they are read
+ *
+ * Archives built with 'far --checksums' store a CRC32C for each block. When enabled, every block read from such an
+ * archive is checked before it is decompressed, and reads of corrupt blocks fail (counted in
+ * StreamerStats::checksumErrors). Archives without checksums are read as before
+ *
+ * While disabled (the default) checksums are ignored and corruption goes undetected: stored blocks are returned with
+ * the damaged bytes and compressed blocks decompress to whatever the damaged data describes, with the read succeeding
+ *
+ * \note Applies to all archive mounts in the context, including later ones; blocks already in the block cache are not checked again
+ *
+ * \param enable - Non-zero to verify blocks, 0 to stop verifying
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int streamerSetVerify(int enable);
+
+/**
+ *
+ * Change the number of decompression worker threads
+ *
+ * Large archive reads are decompressed by a pool of worker threads shared by all contexts, by default one for each
+ * additional core. Fewer workers leave cores to the application, 0 decompresses every block on the calling thread
+ *
+ * \note Takes effect the next time the pool is started, which happens when the first archive mount is created after all previous ones were destroyed
+ * \note Counts above the supported maximum are clamped
+ *
+ * \param count - Number of worker threads, <0 restores the default
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int streamerSetDecompressionWorkers(int count);
+
+/**
+ *
+ * Streamer context
+ *
+ * Each context owns its own transport, container, handle table and worker. The functions above operate on a
+ * default context created by streamerInitialize(); the streamerContext*() functions below operate on explicitly
+ * created contexts and behave exactly like their default-context counterparts. File handles are only valid within
+ * the context that returned them.
+ *
+**/
+typedef struct StreamerContext StreamerContext;
+
+/**
+ *
+ * Create an independent streamer context
+ *
+ * \param transport - Native layer used for accessing the physical media
+ * \param container - Logical layer used for accessing files
+ * \param root - Root path for native layer
+ * \param file - Logical file stored in the native layer
+ * \return Context if creation was successful, 0 if an error occurs
+ *
+**/
+StreamerContext* streamerCreateContext(StreamerTransport transport, StreamerContainer container, const char* root, const char* file);
+
+/**
+ *
+ * Destroy a streamer context, closing any handles still open in it
+ *
+ * \param context - Context to destroy
+ * \return 0 if shutdown was successful, <0 if an error occurs
+ *
+**/
+int streamerDestroyContext(StreamerContext* context);
+
+int streamerContextPoll(StreamerContext* context, int fd);
+int streamerContextOpen(StreamerContext* context, const char* filename, StreamerOpenMode mode);
+int streamerContextClose(StreamerContext* context, int fd);
+int streamerContextRead(StreamerContext* context, int fd, void* buffer, unsigned int length);
+int streamerContextLSeek(StreamerContext* context, int fd, int offset, StreamerSeekMode whence);
+int streamerContextLSeek64(StreamerContext* context, int fd, StreamerOffset offset, StreamerSeekMode whence);
+StreamerOffset streamerContextTell64(StreamerContext* context, int fd);
+int streamerContextLoadList(StreamerContext* context, StreamerLoadRequest* requests, unsigned int count);
+int streamerContextStat(StreamerContext* context, StreamerStat* stats, unsigned int count);
+int streamerContextDOpen(StreamerContext* context, const char* pathname);
+int streamerContextDClose(StreamerContext* context, int fd);
+int streamerContextDRead(StreamerContext* context, int fd, StreamerDirEntry* entries, unsigned int count);
+int streamerContextMount(StreamerContext* context, StreamerContainer container, const char* root, const char* file, int priority);
+int streamerContextUnmount(StreamerContext* context, int mount);
+int streamerContextGetStats(StreamerContext* context, StreamerStats* stats);
+int streamerContextGetLatency(StreamerContext* context, StreamerLatencyStats* latency);
+int streamerContextTraceStart(StreamerContext* context, unsigned int capacity);
+int streamerContextTraceStop(StreamerContext* context);
+int streamerContextTraceExport(StreamerContext* context, StreamerTraceWriter writer, void* user);
+int streamerContextRecordStart(StreamerContext* context, StreamerTraceWriter writer, void* user);
+int streamerContextRecordStop(StreamerContext* context);
+int streamerContextSetDeviceModel(StreamerContext* context, const StreamerDeviceModel* model);
+int streamerContextSetVerify(StreamerContext* context, int enable);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -26,23 +26,32 @@ SOFTWARE.
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #if defined(__linux__)
 #define __USE_GNU
 #endif
 #include <pthread.h>
 
-static volatile uint32_t s_shutdown = 0;
-static pthread_mutex_t s_condMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t s_cond = PTHREAD_COND_INITIALIZER;
-static pthread_t s_thread = 0;
+typedef struct StreamerThread
+{
+	volatile uint32_t m_shutdown;
+	pthread_mutex_t m_condMutex;
+	pthread_cond_t m_cond;
+	pthread_t m_thread;
+} StreamerThread;
+
+static StreamerContext* s_context = 0;
 
 static void* streamerThread(void* arg)
 {
-	pthread_mutex_lock(&s_condMutex);
-	while (!s_shutdown)
+	StreamerContext* context = (StreamerContext*)arg;
+	StreamerThread* thread = (StreamerThread*)internalStreamerGetPlatform(context);
+
+	pthread_mutex_lock(&thread->m_condMutex);
+	while (!thread->m_shutdown)
 	{
-		switch (internalStreamerIdle())
+		switch (internalStreamerIdle(context))
 		{
 			case StreamerResult_Pending:
 			{
@@ -56,110 +65,430 @@ static void* streamerThread(void* arg)
 
 			default:
 			{
-				pthread_cond_wait(&s_cond, &s_condMutex);
+				pthread_cond_wait(&thread->m_cond, &thread->m_condMutex);
 			}
 			break;
 		}
 	}
-	pthread_mutex_unlock(&s_condMutex);
+	pthread_mutex_unlock(&thread->m_condMutex);
 
-	s_shutdown = 1;
 	pthread_exit(0);
 }
 
-int streamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
+StreamerContext* streamerCreateContext(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
 {
+	StreamerContext* context;
+	StreamerThread* thread;
 	int ret;
 
-	if (internalStreamerInitialize(transport, container, root, file) < 0)
+	thread = malloc(sizeof(StreamerThread));
+	if (!thread)
+	{
+		STREAMER_PRINTF(("Streamer: Failed allocating thread data\n"));
+		return 0;
+	}
+
+	thread->m_shutdown = 0;
+	pthread_mutex_init(&thread->m_condMutex, 0);
+	pthread_cond_init(&thread->m_cond, 0);
+
+	context = internalStreamerInitialize(transport, container, root, file, thread);
+	if (!context)
 	{
 		STREAMER_PRINTF(("Streamer: Failed initializing streamer engine\n"));
-		return StreamerResult_Error;
+		pthread_cond_destroy(&thread->m_cond);
+		pthread_mutex_destroy(&thread->m_condMutex);
+		free(thread);
+		return 0;
 	}
 
-	ret = pthread_create(&s_thread, 0, streamerThread, 0);
+	ret = pthread_create(&thread->m_thread, 0, streamerThread, context);
 	if (ret != 0)
 	{
 		STREAMER_PRINTF(("Streamer: Failed creating thread (%d)\n", ret));
+		internalStreamerShutdown(context);
+		pthread_cond_destroy(&thread->m_cond);
+		pthread_mutex_destroy(&thread->m_condMutex);
+		free(thread);
+		return 0;
+	}
+
+	return context;
+}
+
+int streamerDestroyContext(StreamerContext* context)
+{
+	StreamerThread* thread;
+	int result = StreamerResult_Ok;
+
+	if (!context)
+	{
 		return StreamerResult_Error;
 	}
 
-	return StreamerResult_Ok;
+	thread = (StreamerThread*)internalStreamerGetPlatform(context);
+
+	pthread_mutex_lock(&thread->m_condMutex);
+	thread->m_shutdown = 1;
+	pthread_cond_signal(&thread->m_cond);
+	pthread_mutex_unlock(&thread->m_condMutex);
+
+	pthread_join(thread->m_thread, 0);
+
+	if (internalStreamerShutdown(context) < 0)
+	{
+		STREAMER_PRINTF(("Streamer: Failed shutting down streamer engine\n"));
+		result = StreamerResult_Error;
+	}
+
+	pthread_cond_destroy(&thread->m_cond);
+	pthread_mutex_destroy(&thread->m_condMutex);
+	free(thread);
+
+	return result;
 }
 
-int streamerShutdown()
+int streamerContextPoll(StreamerContext* context, int fd)
 {
-	if (s_thread)
+	return internalStreamerPoll(context, fd);
+}
+
+int streamerContextOpen(StreamerContext* context, const char* filename, StreamerOpenMode mode)
+{
+	int result = internalStreamerOpen(context, filename, mode, StreamerCallMethod_Normal);
+	if (result >= 0)
 	{
-		s_shutdown = 1;
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
 
-		pthread_join(s_thread, 0);
+int streamerContextClose(StreamerContext* context, int fd)
+{
+	int result = internalStreamerClose(context, fd, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
 
-		s_thread = 0; s_shutdown = 0;
+int streamerContextRead(StreamerContext* context, int fd, void* buffer, unsigned int length)
+{
+	int result = internalStreamerRead(context, fd, buffer, length, 0, 0, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
 	}
+	return result;
+}
 
-	if (internalStreamerShutdown() < 0)
+int streamerContextLSeek(StreamerContext* context, int fd, int offset, StreamerSeekMode whence)
+{
+	int result = internalStreamerLSeek(context, fd, offset, whence, StreamerCallMethod_Normal);
+	if (result >= 0)
 	{
-		STREAMER_PRINTF(("Streamer: Failed shutting down streamer engine\n"));
-		return StreamerResult_Error;
+		internalStreamerSetEventFlag(context);
 	}
+	return result;
+}
 
-	return StreamerResult_Ok;
+int streamerContextLSeek64(StreamerContext* context, int fd, StreamerOffset offset, StreamerSeekMode whence)
+{
+	int result = internalStreamerLSeek64(context, fd, offset, whence, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
 }
 
-int streamerPoll(int fd)
+StreamerOffset streamerContextTell64(StreamerContext* context, int fd)
 {
-	return internalStreamerPoll(fd);
+	return internalStreamerTell64(context, fd);
 }
 
-int streamerOpen(const char* filename, StreamerOpenMode mode)
+int streamerContextLoadList(StreamerContext* context, StreamerLoadRequest* requests, unsigned int count)
 {
-	int result = internalStreamerOpen(filename, mode, StreamerCallMethod_Normal);
+	int result = internalStreamerLoadList(context, requests, count, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-int streamerClose(int fd)
+int streamerContextStat(StreamerContext* context, StreamerStat* stats, unsigned int count)
 {
-	int result = internalStreamerClose(fd, StreamerCallMethod_Normal);
+	int result = internalStreamerStat(context, stats, count, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-int streamerRead(int fd, void* buffer, unsigned int length)
+int streamerContextDOpen(StreamerContext* context, const char* pathname)
 {
-	int result = internalStreamerRead(fd, buffer, length, 0, 0, StreamerCallMethod_Normal);
+	int result = internalStreamerDOpen(context, pathname, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-int streamerLSeek(int fd, int offset, StreamerSeekMode whence)
+int streamerContextDClose(StreamerContext* context, int fd)
 {
-	int result = internalStreamerLSeek(fd, offset, whence, StreamerCallMethod_Normal);
+	int result = internalStreamerDClose(context, fd, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextDRead(StreamerContext* context, int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	int result = internalStreamerDRead(context, fd, entries, count, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextMount(StreamerContext* context, StreamerContainer container, const char* root, const char* file, int priority)
+{
+	int result = internalStreamerMount(context, container, root, file, priority, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextUnmount(StreamerContext* context, int mount)
+{
+	int result = internalStreamerUnmount(context, mount, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextGetStats(StreamerContext* context, StreamerStats* stats)
+{
+	return internalStreamerGetStats(context, stats);
+}
+
+int streamerContextGetLatency(StreamerContext* context, StreamerLatencyStats* latency)
+{
+	return internalStreamerGetLatency(context, latency);
+}
+
+int streamerContextTraceStart(StreamerContext* context, unsigned int capacity)
+{
+	return internalStreamerTraceStart(context, capacity);
+}
+
+int streamerContextTraceStop(StreamerContext* context)
+{
+	return internalStreamerTraceStop(context);
+}
+
+int streamerContextTraceExport(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	return internalStreamerTraceExport(context, writer, user);
+}
+
+int streamerContextRecordStart(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	return internalStreamerRecordStart(context, writer, user);
+}
+
+int streamerContextRecordStop(StreamerContext* context)
+{
+	return internalStreamerRecordStop(context);
+}
+
+int streamerContextSetDeviceModel(StreamerContext* context, const StreamerDeviceModel* model)
+{
+	return internalStreamerSetDeviceModel(context, model);
+}
+
+int streamerContextSetVerify(StreamerContext* context, int enable)
+{
+	return internalStreamerSetVerify(context, enable);
+}
+
+int streamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
+{
+	if (s_context)
+	{
+		STREAMER_PRINTF(("Streamer: Already initialized\n"));
+		return StreamerResult_Error;
 	}
+
+	s_context = streamerCreateContext(transport, container, root, file);
+	if (!s_context)
+	{
+		return StreamerResult_Error;
+	}
+
+	return StreamerResult_Ok;
+}
+
+int streamerShutdown()
+{
+	int result;
+
+	if (!s_context)
+	{
+		return StreamerResult_Ok;
+	}
+
+	result = streamerDestroyContext(s_context);
+	s_context = 0;
+
 	return result;
 }
 
-void internalStreamerSetEventFlag()
+int streamerPoll(int fd)
+{
+	return streamerContextPoll(s_context, fd);
+}
+
+int streamerOpen(const char* filename, StreamerOpenMode mode)
+{
+	return streamerContextOpen(s_context, filename, mode);
+}
+
+int streamerClose(int fd)
 {
-	pthread_mutex_lock(&s_condMutex);
-	pthread_cond_signal(&s_cond);
-	pthread_mutex_unlock(&s_condMutex);
+	return streamerContextClose(s_context, fd);
+}
+
+int streamerRead(int fd, void* buffer, unsigned int length)
+{
+	return streamerContextRead(s_context, fd, buffer, length);
+}
+
+int streamerLSeek(int fd, int offset, StreamerSeekMode whence)
+{
+	return streamerContextLSeek(s_context, fd, offset, whence);
+}
+
+int streamerLSeek64(int fd, StreamerOffset offset, StreamerSeekMode whence)
+{
+	return streamerContextLSeek64(s_context, fd, offset, whence);
+}
+
+StreamerOffset streamerTell64(int fd)
+{
+	return streamerContextTell64(s_context, fd);
+}
+
+int streamerLoadList(StreamerLoadRequest* requests, unsigned int count)
+{
+	return streamerContextLoadList(s_context, requests, count);
+}
+
+int streamerStat(StreamerStat* stats, unsigned int count)
+{
+	return streamerContextStat(s_context, stats, count);
+}
+
+int streamerDOpen(const char* pathname)
+{
+	return streamerContextDOpen(s_context, pathname);
+}
+
+int streamerDClose(int fd)
+{
+	return streamerContextDClose(s_context, fd);
+}
+
+int streamerDRead(int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	return streamerContextDRead(s_context, fd, entries, count);
+}
+
+int streamerMount(StreamerContainer container, const char* root, const char* file, int priority)
+{
+	return streamerContextMount(s_context, container, root, file, priority);
+}
+
+int streamerUnmount(int mount)
+{
+	return streamerContextUnmount(s_context, mount);
+}
+
+int streamerGetStats(StreamerStats* stats)
+{
+	return streamerContextGetStats(s_context, stats);
+}
+
+int streamerGetLatency(StreamerLatencyStats* latency)
+{
+	return streamerContextGetLatency(s_context, latency);
+}
+
+int streamerFormatLatency(const StreamerLatencyStats* latency, char* buffer, unsigned int size)
+{
+	return internalStreamerFormatLatency(latency, buffer, size);
+}
+
+int streamerTraceStart(unsigned int capacity)
+{
+	return streamerContextTraceStart(s_context, capacity);
+}
+
+int streamerTraceStop()
+{
+	return streamerContextTraceStop(s_context);
+}
+
+int streamerTraceExport(StreamerTraceWriter writer, void* user)
+{
+	return streamerContextTraceExport(s_context, writer, user);
+}
+
+int streamerRecordStart(StreamerTraceWriter writer, void* user)
+{
+	return streamerContextRecordStart(s_context, writer, user);
+}
+
+int streamerRecordStop()
+{
+	return streamerContextRecordStop(s_context);
+}
+
+int streamerSetDeviceModel(const StreamerDeviceModel* model)
+{
+	return streamerContextSetDeviceModel(s_context, model);
+}
+
+int streamerSetVerify(int enable)
+{
+	return streamerContextSetVerify(s_context, enable);
+}
+
+int streamerSetDecompressionWorkers(int count)
+{
+	return internalStreamerSetDecompressionWorkers(count);
+}
+
+void internalStreamerSetEventFlag(StreamerContext* context)
+{
+	StreamerThread* thread = (StreamerThread*)internalStreamerGetPlatform(context);
+
+	pthread_mutex_lock(&thread->m_condMutex);
+	pthread_cond_signal(&thread->m_cond);
+	pthread_mutex_unlock(&thread->m_condMutex);
 }
 
-void internalStreamerIssueCompletion(int fd, int operation, int result, StreamerCallMethod method)
+void internalStreamerIssueCompletion(StreamerContext* context, int fd, int operation, int result, StreamerCallMethod method)
 {
 }
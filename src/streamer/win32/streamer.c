@@ -28,6 +28,7 @@ SOFTWARE.
 #include <windows.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 
 void streamer_dprintf(const char* fmt, ...)
@@ -43,17 +44,25 @@ void streamer_dprintf(const char* fmt, ...)
 	fprintf(stderr, buffer);
 }
 
-static volatile BOOL s_shutdown = FALSE;
-static HANDLE s_thread = 0;
-static HANDLE s_event = 0;
+typedef struct StreamerThread
+{
+	volatile BOOL m_shutdown;
+	HANDLE m_thread;
+	HANDLE m_event;
+} StreamerThread;
+
+static StreamerContext* s_context = 0;
 
 static DWORD WINAPI streamerThread(LPVOID arg)
 {
+	StreamerContext* context = (StreamerContext*)arg;
+	StreamerThread* thread = (StreamerThread*)internalStreamerGetPlatform(context);
+
 	STREAMER_PRINTF(("Streamer: Thread started\n"));
  
-	while (s_shutdown != TRUE)
+	while (thread->m_shutdown != TRUE)
 	{
-		switch (internalStreamerIdle())
+		switch (internalStreamerIdle(context))
 		{
 			case StreamerResult_Pending:
 			{
@@ -63,126 +72,428 @@ static DWORD WINAPI streamerThread(LPVOID arg)
 
 			default:
 			{
-				WaitForSingleObject(s_event, INFINITE);
+				WaitForSingleObject(thread->m_event, INFINITE);
 			}
 			break;
 		}
 	}
 
-	s_shutdown = FALSE;
-
 	STREAMER_PRINTF(("Streamer: Thread stopped\n"));
 	return 0;
 }
 
-int streamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
+StreamerContext* streamerCreateContext(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
 {
-	s_event = CreateEvent(0, FALSE, FALSE, 0);
-	if (!s_event)
+	StreamerContext* context;
+	StreamerThread* thread;
+
+	thread = malloc(sizeof(StreamerThread));
+	if (!thread)
+	{
+		STREAMER_PRINTF(("Streamer: Failed allocating thread data\n"));
+		return 0;
+	}
+
+	thread->m_shutdown = FALSE;
+	thread->m_thread = 0;
+	thread->m_event = CreateEvent(0, FALSE, FALSE, 0);
+	if (!thread->m_event)
 	{
 		STREAMER_PRINTF(("Streamer: Failed creating event\n"));
-		return StreamerResult_Error;
+		free(thread);
+		return 0;
+	}
+
+	context = internalStreamerInitialize(transport, container, root, file, thread);
+	if (!context)
+	{
+		STREAMER_PRINTF(("Streamer: Failed initializing streamer engine\n"));
+		CloseHandle(thread->m_event);
+		free(thread);
+		return 0;
 	}
 
-	s_thread = CreateThread(0, 0, streamerThread, 0, CREATE_SUSPENDED, 0);
-	if (!s_thread)
+	thread->m_thread = CreateThread(0, 0, streamerThread, context, 0, 0);
+	if (!thread->m_thread)
 	{
 		STREAMER_PRINTF(("Streamer: Failed creating thread\n"));
-		CloseHandle(s_event);
-		s_event = 0;
-		return StreamerResult_Error;
+		internalStreamerShutdown(context);
+		CloseHandle(thread->m_event);
+		free(thread);
+		return 0;
 	}
 
-	if (internalStreamerInitialize(transport, container, root, file) < 0)
+	return context;
+}
+
+int streamerDestroyContext(StreamerContext* context)
+{
+	StreamerThread* thread;
+	int result = StreamerResult_Ok;
+
+	if (!context)
 	{
-		STREAMER_PRINTF(("Streamer: Failed initializing streamer engine\n"));
-		CloseHandle(s_thread);
-		CloseHandle(s_event);
-		s_event = s_thread = 0;
 		return StreamerResult_Error;
 	}
 
-	ResumeThread(s_thread);
-	return StreamerResult_Ok;
+	thread = (StreamerThread*)internalStreamerGetPlatform(context);
+
+	thread->m_shutdown = TRUE;
+	SetEvent(thread->m_event);
+
+	WaitForSingleObject(thread->m_thread, INFINITE);
+
+	if (internalStreamerShutdown(context) < 0)
+	{
+		STREAMER_PRINTF(("Streamer: Failed shutting down streamer engine\n"));
+		result = StreamerResult_Error;
+	}
+
+	CloseHandle(thread->m_thread);
+	CloseHandle(thread->m_event);
+	free(thread);
+
+	return result;
 }
 
-int streamerShutdown()
+int streamerContextPoll(StreamerContext* context, int fd)
 {
-	if (s_thread)
+	return internalStreamerPoll(context, fd);
+}
+
+int streamerContextOpen(StreamerContext* context, const char* filename, StreamerOpenMode mode)
+{
+	int result = internalStreamerOpen(context, filename, mode, StreamerCallMethod_Normal);
+	if (result >= 0)
 	{
-		s_shutdown = TRUE;
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
 
-		while (s_shutdown != FALSE)
-		{
-			SleepEx(1, TRUE);
-		}
+int streamerContextClose(StreamerContext* context, int fd)
+{
+	int result = internalStreamerClose(context, fd, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
 
-		CloseHandle(s_thread);
-		CloseHandle(s_event);
-		s_thread = s_event = 0;
+int streamerContextRead(StreamerContext* context, int fd, void* buffer, unsigned int length)
+{
+	int result = internalStreamerRead(context, fd, buffer, length, 0, 0, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
 	}
+	return result;
+}
 
-	if (internalStreamerShutdown() < 0)
+int streamerContextLSeek(StreamerContext* context, int fd, int offset, StreamerSeekMode whence)
+{
+	int result = internalStreamerLSeek(context, fd, offset, whence, StreamerCallMethod_Normal);
+	if (result >= 0)
 	{
-		STREAMER_PRINTF(("Streamer: Failed shutting down streamer engine\n"));
-		return StreamerResult_Error;
+		internalStreamerSetEventFlag(context);
 	}
+	return result;
+}
 
-	return StreamerResult_Ok;
+int streamerContextLSeek64(StreamerContext* context, int fd, StreamerOffset offset, StreamerSeekMode whence)
+{
+	int result = internalStreamerLSeek64(context, fd, offset, whence, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
 }
 
-int streamerPoll(int fd)
+StreamerOffset streamerContextTell64(StreamerContext* context, int fd)
 {
-	return internalStreamerPoll(fd);
+	return internalStreamerTell64(context, fd);
 }
 
-int streamerOpen(const char* filename, StreamerOpenMode mode)
+int streamerContextLoadList(StreamerContext* context, StreamerLoadRequest* requests, unsigned int count)
 {
-	int result = internalStreamerOpen(filename, mode, StreamerCallMethod_Normal);
+	int result = internalStreamerLoadList(context, requests, count, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-int streamerClose(int fd)
+int streamerContextStat(StreamerContext* context, StreamerStat* stats, unsigned int count)
 {
-	int result = internalStreamerClose(fd, StreamerCallMethod_Normal);
+	int result = internalStreamerStat(context, stats, count, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-int streamerRead(int fd, void* buffer, unsigned int length)
+int streamerContextDOpen(StreamerContext* context, const char* pathname)
 {
-	int result = internalStreamerRead(fd, buffer, length, 0, 0, StreamerCallMethod_Normal);
+	int result = internalStreamerDOpen(context, pathname, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
 	}
 	return result;
 }
 
-int streamerLSeek(int fd, int offset, StreamerSeekMode whence)
+int streamerContextDClose(StreamerContext* context, int fd)
+{
+	int result = internalStreamerDClose(context, fd, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextDRead(StreamerContext* context, int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	int result = internalStreamerDRead(context, fd, entries, count, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextMount(StreamerContext* context, StreamerContainer container, const char* root, const char* file, int priority)
 {
-	int result = internalStreamerLSeek(fd, offset, whence, StreamerCallMethod_Normal);
+	int result = internalStreamerMount(context, container, root, file, priority, StreamerCallMethod_Normal);
 	if (result >= 0)
 	{
-		internalStreamerSetEventFlag();
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextUnmount(StreamerContext* context, int mount)
+{
+	int result = internalStreamerUnmount(context, mount, StreamerCallMethod_Normal);
+	if (result >= 0)
+	{
+		internalStreamerSetEventFlag(context);
+	}
+	return result;
+}
+
+int streamerContextGetStats(StreamerContext* context, StreamerStats* stats)
+{
+	return internalStreamerGetStats(context, stats);
+}
+
+int streamerContextGetLatency(StreamerContext* context, StreamerLatencyStats* latency)
+{
+	return internalStreamerGetLatency(context, latency);
+}
+
+int streamerContextTraceStart(StreamerContext* context, unsigned int capacity)
+{
+	return internalStreamerTraceStart(context, capacity);
+}
+
+int streamerContextTraceStop(StreamerContext* context)
+{
+	return internalStreamerTraceStop(context);
+}
+
+int streamerContextTraceExport(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	return internalStreamerTraceExport(context, writer, user);
+}
+
+int streamerContextRecordStart(StreamerContext* context, StreamerTraceWriter writer, void* user)
+{
+	return internalStreamerRecordStart(context, writer, user);
+}
+
+int streamerContextRecordStop(StreamerContext* context)
+{
+	return internalStreamerRecordStop(context);
+}
+
+int streamerContextSetDeviceModel(StreamerContext* context, const StreamerDeviceModel* model)
+{
+	return internalStreamerSetDeviceModel(context, model);
+}
+
+int streamerContextSetVerify(StreamerContext* context, int enable)
+{
+	return internalStreamerSetVerify(context, enable);
+}
+
+int streamerInitialize(StreamerTransport transport, StreamerContainer container, const char* root, const char* file)
+{
+	if (s_context)
+	{
+		STREAMER_PRINTF(("Streamer: Already initialized\n"));
+		return StreamerResult_Error;
+	}
+
+	s_context = streamerCreateContext(transport, container, root, file);
+	if (!s_context)
+	{
+		return StreamerResult_Error;
+	}
+
+	return StreamerResult_Ok;
+}
+
+int streamerShutdown()
+{
+	int result;
+
+	if (!s_context)
+	{
+		return StreamerResult_Ok;
 	}
+
+	result = streamerDestroyContext(s_context);
+	s_context = 0;
+
 	return result;
 }
 
-void internalStreamerSetEventFlag()
+int streamerPoll(int fd)
+{
+	return streamerContextPoll(s_context, fd);
+}
+
+int streamerOpen(const char* filename, StreamerOpenMode mode)
+{
+	return streamerContextOpen(s_context, filename, mode);
+}
+
+int streamerClose(int fd)
 {
-	SetEvent(s_event);
+	return streamerContextClose(s_context, fd);
 }
 
-void internalStreamerIssueCompletion(int fd, int operation, int result, StreamerCallMethod method)
+int streamerRead(int fd, void* buffer, unsigned int length)
 {
+	return streamerContextRead(s_context, fd, buffer, length);
 }
 
+int streamerLSeek(int fd, int offset, StreamerSeekMode whence)
+{
+	return streamerContextLSeek(s_context, fd, offset, whence);
+}
+
+int streamerLSeek64(int fd, StreamerOffset offset, StreamerSeekMode whence)
+{
+	return streamerContextLSeek64(s_context, fd, offset, whence);
+}
+
+StreamerOffset streamerTell64(int fd)
+{
+	return streamerContextTell64(s_context, fd);
+}
+
+int streamerLoadList(StreamerLoadRequest* requests, unsigned int count)
+{
+	return streamerContextLoadList(s_context, requests, count);
+}
+
+int streamerStat(StreamerStat* stats, unsigned int count)
+{
+	return streamerContextStat(s_context, stats, count);
+}
+
+int streamerDOpen(const char* pathname)
+{
+	return streamerContextDOpen(s_context, pathname);
+}
+
+int streamerDClose(int fd)
+{
+	return streamerContextDClose(s_context, fd);
+}
+
+int streamerDRead(int fd, StreamerDirEntry* entries, unsigned int count)
+{
+	return streamerContextDRead(s_context, fd, entries, count);
+}
+
+int streamerMount(StreamerContainer container, const char* root, const char* file, int priority)
+{
+	return streamerContextMount(s_context, container, root, file, priority);
+}
+
+int streamerUnmount(int mount)
+{
+	return streamerContextUnmount(s_context, mount);
+}
+
+int streamerGetStats(StreamerStats* stats)
+{
+	return streamerContextGetStats(s_context, stats);
+}
+
+int streamerGetLatency(StreamerLatencyStats* latency)
+{
+	return streamerContextGetLatency(s_context, latency);
+}
+
+int streamerFormatLatency(const StreamerLatencyStats* latency, char* buffer, unsigned int size)
+{
+	return internalStreamerFormatLatency(latency, buffer, size);
+}
+
+int streamerTraceStart(unsigned int capacity)
+{
+	return streamerContextTraceStart(s_context, capacity);
+}
+
+int streamerTraceStop()
+{
+	return streamerContextTraceStop(s_context);
+}
+
+int streamerTraceExport(StreamerTraceWriter writer, void* user)
+{
+	return streamerContextTraceExport(s_context, writer, user);
+}
+
+int streamerRecordStart(StreamerTraceWriter writer, void* user)
+{
+	return streamerContextRecordStart(s_context, writer, user);
+}
+
+int streamerRecordStop()
+{
+	return streamerContextRecordStop(s_context);
+}
+
+int streamerSetDeviceModel(const StreamerDeviceModel* model)
+{
+	return streamerContextSetDeviceModel(s_context, model);
+}
+
+int streamerSetVerify(int enable)
+{
+	return streamerContextSetVerify(s_context, enable);
+}
+
+int streamerSetDecompressionWorkers(int count)
+{
+	return internalStreamerSetDecompressionWorkers(count);
+}
+
+void internalStreamerSetEventFlag(StreamerContext* context)
+{
+	StreamerThread* thread = (StreamerThread*)internalStreamerGetPlatform(context);
+	SetEvent(thread->m_event);
+}
+
+void internalStreamerIssueCompletion(StreamerContext* context, int fd, int operation, int result, StreamerCallMethod method)
+{
+}
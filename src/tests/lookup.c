@@ -0,0 +1,202 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "tests.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOOKUP_FILES (240)
+#define LOOKUP_LARGEST (24 * 1024)
+
+// Both pairs hash to the same FNV-1a value, the second path of the last pair is left out of the tree
+
+static const char* s_collisions[][2] =
+{
+	{ "collide/p3rqp6w.bin", "collide/9c3pg8u.bin" },
+	{ "collide/8mo0aso.bin", "collide/mo63pd8.bin" }
+};
+
+static const char* s_missingPaths[] =
+{
+	"collide/mo63pd8.bin",
+	"dir00/sub0/missing.dat",
+	"nodir/file000.dat",
+	"file000.dat"
+};
+
+static const char* s_missingHashes[] =
+{
+	"@0000000000000000000000000000000000000000",
+	"@ffffffffffffffffffffffffffffffffffffffff",
+	"@da39a3ee5e6b4b0d3255bfef95601890afd80708"	// Empty file, the tree has none
+};
+
+static unsigned int lookupHash(const char* path)
+{
+	unsigned int hash = 2166136261u;
+
+	while (*path)
+	{
+		hash = (hash ^ (unsigned char)*path++) * 16777619u;
+	}
+
+	return hash;
+}
+
+static unsigned int lookupCreateFiles(TestFile* files)
+{
+	unsigned int count = 0, i;
+
+	// Every seventh file shares its contents with others, so hash lookups see runs of equal hashes
+
+	for (i = 0; i < LOOKUP_FILES; ++i, ++count)
+	{
+		TestFile* file = &(files[count]);
+
+		sprintf(file->path, "dir%02u/sub%u/file%03u.dat", i % 12, i % 3, i);
+		file->seed = (i % 7) ? i + 1 : 0;
+		file->size = (i % 7) ? 1 + (i * 7919) % LOOKUP_LARGEST : 3000;
+	}
+
+	for (i = 0; i < 8; ++i, ++count)
+	{
+		sprintf(files[count].path, "root%u.txt", i);
+		files[count].seed = 1000 + i;
+		files[count].size = 100 + i;
+	}
+
+	for (i = 0; i < sizeof(s_collisions) / sizeof(s_collisions[0]); ++i)
+	{
+		unsigned int n = (i + 1) < sizeof(s_collisions) / sizeof(s_collisions[0]) ? 2 : 1;
+		unsigned int j;
+
+		for (j = 0; j < n; ++j, ++count)
+		{
+			strcpy(files[count].path, s_collisions[i][j]);
+			files[count].seed = 2000 + count;
+			files[count].size = 500 + count;
+		}
+	}
+
+	return count;
+}
+
+static int lookupMisses(StreamerContext* context, unsigned char* buffer)
+{
+	int failed = 0;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(s_missingPaths) / sizeof(s_missingPaths[0]); ++i)
+	{
+		if (testReadFile(context, s_missingPaths[i], buffer, LOOKUP_LARGEST) >= 0)
+		{
+			fprintf(stderr, "Opened missing file \"%s\"\n", s_missingPaths[i]);
+			failed = 1;
+		}
+	}
+
+	for (i = 0; i < sizeof(s_missingHashes) / sizeof(s_missingHashes[0]); ++i)
+	{
+		if (testReadFile(context, s_missingHashes[i], buffer, LOOKUP_LARGEST) >= 0)
+		{
+			fprintf(stderr, "Opened missing hash \"%s\"\n", s_missingHashes[i]);
+			failed = 1;
+		}
+	}
+
+	return failed ? -1 : 0;
+}
+
+static int lookupArchive(const TestEnvironment* env, const char* archive, int paths, const TestFile* files, unsigned int count, unsigned char* expected, unsigned char* buffer)
+{
+	StreamerContext* context;
+	unsigned int i;
+	int failed = 0;
+
+	context = testOpenArchive(env, StreamerTransport_FileIo, archive);
+	if (!context)
+	{
+		return -1;
+	}
+
+	// Misses are checked before and after the bulk lookups, as archives that are touched lazily are only indexed
+	// after a number of lookups. Without paths the index is reached through content hash lookups alone
+
+	failed |= lookupMisses(context, buffer);
+
+	for (i = 0; i < count; ++i)
+	{
+		const TestFile* file = &(files[i]);
+		char name[42];
+		int ret;
+
+		testFill(file->seed, expected, file->size);
+		testDigest(expected, file->size, name);
+
+		ret = paths ? testReadFile(context, file->path, buffer, LOOKUP_LARGEST) : (int)file->size;
+		if ((ret != (int)file->size) || (paths && memcmp(buffer, expected, file->size)))
+		{
+			fprintf(stderr, "%s: Mismatch reading \"%s\" (%d of %u bytes)\n", archive, file->path, ret, file->size);
+			failed = 1;
+		}
+
+		ret = testReadFile(context, name, buffer, LOOKUP_LARGEST);
+		if ((ret != (int)file->size) || memcmp(buffer, expected, file->size))
+		{
+			fprintf(stderr, "%s: Mismatch reading \"%s\" (%d of %u bytes)\n", archive, name, ret, file->size);
+			failed = 1;
+		}
+	}
+
+	failed |= lookupMisses(context, buffer);
+
+	streamerDestroyContext(context);
+	return failed ? -1 : 0;
+}
+
+int testLookup(const TestEnvironment* env)
+{
+	unsigned char* expected = malloc(LOOKUP_LARGEST);
+	unsigned char* buffer = malloc(LOOKUP_LARGEST);
+	TestFile* files = malloc((LOOKUP_FILES + 16) * sizeof(TestFile));
+	unsigned int count, i;
+	int failed = 0;
+
+	if (!expected || !buffer || !files)
+	{
+		fprintf(stderr, "Failed to allocate lookup buffers\n");
+		free(expected);
+		free(buffer);
+		free(files);
+		return -1;
+	}
+
+	for (i = 0; i < sizeof(s_collisions) / sizeof(s_collisions[0]); ++i)
+	{
+		if (lookupHash(s_collisions[i][0]) != lookupHash(s_collisions[i][1]))
+		{
+			fprintf(stderr, "\"%s\" and \"%s\" no longer collide\n", s_collisions[i][0], s_collisions[i][1]);
+			failed = 1;
+		}
+	}
+
+	count = lookupCreateFiles(files);
+
+	if (failed || (testWriteTree(env, "lookup", files, count) < 0) || (testBuildArchive(env, "lookup", "lookup", "") < 0) || (testBuildArchive(env, "lookup", "lookup_paged", "--pack-toc") < 0))
+	{
+		failed = 1;
+	}
+	else
+	{
+		failed |= lookupArchive(env, "lookup", 1, files, count, expected, buffer) < 0;
+		failed |= lookupArchive(env, "lookup_paged", 1, files, count, expected, buffer) < 0;
+		failed |= lookupArchive(env, "lookup", 0, files, count, expected, buffer) < 0;
+		failed |= lookupArchive(env, "lookup_paged", 0, files, count, expected, buffer) < 0;
+	}
+
+	free(expected);
+	free(buffer);
+	free(files);
+	return failed ? -1 : 0;
+}
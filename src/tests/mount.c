@@ -0,0 +1,221 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "tests.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOUNT_SIZE(seed) (2000 + (seed) * 13)
+#define MOUNT_LARGEST MOUNT_SIZE(400)
+
+#define MOUNT_HASH (1)		// Open by content hash of the seeded contents rather than by path
+#define MOUNT_UPPER (2)		// Content hash in upper case
+#define MOUNT_MISSING (4)	// Open is expected to fail
+
+typedef struct MountCheck
+{
+	const char* path;
+	unsigned int seed;	// Expected contents
+	int flags;
+} MountCheck;
+
+// Each archive has its own version of shared.bin. dup.bin has the same contents in a and c, and dir is a directory
+// in a but a file in b
+
+static const TestFile s_filesA[] =
+{
+	{ "shared.bin", MOUNT_SIZE(101), 101 },
+	{ "only_a.bin", MOUNT_SIZE(102), 102 },
+	{ "dup.bin", MOUNT_SIZE(100), 100 },
+	{ "dir/x.bin", MOUNT_SIZE(103), 103 }
+};
+
+static const TestFile s_filesB[] =
+{
+	{ "shared.bin", MOUNT_SIZE(201), 201 },
+	{ "only_b.bin", MOUNT_SIZE(202), 202 },
+	{ "dir", MOUNT_SIZE(203), 203 }
+};
+
+static const TestFile s_filesC[] =
+{
+	{ "shared.bin", MOUNT_SIZE(301), 301 },
+	{ "only_c.bin", MOUNT_SIZE(302), 302 },
+	{ "dup.bin", MOUNT_SIZE(100), 100 }
+};
+
+// a (0), b (1), c (0) mounted in that order, so b wins over c and c over a
+
+static const MountCheck s_all[] =
+{
+	{ "shared.bin", 201, 0 },
+	{ "only_a.bin", 102, 0 },
+	{ "only_b.bin", 202, 0 },
+	{ "only_c.bin", 302, 0 },
+	{ "dir", 203, 0 },
+	{ "dir/x.bin", 103, 0 },
+	{ "missing.bin", 0, MOUNT_MISSING },
+	{ 0, 101, MOUNT_HASH },
+	{ 0, 201, MOUNT_HASH },
+	{ 0, 301, MOUNT_HASH | MOUNT_UPPER },
+	{ 0, 100, MOUNT_HASH },
+	{ 0, 102, MOUNT_HASH | MOUNT_UPPER },
+	{ 0, 400, MOUNT_HASH | MOUNT_MISSING }
+};
+
+static const MountCheck s_withoutB[] =
+{
+	{ "shared.bin", 301, 0 },
+	{ "only_b.bin", 0, MOUNT_MISSING },
+	{ "dir", 0, MOUNT_MISSING },
+	{ "dir/x.bin", 103, 0 },
+	{ 0, 201, MOUNT_HASH | MOUNT_MISSING },
+	{ 0, 202, MOUNT_HASH | MOUNT_MISSING },
+	{ 0, 101, MOUNT_HASH },
+	{ 0, 100, MOUNT_HASH }
+};
+
+static const MountCheck s_onlyA[] =
+{
+	{ "shared.bin", 101, 0 },
+	{ "only_c.bin", 0, MOUNT_MISSING },
+	{ "dir/x.bin", 103, 0 },
+	{ 0, 301, MOUNT_HASH | MOUNT_MISSING },
+	{ 0, 100, MOUNT_HASH },
+	{ 0, 103, MOUNT_HASH | MOUNT_UPPER }
+};
+
+// b (1) and c (2) mounted again, on top of a
+
+static const MountCheck s_remounted[] =
+{
+	{ "shared.bin", 301, 0 },
+	{ "only_b.bin", 202, 0 },
+	{ "dir", 203, 0 },
+	{ "dir/x.bin", 103, 0 },
+	{ 0, 201, MOUNT_HASH },
+	{ 0, 302, MOUNT_HASH },
+	{ 0, 100, MOUNT_HASH }
+};
+
+static int mountAdd(const TestEnvironment* env, StreamerContext* context, const char* archive, int priority)
+{
+	char path[512];
+	int fd;
+
+	sprintf(path, "%s%s.far", env->work, archive);
+
+	fd = streamerContextMount(context, StreamerContainer_FileArchive, "", path, priority);
+	fd = fd < 0 ? fd : testWait(context, fd);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Failed to mount \"%s\"\n", path);
+	}
+
+	return fd;
+}
+
+static int mountRemove(StreamerContext* context, int mount)
+{
+	int fd = streamerContextUnmount(context, mount);
+
+	fd = fd < 0 ? fd : testWait(context, fd);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Failed to unmount %d\n", mount);
+	}
+
+	return fd;
+}
+
+static int mountCheck(StreamerContext* context, const char* stage, const MountCheck* checks, unsigned int count, unsigned char* expected, unsigned char* buffer)
+{
+	int failed = 0;
+	unsigned int i;
+
+	for (i = 0; i < count; ++i)
+	{
+		const MountCheck* check = &(checks[i]);
+		unsigned int size = MOUNT_SIZE(check->seed);
+		char name[42];
+		const char* path = check->path;
+		int ret;
+
+		testFill(check->seed, expected, size);
+
+		if (check->flags & MOUNT_HASH)
+		{
+			char* curr;
+
+			testDigest(expected, size, name);
+			for (curr = name; (check->flags & MOUNT_UPPER) && *curr; ++curr)
+			{
+				*curr = ((*curr >= 'a') && (*curr <= 'f')) ? (char)(*curr - 'a' + 'A') : *curr;
+			}
+			path = name;
+		}
+
+		ret = testReadFile(context, path, buffer, MOUNT_LARGEST);
+
+		if ((check->flags & MOUNT_MISSING) ? (ret >= 0) : ((ret != (int)size) || memcmp(buffer, expected, size)))
+		{
+			fprintf(stderr, "%s: Unexpected result opening \"%s\" (%d)\n", stage, path, ret);
+			failed = 1;
+		}
+	}
+
+	return failed ? -1 : 0;
+}
+
+int testMount(const TestEnvironment* env)
+{
+	unsigned char* expected = malloc(MOUNT_LARGEST);
+	unsigned char* buffer = malloc(MOUNT_LARGEST);
+	StreamerContext* context = 0;
+	int failed = 0, b, c;
+
+	if (!expected || !buffer)
+	{
+		fprintf(stderr, "Failed to allocate mount buffers\n");
+		failed = 1;
+	}
+	else if ((testWriteTree(env, "mount_a", s_filesA, sizeof(s_filesA) / sizeof(s_filesA[0])) < 0) || (testWriteTree(env, "mount_b", s_filesB, sizeof(s_filesB) / sizeof(s_filesB[0])) < 0) || (testWriteTree(env, "mount_c", s_filesC, sizeof(s_filesC) / sizeof(s_filesC[0])) < 0))
+	{
+		failed = 1;
+	}
+	else if ((testBuildArchive(env, "mount_a", "mount_a", "") < 0) || (testBuildArchive(env, "mount_b", "mount_b", "") < 0) || (testBuildArchive(env, "mount_c", "mount_c", "") < 0))
+	{
+		failed = 1;
+	}
+	else if (!(context = testOpenArchive(env, StreamerTransport_FileIo, "mount_a")))
+	{
+		failed = 1;
+	}
+
+	// Sources come and go in a different order than they were mounted, and a lone source is not indexed at all
+
+	if (!failed)
+	{
+		failed = ((b = mountAdd(env, context, "mount_b", 1)) < 0) || ((c = mountAdd(env, context, "mount_c", 0)) < 0);
+		failed = failed || (mountCheck(context, "all mounted", s_all, sizeof(s_all) / sizeof(s_all[0]), expected, buffer) < 0);
+
+		failed = failed || (mountRemove(context, b) < 0);
+		failed = failed || (mountCheck(context, "b unmounted", s_withoutB, sizeof(s_withoutB) / sizeof(s_withoutB[0]), expected, buffer) < 0);
+
+		failed = failed || (mountRemove(context, c) < 0);
+		failed = failed || (mountCheck(context, "c unmounted", s_onlyA, sizeof(s_onlyA) / sizeof(s_onlyA[0]), expected, buffer) < 0);
+
+		failed = failed || (mountAdd(env, context, "mount_b", 1) < 0) || (mountAdd(env, context, "mount_c", 2) < 0);
+		failed = failed || (mountCheck(context, "remounted", s_remounted, sizeof(s_remounted) / sizeof(s_remounted[0]), expected, buffer) < 0);
+	}
+
+	if (context)
+	{
+		streamerDestroyContext(context);
+	}
+
+	free(expected);
+	free(buffer);
+	return failed ? -1 : 0;
+}
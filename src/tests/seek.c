@@ -0,0 +1,324 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "tests.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEEK_OPERATIONS (1500)
+#define SEEK_LARGEST_READ (512 * 1024)
+#define SEEK_CACHE_SIZE (4 * 1024 * 1024)	// Size of the decompressed block cache
+
+typedef struct SeekArchive
+{
+	const char* name;
+	const char* options;
+	unsigned int blockSize;
+} SeekArchive;
+
+// The large file is twice the size of the block cache, so random reads evict blocks whatever the block size
+
+static const TestFile s_files[] =
+{
+	{ "large.bin", 2 * SEEK_CACHE_SIZE, 1 },
+	{ "medium.bin", 1536 * 1024 + 123, 2 },
+	{ "small/small.bin", 5000, 3 }
+};
+
+static const TestFile s_otherFiles[] =
+{
+	{ "large.bin", 2 * SEEK_CACHE_SIZE, 11 },
+	{ "medium.bin", 1536 * 1024 + 123, 12 },
+	{ "small/small.bin", 5000, 13 }
+};
+
+static const SeekArchive s_archives[] =
+{
+	{ "seek_16", "--block-size 16", 16 },
+	{ "seek_16_paged", "--block-size 16 --pack-toc", 16 },
+	{ "seek_64", "", 64 },
+	{ "seek_64_paged", "--pack-toc", 64 },
+	{ "seek_256", "--block-size 256", 256 },
+	{ "seek_256_paged", "--block-size 256 --pack-toc", 256 },
+	{ "seek_1024", "--block-size 1024", 1024 },
+	{ "seek_1024_paged", "--block-size 1024 --pack-toc", 1024 },
+
+	// Read right after seek_16 is closed, blocks it left in the block cache must not be returned for this one
+
+	{ "seek_other_16", "--block-size 16", 16 }
+};
+
+#define SEEK_FILES (sizeof(s_files) / sizeof(s_files[0]))
+#define SEEK_ARCHIVES (sizeof(s_archives) / sizeof(s_archives[0]))
+
+static unsigned int seekRandom(unsigned int* state)
+{
+	*state = *state * 1664525 + 1013904223;
+	return *state >> 8;
+}
+
+static int seekMove(StreamerContext* context, int fd, StreamerOffset position, StreamerOffset target, StreamerOffset size, unsigned int mode)
+{
+	int ret;
+
+	switch (mode % 4)
+	{
+		case 0: ret = streamerContextLSeek64(context, fd, target, StreamerSeekMode_Set); break;
+		case 1: ret = streamerContextLSeek64(context, fd, target - position, StreamerSeekMode_Current); break;
+		case 2: ret = streamerContextLSeek64(context, fd, target - size, StreamerSeekMode_End); break;
+		default: ret = streamerContextLSeek(context, fd, (int)target, StreamerSeekMode_Set); break;
+	}
+
+	ret = ret < 0 ? ret : testWait(context, fd);
+
+	if ((ret < 0) || (((mode % 4) == 3) ? (ret != (int)target) : (ret != 0)) || (streamerContextTell64(context, fd) != target))
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+static StreamerContext* seekOpenArchive(const TestEnvironment* env, const char* archive, const StreamerDeviceModel* model)
+{
+	StreamerContext* context = testOpenArchive(env, model ? StreamerTransport_Simulated : StreamerTransport_FileIo, archive);
+
+	if (context && model && (streamerContextSetDeviceModel(context, model) < 0))
+	{
+		fprintf(stderr, "Failed to set device model for \"%s\"\n", archive);
+		streamerDestroyContext(context);
+		return 0;
+	}
+
+	return context;
+}
+
+static int seekArchive(const TestEnvironment* env, const SeekArchive* archive, const StreamerDeviceModel* model, unsigned char** contents, unsigned char* buffer)
+{
+	const TestFile* files = strstr(archive->name, "other") ? s_otherFiles : s_files;
+	StreamerOffset positions[SEEK_FILES];
+	unsigned int state = 1, i;
+	StreamerContext* context;
+	StreamerStats stats;
+	int fds[SEEK_FILES];
+	int failed = 0;
+
+	context = seekOpenArchive(env, archive->name, model);
+	if (!context)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < SEEK_FILES; ++i)
+	{
+		fds[i] = streamerContextOpen(context, files[i].path, StreamerOpenMode_Read);
+		if ((fds[i] < 0) || (testWait(context, fds[i]) < 0))
+		{
+			fprintf(stderr, "%s: Failed to open \"%s\"\n", archive->name, files[i].path);
+			streamerDestroyContext(context);
+			return -1;
+		}
+		positions[i] = 0;
+	}
+
+	// Reads from the start of a file in large pieces, which is where decompression is spread over the workers
+
+	for (i = 0; (i < SEEK_FILES) && !failed; ++i)
+	{
+		unsigned int offset = 0, length = SEEK_LARGEST_READ;
+		int ret;
+
+		do
+		{
+			unsigned int expected = (files[i].size - offset) < length ? (files[i].size - offset) : length;
+
+			ret = streamerContextRead(context, fds[i], buffer, length);
+			ret = ret < 0 ? ret : testWait(context, fds[i]);
+
+			if ((ret != (int)expected) || memcmp(buffer, contents[i] + offset, expected))
+			{
+				fprintf(stderr, "%s: Mismatch reading %u bytes of \"%s\" at %u (%d)\n", archive->name, length, files[i].path, offset, ret);
+				failed = 1;
+				break;
+			}
+
+			offset += expected;
+			length = SEEK_LARGEST_READ - (offset % 4096);
+		}
+		while (ret > 0);
+
+		positions[i] = offset;
+	}
+
+	for (i = 0; (i < SEEK_OPERATIONS) && !failed; ++i)
+	{
+		unsigned int index = seekRandom(&state) % SEEK_FILES;
+		unsigned int size = files[index].size;
+		unsigned int choice = seekRandom(&state);
+		unsigned int target, length, expected;
+		int fd = fds[index], ret;
+
+		// Mostly uniform offsets, with a share right at the end of the file and reads of every size class
+
+		target = (choice % 8) ? seekRandom(&state) % (size + 1) : size - seekRandom(&state) % 64;
+
+		switch ((choice >> 3) % 3)
+		{
+			case 0: length = 1 + seekRandom(&state) % 64; break;
+			case 1: length = 1 + seekRandom(&state) % (64 * 1024); break;
+			default: length = 1 + seekRandom(&state) % SEEK_LARGEST_READ; break;
+		}
+
+		if ((choice % 5) && (seekMove(context, fd, positions[index], target, size, choice >> 5) < 0))
+		{
+			fprintf(stderr, "%s: Failed seeking \"%s\" to %u\n", archive->name, files[index].path, target);
+			failed = 1;
+			break;
+		}
+
+		// Reads without a seek first continue from where the last one stopped
+
+		target = (choice % 5) ? target : (unsigned int)positions[index];
+		expected = (size - target) < length ? (size - target) : length;
+
+		ret = streamerContextRead(context, fd, buffer, length);
+		ret = ret < 0 ? ret : testWait(context, fd);
+
+		if ((ret != (int)expected) || memcmp(buffer, contents[index] + target, expected))
+		{
+			fprintf(stderr, "%s: Mismatch reading %u bytes of \"%s\" at %u (%d)\n", archive->name, length, files[index].path, target, ret);
+			failed = 1;
+			break;
+		}
+
+		positions[index] = target + expected;
+
+		// A seek beyond the end fails and leaves the position alone
+
+		if (!(choice % 61))
+		{
+			ret = streamerContextLSeek64(context, fd, (StreamerOffset)size + 1, StreamerSeekMode_Set);
+			ret = ret < 0 ? ret : testWait(context, fd);
+
+			if ((ret >= 0) || (streamerContextTell64(context, fd) != positions[index]))
+			{
+				fprintf(stderr, "%s: Seek beyond end of \"%s\" did not fail cleanly\n", archive->name, files[index].path);
+				failed = 1;
+			}
+		}
+	}
+
+	for (i = 0; i < SEEK_FILES; ++i)
+	{
+		if ((streamerContextClose(context, fds[i]) < 0) || (testWait(context, fds[i]) < 0))
+		{
+			failed = 1;
+		}
+	}
+
+	// Make sure the block cache was cycled through rather than holding every block that was read, and that blocks of
+	// every size were served from it rather than only the single block of the small file
+
+	if ((streamerContextGetStats(context, &stats) < 0) || (stats.blockMisses <= SEEK_CACHE_SIZE / (archive->blockSize * 1024)) || (stats.blockHits * 4 < stats.blockMisses))
+	{
+		fprintf(stderr, "%s: Block cache was not exercised (%u hits, %u misses)\n", archive->name, (unsigned int)stats.blockHits, (unsigned int)stats.blockMisses);
+		failed = 1;
+	}
+
+	streamerDestroyContext(context);
+	return failed ? -1 : 0;
+}
+
+static int seekPass(const TestEnvironment* env, int workers, const StreamerDeviceModel* model, unsigned char** contents, unsigned char* buffer)
+{
+	StreamerContext* keep;
+	unsigned int i;
+	int failed = 0;
+
+	streamerSetDecompressionWorkers(workers);
+
+	// Keeping another archive open holds on to the block cache and decompressor between the archives under test
+
+	keep = seekOpenArchive(env, "seek_16_paged", model);
+	if (!keep || (testReadFile(keep, s_files[2].path, buffer, SEEK_LARGEST_READ) != (int)s_files[2].size))
+	{
+		fprintf(stderr, "Failed reading through shared archive\n");
+		failed = 1;
+	}
+
+	for (i = 0; (i < SEEK_ARCHIVES) && !failed; ++i)
+	{
+		if (seekArchive(env, &(s_archives[i]), model, strstr(s_archives[i].name, "other") ? contents + SEEK_FILES : contents, buffer) < 0)
+		{
+			fprintf(stderr, "Seek test failed on %s with %d decompression workers\n", s_archives[i].name, workers);
+			failed = 1;
+		}
+	}
+
+	if (keep)
+	{
+		streamerDestroyContext(keep);
+	}
+
+	streamerSetDecompressionWorkers(-1);
+	return failed ? -1 : 0;
+}
+
+int testSeek(const TestEnvironment* env)
+{
+	unsigned char* contents[SEEK_FILES * 2];
+	unsigned char* buffer = malloc(SEEK_LARGEST_READ);
+	StreamerDeviceModel model;
+	unsigned int i;
+	int failed = 0;
+
+	memset(contents, 0, sizeof(contents));
+
+	for (i = 0; i < SEEK_FILES; ++i)
+	{
+		contents[i] = malloc(s_files[i].size);
+		contents[SEEK_FILES + i] = malloc(s_otherFiles[i].size);
+		failed |= !contents[i] || !contents[SEEK_FILES + i];
+	}
+
+	if (failed || !buffer)
+	{
+		fprintf(stderr, "Failed to allocate seek buffers\n");
+		failed = 1;
+	}
+	else if ((testWriteTree(env, "seek", s_files, SEEK_FILES) < 0) || (testWriteTree(env, "seek_other", s_otherFiles, SEEK_FILES) < 0))
+	{
+		failed = 1;
+	}
+	else
+	{
+		for (i = 0; (i < SEEK_ARCHIVES) && !failed; ++i)
+		{
+			failed = testBuildArchive(env, strstr(s_archives[i].name, "other") ? "seek_other" : "seek", s_archives[i].name, s_archives[i].options) < 0;
+		}
+
+		for (i = 0; i < SEEK_FILES; ++i)
+		{
+			testFill(s_files[i].seed, contents[i], s_files[i].size);
+			testFill(s_otherFiles[i].seed, contents[SEEK_FILES + i], s_otherFiles[i].size);
+		}
+
+		// Once with decompression on the calling thread, and once with blocks spread over worker threads. The second
+		// pass reads from a simulated device that sleeps for its transfers, so the workers get to run even when the
+		// machine has a single core
+
+		memset(&model, 0, sizeof(model));
+		model.bandwidth = 256 * 1024;
+		model.capacity = 64;
+
+		failed = failed || (seekPass(env, 0, 0, contents, buffer) < 0) || (seekPass(env, 3, &model, contents, buffer) < 0);
+	}
+
+	for (i = 0; i < sizeof(contents) / sizeof(contents[0]); ++i)
+	{
+		free(contents[i]);
+	}
+	free(buffer);
+	return failed ? -1 : 0;
+}
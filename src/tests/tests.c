@@ -0,0 +1,393 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "tests.h"
+
+#include <sha1/sha1.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(STREAMER_WIN32)
+#include <windows.h>
+#include <direct.h>
+#include <errno.h>
+#elif defined(STREAMER_UNIX)
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#endif
+
+#define TEST_READ_SIZE (64 * 1024)
+
+typedef struct TestSuite
+{
+	const char* name;
+	int (*run)(const TestEnvironment* env);
+} TestSuite;
+
+static const TestSuite s_suites[] =
+{
+	{ "lookup", testLookup },
+	{ "mount", testMount },
+	{ "seek", testSeek },
+	{ "verify", testVerify }
+};
+
+static const char* s_phrases[] =
+{
+	"streamer ", "archive ", "block ", "entry ", "container ", "footer ", "texture ", "mesh ", "sound ", "level "
+};
+
+static unsigned int testRandom(unsigned int* state)
+{
+	*state = *state * 1664525 + 1013904223;
+	return *state >> 8;
+}
+
+void testFill(unsigned int seed, unsigned char* buffer, unsigned int length)
+{
+	unsigned int state = seed * 2654435761u + 1;
+	unsigned int offset = 0;
+
+	while (offset < length)
+	{
+		unsigned int run = 256 + testRandom(&state) % 4096;
+		unsigned int mode = testRandom(&state) % 4;
+		unsigned int i;
+
+		run = run < (length - offset) ? run : (length - offset);
+
+		switch (mode)
+		{
+			case 0:
+			{
+				unsigned int value = testRandom(&state) & 0xff;
+
+				memset(buffer + offset, (int)value, run);
+			}
+			break;
+
+			case 1:
+			{
+				for (i = 0; i < run; ++i)
+				{
+					buffer[offset + i] = (unsigned char)testRandom(&state);
+				}
+			}
+			break;
+
+			default:
+			{
+				for (i = 0; i < run;)
+				{
+					const char* phrase = s_phrases[testRandom(&state) % (sizeof(s_phrases) / sizeof(s_phrases[0]))];
+					unsigned int count = (unsigned int)strlen(phrase);
+
+					count = count < (run - i) ? count : (run - i);
+					memcpy(buffer + offset + i, phrase, count);
+					i += count;
+				}
+			}
+			break;
+		}
+
+		offset += run;
+	}
+}
+
+void testDigest(const unsigned char* data, unsigned int length, char* name)
+{
+	SHA1Context state;
+	int i;
+
+	SHA1Reset(&state);
+	SHA1Input(&state, data, length);
+	SHA1Result(&state);
+
+	name[0] = '@';
+	for (i = 0; i < 20; ++i)
+	{
+		sprintf(name + 1 + i * 2, "%02x", (state.Message_Digest[i / 4] >> ((3 - (i & 3)) * 8)) & 0xff);
+	}
+}
+
+static int testMakeDirectory(const char* path)
+{
+#if defined(STREAMER_WIN32)
+	return (_mkdir(path) == 0) || (errno == EEXIST) ? 0 : -1;
+#else
+	struct stat info;
+
+	if (!stat(path, &info))
+	{
+		return S_ISDIR(info.st_mode) ? 0 : -1;
+	}
+	return mkdir(path, 0755);
+#endif
+}
+
+int testWriteFile(const TestEnvironment* env, const char* tree, const char* file, const unsigned char* data, unsigned int length)
+{
+	char path[512];
+	char* curr;
+	FILE* fp;
+
+	// Create the tree and the directories leading up to the file
+
+	sprintf(path, "%s%s/%s", env->work, tree, file);
+	for (curr = path + strlen(env->work); (curr = strchr(curr, '/')) != NULL; ++curr)
+	{
+		int result;
+
+		*curr = '\0';
+		result = testMakeDirectory(path);
+		*curr = '/';
+
+		if (result < 0)
+		{
+			fprintf(stderr, "Failed to create directory for \"%s\"\n", path);
+			return -1;
+		}
+	}
+
+	fp = fopen(path, "wb");
+	if (!fp || (fwrite(data, 1, length, fp) != length))
+	{
+		fprintf(stderr, "Failed writing \"%s\"\n", path);
+		if (fp)
+		{
+			fclose(fp);
+		}
+		return -1;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+int testWriteTree(const TestEnvironment* env, const char* tree, const TestFile* files, unsigned int count)
+{
+	unsigned char* buffer = 0;
+	unsigned int capacity = 0, i;
+	int result = 0;
+
+	for (i = 0; (i < count) && !result; ++i)
+	{
+		const TestFile* file = &(files[i]);
+
+		if (file->size > capacity)
+		{
+			free(buffer);
+			capacity = file->size;
+			buffer = malloc(capacity);
+		}
+
+		if (file->size && !buffer)
+		{
+			result = -1;
+			break;
+		}
+
+		testFill(file->seed, buffer, file->size);
+		result = testWriteFile(env, tree, file->path, buffer, file->size);
+	}
+
+	free(buffer);
+	return result;
+}
+
+int testBuildArchive(const TestEnvironment* env, const char* tree, const char* archive, const char* options)
+{
+	char command[1024];
+
+	// cmd.exe strips the outermost quotes, so the whole command is quoted once more there
+
+#if defined(STREAMER_WIN32)
+	sprintf(command, "\"\"%s\" %s \"%s%s\" \"%s%s.far\"\"", env->far, options, env->work, tree, env->work, archive);
+#else
+	sprintf(command, "\"%s\" %s \"%s%s\" \"%s%s.far\" > /dev/null", env->far, options, env->work, tree, env->work, archive);
+#endif
+
+	if (system(command) != 0)
+	{
+		fprintf(stderr, "Failed building archive \"%s%s.far\"\n", env->work, archive);
+		return -1;
+	}
+
+	return 0;
+}
+
+StreamerContext* testOpenArchive(const TestEnvironment* env, StreamerTransport transport, const char* archive)
+{
+	StreamerContext* context;
+	char path[512];
+
+	sprintf(path, "%s%s.far", env->work, archive);
+
+	context = streamerCreateContext(transport, StreamerContainer_FileArchive, "", path);
+	if (!context)
+	{
+		fprintf(stderr, "Failed to open archive \"%s\"\n", path);
+	}
+
+	return context;
+}
+
+int testWait(StreamerContext* context, int fd)
+{
+	int ret;
+
+	while ((ret = streamerContextPoll(context, fd)) == StreamerResult_Pending)
+	{
+#if defined(STREAMER_WIN32)
+		SleepEx(0, TRUE);
+#elif defined(STREAMER_UNIX)
+		struct timespec req = { 0, 1000 };
+		nanosleep(&req, 0);
+#endif
+	}
+
+	return ret;
+}
+
+int testReadFile(StreamerContext* context, const char* path, unsigned char* buffer, unsigned int capacity)
+{
+	unsigned int total = 0;
+	int fd, ret;
+
+	fd = streamerContextOpen(context, path, StreamerOpenMode_Read);
+	if ((fd < 0) || (testWait(context, fd) < 0))
+	{
+		return -1;
+	}
+
+	do
+	{
+		unsigned int length = (capacity - total) < TEST_READ_SIZE ? (capacity - total) : TEST_READ_SIZE;
+
+		// Reading one byte past capacity tells a full buffer apart from a file that is too large
+
+		if (!length)
+		{
+			unsigned char extra;
+
+			ret = streamerContextRead(context, fd, &extra, 1);
+			ret = ret < 0 ? ret : testWait(context, fd);
+			ret = ret > 0 ? -1 : ret;
+			break;
+		}
+
+		ret = streamerContextRead(context, fd, buffer + total, length);
+		ret = ret < 0 ? ret : testWait(context, fd);
+		total += ret > 0 ? (unsigned int)ret : 0;
+	}
+	while (ret > 0);
+
+	if ((streamerContextClose(context, fd) < 0) || (testWait(context, fd) < 0))
+	{
+		return -1;
+	}
+
+	return ret < 0 ? ret : (int)total;
+}
+
+static void testUsage()
+{
+	unsigned int i;
+
+	fprintf(stderr, "\nStreamer tests - check archive reading against generated trees\n\n");
+	fprintf(stderr, "Usage: tests [options] [suite...]\n\n");
+	fprintf(stderr, "  --far <file>  Archive builder to pack trees with (default: far)\n");
+	fprintf(stderr, "  --work <dir>  Working directory for trees and archives (default: tests.work)\n\n");
+	fprintf(stderr, "Suites:");
+	for (i = 0; i < sizeof(s_suites) / sizeof(s_suites[0]); ++i)
+	{
+		fprintf(stderr, " %s", s_suites[i].name);
+	}
+	fprintf(stderr, " (default: all)\n\n");
+}
+
+int main(int argc, char* argv[])
+{
+	const char* work = "tests.work";
+	const char* selected[sizeof(s_suites) / sizeof(s_suites[0])];
+	unsigned int count = 0, failed = 0, i, j;
+	TestEnvironment env;
+
+	env.far = "far";
+
+	for (i = 1; i < (unsigned int)argc; ++i)
+	{
+		const char* value = (i + 1) < (unsigned int)argc ? argv[i + 1] : 0;
+
+		if (value && !strcmp(argv[i], "--far"))
+		{
+			env.far = value;
+			++i;
+		}
+		else if (value && !strcmp(argv[i], "--work"))
+		{
+			work = value;
+			++i;
+		}
+		else
+		{
+			for (j = 0; j < sizeof(s_suites) / sizeof(s_suites[0]); ++j)
+			{
+				if (!strcmp(argv[i], s_suites[j].name))
+				{
+					break;
+				}
+			}
+
+			if ((j == sizeof(s_suites) / sizeof(s_suites[0])) || (count == sizeof(selected) / sizeof(selected[0])))
+			{
+				testUsage();
+				return 1;
+			}
+
+			selected[count++] = s_suites[j].name;
+		}
+	}
+
+	if ((strlen(work) + 2) > sizeof(env.work))
+	{
+		fprintf(stderr, "Working directory path too long\n");
+		return 1;
+	}
+
+	sprintf(env.work, "%s/", work);
+	if (testMakeDirectory(work) < 0)
+	{
+		fprintf(stderr, "Failed to create \"%s\"\n", work);
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(s_suites) / sizeof(s_suites[0]); ++i)
+	{
+		int run = !count;
+
+		for (j = 0; j < count; ++j)
+		{
+			run = run || !strcmp(selected[j], s_suites[i].name);
+		}
+
+		if (!run)
+		{
+			continue;
+		}
+
+		if (s_suites[i].run(&env) < 0)
+		{
+			fprintf(stdout, "%s: FAILED\n", s_suites[i].name);
+			++failed;
+		}
+		else
+		{
+			fprintf(stdout, "%s: passed\n", s_suites[i].name);
+		}
+	}
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+#ifndef streamer_tests_tests_h
+#define streamer_tests_tests_h
+
+#include <streamer/streamer.h>
+
+typedef struct TestFile
+{
+	char path[64];		// Path relative to tree root
+	unsigned int size;
+	unsigned int seed;	// Files with the same seed and size have the same contents
+} TestFile;
+
+typedef struct TestEnvironment
+{
+	const char* far;	// Archive builder used to pack the generated trees
+	char work[224];		// Working directory, with trailing separator
+} TestEnvironment;
+
+/**
+ *
+ * Generate file contents, mixing runs that compress well with runs that do not
+ *
+**/
+void testFill(unsigned int seed, unsigned char* buffer, unsigned int length);
+
+/**
+ *
+ * Format the content hash path of data, '@' followed by 40 hex digits and a terminator
+ *
+**/
+void testDigest(const unsigned char* data, unsigned int length, char* name);
+
+/**
+ *
+ * Write a file to a tree below the working directory, creating the directories leading up to it
+ *
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int testWriteFile(const TestEnvironment* env, const char* tree, const char* file, const unsigned char* data, unsigned int length);
+
+/**
+ *
+ * Write a tree of generated files below the working directory
+ *
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int testWriteTree(const TestEnvironment* env, const char* tree, const TestFile* files, unsigned int count);
+
+/**
+ *
+ * Pack a tree below the working directory into <work><archive>.far
+ *
+ * \param options - Options passed to far ahead of the directory and archive
+ * \return 0 if successful, <0 if an error occured
+ *
+**/
+int testBuildArchive(const TestEnvironment* env, const char* tree, const char* archive, const char* options);
+
+/**
+ *
+ * Create a context reading from <work><archive>.far
+ *
+**/
+StreamerContext* testOpenArchive(const TestEnvironment* env, StreamerTransport transport, const char* archive);
+
+/**
+ *
+ * Wait for the outstanding request on a handle
+ *
+ * \return Result of request
+ *
+**/
+int testWait(StreamerContext* context, int fd);
+
+/**
+ *
+ * Open a file and read all of it
+ *
+ * \return Number of bytes read, <0 if the file could not be opened or read, or did not fit in buffer
+ *
+**/
+int testReadFile(StreamerContext* context, const char* path, unsigned char* buffer, unsigned int capacity);
+
+/**
+ *
+ * Test suites, each returning 0 if all checks passed and <0 otherwise
+ *
+**/
+int testLookup(const TestEnvironment* env);
+int testMount(const TestEnvironment* env);
+int testSeek(const TestEnvironment* env);
+int testVerify(const TestEnvironment* env);
+
+#endif
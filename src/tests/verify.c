@@ -0,0 +1,210 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "tests.h"
+
+#include <streamer/backend/filearchive.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VERIFY_BLOCK_SIZE (16 * 1024)
+#define VERIFY_FILE_SIZE (4 * VERIFY_BLOCK_SIZE)
+#define VERIFY_DAMAGE (100)	// Offset of the damaged byte in the first block
+
+static const char* s_path = "noise.bin";
+
+static int verifyLoad(const char* path, unsigned char** data, unsigned int* length)
+{
+	FILE* fp = fopen(path, "rb");
+	long size;
+
+	*data = 0;
+
+	if (!fp)
+	{
+		fprintf(stderr, "Failed to open \"%s\"\n", path);
+		return -1;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	*data = size > 0 ? malloc(size) : 0;
+	*length = (unsigned int)size;
+
+	if (!*data || (fread(*data, 1, size, fp) != (size_t)size))
+	{
+		fprintf(stderr, "Failed to read \"%s\"\n", path);
+		free(*data);
+		*data = 0;
+		fclose(fp);
+		return -1;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+/**
+ *
+ * Copy the archive with one byte of the first block flipped
+ *
+ * The tree holds a single file, so its first block starts the archive. The block is noise and stored, which makes
+ * the damage show up as exactly one changed byte when reading without verification
+ *
+**/
+static int verifyDamage(const TestEnvironment* env)
+{
+	unsigned char* data;
+	unsigned int length;
+	fa_block_crc_t header;
+	char path[512];
+	FILE* fp;
+
+	sprintf(path, "%sverify.far", env->work);
+	if (verifyLoad(path, &data, &length) < 0)
+	{
+		return -1;
+	}
+
+	memcpy(&header, data, sizeof(header));
+	if (!(header.compressed & FA_COMPRESSION_SIZE_IGNORE_32) || (header.original != VERIFY_BLOCK_SIZE))
+	{
+		fprintf(stderr, "First block of \"%s\" is not a stored block\n", path);
+		free(data);
+		return -1;
+	}
+
+	data[sizeof(header) + VERIFY_DAMAGE] ^= 0x01;
+
+	sprintf(path, "%sverify_damaged.far", env->work);
+	fp = fopen(path, "wb");
+	if (!fp || (fwrite(data, 1, length, fp) != length))
+	{
+		fprintf(stderr, "Failed writing \"%s\"\n", path);
+		if (fp)
+		{
+			fclose(fp);
+		}
+		free(data);
+		return -1;
+	}
+
+	fclose(fp);
+	free(data);
+	return 0;
+}
+
+static int verifyRead(const TestEnvironment* env, const char* archive, int verify, const unsigned char* expected, unsigned char* buffer)
+{
+	StreamerContext* context;
+	StreamerStats stats;
+	int damaged = strstr(archive, "damaged") != NULL;
+	int failed = 0, fd, ret;
+
+	context = testOpenArchive(env, StreamerTransport_FileIo, archive);
+	if (!context)
+	{
+		return -1;
+	}
+
+	if (streamerContextSetVerify(context, verify) < 0)
+	{
+		fprintf(stderr, "%s: Failed to set verification\n", archive);
+		streamerDestroyContext(context);
+		return -1;
+	}
+
+	// Damaged blocks fail when verifying and come back as they are otherwise
+
+	ret = testReadFile(context, s_path, buffer, VERIFY_FILE_SIZE);
+	if (damaged && verify ? (ret >= 0) : ((ret != VERIFY_FILE_SIZE) || memcmp(buffer, expected, VERIFY_FILE_SIZE)))
+	{
+		fprintf(stderr, "%s: Unexpected result reading \"%s\" with verification %s (%d)\n", archive, s_path, verify ? "on" : "off", ret);
+		failed = 1;
+	}
+
+	// Blocks after the damaged one still read fine
+
+	fd = streamerContextOpen(context, s_path, StreamerOpenMode_Read);
+	ret = (fd < 0) ? fd : testWait(context, fd);
+	ret = (ret < 0) ? ret : streamerContextLSeek64(context, fd, VERIFY_BLOCK_SIZE, StreamerSeekMode_Set);
+	ret = (ret < 0) ? ret : testWait(context, fd);
+	ret = (ret < 0) ? ret : streamerContextRead(context, fd, buffer, VERIFY_FILE_SIZE - VERIFY_BLOCK_SIZE);
+	ret = (ret < 0) ? ret : testWait(context, fd);
+
+	if ((ret != (VERIFY_FILE_SIZE - VERIFY_BLOCK_SIZE)) || memcmp(buffer, expected + VERIFY_BLOCK_SIZE, VERIFY_FILE_SIZE - VERIFY_BLOCK_SIZE))
+	{
+		fprintf(stderr, "%s: Failed reading past the first block with verification %s (%d)\n", archive, verify ? "on" : "off", ret);
+		failed = 1;
+	}
+
+	if ((fd >= 0) && ((streamerContextClose(context, fd) < 0) || (testWait(context, fd) < 0)))
+	{
+		failed = 1;
+	}
+
+	if ((streamerContextGetStats(context, &stats) < 0) || ((stats.checksumErrors > 0) != (damaged && verify)))
+	{
+		fprintf(stderr, "%s: Unexpected checksum error count %u with verification %s\n", archive, (unsigned int)stats.checksumErrors, verify ? "on" : "off");
+		failed = 1;
+	}
+
+	streamerDestroyContext(context);
+	return failed ? -1 : 0;
+}
+
+int testVerify(const TestEnvironment* env)
+{
+	unsigned char* original = malloc(VERIFY_FILE_SIZE);
+	unsigned char* damaged = malloc(VERIFY_FILE_SIZE);
+	unsigned char* buffer = malloc(VERIFY_FILE_SIZE);
+	unsigned int state = 1, i;
+	int failed = 0, workers;
+
+	if (!original || !damaged || !buffer)
+	{
+		fprintf(stderr, "Failed to allocate verify buffers\n");
+		free(original);
+		free(damaged);
+		free(buffer);
+		return -1;
+	}
+
+	// A block of noise that far stores as is, followed by blocks that compress
+
+	for (i = 0; i < VERIFY_BLOCK_SIZE; ++i)
+	{
+		state = state * 1664525 + 1013904223;
+		original[i] = (unsigned char)(state >> 24);
+	}
+	testFill(1, original + VERIFY_BLOCK_SIZE, VERIFY_FILE_SIZE - VERIFY_BLOCK_SIZE);
+
+	memcpy(damaged, original, VERIFY_FILE_SIZE);
+	damaged[VERIFY_DAMAGE] ^= 0x01;
+
+	if ((testWriteFile(env, "verify", s_path, original, VERIFY_FILE_SIZE) < 0) || (testBuildArchive(env, "verify", "verify", "--checksums --block-size 16") < 0) || (verifyDamage(env) < 0))
+	{
+		failed = 1;
+	}
+
+	// Blocks are checked on the calling thread and, for reads large enough to be pipelined, on the workers
+
+	for (workers = 0; (workers < 4) && !failed; workers += 3)
+	{
+		streamerSetDecompressionWorkers(workers);
+
+		failed |= verifyRead(env, "verify", 1, original, buffer) < 0;
+		failed |= verifyRead(env, "verify_damaged", 1, damaged, buffer) < 0;
+		failed |= verifyRead(env, "verify_damaged", 0, damaged, buffer) < 0;
+
+		streamerSetDecompressionWorkers(-1);
+	}
+
+	free(original);
+	free(damaged);
+	free(buffer);
+	return failed ? -1 : 0;
+}
@@ -157,5 +157,81 @@ Program
 	Depends = { "streamer", "contrib.fastlz", "contrib.sha1" }
 }
 
+---------------
+-- Benchmark --
+---------------
+
+Program
+{
+	Name = "streamer.bench",
+	Config = { "win*-*-*-*", "macosx-*-*-*", "linux-*-*-*" },
+
+	Sources = {
+		Glob { Dir = "src/bench", Extensions = { ".c" } }
+	},
+
+	Env = {
+		CPPPATH = { "src", "src/contrib" }
+	},
+
+	Depends = { "streamer", "contrib.sha1" }
+}
+
+Program
+{
+	Name = "streamer.replay",
+	Config = { "win*-*-*-*", "macosx-*-*-*", "linux-*-*-*" },
+
+	Sources = {
+		Glob { Dir = "src/replay", Extensions = { ".c" } }
+	},
+
+	Env = {
+		CPPPATH = "src"
+	},
+
+	Depends = { "streamer" }
+}
+
+-----------
+-- Tests --
+-----------
+
+Program
+{
+	Name = "streamer.tests",
+	Config = { "win*-*-*-*", "macosx-*-*-*", "linux-*-*-*" },
+
+	Sources = {
+		Glob { Dir = "src/tests", Extensions = { ".c" } }
+	},
+
+	Env = {
+		CPPPATH = { "src", "src/contrib" }
+	},
+
+	Depends = { "streamer", "contrib.sha1" }
+}
+
+-----------
+-- Tools --
+-----------
+
+Program
+{
+	Name = "far",
+	Config = { "win*-*-*-*", "macosx-*-*-*", "linux-*-*-*" },
+
+	Sources = {
+		Glob { Dir = "src/far", Extensions = { ".c" } }
+	},
+
+	Env = {
+		CPPPATH = { "src", "src/contrib" }
+	},
+
+	Depends = { "streamer", "contrib.sha1" }
+}
+
 Default "streamer"
 Default "iopstrmr"